@@ -191,6 +191,27 @@ void FORB::toMat8U(const std::vector<TDescriptor> &descriptors,
 
 // --------------------------------------------------------------------------
 
+void FORB::toBinary(const FORB::TDescriptor &a, unsigned char *p)
+{
+  if(a.empty())
+  {
+    std::fill(p, p+FORB::L, 0);
+    return;
+  }
+
+  const unsigned char *d = a.ptr<unsigned char>();
+  std::copy(d, d+FORB::L, p);
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::fromBinary(const cv::Mat &mat, int i, FORB::TDescriptor &a)
+{
+  a = mat.row(i);
+}
+
+// --------------------------------------------------------------------------
+
 } // namespace DBoW2
 
 
@@ -71,6 +71,22 @@ public:
   static void toMat8U(const std::vector<TDescriptor> &descriptors,
     cv::Mat &mat);
 
+  /**
+   * Copies the descriptor into L bytes
+   * @param a descriptor
+   * @param p (out) destination of L bytes
+   */
+  static void toBinary(const TDescriptor &a, unsigned char *p);
+
+  /**
+   * Returns a descriptor referring to a row of a NxL 8U matrix. The data is
+   * not copied, and shared with the matrix.
+   * @param mat NxL 8U matrix
+   * @param i row
+   * @param a (out) descriptor
+   */
+  static void fromBinary(const cv::Mat &mat, int i, TDescriptor &a);
+
 };
 
 } // namespace DBoW2
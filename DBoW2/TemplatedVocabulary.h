@@ -26,6 +26,9 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -246,6 +249,29 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile.
+   * The descriptors are read into a block at once, and the nodes refer to
+   * its rows.
+   * @param filename
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file
+   * @param filename
+   */
+  bool saveToBinaryFile(const std::string &filename) const;
+
+  /**
+   * Loads the vocabulary from a text file through the binary cache 
+   * <filename>.bin. The cache is used if it is newer than the text file,
+   * otherwise the text file is loaded and the cache is (re)created. A file
+   * with the extension .bin is loaded as a binary file.
+   * @param filename
+   */
+  bool loadFromCachedFile(const std::string &filename);
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -293,6 +319,17 @@ protected:
   /// Pointer to descriptor
   typedef const TDescriptor *pDescriptor;
 
+  /// Header of the binary file, followed by weight[N], parent[N], 
+  /// leaf[N] (a byte each) and descriptor[N][D] of the N nodes 
+  struct BinaryHeader
+  {
+    char magic[8];
+    unsigned int version;
+    int k, L, scoring, weighting;
+    unsigned int nnodes; // including the root
+    unsigned int ldesc;  // length of a descriptor in bytes (D)
+  };
+
   /// Tree node
   struct Node 
   {
@@ -1450,6 +1487,173 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename)
+{
+    ifstream f;
+    f.open(filename.c_str(), ios_base::in | ios_base::binary);
+    if(!f.is_open())
+        return false;
+
+    BinaryHeader hdr;
+    f.read((char*)&hdr, sizeof(hdr));
+    if(!f || memcmp(hdr.magic, "DBOW2VB", 8) != 0 || hdr.version != 1 ||
+       hdr.ldesc != (unsigned int)F::L || hdr.nnodes == 0 ||
+       hdr.k<0 || hdr.k>20 || hdr.L<1 || hdr.L>10 || 
+       hdr.scoring<0 || hdr.scoring>5 || hdr.weighting<0 || hdr.weighting>3)
+    {
+        std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+        return false;
+    }
+
+    const size_t N = hdr.nnodes;
+    vector<WordValue> weight(N);
+    vector<NodeId> parent(N);
+    vector<unsigned char> leaf(N);
+    cv::Mat descriptors(N, F::L, CV_8U);
+    f.read((char*)weight.data(), N * sizeof(WordValue));
+    f.read((char*)parent.data(), N * sizeof(NodeId));
+    f.read((char*)leaf.data(), N);
+    f.read((char*)descriptors.data, N * F::L);
+    if(!f)
+    {
+        std::cerr << "Vocabulary loading failure: The binary file is truncated!" << endl;
+        return false;
+    }
+
+    // nodes are stored in the order of creation, the parent comes first
+    vector<unsigned int> nchildren(N, 0);
+    size_t nwords = 0;
+    for(size_t i=1; i<N; i++)
+    {
+        if(parent[i] >= i)
+        {
+            std::cerr << "Vocabulary loading failure: Broken tree in the binary file!" << endl;
+            return false;
+        }
+        nchildren[parent[i]]++;
+        if(leaf[i]) nwords++;
+    }
+
+    m_k = hdr.k;
+    m_L = hdr.L;
+    m_scoring = (ScoringType)hdr.scoring;
+    m_weighting = (WeightingType)hdr.weighting;
+    createScoringObject();
+
+    m_words.clear();
+    m_nodes.clear();
+    m_nodes.resize(N);
+    m_words.reserve(nwords);
+
+    for(size_t i=0; i<N; i++)
+    {
+        Node &node = m_nodes[i];
+        node.id = i;
+        node.weight = weight[i];
+        node.children.reserve(nchildren[i]);
+        if(i == 0)
+            continue;
+
+        node.parent = parent[i];
+        m_nodes[parent[i]].children.push_back(i);
+        F::fromBinary(descriptors, i, node.descriptor);
+
+        if(leaf[i])
+        {
+            node.word_id = m_words.size();
+            m_words.push_back(&node);
+        }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename) const
+{
+    const size_t N = m_nodes.size();
+    BinaryHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "DBOW2VB", 8);
+    hdr.version = 1;
+    hdr.k = m_k;
+    hdr.L = m_L;
+    hdr.scoring = m_scoring;
+    hdr.weighting = m_weighting;
+    hdr.nnodes = N;
+    hdr.ldesc = F::L;
+
+    vector<WordValue> weight(N);
+    vector<NodeId> parent(N, 0);
+    vector<unsigned char> leaf(N, 0);
+    vector<unsigned char> descriptors(N * F::L, 0);
+    for(size_t i=0; i<N; i++)
+    {
+        const Node& node = m_nodes[i];
+        weight[i] = node.weight;
+        if(i == 0)
+            continue;
+        parent[i] = node.parent;
+        leaf[i] = (node.isLeaf() ? 1 : 0);
+        F::toBinary(node.descriptor, &descriptors[i * F::L]);
+    }
+
+    ofstream f;
+    f.open(filename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+    if(!f.is_open())
+        return false;
+
+    f.write((const char*)&hdr, sizeof(hdr));
+    f.write((const char*)weight.data(), N * sizeof(WordValue));
+    f.write((const char*)parent.data(), N * sizeof(NodeId));
+    f.write((const char*)leaf.data(), N);
+    f.write((const char*)descriptors.data(), N * F::L);
+    f.close();
+
+    return !f.fail();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromCachedFile(const std::string &filename)
+{
+    const string ext(".bin");
+    if(filename.size() > ext.size() && 
+       filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0)
+        return loadFromBinaryFile(filename);
+
+    string fcache = filename + ext;
+    struct stat st_txt, st_bin;
+    bool btxt = (stat(filename.c_str(), &st_txt) == 0);
+    bool bbin = (stat(fcache.c_str(), &st_bin) == 0);
+    if(bbin && (!btxt || st_bin.st_mtime >= st_txt.st_mtime))
+    {
+        if(loadFromBinaryFile(fcache))
+            return true;
+        std::cerr << "Vocabulary cache " << fcache << " is not usable." << endl;
+    }
+
+    if(!btxt || !loadFromTextFile(filename))
+        return false;
+
+    // written to a temporary file and renamed, the others never see a 
+    // partially written cache.
+    string ftmp = fcache + ".tmp";
+    if(!saveToBinaryFile(ftmp) || rename(ftmp.c_str(), fcache.c_str()) != 0)
+    {
+        remove(ftmp.c_str());
+        std::cerr << "Failed to save vocabulary cache " << fcache << endl;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -17,6 +17,7 @@
 // along with c_aws.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _WIN32
 #include <signal.h>
+#include <sys/resource.h>
 #endif
 
 #include <cstdio>
@@ -27,6 +28,7 @@
 #include <vector>
 #include <list>
 #include <queue>
+#include <algorithm>
 using namespace std;
 
 #ifdef _WIN32
@@ -38,6 +40,7 @@ using namespace std;
 #include "util/aws_thread.h"
 
 #include "util/c_clock.h"
+#include "util/c_thread_pool.h"
 
 #include <opencv2/opencv.hpp>
 using namespace cv;
@@ -139,14 +142,40 @@ void cmd_proc_loop(const char * prompt, c_aws & aws, istream & in)
 // All filters and channels are discarded.
 // * rcmd <port number>
 // Invoking reciever thread of rcmd with <port number>
-// * trat <int >= 1>
+// * trat <int >= 0>
 // Setting trat. trat enables the faster time clocking. For example, the time goes twice as fast as usual with trat of 2. 
+// trat of 0 enables lock step mode. The clock advances without sleep after all the filters finished their proc() 
+// for the current cycle (including the filters driven by the events caused in the cycle). In a cycle, the filters 
+// run one at a time in the order they were created, so a filter reads the outputs of the filters created before it 
+// in the same cycle, and those created after it in the previous cycle. Then a replay is reproducible as long as 
+// the filters themselves do not depend on the wall clock (e.g. f_aws1_ap's mpc with the deadline mpc_tmax or the 
+// worker threads mpc_nth). The replay rate (sim sec / wall sec) is reported at the end time and stop.
 // Not that, trat is only allowed for offline mode.
+// * fprof <filter name> | fprof n <filter id>
+// Processing time statistics of the filter in micro second are returned. (n, mean, p50, p99, p999, max of proc(), 
+// p99 and max of waiting for the command lock, p99 and max of blocking in channel locks)
+// * fprof reset | fprof csv <file> <sec> | fprof json <file> <sec> | fprof off
+// Resetting statistics of all the filters, or starting/stopping periodic dump of the statistics.
+// * chstat on | chstat off | chstat reset
+// Enabling, disabling or resetting contention and throughput counters of all the channels.
+// * chstat <channel name> | chstat n <channel id>
+// Lock acquisitions, contended acquisitions, total lock wait time, and the number of operations and 
+// bytes published and consumed are returned. 
+// * chstat rank | chstat rank <file>
+// All the channels are ranked by the lock wait time and printed to stdout (or saved to <file> as csv). 
+// Top channels are returned.
+//
+// * Command line option -pool <n>
+// Filters are executed as tasks in a work stealing pool of n worker threads instead of 
+// one thread per filter. n < 0 means the number of hardware threads. Filters blocking
+// in drivers should be configured with "fset <filter> DedicatedThread y".
 
 
 c_aws::c_aws(int argc, char ** argv):CmdAppBase(argc, argv),
 	m_cmd_port(20000), m_working_path(NULL), m_bonline(true), m_exit(false),
-	m_cycle_time(166667), m_time(0), m_time_zone_minute(540), m_time_rate(1)
+	m_cycle_time(166667), m_time(0), m_time_zone_minute(540), m_time_rate(1),
+	m_num_workers(0), m_pool(NULL), m_brunstat(false), 
+	m_bprof_json(false), m_prof_intvl(0), m_prof_tnext(0)
 {
 	set_name_app("aws");
 	set_version(0, 20);
@@ -163,6 +192,9 @@ c_aws::c_aws(int argc, char ** argv):CmdAppBase(argc, argv),
 	add_arg("-tzm", "Time Zone in minutes.");
 	add_val(&m_time_zone_minute, "int");
 
+	add_arg("-pool", "Number of worker threads executing filters. (0: a thread per filter, <0: number of hardware threads)");
+	add_val(&m_num_workers, "int");
+
 	// Initializing filter globals
 	f_base::init(this);
 
@@ -319,9 +351,73 @@ bool c_aws::handle_stop()
 			(*fitr)->runstat();
 	}
 
+	if(m_pool){
+		m_pool->print_stat(cout);
+		m_pool->stop();
+		delete m_pool;
+		m_pool = NULL;
+		f_base::set_pool(NULL);
+	}
+
+#ifndef _WIN32
+	if(m_brunstat)
+		print_rusage();
+#endif
+	m_brunstat = false;
+
 	return true;
 }
 
+#ifndef _WIN32
+// print_rusage prints the resource usage of the process from the last "go".
+// Comparing the context switches and cpu time, the execution models can be evaluated.
+void c_aws::print_rusage()
+{
+	rusage ru;
+	timespec ts;
+	getrusage(RUSAGE_SELF, &ru);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	double twall = (double)(ts.tv_sec - m_ts_start.tv_sec) 
+		+ (double)(ts.tv_nsec - m_ts_start.tv_nsec) * 1e-9;
+	double tusr = (double)(ru.ru_utime.tv_sec - m_ru_start.ru_utime.tv_sec)
+		+ (double)(ru.ru_utime.tv_usec - m_ru_start.ru_utime.tv_usec) * 1e-6;
+	double tsys = (double)(ru.ru_stime.tv_sec - m_ru_start.ru_stime.tv_sec)
+		+ (double)(ru.ru_stime.tv_usec - m_ru_start.ru_stime.tv_usec) * 1e-6;
+
+	int nthreads = 0;
+	for(vector<f_base*>::iterator fitr = m_filters.begin();
+		fitr != m_filters.end(); fitr++){
+		if(!(*fitr)->is_main_thread() && !(*fitr)->is_pooled())
+			nthreads++;
+	}
+
+	cout << "Execution: " << (m_num_workers ? "pool" : "thread per filter")
+		<< " (" << nthreads << " filter threads)" << endl;
+	cout << "Wall time " << twall << " sec, User time " << tusr 
+		<< " sec, System time " << tsys << " sec, CPU load " 
+		<< (twall > 0 ? (tusr + tsys) / twall : 0.) << endl;
+	cout << "Context switches voluntary " << ru.ru_nvcsw - m_ru_start.ru_nvcsw 
+		<< " involuntary " << ru.ru_nivcsw - m_ru_start.ru_nivcsw << endl;
+	if(!m_bonline)
+		print_replay_rate();
+}
+
+// print_replay_rate prints the time replayed from the last "go" per wall time.
+void c_aws::print_replay_rate()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	double twall = (double)(ts.tv_sec - m_ts_start.tv_sec) 
+		+ (double)(ts.tv_nsec - m_ts_start.tv_nsec) * 1e-9;
+	double tsim = (double)(m_time - m_start_time) / (double) SEC;
+
+	cout << "Replayed " << tsim << " sec in " << twall << " sec ("
+		<< (twall > 0 ? tsim / twall : 0.) << " sim sec/wall sec"
+		<< (f_base::m_clk.is_lock_step() ? ", lock step)" : ")") << endl;
+}
+#endif
+
 // handle_run runs all the filters in the graph.
 bool c_aws::handle_chan(s_cmd & cmd)
 {
@@ -520,6 +616,149 @@ bool c_aws::handle_chinf(s_cmd & cmd)
 	return result;
 }
 
+bool c_aws::handle_fprof(s_cmd & cmd)
+{
+	f_base * pfilter = NULL;
+	if(cmd.num_args == 2){
+		pfilter = get_filter(cmd.args[1]);
+		if(pfilter == NULL){
+			if(strcmp(cmd.args[1], "reset") == 0){
+				for(vector<f_base*>::iterator itr = m_filters.begin();
+					itr != m_filters.end(); itr++)
+					(*itr)->reset_prof();
+				return true;
+			}else if(strcmp(cmd.args[1], "off") == 0){
+				if(m_fprof.is_open())
+					m_fprof.close();
+				return true;
+			}
+			snprintf(cmd.get_ret_str(), RET_LEN, "Filter %s was not found.", cmd.args[1]);
+			return false;
+		}
+	}else if(cmd.num_args == 3 && cmd.args[1][0] == 'n'){
+		int ifilter = atoi(cmd.args[2]);
+		if(ifilter < 0 || ifilter >= m_filters.size()){
+			snprintf(cmd.get_ret_str(), RET_LEN, "Filter id=%d does not exist.", ifilter);
+			return false;
+		}
+		pfilter = m_filters[ifilter];
+	}else if(cmd.num_args == 4){
+		bool json;
+		if(strcmp(cmd.args[1], "csv") == 0)
+			json = false;
+		else if(strcmp(cmd.args[1], "json") == 0)
+			json = true;
+		else
+			return false;
+
+		if(m_fprof.is_open())
+			m_fprof.close();
+		m_fprof.open(cmd.args[2]);
+		if(!m_fprof.is_open()){
+			snprintf(cmd.get_ret_str(), RET_LEN, "Failed to open %s.", cmd.args[2]);
+			return false;
+		}
+
+		if(!json)
+			m_fprof << "t,filter,n,mean,p50,p99,p999,max,cmd_p99,cmd_max,ch_p99,ch_max" << endl;
+		m_bprof_json = json;
+		m_prof_intvl = (long long)(atof(cmd.args[3]) * SEC);
+		m_prof_tnext = 0;
+		return true;
+	}else{
+		return false;
+	}
+
+	pfilter->get_prof_info(cmd);
+	return true;
+}
+
+// comparator for chstat rank
+static bool cmp_ch_wait(ch_base * pch0, ch_base * pch1)
+{
+	if(pch0->get_wait_nsec() != pch1->get_wait_nsec())
+		return pch0->get_wait_nsec() > pch1->get_wait_nsec();
+	return pch0->get_count_contended() > pch1->get_count_contended();
+}
+
+bool c_aws::handle_chstat(s_cmd & cmd)
+{
+	ch_base * pch = NULL;
+	if(cmd.num_args == 2 && (pch = get_channel(cmd.args[1])) != NULL){
+		pch->get_stat(cmd);
+		return true;
+	}
+
+	if(cmd.num_args == 3 && strcmp(cmd.args[1], "n") == 0){
+		int ich = atoi(cmd.args[2]);
+		if(ich < 0 || ich >= m_channels.size()){
+			snprintf(cmd.get_ret_str(), RET_LEN, "Channel id=%d does not exist.", ich);
+			return false;
+		}
+		m_channels[ich]->get_stat(cmd);
+		return true;
+	}
+
+	if(cmd.num_args < 2)
+		return false;
+
+	if(strcmp(cmd.args[1], "on") == 0){
+		ch_base::set_stat(true);
+		return true;
+	}else if(strcmp(cmd.args[1], "off") == 0){
+		ch_base::set_stat(false);
+		return true;
+	}else if(strcmp(cmd.args[1], "reset") == 0){
+		for(vector<ch_base*>::iterator itr = m_channels.begin();
+			itr != m_channels.end(); itr++)
+			(*itr)->reset_stat();
+		return true;
+	}else if(strcmp(cmd.args[1], "rank") == 0){
+		vector<ch_base*> chs(m_channels);
+		sort(chs.begin(), chs.end(), cmp_ch_wait);
+
+		s_cmd cmd_stat;
+		ofstream fout;
+		if(cmd.num_args == 3){
+			fout.open(cmd.args[2]);
+			if(!fout.is_open()){
+				snprintf(cmd.get_ret_str(), RET_LEN, "Failed to open %s.", cmd.args[2]);
+				return false;
+			}
+		}
+		ostream & out = (fout.is_open() ? fout : cout);
+
+		// the top channels are packed into the return string as "name:wait(us)"
+		char * ret = cmd.get_ret_str();
+		int len = 0;
+		ret[0] = '\0';
+		for(int ich = 0; ich < chs.size(); ich++){
+			chs[ich]->get_stat(cmd_stat);
+			out << ich << " " << cmd_stat.get_ret_str() << endl;
+
+			if(len < RET_LEN - 64)
+				len += snprintf(ret + len, RET_LEN - len, "%s:%.1f ", 
+					chs[ich]->get_name(), chs[ich]->get_wait_nsec() * 1e-3);
+		}
+		return true;
+	}
+
+	snprintf(cmd.get_ret_str(), RET_LEN, "Channel %s was not found.", cmd.args[1]);
+	return false;
+}
+
+void c_aws::dump_prof()
+{
+	if(m_time < m_prof_tnext)
+		return;
+
+	for(vector<f_base*>::iterator itr = m_filters.begin();
+		itr != m_filters.end(); itr++)
+		(*itr)->dump_prof(m_fprof, m_time, m_bprof_json);
+
+	m_prof_tnext = m_time + m_prof_intvl;
+}
+
 bool c_aws::handle_quit(s_cmd & cmd)
 {
 	bool result = true;
@@ -633,8 +872,14 @@ bool c_aws::handle_trat(s_cmd & cmd)
 		sprintf(cmd.get_ret_str(), "Trat cannot be changed during execution");
 		result = false;
 	}else{
-		m_time_rate = (int) atoi(cmd.args[1]);
-		result = true;
+		int rate = (cmd.num_args == 2 ? atoi(cmd.args[1]) : -1);
+		if(rate < 0){
+			sprintf(cmd.get_ret_str(), "trat should be a non-negative integer.");
+			result = false;
+		}else{
+			m_time_rate = rate;
+			result = true;
+		}
 	}
 	return result;
 }
@@ -712,6 +957,19 @@ bool c_aws::handle_run(s_cmd & cmd)
   m_time = f_base::m_clk.get_time();
   f_base::clock(m_start_time);  
   f_base::init_run_all();
+
+  if(m_num_workers != 0){
+    m_pool = new c_thread_pool;
+    m_pool->start(m_num_workers < 0 ? 0 : m_num_workers);
+    cout << "Worker pool started with " << m_pool->get_num_workers() << " threads." << endl;
+  }
+  f_base::set_pool(m_pool);
+
+#ifndef _WIN32
+  getrusage(RUSAGE_SELF, &m_ru_start);
+  clock_gettime(CLOCK_MONOTONIC, &m_ts_start);
+  m_brunstat = true;
+#endif
   
   // check filter's status. 
   for(vector<f_base*>::iterator fitr = m_filters.begin();
@@ -851,6 +1109,12 @@ void c_aws::proc_command()
 		case CMD_FRM:
 			result = handle_frm(cmd);
 			break;
+		case CMD_FPROF:
+			result = handle_fprof(cmd);
+			break;
+		case CMD_CHSTAT:
+			result = handle_chstat(cmd);
+			break;
 		case CMD_CD:
 			if(cmd.num_args != 2)
 				result = false;
@@ -1008,20 +1272,34 @@ bool c_aws::main(){
 	while(!m_exit){
 		proc_command();
 		if(!f_base::m_clk.is_stop()){
-			// wait the time specified in cyc command.
+			// wait the time specified in cyc command. (no wait in lock step mode)
 			f_base::m_clk.wait();
 
 			// getting current time
+			long long tprev = m_time;
 			m_time = f_base::m_clk.get_time();
 
 			// sending clock signal to each filters. The time string for current time is generated simultaneously
 			f_base::clock(m_time);
 
+			if(m_fprof.is_open())
+				dump_prof();
+
+			// in lock step mode, the filters are executed one by one, and 
+			// the next clock waits for all the filters
+			bool bstep = f_base::m_clk.is_lock_step() && m_time != tprev;
+			if(bstep)
+				f_base::settle(m_filters);
+
 			// checking activity of filters. 
 			for(vector<f_base*>::iterator itr = m_filters.begin(); 
 				itr != m_filters.end(); itr++){
-			  if((*itr)->is_main_thread())
-			    (*itr)->fthread();
+			  if(!bstep){
+			    if((*itr)->is_main_thread())
+			      (*itr)->fthread();
+			    else if((*itr)->is_pooled())
+			      (*itr)->dispatch();
+			  }
 			  if(!(*itr)->is_active()){
 			    cout << (*itr)->get_name() << " stopped." << endl;
 			    f_base::m_clk.stop();
@@ -1031,7 +1309,11 @@ bool c_aws::main(){
 
 			// Time is exceeded over m_end_time, automatically pause.
 			if(!m_bonline && m_time >= m_end_time){
-				f_base::m_clk.pause();
+				if(f_base::m_clk.pause()){
+#ifndef _WIN32
+					print_replay_rate();
+#endif
+				}
 			}
 
 			if(f_base::m_clk.is_stop()){
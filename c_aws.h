@@ -16,7 +16,12 @@
 // You should have received a copy of the GNU General Public License
 // along with c_aws.h.  If not, see <http://www.gnu.org/licenses/>. 
 #include "CmdAppBase/CmdAppBase.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
 class c_rcmd;
+class c_thread_pool;
 
 //////////////////////////////////////////////////////////// class c_aws
 // c_aws is the main class of automatic watch system.
@@ -55,6 +60,25 @@ protected:
 	vector<f_base *> m_filters;
 	vector<ch_base *> m_channels;
 
+	// worker pool executing filters. enabled if m_num_workers is not zero.
+	int m_num_workers;
+	c_thread_pool * m_pool;
+
+	// periodic profile dump. enabled by "fprof csv|json <file> <sec>"
+	ofstream m_fprof;
+	bool m_bprof_json;
+	long long m_prof_intvl, m_prof_tnext;
+	void dump_prof();
+
+	// resource usage at the start of the graph, reported at stop for comparison
+	bool m_brunstat;
+#ifndef _WIN32
+	rusage m_ru_start;
+	timespec m_ts_start;
+	void print_rusage();
+	void print_replay_rate();
+#endif
+
 	bool m_blk_cmd;
 	int skip_space(const char * ptr, int len)
 	{
@@ -106,6 +130,8 @@ protected:
 	bool handle_stop();
 	bool handle_frm(s_cmd & cmd);
 	bool handle_chrm(s_cmd & cmd);
+	bool handle_fprof(s_cmd & cmd);
+	bool handle_chstat(s_cmd & cmd);
 
 public:
 	c_aws(int argc, char ** argv);
@@ -17,6 +17,7 @@
 
 #include "ch_base.h"
 #include "../util/aws_coord.h"
+#include "../util/c_seqlock.h"
 
 enum e_aws1_ctrl_src{
   ACS_UI, ACS_RMT, ACS_AP1, ACS_AP2, ACS_FSET, ACS_NONE
@@ -181,26 +182,29 @@ s_aws1_ctrl_stat():
   }
 };
 
+// control instruction channel. get() reads a seqlocked copy of inst without
+// locking, the writers update inst under the lock and publish it.
 class ch_aws1_ctrl_inst: public ch_base
 {
  protected:
   s_aws1_ctrl_inst inst;
+  c_seqlock<s_aws1_ctrl_inst> m_inst;
   long long m_tfile;
  public:
  ch_aws1_ctrl_inst(const char * name): ch_base(name), m_tfile(0)
     {
+      m_inst.write(inst);
     }
   
   void set(const s_aws1_ctrl_inst & _inst){
     lock();
     inst = _inst;
+    m_inst.write(inst);
     unlock();
   }
   
   void get(s_aws1_ctrl_inst & _inst){
-    lock();
-    _inst = inst;
-    unlock();
+    m_inst.read(_inst);
   }
   
   virtual size_t get_dsize()
@@ -212,6 +216,7 @@ class ch_aws1_ctrl_inst: public ch_base
   {
     lock();
     memcpy((void*)&inst, (void*) buf, sizeof(s_aws1_ctrl_inst));
+    m_inst.write(inst);
     unlock();
     return get_dsize();
   }
@@ -284,6 +289,7 @@ class ch_aws1_ctrl_inst: public ch_base
 			goto eof;
 		sz = sizeof(long long) + sizeof(e_aws1_ctrl_src), sizeof(unsigned char) * 3;
 		m_tfile = inst.tcur;
+		m_inst.write(inst);
 		unlock();			
 	}
     return sz;
@@ -292,6 +298,11 @@ class ch_aws1_ctrl_inst: public ch_base
     return 0;
   }
 
+  virtual bool skip_rec(FILE * pbf, long long & trec)
+  {
+    return skip_fixed_rec(pbf, sizeof(long long) + sizeof(e_aws1_ctrl_src) + sizeof(unsigned char) * 3, 0, trec);
+  }
+
   virtual bool log2txt(FILE * pbf, FILE * ptf)
   {
     int sz = 0;
@@ -416,6 +427,11 @@ public:
     return sz;
   }
 
+  virtual bool skip_rec(FILE * pbf, long long & trec)
+  {
+    return skip_fixed_rec(pbf, sizeof(s_aws1_ctrl_stat), 0, trec);
+  }
+
   virtual bool log2txt(FILE * pbf, FILE * ptf)
   {
     int sz = 0;
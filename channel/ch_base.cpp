@@ -47,6 +47,8 @@ using namespace cv;
 #include "ch_base.h"
 
 CHMap ch_base::m_chmap;
+thread_local long long ch_base::m_lock_wait_nsec = 0;
+atomic<bool> ch_base::m_bstat(false);
 
 ch_base * ch_base::create(const char * type_name, const char * chan_name)
 {	
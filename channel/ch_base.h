@@ -17,6 +17,8 @@
 // along with ch_base.h.  If not, see <http://www.gnu.org/licenses/>. 
 
 #include "../command.h"
+#include "../util/c_lat_hist.h"
+#include "../util/c_log_map.h"
 
 class f_base;
 class ch_base;
@@ -29,6 +31,38 @@ template <class T> ch_base * createChannel(const char * name)
 
 typedef map<const char *, CreateChannel, cmp> CHMap;
 
+// s_evt_signal is the wake up signal of an event driven filter. The filter 
+// registers its signal to the input channels, and the channels notify the 
+// signal every time new data is published. 
+struct s_evt_signal
+{
+	mutex mtx;
+	condition_variable cnd;
+	long long count; // number of notifications received
+
+	s_evt_signal():count(0)
+	{
+	}
+
+	void notify()
+	{
+		{
+			unique_lock<mutex> lock(mtx);
+			count++;
+		}
+		cnd.notify_one();
+	}
+
+	// wait blocks until count differs from count_prev, and count_prev is 
+	// updated to the current count.
+	void wait(long long & count_prev)
+	{
+		unique_lock<mutex> lock(mtx);
+		cnd.wait(lock, [&]{return count != count_prev;});
+		count_prev = count;
+	}
+};
+
 class ch_base
 {
 protected:
@@ -54,8 +88,65 @@ public:
 protected:
 	char * m_name;
 	mutex m_mtx;
+
+	// total time the calling thread has been blocked in lock() 
+	static thread_local long long m_lock_wait_nsec;
+
+	// contention and throughput statistics. counted only if m_bstat is true.
+	static atomic<bool> m_bstat;
+	atomic<long long> m_count_lock, m_count_contended, m_wait_nsec;
+	atomic<long long> m_count_pub, m_count_cons, m_bytes_pub, m_bytes_cons;
+
+	static bool is_stat()
+	{
+		return m_bstat.load(memory_order_relaxed);
+	}
+
+	// lock mtx measuring the time blocked. lock() and the channels having 
+	// their own mutexes use this.
+	void lock_mtx(mutex & mtx)
+	{
+		if(!mtx.try_lock()){
+			// only contended acquisition is timed
+			long long t = get_mono_time_nsec();
+			mtx.lock();
+			t = get_mono_time_nsec() - t;
+			m_lock_wait_nsec += t;
+			if(is_stat()){
+				m_count_contended.fetch_add(1, memory_order_relaxed);
+				m_wait_nsec.fetch_add(t, memory_order_relaxed);
+			}
+		}
+		if(is_stat())
+			m_count_lock.fetch_add(1, memory_order_relaxed);
+	}
+
+	// channels call these when data is written or read.
+	void count_pub(long long bytes)
+	{
+		if(!is_stat())
+			return;
+		m_count_pub.fetch_add(1, memory_order_relaxed);
+		m_bytes_pub.fetch_add(bytes, memory_order_relaxed);
+	}
+
+	void count_cons(long long bytes)
+	{
+		if(!is_stat())
+			return;
+		m_count_cons.fetch_add(1, memory_order_relaxed);
+		m_bytes_cons.fetch_add(bytes, memory_order_relaxed);
+	}
+
+	// publication sequence number and the signals of the subscribers
+	mutex m_mtx_evt;
+	long long m_seq;
+	vector<s_evt_signal*> m_evts;
 public:
-	ch_base(const char * name):m_name(NULL){
+	ch_base(const char * name):m_name(NULL), m_seq(0)
+	{
+		reset_stat();
+
 		m_name = new char[strlen(name) + 1];
 		strcpy(m_name, name);
 	};
@@ -66,7 +157,13 @@ public:
 	
 	void lock()
 	{
-		m_mtx.lock();
+		lock_mtx(m_mtx);
+	}
+
+	// returns the total time the calling thread has been blocked in lock().
+	static long long get_lock_wait_nsec()
+	{
+		return m_lock_wait_nsec;
 	}
 	
 	void unlock()
@@ -76,11 +173,84 @@ public:
 	
 	const char * get_name(){ return m_name;};
 
+	// publish() notifies the subscribers that new data is available. 
+	// f_base calls this for all the output channels after each proc(). 
+	void publish()
+	{
+		unique_lock<mutex> lock(m_mtx_evt);
+		m_seq++;
+		for(int i = 0; i < m_evts.size(); i++)
+			m_evts[i]->notify();
+	}
+
+	long long get_seq()
+	{
+		unique_lock<mutex> lock(m_mtx_evt);
+		return m_seq;
+	}
+
+	void add_evt_signal(s_evt_signal * pevt)
+	{
+		unique_lock<mutex> lock(m_mtx_evt);
+		for(int i = 0; i < m_evts.size(); i++)
+			if(m_evts[i] == pevt)
+				return;
+		m_evts.push_back(pevt);
+	}
+
+	void remove_evt_signal(s_evt_signal * pevt)
+	{
+		unique_lock<mutex> lock(m_mtx_evt);
+		for(vector<s_evt_signal*>::iterator itr = m_evts.begin(); 
+			itr != m_evts.end(); itr++){
+			if(*itr == pevt){
+				m_evts.erase(itr);
+				return;
+			}
+		}
+	}
+
 	void get_info(s_cmd & rcmd, int ich)
 	{
 	  snprintf(rcmd.get_ret_str(), RET_LEN, "%s(%s) %d", m_name, typeid(*this).name(), ich);
 	}
 
+	static void set_stat(bool bstat)
+	{
+		m_bstat = bstat;
+	}
+
+	void reset_stat()
+	{
+		m_count_lock = m_count_contended = m_wait_nsec = 0;
+		m_count_pub = m_count_cons = m_bytes_pub = m_bytes_cons = 0;
+	}
+
+	long long get_wait_nsec()
+	{
+		return m_wait_nsec.load(memory_order_relaxed);
+	}
+
+	long long get_count_contended()
+	{
+		return m_count_contended.load(memory_order_relaxed);
+	}
+
+	// statistics for chstat command
+	virtual void get_stat(s_cmd & rcmd)
+	{
+		long long nlock = m_count_lock.load(memory_order_relaxed);
+		long long ncont = get_count_contended();
+		snprintf(rcmd.get_ret_str(), RET_LEN, 
+			"%s lock=%lld contended=%lld(%.2f%%) wait=%.1fus pub=%lld cons=%lld bytes_pub=%lld bytes_cons=%lld",
+			m_name, nlock, ncont, (nlock ? 100.0 * (double) ncont / (double) nlock : 0.0),
+			get_wait_nsec() * 1e-3,
+			m_count_pub.load(memory_order_relaxed),
+			m_count_cons.load(memory_order_relaxed),
+			m_bytes_pub.load(memory_order_relaxed),
+			m_bytes_cons.load(memory_order_relaxed));
+	}
+
 	virtual size_t get_dsize()
 	{ 
 	  return 0;
@@ -116,6 +286,50 @@ public:
 	{
 		return false;
 	}
+
+	// reader method for the mapped log file. Channels can override this to 
+	// refer to the mapped data without copying. By default, read() is 
+	// called with the stream over the mapping.
+	virtual int read_map(c_log_map & lm, long long tcur)
+	{
+		FILE * pf = lm.begin_stream();
+		if(!pf)
+			return 0;
+		int sz = read(pf, tcur);
+		lm.end_stream();
+		return sz;
+	}
+
+	virtual bool log2txt_map(c_log_map & lm, FILE * ptf)
+	{
+		FILE * pf = lm.begin_stream();
+		if(!pf)
+			return false;
+		bool res = log2txt(pf, ptf);
+		lm.end_stream();
+		return res;
+	}
+
+	// skips a log record at the current position of pbf, and returns its 
+	// time in trec. The time is the one read() compares with tcur. This is
+	// used to build log index for existing logs. Returns false at the end of
+	// the file, or if the channel does not support it.
+	virtual bool skip_rec(FILE * pbf, long long & trec)
+	{
+		return false;
+	}
+
+protected:
+	// skip_rec() for the records of fixed size sz, having their time at 
+	// toff bytes from the head.
+	bool skip_fixed_rec(FILE * pbf, const size_t sz, const size_t toff, long long & trec)
+	{
+		if(fseek(pbf, (long) toff, SEEK_CUR) != 0)
+			return false;
+		if(fread((void*)&trec, sizeof(long long), 1, pbf) != 1)
+			return false;
+		return fseek(pbf, (long)(sz - toff - sizeof(long long)), SEEK_CUR) == 0;
+	}
 };
 
 #endif
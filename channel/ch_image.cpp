@@ -50,31 +50,38 @@ int ch_image::write(FILE * pf, long long tcur)
     unique_lock<mutex> lock(m_mtx_fr);
     Mat img;
     if (!m_img[m_front].empty() && m_tfile < m_time[m_front]){
-      img = m_img[m_front].clone();
+      // set_img() replaces the Mat rather than overwriting its data, then
+      // the reference is enough to serialize the frame.
+      img = m_img[m_front];
     }
     lock.unlock();
     if (!img.empty()){
       m_tfile = m_time[m_front];
-      int r, c, type, size;
-      r = img.rows;
-      c = img.cols;
-      type = img.type();
-      size = (int)(r * c * img.elemSize());
-      fwrite((void*)&m_tfile, sizeof(long long), 1, pf);
-      fwrite((void*)&m_ifrm[m_front], sizeof(long long), 1, pf);
-      fwrite((void*)&type, sizeof(int), 1, pf);
-      fwrite((void*)&m_offset, sizeof(m_offset), 1, pf); // from ver.1.00	      
-      fwrite((void*)&m_sz_sensor, sizeof(m_sz_sensor), 1, pf); // from ver.1.00	      
-      fwrite((void*)&r, sizeof(int), 1, pf);
-      fwrite((void*)&c, sizeof(int), 1, pf);
-      fwrite((void*)&size, sizeof(int), 1, pf);
-      fwrite((void*)img.data, sizeof(char), size, pf);
-      return sizeof(long long) + sizeof(m_offset) + sizeof(m_sz_sensor) + 4 * sizeof(int)+size;
+      return write_frame(pf, img, m_tfile, m_ifrm[m_front]);
     }
   }
   return 0;
 }
 
+int ch_image::write_frame(FILE * pf, const Mat & img, const long long t, const long long ifrm)
+{
+  int r, c, type, size;
+  r = img.rows;
+  c = img.cols;
+  type = img.type();
+  size = (int)(r * c * img.elemSize());
+  fwrite((void*)&t, sizeof(long long), 1, pf);
+  fwrite((void*)&ifrm, sizeof(long long), 1, pf);
+  fwrite((void*)&type, sizeof(int), 1, pf);
+  fwrite((void*)&m_offset, sizeof(m_offset), 1, pf); // from ver.1.00	      
+  fwrite((void*)&m_sz_sensor, sizeof(m_sz_sensor), 1, pf); // from ver.1.00	      
+  fwrite((void*)&r, sizeof(int), 1, pf);
+  fwrite((void*)&c, sizeof(int), 1, pf);
+  fwrite((void*)&size, sizeof(int), 1, pf);
+  fwrite((void*)img.data, sizeof(char), size, pf);
+  return sizeof(long long) + sizeof(m_offset) + sizeof(m_sz_sensor) + 4 * sizeof(int)+size;
+}
+
 int ch_image::read(FILE * pf, long long tcur)
 {
   if(!pf)
@@ -131,13 +138,16 @@ int ch_image::read(FILE * pf, long long tcur)
     sz += res;
     
     Mat & img = m_img[m_back];
-    if(img.type() != type || img.rows != r || img.cols != c){
+    if(m_hist_depth > 0){
+      img = Mat(r, c, type); // the previous buffer may be held in the history
+    }else if(img.type() != type || img.rows != r || img.cols != c){
       img.create(r, c, type);
     }
     res = fread((void*)img.data, sizeof(char), size, pf);
     if(!res)
       goto failed;
     sz += res;
+    push_hist(img, tsave, ifrm);
 
     cout << m_name << " time " << m_time[m_back] << " frm " << m_ifrm[m_back] << " loaded." << endl;
     
@@ -154,6 +164,274 @@ int ch_image::read(FILE * pf, long long tcur)
   return 0;
 }
 
+// parses a frame record at the current position of lm. img refers to the
+// mapped data. 
+static bool take_frame_rec(c_log_map & lm, long long & t, long long & ifrm,
+			   Point2i & offset, Size & sz_sensor, Mat & img)
+{
+  int r, c, type, size;
+  if(!lm.take(t) || !lm.take(ifrm) || !lm.take(type))
+    return false;
+  if(t > TIME_VERSION_1_00){
+    if(!lm.take(offset) || !lm.take(sz_sensor))
+      return false;
+  }
+  if(!lm.take(r) || !lm.take(c) || !lm.take(size))
+    return false;
+  if(r < 0 || c < 0 || size < 0 || (size_t) r * c * CV_ELEM_SIZE(type) > (size_t) size)
+    return false;
+
+  const char * data = lm.take((size_t) size);
+  if(!data)
+    return false;
+  img = Mat(r, c, type, (void*) data);
+  return true;
+}
+
+// c_map_allocator releases the reference to the mapped log region when the
+// last Mat referring to a mapped frame is released. Only the frames made by
+// ref_map() have it as the allocator.
+#if CV_VERSION_MAJOR >= 4
+typedef AccessFlag t_cv_access_flag;
+#else
+typedef int t_cv_access_flag;
+#endif
+
+class c_map_allocator: public MatAllocator
+{
+public:
+  UMatData * allocate(int dims, const int * sizes, int type, void * data, 
+		      size_t * step, t_cv_access_flag flags, 
+		      UMatUsageFlags usageFlags) const
+  {
+    return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, 
+					    flags, usageFlags);
+  }
+
+  bool allocate(UMatData * u, t_cv_access_flag accessFlags, 
+		UMatUsageFlags usageFlags) const
+  {
+    return Mat::getStdAllocator()->allocate(u, accessFlags, usageFlags);
+  }
+
+  void deallocate(UMatData * u) const
+  {
+    if(!u)
+      return;
+    c_log_map::unref((s_log_map_region*) u->userdata);
+    delete u;
+  }
+};
+
+static c_map_allocator g_map_allocator;
+
+// makes img, referring to the mapped data, hold a reference to the mapping.
+// The copies of img given to the consumers share the reference.
+static void ref_map(Mat & img, c_log_map & lm)
+{
+  UMatData * u = new UMatData(&g_map_allocator);
+  u->data = u->origdata = img.data;
+  u->size = img.total() * img.elemSize();
+  u->refcount = 1;
+  u->userdata = (void*) lm.ref();
+  img.u = u;
+}
+
+int ch_image::read_map(c_log_map & lm, long long tcur)
+{
+  size_t pos = lm.tell();
+  while(m_tfile <= tcur && !lm.eof()){
+    long long tsave, ifrm;
+    Point2i offset = m_offset;
+    Size sz_sensor = m_sz_sensor;
+    Mat img;
+    if(!take_frame_rec(lm, tsave, ifrm, offset, sz_sensor, img))
+      return 0;
+    ref_map(img, lm);
+
+    unique_lock<mutex> lock_bk(m_mtx_bk);
+    m_ifrm[m_back] = ifrm;
+    m_time[m_back] = m_tfile = tsave;
+    m_offset = offset;
+    m_sz_sensor = sz_sensor;
+    m_img[m_back] = img;
+    push_hist(img, tsave, ifrm);
+
+    unique_lock<mutex> lock_fr(m_mtx_fr);
+    int tmp = m_front;
+    m_front = m_back;
+    m_back = tmp;
+    lock_fr.unlock();
+    lock_bk.unlock();
+  }
+  return (int)(lm.tell() - pos);
+}
+
+bool ch_image::skip_rec(FILE * pbf, long long & trec)
+{
+  long long ifrm;
+  int type, r, c, size;
+  if(fread((void*)&trec, sizeof(long long), 1, pbf) != 1)
+    return false;
+  if(fread((void*)&ifrm, sizeof(long long), 1, pbf) != 1)
+    return false;
+  if(fread((void*)&type, sizeof(int), 1, pbf) != 1)
+    return false;
+  if(trec > TIME_VERSION_1_00){
+    if(fseek(pbf, (long)(sizeof(m_offset) + sizeof(m_sz_sensor)), SEEK_CUR) != 0)
+      return false;
+  }
+  if(fread((void*)&r, sizeof(int), 1, pbf) != 1)
+    return false;
+  if(fread((void*)&c, sizeof(int), 1, pbf) != 1)
+    return false;
+  if(fread((void*)&size, sizeof(int), 1, pbf) != 1)
+    return false;
+  return fseek(pbf, (long) size, SEEK_CUR) == 0;
+}
+
+void ch_image::push_hist(const Mat & img, const long long t, const long long ifrm,
+			 Mat * pimg_old)
+{
+  if(m_hist_depth == 0)
+    return;
+
+  unique_lock<mutex> lock(m_mtx_hist);
+  if(pimg_old && m_hist_num == m_hist_depth)
+    *pimg_old = m_hist_img[m_hist_head];
+  m_hist_img[m_hist_head] = img;
+  m_hist_time[m_hist_head] = t;
+  m_hist_ifrm[m_hist_head] = ifrm;
+  m_hist_head = (m_hist_head + 1) % m_hist_depth;
+  if(m_hist_num < m_hist_depth)
+    m_hist_num++;
+}
+
+void ch_image::set_hist_depth(const int depth)
+{
+  unique_lock<mutex> lock(m_mtx_hist);
+  if(depth <= m_hist_depth)
+    return;
+
+  // rearrange the frames in the history so that the oldest is at 0.
+  vector<Mat> img(depth);
+  vector<long long> t(depth, 0), ifrm(depth, -1);
+  for(int i = 0; i < m_hist_num; i++){
+    int ipos = hist_pos(m_hist_num - 1 - i);
+    img[i] = m_hist_img[ipos];
+    t[i] = m_hist_time[ipos];
+    ifrm[i] = m_hist_ifrm[ipos];
+  }
+  m_hist_img.swap(img);
+  m_hist_time.swap(t);
+  m_hist_ifrm.swap(ifrm);
+  m_hist_head = m_hist_num % depth;
+  m_hist_depth = depth;
+}
+
+int ch_image::get_num_hist()
+{
+  unique_lock<mutex> lock(m_mtx_hist);
+  return m_hist_num;
+}
+
+Mat ch_image::get_hist_img(const int age, long long & t, long long & ifrm)
+{
+  unique_lock<mutex> lock(m_mtx_hist);
+  if(age < 0 || age >= m_hist_num)
+    return Mat();
+
+  int ipos = hist_pos(age);
+  t = m_hist_time[ipos];
+  ifrm = m_hist_ifrm[ipos];
+  count_cons(0); // no copy
+  return m_hist_img[ipos];
+}
+
+Mat ch_image::get_img_by_ifrm(const long long ifrm, long long & t)
+{
+  unique_lock<mutex> lock(m_mtx_hist);
+  if(m_hist_num == 0 || ifrm < 0)
+    return Mat();
+
+  // frame indices are usually consecutive, then the age is guessed first.
+  long long age = m_hist_ifrm[hist_pos(0)] - ifrm;
+  if(age >= 0 && age < m_hist_num && m_hist_ifrm[hist_pos((int) age)] == ifrm){
+    int ipos = hist_pos((int) age);
+    t = m_hist_time[ipos];
+    count_cons(0);
+    return m_hist_img[ipos];
+  }
+
+  for(int iage = 0; iage < m_hist_num; iage++){
+    int ipos = hist_pos(iage);
+    if(m_hist_ifrm[ipos] == ifrm){
+      t = m_hist_time[ipos];
+      count_cons(0);
+      return m_hist_img[ipos];
+    }
+  }
+  return Mat();
+}
+
+Mat ch_image::get_img_nearest(const long long t, long long & tfrm, long long & ifrm)
+{
+  unique_lock<mutex> lock(m_mtx_hist);
+  if(m_hist_num == 0)
+    return Mat();
+
+  // frame times increase with the age decreasing. binary search for the 
+  // youngest frame not newer than t.
+  int amin = 0, amax = m_hist_num - 1;
+  if(m_hist_time[hist_pos(amax)] > t){
+    amin = amax;
+  }else{
+    while(amin < amax){
+      int amid = (amin + amax) / 2;
+      if(m_hist_time[hist_pos(amid)] <= t)
+	amax = amid;
+      else
+	amin = amid + 1;
+    }
+    // compare with the next newer frame
+    if(amin > 0){
+      long long dtold = t - m_hist_time[hist_pos(amin)];
+      long long dtnew = m_hist_time[hist_pos(amin - 1)] - t;
+      if(dtnew < dtold)
+	amin--;
+    }
+  }
+
+  int ipos = hist_pos(amin);
+  tfrm = m_hist_time[ipos];
+  ifrm = m_hist_ifrm[ipos];
+  count_cons(0);
+  return m_hist_img[ipos];
+}
+
+Mat ch_image::get_img_before(const long long t, long long & tfrm, long long & ifrm)
+{
+  unique_lock<mutex> lock(m_mtx_hist);
+  if(m_hist_num == 0 || m_hist_time[hist_pos(m_hist_num - 1)] >= t)
+    return Mat();
+
+  // binary search for the youngest frame older than t
+  int amin = 0, amax = m_hist_num - 1;
+  while(amin < amax){
+    int amid = (amin + amax) / 2;
+    if(m_hist_time[hist_pos(amid)] < t)
+      amax = amid;
+    else
+      amin = amid + 1;
+  }
+
+  int ipos = hist_pos(amin);
+  tfrm = m_hist_time[ipos];
+  ifrm = m_hist_ifrm[ipos];
+  count_cons(0);
+  return m_hist_img[ipos];
+}
+
 bool ch_image::log2txt(FILE * pbf, FILE * ptf)
 {
   char fname[1024];
@@ -215,3 +493,305 @@ bool ch_image::log2txt(FILE * pbf, FILE * ptf)
  failed:
   return false;
 }
+
+bool ch_image::log2txt_map(c_log_map & lm, FILE * ptf)
+{
+  char fname[1024];
+  long long tprev = 0;
+  fprintf(ptf, "t, filename\n");
+  while(!lm.eof()){
+    long long tsave, ifrm;
+    Mat img;
+    if(!take_frame_rec(lm, tsave, ifrm, m_offset, m_sz_sensor, img))
+      return false;
+    if(tsave == tprev)
+      continue;
+
+    snprintf(fname, 1024, "%s_%lld.png", get_name(), tsave);
+    fprintf(ptf, "%lld, %s\n", tsave, fname);
+    imwrite(fname, img);
+    tprev = tsave;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////////// ch_image_pool
+ch_image_pool::ch_image_pool(const char * name): ch_image(name), 
+  m_cur_slot(-1), m_next_slot(0), m_count_acquire(0), m_count_exhausted(0),
+  m_max_in_use(0)
+{
+  set_pool_size(IMG_POOL_SIZE_DEFAULT);
+}
+
+ch_image_pool::~ch_image_pool()
+{
+  for(int islot = 0; islot < m_slots.size(); islot++)
+    delete m_slots[islot];
+  m_slots.clear();
+}
+
+void ch_image_pool::set_pool_size(const int size)
+{
+  lock_mtx(m_mtx_bk);
+  unique_lock<mutex> lock_bk(m_mtx_bk, adopt_lock);
+  lock_mtx(m_mtx_fr);
+  unique_lock<mutex> lock_fr(m_mtx_fr, adopt_lock);
+  while(m_slots.size() < size)
+    m_slots.push_back(new s_img_slot);
+}
+
+int ch_image_pool::get_num_in_use()
+{
+  int n = 0;
+  for(int islot = 0; islot < m_slots.size(); islot++)
+    if(m_slots[islot]->nref.load(memory_order_relaxed) > 0)
+      n++;
+  return n;
+}
+
+void ch_image_pool::update_max_in_use()
+{
+  int n = get_num_in_use();
+  if(n > m_max_in_use.load(memory_order_relaxed))
+    m_max_in_use.store(n, memory_order_relaxed);
+}
+
+int ch_image_pool::acquire(Mat & img, const int rows, const int cols, const int type)
+{
+  lock_mtx(m_mtx_bk);
+  unique_lock<mutex> lock(m_mtx_bk, adopt_lock);
+  int nslots = (int) m_slots.size();
+  for(int i = 0; i < nslots; i++){
+    int islot = (int)((m_next_slot + i) % nslots);
+    s_img_slot * pslot = m_slots[islot];
+    int nref = 0;
+    // free slot has no holder. the producer becomes the first holder.
+    if(!pslot->nref.compare_exchange_strong(nref, 1, memory_order_acquire))
+      continue;
+
+    m_next_slot = (unsigned int)(islot + 1);
+    lock.unlock();
+
+    if(pslot->img.rows != rows || pslot->img.cols != cols || pslot->img.type() != type){
+      pslot->img.create(rows, cols, type); // allocates only when the format changes
+    }
+    img = pslot->img;
+    m_count_acquire.fetch_add(1, memory_order_relaxed);
+    update_max_in_use();
+    return islot;
+  }
+  m_count_exhausted.fetch_add(1, memory_order_relaxed);
+  return -1;
+}
+
+void ch_image_pool::commit(const int islot, const long long t, const long long ifrm)
+{
+  s_img_slot * pslot = m_slots[islot];
+  pslot->t = t;
+  pslot->ifrm = ifrm;
+  count_pub((long long)(pslot->img.total() * pslot->img.elemSize()));
+
+  // the producer's reference is handed over to the channel front
+  lock_mtx(m_mtx_fr);
+  unique_lock<mutex> lock(m_mtx_fr, adopt_lock);
+  int iprev = m_cur_slot;
+  m_cur_slot = islot;
+  m_time[m_front] = t;
+  m_ifrm[m_front] = ifrm;
+  lock.unlock();
+
+  push_hist_slot(islot);
+
+  if(iprev >= 0)
+    m_slots[iprev]->nref.fetch_sub(1, memory_order_acq_rel);
+}
+
+void ch_image_pool::push_hist_slot(const int islot)
+{
+  if(get_hist_depth() == 0)
+    return;
+
+  s_img_slot * pslot = m_slots[islot];
+  pslot->nref.fetch_add(1, memory_order_relaxed);
+  Mat img_old;
+  push_hist(pslot->img, pslot->t, pslot->ifrm, &img_old);
+  if(!img_old.empty())
+    release_slot(img_old);
+}
+
+void ch_image_pool::release_slot(const Mat & img)
+{
+  // the buffer of a held slot is never reallocated, then the slot is 
+  // found by the buffer address.
+  lock_mtx(m_mtx_bk);
+  unique_lock<mutex> lock(m_mtx_bk, adopt_lock);
+  for(int islot = 0; islot < m_slots.size(); islot++){
+    if(m_slots[islot]->img.data == img.data){
+      m_slots[islot]->nref.fetch_sub(1, memory_order_acq_rel);
+      return;
+    }
+  }
+}
+
+void ch_image_pool::set_hist_depth(const int depth)
+{
+  ch_image::set_hist_depth(depth);
+  set_pool_size(get_hist_depth() + IMG_POOL_SIZE_DEFAULT);
+}
+
+void ch_image_pool::cancel(const int islot)
+{
+  m_slots[islot]->nref.fetch_sub(1, memory_order_acq_rel);
+}
+
+bool ch_image_pool::get_frame(c_img_frame & frm)
+{
+  lock_mtx(m_mtx_fr);
+  unique_lock<mutex> lock(m_mtx_fr, adopt_lock);
+  if(m_cur_slot < 0){
+    frm.release();
+    return false;
+  }
+  s_img_slot * pslot = m_slots[m_cur_slot];
+  pslot->nref.fetch_add(1, memory_order_relaxed);
+  lock.unlock();
+
+  frm.attach(pslot);
+  count_cons(0); // no copy
+  return true;
+}
+
+Mat ch_image_pool::get_img(long long & t)
+{
+  long long ifrm;
+  return get_img(t, ifrm);
+}
+
+Mat ch_image_pool::get_img(long long & t, long long & ifrm)
+{
+  Mat img;
+  c_img_frame frm;
+  if(!get_frame(frm) || frm.empty())
+    return img;
+  img = frm.img().clone();
+  t = frm.get_time();
+  ifrm = frm.get_ifrm();
+  count_cons((long long)(img.total() * img.elemSize()));
+  return img;
+}
+
+void ch_image_pool::set_img(Mat & img, long long t)
+{
+  set_img(img, t, -1);
+}
+
+void ch_image_pool::set_img(Mat & img, long long t, long long ifrm)
+{
+  Mat buf;
+  int islot = acquire(buf, img.rows, img.cols, img.type());
+  if(islot < 0)
+    return; // pool exhausted, the frame is dropped
+  img.copyTo(buf);
+  commit(islot, t, ifrm);
+}
+
+void ch_image_pool::get_stat(s_cmd & rcmd)
+{
+  ch_base::get_stat(rcmd);
+  size_t len = strlen(rcmd.get_ret_str());
+  snprintf(rcmd.get_ret_str() + len, RET_LEN - len, 
+	   " pool=%d in_use=%d max_in_use=%d acquired=%lld exhausted=%lld",
+	   get_pool_size(), get_num_in_use(), 
+	   m_max_in_use.load(memory_order_relaxed),
+	   m_count_acquire.load(memory_order_relaxed),
+	   m_count_exhausted.load(memory_order_relaxed));
+}
+
+void ch_image_pool::print(ostream & out)
+{
+  out << "channel " << m_name << " pool " << get_pool_size()
+      << " in_use " << get_num_in_use()
+      << " max_in_use " << m_max_in_use.load(memory_order_relaxed)
+      << " acquired " << m_count_acquire.load(memory_order_relaxed)
+      << " exhausted " << m_count_exhausted.load(memory_order_relaxed) << endl;
+}
+
+int ch_image_pool::write(FILE * pf, long long tcur)
+{
+  if(!pf)
+    return 0;
+
+  // the frame is kept in the slot while writing, no copy is needed.
+  c_img_frame frm;
+  if(!get_frame(frm) || frm.empty() || frm.get_time() <= m_tfile)
+    return 0;
+
+  m_tfile = frm.get_time();
+  return write_frame(pf, frm.img(), m_tfile, frm.get_ifrm());
+}
+
+// frames are loaded directly into the acquired slots. If the pool is 
+// exhausted, the frame is skipped.
+int ch_image_pool::read(FILE * pf, long long tcur)
+{
+  if(!pf)
+    return 0;
+  size_t sz = 0;
+  while(m_tfile <= tcur && !feof(pf)){
+    long long tsave, ifrm;
+    int r, c, type, size;
+    if(fread((void*)&tsave, sizeof(long long), 1, pf) != 1 ||
+       fread((void*)&ifrm, sizeof(long long), 1, pf) != 1 ||
+       fread((void*)&type, sizeof(int), 1, pf) != 1)
+      return 0;
+    if(tsave > TIME_VERSION_1_00){
+      if(fread((void*)&m_offset, sizeof(m_offset), 1, pf) != 1 ||
+	 fread((void*)&m_sz_sensor, sizeof(m_sz_sensor), 1, pf) != 1)
+	return 0;
+    }
+    if(fread((void*)&r, sizeof(int), 1, pf) != 1 ||
+       fread((void*)&c, sizeof(int), 1, pf) != 1 ||
+       fread((void*)&size, sizeof(int), 1, pf) != 1)
+      return 0;
+    if(r < 0 || c < 0 || size < 0 || (size_t) r * c * CV_ELEM_SIZE(type) != (size_t) size)
+      return 0;
+    m_tfile = tsave;
+
+    Mat buf;
+    int islot = acquire(buf, r, c, type);
+    if(islot < 0){
+      if(fseek(pf, (long) size, SEEK_CUR) != 0)
+	return 0;
+      continue;
+    }
+    if(fread((void*)buf.data, sizeof(char), size, pf) != size){
+      cancel(islot);
+      return 0;
+    }
+    commit(islot, tsave, ifrm);
+    sz += size;
+  }
+  return (int) sz;
+}
+
+int ch_image_pool::read_map(c_log_map & lm, long long tcur)
+{
+  size_t pos = lm.tell();
+  while(m_tfile <= tcur && !lm.eof()){
+    long long tsave, ifrm;
+    Mat img;
+    if(!take_frame_rec(lm, tsave, ifrm, m_offset, m_sz_sensor, img))
+      return 0;
+    m_tfile = tsave;
+
+    // the mapped data is copied into the slot, no reference to the map
+    // remains in the pool.
+    Mat buf;
+    int islot = acquire(buf, img.rows, img.cols, img.type());
+    if(islot < 0)
+      continue;
+    img.copyTo(buf);
+    commit(islot, tsave, ifrm);
+  }
+  return (int)(lm.tell() - pos);
+}
@@ -58,9 +58,28 @@ protected:
 
   AWSCamPar m_campar;
   AWSAttitude m_camatt;
+
+  // frame history. set_img() pushes the frame also to the ring buffer of
+  // m_hist_depth frames. Only the Mat headers are kept, then the producer
+  // should set newly allocated image for each frame, as is already required
+  // for the front/back buffers. Disabled if m_hist_depth is zero.
+  mutex m_mtx_hist;
+  int m_hist_depth, m_hist_head, m_hist_num; // m_hist_head is the next position to be written
+  vector<Mat> m_hist_img;
+  vector<long long> m_hist_time, m_hist_ifrm;
+
+  // pushes the frame, and the frame pushed out is given to pimg_old if any.
+  void push_hist(const Mat & img, const long long t, const long long ifrm,
+		 Mat * pimg_old = NULL);
+  // ring buffer position of the frame of age (0 is the latest) 
+  int hist_pos(const int age)
+  {
+    return (m_hist_head + m_hist_depth - 1 - age) % m_hist_depth;
+  }
 	
  public:
- ch_image(const char * name) :ch_base(name), m_front(0), m_back(1), m_tfile(0), m_offset(0, 0), m_sz_sensor(0, 0), fmt(IMF_Undef)
+ ch_image(const char * name) :ch_base(name), m_front(0), m_back(1), m_tfile(0), m_offset(0, 0), m_sz_sensor(0, 0), fmt(IMF_Undef),
+    m_hist_depth(0), m_hist_head(0), m_hist_num(0)
   {
     m_time[0] = m_time[1] = 0;
     m_ifrm[0] = m_ifrm[1] = -1;
@@ -126,6 +145,24 @@ protected:
    
   virtual Mat get_img(long long & t) = 0;
   virtual Mat get_img(long long & t, long long & ifrm) = 0;
+
+  // Frame history shared by temporal filters. Each consumer requests the 
+  // depth it needs in init_run(), and the largest request is kept.
+  virtual void set_hist_depth(const int depth);
+  int get_hist_depth()
+  {
+    return m_hist_depth;
+  }
+  int get_num_hist();
+  
+  // the frame of the age (0 is the latest). returns empty Mat if not in history.
+  Mat get_hist_img(const int age, long long & t, long long & ifrm);
+  // the frame of the frame index
+  Mat get_img_by_ifrm(const long long ifrm, long long & t);
+  // the frame whose time is the nearest to t
+  Mat get_img_nearest(const long long t, long long & tfrm, long long & ifrm);
+  // the latest frame strictly older than t. returns empty Mat if none.
+  Mat get_img_before(const long long t, long long & tfrm, long long & ifrm);
   virtual void set_img(Mat & img, long long t) = 0;
   virtual void set_img(Mat & img, long long t, long long ifrm) = 0;
   
@@ -145,8 +182,17 @@ protected:
   virtual int write(FILE * pf, long long tcur);
   // file reader method
   virtual int read(FILE * pf, long long tcur);
+  // reader for the mapped log. The frames refer to the mapped file, and
+  // keep the mapping alive until the last copy of them is released.
+  virtual int read_map(c_log_map & lm, long long tcur);
   
   virtual bool log2txt(FILE * pbf, FILE * ptf);
+  virtual bool log2txt_map(c_log_map & lm, FILE * ptf);
+  virtual bool skip_rec(FILE * pbf, long long & trec);
+
+ protected:
+  // writes a frame record in the format read() reads.
+  int write_frame(FILE * pf, const Mat & img, const long long t, const long long ifrm);
 };
 
 // ch_image_cln output clone of the image for get_img
@@ -164,19 +210,22 @@ class ch_image_cln: public ch_image
   
   virtual Mat get_img(long long & t){
     Mat img;
-    unique_lock<mutex> lock(m_mtx_fr);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock(m_mtx_fr, adopt_lock);
     if(m_img[m_front].empty()){
       return img;
     }
 
     img = m_img[m_front].clone();
     t = m_time[m_front];
+    count_cons((long long)(img.total() * img.elemSize()));
     return img;
   }
   
   virtual Mat get_img(long long & t, long long & ifrm){
     Mat img;
-    unique_lock<mutex> lock(m_mtx_bk);
+    lock_mtx(m_mtx_bk);
+    unique_lock<mutex> lock(m_mtx_bk, adopt_lock);
     if(m_img[m_front].empty()){
       return img;
     }
@@ -184,25 +233,34 @@ class ch_image_cln: public ch_image
     img = m_img[m_front].clone();
     t = m_time[m_front];
     ifrm = m_ifrm[m_front];
+    count_cons((long long)(img.total() * img.elemSize()));
     return img;
   }
   
   virtual void set_img(Mat & img, long long t){
-    unique_lock<mutex> lock_bk(m_mtx_bk);
+    lock_mtx(m_mtx_bk);
+    unique_lock<mutex> lock_bk(m_mtx_bk, adopt_lock);
     m_img[m_back] = img;
     m_time[m_back] = t;
-    unique_lock<mutex> lock_fr(m_mtx_fr);
+    count_pub((long long)(img.total() * img.elemSize()));
+    push_hist(img, t, -1);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock_fr(m_mtx_fr, adopt_lock);
     int tmp = m_front;
     m_front = m_back;
     m_back = tmp;
   }
   
   virtual void set_img(Mat & img, long long t, long long ifrm){
-    unique_lock<mutex> lock_bk(m_mtx_bk);
+    lock_mtx(m_mtx_bk);
+    unique_lock<mutex> lock_bk(m_mtx_bk, adopt_lock);
     m_img[m_back] = img;
     m_time[m_back] = t;
     m_ifrm[m_back] = ifrm;
-    unique_lock<mutex> lock_fr(m_mtx_fr);
+    count_pub((long long)(img.total() * img.elemSize()));
+    push_hist(img, t, ifrm);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock_fr(m_mtx_fr, adopt_lock);
     int tmp = m_front;
     m_front = m_back;
     m_back = tmp;
@@ -222,48 +280,207 @@ class ch_image_ref: public ch_image
   }
   
   virtual Mat get_img(long long & t){
-    unique_lock<mutex> lock(m_mtx_fr);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock(m_mtx_fr, adopt_lock);
     Mat img = m_img[m_front];
     t = m_time[m_front];
+    count_cons(0); // no copy
     return img;
   }
   
   virtual Mat get_img(long long & t, long long & ifrm){
-    unique_lock<mutex> lock(m_mtx_fr);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock(m_mtx_fr, adopt_lock);
     Mat img = m_img[m_front];
     t = m_time[m_front];
     ifrm = m_ifrm[m_front];
+    count_cons(0); // no copy
     return img;
   }
 
   virtual Mat get_img_clone(long long & t, long long & ifrm){
-    unique_lock<mutex> lock(m_mtx_fr);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock(m_mtx_fr, adopt_lock);
     Mat img = m_img[m_front].clone();
     t = m_time[m_front];
     ifrm = m_ifrm[m_front];
+    count_cons((long long)(img.total() * img.elemSize()));
     return img;   
   }
   
   virtual void set_img(Mat & img, long long t){
-    unique_lock<mutex> lock_bk(m_mtx_bk);
+    lock_mtx(m_mtx_bk);
+    unique_lock<mutex> lock_bk(m_mtx_bk, adopt_lock);
     m_img[m_back] = img;
     m_time[m_back] = t;
-    unique_lock<mutex> lock_fr(m_mtx_fr);
+    count_pub((long long)(img.total() * img.elemSize()));
+    push_hist(img, t, -1);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock_fr(m_mtx_fr, adopt_lock);
     int tmp = m_front;
     m_front = m_back;
     m_back = tmp;
   }
   
   virtual void set_img(Mat & img, long long t, long long ifrm){
-    unique_lock<mutex> lock_bk(m_mtx_bk);
+    lock_mtx(m_mtx_bk);
+    unique_lock<mutex> lock_bk(m_mtx_bk, adopt_lock);
     m_img[m_back] = img;
     m_time[m_back] = t;
     m_ifrm[m_back] = ifrm;
-    unique_lock<mutex> lock_fr(m_mtx_fr);
+    count_pub((long long)(img.total() * img.elemSize()));
+    push_hist(img, t, ifrm);
+    lock_mtx(m_mtx_fr);
+    unique_lock<mutex> lock_fr(m_mtx_fr, adopt_lock);
     int tmp = m_front;
     m_front = m_back;
     m_back = tmp;
   }
 };
 
+// frame buffer slot of ch_image_pool. 
+struct s_img_slot{
+  Mat img;
+  long long t, ifrm;
+  atomic<int> nref; // number of the holders (producer, channel front and readers)
+  s_img_slot():t(0), ifrm(-1), nref(0){}
+};
+
+// c_img_frame is a shared read only handle of a frame in ch_image_pool. The
+// frame is kept alive while any handle refers to it, then returned to the 
+// pool when the last handle is released or destroyed. Don't write to img().
+class c_img_frame
+{
+ private:
+  s_img_slot * m_slot;
+  
+ public:
+ c_img_frame():m_slot(NULL)
+  {
+  }
+  
+ c_img_frame(const c_img_frame & frm):m_slot(frm.m_slot)
+  {
+    if(m_slot)
+      m_slot->nref.fetch_add(1, memory_order_relaxed);
+  }
+  
+  ~c_img_frame()
+    {
+      release();
+    }
+  
+  c_img_frame & operator = (const c_img_frame & frm)
+    {
+      if(frm.m_slot)
+	frm.m_slot->nref.fetch_add(1, memory_order_relaxed);
+      release();
+      m_slot = frm.m_slot;
+      return *this;
+    }
+  
+  // slot should be already referenced for this handle.
+  void attach(s_img_slot * slot)
+  {
+    release();
+    m_slot = slot;
+  }
+  
+  void release()
+  {
+    if(m_slot)
+      m_slot->nref.fetch_sub(1, memory_order_acq_rel);
+    m_slot = NULL;
+  }
+  
+  bool empty() const
+  {
+    return m_slot == NULL || m_slot->img.empty();
+  }
+  
+  const Mat & img() const
+  {
+    return m_slot->img;
+  }
+  
+  long long get_time() const
+  {
+    return m_slot ? m_slot->t : 0;
+  }
+  
+  long long get_ifrm() const
+  {
+    return m_slot ? m_slot->ifrm : -1;
+  }
+};
+
+// ch_image_pool holds images in a fixed number of pre-allocated frame 
+// buffers. A producer acquires a free slot, fills the image in place and 
+// commits it as the latest frame. Readers take c_img_frame handles by 
+// get_frame() without copying, and the slot returns to the pool after the
+// last handle is released. No allocation occurs as long as the image size 
+// and type are not changed. If all the slots are in use, acquire() fails
+// and the frame is dropped, which is counted in the pool statistics.
+// get_img()/set_img() are still available for the filters not aware of 
+// the pool, but they copy the image like ch_image_cln.
+#define IMG_POOL_SIZE_DEFAULT 4
+
+class ch_image_pool: public ch_image
+{
+ protected:
+  vector<s_img_slot*> m_slots;
+  int m_cur_slot; // the latest frame (-1 if none)
+  unsigned int m_next_slot; // the slot acquire() starts searching from
+
+  // pool statistics
+  atomic<long long> m_count_acquire, m_count_exhausted;
+  atomic<int> m_max_in_use;
+
+  void update_max_in_use();
+
+  // the history holds a reference on the slot of each frame, then the frame
+  // is not overwritten until it is pushed out of the history.
+  void push_hist_slot(const int islot);
+  void release_slot(const Mat & img);
+  
+ public:
+  ch_image_pool(const char * name);  
+  virtual ~ch_image_pool();
+
+  // change the number of the slots. the pool only grows.
+  void set_pool_size(const int size);
+
+  int get_pool_size()
+  {
+    return (int) m_slots.size();
+  }
+
+  int get_num_in_use();
+
+  // the pool grows by the depth, because the history holds the slots.
+  virtual void set_hist_depth(const int depth);
+  
+  // producer side. acquire() gives the slot's buffer allocated for the 
+  // given size and type, and returns slot index, or -1 if the pool is 
+  // exhausted. The acquired slot should be passed to commit() or cancel().
+  int acquire(Mat & img, const int rows, const int cols, const int type);
+  void commit(const int islot, const long long t, const long long ifrm = -1);
+  void cancel(const int islot);
+
+  // reader side. returns false if no frame is available.
+  bool get_frame(c_img_frame & frm);
+  
+  virtual Mat get_img(long long & t);
+  virtual Mat get_img(long long & t, long long & ifrm);
+  virtual void set_img(Mat & img, long long t);
+  virtual void set_img(Mat & img, long long t, long long ifrm);
+
+  virtual void get_stat(s_cmd & rcmd);
+  virtual void print(ostream & out);
+  
+  virtual int write(FILE * pf, long long tcur);
+  virtual int read(FILE * pf, long long tcur);
+  virtual int read_map(c_log_map & lm, long long tcur);
+};
+
 #endif
@@ -25,13 +25,16 @@ class ch_map: public ch_base
 {
 protected:
   bool bupdate, bready;
+	unsigned int m_npending; // number of map data being loaded in the background
 	float m_range, m_resolution;
 	bool m_blayer_type[AWSMap2::lt_undef];
 	list<AWSMap2::LayerDataPtr> m_layer_datum[AWSMap2::lt_undef];
 
 	AWSMap2::vec3 m_cecef; // x, y, z
+
+	AWSMap2::MapDataBase * m_db; // the database opened by f_map
 public:
- ch_map(const char * name):ch_base(name), bupdate(true), bready(false), m_resolution(10), m_range(10000), m_cecef()
+ ch_map(const char * name):ch_base(name), bupdate(true), bready(false), m_npending(0), m_resolution(10), m_range(10000), m_cecef(), m_db(NULL)
 	{
 		m_blayer_type[AWSMap2::lt_coast_line] = true;
 	}
@@ -64,6 +67,26 @@ public:
 	  bready = false;
 	}
 
+	// layer data given is partial (coarse) while pending is non-zero,
+	// and would be updated after the loads.
+	void set_pending(const unsigned int npending){
+	  m_npending = npending;
+	}
+
+	unsigned int get_pending(){
+	  return m_npending;
+	}
+
+	// the database can be queried directly from any filter (MapDataBase is
+	// thread safe). NULL while f_map is not running.
+	void set_db(AWSMap2::MapDataBase * db){
+	  m_db = db;
+	}
+
+	AWSMap2::MapDataBase * get_db(){
+	  return m_db;
+	}
+
 
 	void enable_layer(const AWSMap2::LayerType layer_type)
 	{
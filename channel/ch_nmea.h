@@ -18,6 +18,7 @@
 #ifndef _CH_NMEA_H_
 #define _CH_NMEA_H_
 #include "ch_base.h"
+#include "../util/aws_nmea.h"
 
 class ch_nmea: public ch_base
 {
@@ -83,6 +84,7 @@ public:
 		}
 
 		*buf = *p;
+		count_cons(p - m_buf[m_head]);
 		m_head = (m_head + 1) % m_max_buf;
 
 		unlock();
@@ -115,6 +117,60 @@ public:
 		m_tail = next_tail;
 
 		m_new_nmeas++;
+		count_pub(len);
+		unlock();
+		return true;
+	}
+};
+
+// ch_nmea_rec is the queue of the NMEA sentences decoded by the producer
+// (f_nmea). Consumers use the payload without decoding the string again.
+// The raw sentence is also in the record. As ch_nmea, the oldest record
+// is overwritten if the queue is full.
+class ch_nmea_rec: public ch_base
+{
+protected:
+	int m_max_buf;
+	int m_head;
+	int m_tail;
+	s_nmea_rec * m_buf;
+
+public:
+	ch_nmea_rec(const char * name): ch_base(name), m_max_buf(128),
+		m_head(0), m_tail(0)
+	{
+		m_buf = new s_nmea_rec[m_max_buf];
+	}
+
+	virtual ~ch_nmea_rec()
+	{
+		delete[] m_buf;
+	}
+
+	bool pop(s_nmea_rec & rec)
+	{
+		lock();
+		if(m_head == m_tail){
+			unlock();
+			return false;
+		}
+		rec = m_buf[m_head];
+		m_head = (m_head + 1) % m_max_buf;
+		count_cons(sizeof(s_nmea_rec));
+		unlock();
+		return true;
+	}
+
+	bool push(const s_nmea_rec & rec)
+	{
+		lock();
+		m_buf[m_tail] = rec;
+		int next_tail = (m_tail + 1) % m_max_buf;
+		if(m_head == next_tail){
+			m_head = (m_head + 1) % m_max_buf;
+		}
+		m_tail = next_tail;
+		count_pub(sizeof(s_nmea_rec));
 		unlock();
 		return true;
 	}
@@ -30,6 +30,7 @@ using namespace std;
 #include <opencv2/opencv.hpp>
 using namespace cv;
 #include "ch_obj.h"
+#include "ch_state.h"
 
 /////////////////////////////////////////////////////// c_obj member (The base class of the objects in aws)
 c_obj::c_obj():
@@ -101,4 +102,27 @@ c_ais_obj::~c_ais_obj()
 {
 }
 
+///////////////////////////////////////////////////// ch_ais_obj member
+void ch_ais_obj::update_rel_pos_and_vel(ch_state * state, const Mat & R, const float x,
+	const float y, const float z)
+{
+	Mat Rt;
+	float lat, lon, alt, xt, yt, zt;
+	lock();
+	for (itr = objs.begin(); itr != objs.end(); itr++){
+		c_ais_obj * pobj = itr->second;
+		if (state && state->get_position_at(pobj->get_time(), lat, lon, alt, xt, yt, zt, Rt)){
+			pobj->set_pos_rel_from_ecef(Rt, xt, yt, zt);
+			pobj->set_vel_ecef_from_bih(Rt);
+		}
+		else{
+			pobj->set_pos_rel_from_ecef(R, x, y, z);
+			pobj->set_vel_ecef_from_bih(R);
+		}
+		pobj->set_vel_rel_from_bih();
+		pobj->set_pos_bd_from_rel();
+	}
+	unlock();
+}
+
 //////////////////////////////////////////////////// 
@@ -18,6 +18,8 @@
 #include "ch_base.h"
 #include "../util/aws_coord.h"
 
+class ch_state;
+
 // Object source (Defines how the object is detected.)
 enum e_obj_src
 {
@@ -928,6 +930,12 @@ public:
     }
     unlock();
   }
+
+  // The own ship's position at the time of each object's report is taken 
+  // from the state history. R, x, y, z are used for the objects out of the 
+  // history.
+  void update_rel_pos_and_vel(ch_state * state, const Mat & R, const float x,
+			      const float y, const float z);
   
   void set_track(const int _id){
     int id = 0;
@@ -1167,6 +1175,11 @@ public:
     return sz;
   }
   
+  virtual bool skip_rec(FILE * pbf, long long & trec)
+  {
+    return skip_fixed_rec(pbf, c_ais_obj::get_dsize(), 0, trec);
+  }
+
   virtual bool log2txt(FILE * pbf, FILE * ptf)
   {
     c_ais_obj obj;
@@ -292,9 +292,248 @@ bool ch_estate::get_att(const long long t, float & roll, float & pitch, float &
 
 
 ///////////////////////////////////////////////////////////////////////// ch_state
+void ch_state::update_snapshot()
+{
+	s_state_snapshot & s = m_snap.begin_write();
+	s.tatt = tatt;
+	s.tpos = tpos;
+	s.tvel = tvel;
+	s.tdp = tdp;
+	s.t9dof = t9dof;
+	s.roll = roll;
+	s.pitch = pitch;
+	s.yaw = yaw;
+	s.lon = lon;
+	s.lat = lat;
+	s.alt = alt;
+	s.galt = galt;
+	s.x = x;
+	s.y = y;
+	s.z = z;
+	memcpy((void*)s.R, (void*)R.data, sizeof(double)* 9);
+	s.cog = cog;
+	s.sog = sog;
+	s.vx = vx;
+	s.vy = vy;
+	s.nvx = nvx;
+	s.nvy = nvy;
+	s.depth = depth;
+	s.mx = mx;
+	s.my = my;
+	s.mz = mz;
+	s.ax = ax;
+	s.ay = ay;
+	s.az = az;
+	s.gx = gx;
+	s.gy = gy;
+	s.gz = gz;
+	m_snap.end_write();
+}
+
+void ch_state::push_att()
+{
+	s_att_rec r;
+	r.t = tatt;
+	r.roll = roll;
+	r.pitch = pitch;
+	r.yaw = yaw;
+	m_hatt.push(r);
+}
+
+void ch_state::push_pos()
+{
+	s_pos_rec r;
+	r.t = tpos;
+	bihtoecef((double)(lat * (PI / 180.)), (double)(lon * (PI / 180.)), (double)alt,
+		r.x, r.y, r.z);
+	m_hpos.push(r);
+}
+
+void ch_state::push_vel()
+{
+	s_vel_rec r;
+	r.t = tvel;
+	r.vx = vx;
+	r.vy = vy;
+	m_hvel.push(r);
+}
+
+void ch_state::push_9dof()
+{
+	s_9dof_rec r;
+	r.t = t9dof;
+	r.mx = mx;
+	r.my = my;
+	r.mz = mz;
+	r.ax = ax;
+	r.ay = ay;
+	r.az = az;
+	r.gx = gx;
+	r.gy = gy;
+	r.gz = gz;
+	m_h9dof.push(r);
+}
+
+bool ch_state::calc_weight(const long long t, const long long t0, const long long t1, double & w)
+{
+	if (t > t1 + m_tmax_extrap)
+		return false;
+
+	if (t1 == t0){ // only a sample, held
+		w = 1.0;
+		return true;
+	}
+
+	w = (double)(t - t0) / (double)(t1 - t0);
+	return true;
+}
+
+// quaternion (w, x, y, z) of the rotation yaw-pitch-roll (deg, z-y-x)
+static void rpy2q(const float roll, const float pitch, const float yaw, double * q)
+{
+	double hr = roll * (PI / 360.), hp = pitch * (PI / 360.), hy = yaw * (PI / 360.);
+	double cr = cos(hr), sr = sin(hr), cp = cos(hp), sp = sin(hp), cy = cos(hy), sy = sin(hy);
+	q[0] = cr * cp * cy + sr * sp * sy;
+	q[1] = sr * cp * cy - cr * sp * sy;
+	q[2] = cr * sp * cy + sr * cp * sy;
+	q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+static void q2rpy(const double * q, float & roll, float & pitch, float & yaw)
+{
+	double sp = 2.0 * (q[0] * q[2] - q[3] * q[1]);
+	sp = (sp > 1.0 ? 1.0 : (sp < -1.0 ? -1.0 : sp));
+	roll = (float)(atan2(2.0 * (q[0] * q[1] + q[2] * q[3]), 1.0 - 2.0 * (q[1] * q[1] + q[2] * q[2])) * (180. / PI));
+	pitch = (float)(asin(sp) * (180. / PI));
+	yaw = (float)(atan2(2.0 * (q[0] * q[3] + q[1] * q[2]), 1.0 - 2.0 * (q[2] * q[2] + q[3] * q[3])) * (180. / PI));
+}
+
+bool ch_state::get_attitude_at(const long long t, float & _r, float & _p, float & _y)
+{
+	s_att_rec r0, r1;
+	double w;
+	if (!m_hatt.find(t, r0, r1) || !calc_weight(t, r0.t, r1.t, w))
+		return false;
+
+	double q0[4], q1[4];
+	rpy2q(r0.roll, r0.pitch, r0.yaw, q0);
+	rpy2q(r1.roll, r1.pitch, r1.yaw, q1);
+	double c = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+	if (c < 0){ // shorter path
+		c = -c;
+		for (int i = 0; i < 4; i++)
+			q1[i] = -q1[i];
+	}
+
+	// slerp, w > 1 extrapolates along the same arc
+	double w0 = 1.0 - w, w1 = w;
+	if (c < 0.9999){
+		double th = acos(c), s = sin(th);
+		w0 = sin((1.0 - w) * th) / s;
+		w1 = sin(w * th) / s;
+	}
+
+	double q[4], n = 0;
+	for (int i = 0; i < 4; i++){
+		q[i] = w0 * q0[i] + w1 * q1[i];
+		n += q[i] * q[i];
+	}
+	n = 1.0 / sqrt(n);
+	for (int i = 0; i < 4; i++)
+		q[i] *= n;
+
+	q2rpy(q, _r, _p, _y);
+
+	// yaw is in the range of the latest sample, [0, 360) or [-180, 180)
+	while (_y - r1.yaw > 180.f)
+		_y -= 360.f;
+	while (_y - r1.yaw < -180.f)
+		_y += 360.f;
+	return true;
+}
+
+bool ch_state::get_position_ecef_at(const long long t, double & _x, double & _y, double & _z)
+{
+	s_pos_rec r0, r1;
+	double w;
+	if (!m_hpos.find(t, r0, r1) || !calc_weight(t, r0.t, r1.t, w))
+		return false;
+
+	_x = r0.x + w * (r1.x - r0.x);
+	_y = r0.y + w * (r1.y - r0.y);
+	_z = r0.z + w * (r1.z - r0.z);
+	return true;
+}
+
+bool ch_state::get_position_at(const long long t, float & _lat, float & _lon, float & _alt,
+	float & _x, float & _y, float & _z, Mat & Renu)
+{
+	double x, y, z, lat, lon, alt;
+	if (!get_position_ecef_at(t, x, y, z))
+		return false;
+
+	eceftobih(x, y, z, lat, lon, alt);
+	getwrldrot(lat, lon, Renu);
+	_lat = (float)(lat * (180. / PI));
+	_lon = (float)(lon * (180. / PI));
+	_alt = (float)alt;
+	_x = (float)x;
+	_y = (float)y;
+	_z = (float)z;
+	return true;
+}
+
+bool ch_state::get_velocity_vector_at(const long long t, float & _vx, float & _vy)
+{
+	s_vel_rec r0, r1;
+	double w;
+	if (!m_hvel.find(t, r0, r1) || !calc_weight(t, r0.t, r1.t, w))
+		return false;
+
+	_vx = (float)(r0.vx + w * (r1.vx - r0.vx));
+	_vy = (float)(r0.vy + w * (r1.vy - r0.vy));
+	return true;
+}
+
+bool ch_state::get_velocity_at(const long long t, float & _cog, float & _sog)
+{
+	float vx, vy;
+	if (!get_velocity_vector_at(t, vx, vy))
+		return false;
+
+	_sog = (float)(sqrt(vx * vx + vy * vy) / KNOT);
+	_cog = (float)(atan2(vx, vy) * (180. / PI));
+	if (_cog < 0)
+		_cog += 360.f;
+	return true;
+}
+
+bool ch_state::get_9dof_at(const long long t, float & _mx, float & _my, float & _mz,
+	float & _ax, float & _ay, float & _az,
+	float & _gx, float & _gy, float & _gz)
+{
+	s_9dof_rec r0, r1;
+	double w;
+	if (!m_h9dof.find(t, r0, r1) || !calc_weight(t, r0.t, r1.t, w))
+		return false;
+
+	float w1 = (float)w, w0 = (float)(1.0 - w);
+	_mx = w0 * r0.mx + w1 * r1.mx;
+	_my = w0 * r0.my + w1 * r1.my;
+	_mz = w0 * r0.mz + w1 * r1.mz;
+	_ax = w0 * r0.ax + w1 * r1.ax;
+	_ay = w0 * r0.ay + w1 * r1.ay;
+	_az = w0 * r0.az + w1 * r1.az;
+	_gx = w0 * r0.gx + w1 * r1.gx;
+	_gy = w0 * r0.gy + w1 * r1.gy;
+	_gz = w0 * r0.gz + w1 * r1.gz;
+	return true;
+}
+
 size_t ch_state::write_buf(const char * buf)
 {
 	lock();
+	long long tpos0 = tpos, tatt0 = tatt, tvel0 = tvel, t9dof0 = t9dof;
 	const long long *lptr = (const long long*)buf;
 	tpos = lptr[0];
 	tatt = lptr[1];;
@@ -337,6 +576,16 @@ size_t ch_state::write_buf(const char * buf)
 	const double * dptr = (const double*)(ptr + 22);
 	memcpy((void*)R.data, (void*)dptr, sizeof(double)* 9);
 
+	if (tpos != tpos0)
+		push_pos();
+	if (tatt != tatt0)
+		push_att();
+	if (tvel != tvel0)
+		push_vel();
+	if (t9dof != t9dof0)
+		push_9dof();
+
+	update_snapshot();
 	unlock();
 	return get_dsize();
 }
@@ -575,6 +824,7 @@ size_t ch_env::write_buf(const char * buf)
   humd = fptr[2];
   ilum = fptr[3];
 
+  update_snapshot();
   unlock();
   return get_dsize();
 }
@@ -798,6 +1048,37 @@ const char * strStatGear[Reverse+1] = {
   "Forward", "Neutral", "Reverse"
 };
 
+void ch_eng_state::update_snapshot()
+{
+  s_eng_state_snapshot & s = m_snap.begin_write();
+  s.trapid = trapid;
+  s.rpm = rpm;
+  s.trim = trim;
+  s.tdyn = tdyn;
+  s.poil = poil;
+  s.toil = toil;
+  s.temp = temp;
+  s.valt = valt;
+  s.frate = frate;
+  s.teng = teng;
+  s.pclnt = pclnt;
+  s.pfl = pfl;
+  s.stat1 = stat1;
+  s.stat2 = stat2;
+  s.ld = ld;
+  s.tq = tq;
+  s.ttran = ttran;
+  s.gear = gear;
+  s.pgoil = pgoil;
+  s.tgoil = tgoil;
+  s.ttrip = ttrip;
+  s.flused = flused;
+  s.flavg = flavg;
+  s.fleco = fleco;
+  s.flinst = flinst;
+  m_snap.end_write();
+}
+
 size_t ch_eng_state::write_buf(const char * buf)
 {
   lock();
@@ -843,6 +1124,7 @@ size_t ch_eng_state::write_buf(const char * buf)
   const StatGear * sgptr = (const StatGear *)(se2ptr +1);
   gear = *sgptr;
 
+  update_snapshot();
   unlock();
   return get_dsize();
 }
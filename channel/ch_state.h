@@ -16,6 +16,8 @@
 // along with ch_state.h.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../util/aws_coord.h"
+#include "../util/c_seqlock.h"
+#include "../util/c_hist_ring.h"
 
 #include "ch_base.h"
 
@@ -186,10 +188,79 @@ public:
 	bool get_att(const long long t, float & roll, float & pitch, float & yaw);
 };
 
+// a consistent copy of the ch_state's values. see ch_state::get_snapshot()
+struct s_state_snapshot{
+	long long tatt, tpos, tvel, tdp, t9dof;
+	float roll, pitch, yaw;
+	float lon, lat, alt, galt;
+	float x, y, z;
+	double R[9]; // Rotation matrix for ENU transformation (row major)
+	float cog, sog;
+	float vx, vy;
+	float nvx, nvy;
+	float depth;
+	float mx, my, mz;
+	float ax, ay, az;
+	float gx, gy, gz;
+};
+
+// records in the history of ch_state
+struct s_att_rec{
+	long long t;
+	float roll, pitch, yaw;
+};
+
+struct s_pos_rec{
+	long long t;
+	double x, y, z; // ecef coordinate
+};
+
+struct s_vel_rec{
+	long long t;
+	float vx, vy; // m/s in east and north
+};
+
+struct s_9dof_rec{
+	long long t;
+	float mx, my, mz;
+	float ax, ay, az;
+	float gx, gy, gz;
+};
+
+#define STATE_HIST_SIZE 256
+#define STATE_HIST_MAX_EXTRAP 2000000LL // 200ms in 100ns unit
+
 // state channel contains row sensor data.
+// The setters update the fields under the channel lock and then publish
+// them to a seqlock, and the getters read the seqlock without locking. Then
+// the readers polling at high rate (e.g. autopilot reading 100Hz AHRS) never
+// block the writers, and get_snapshot() gives a consistent set of the
+// attitude, position and velocity in a single read.
+// The setters also push the samples to the histories, and get_xxx_at(t) 
+// gives the state at the time t interpolated (attitude by slerp, others
+// linearly) from the samples around t. This is for the sensors with
+// latency, e.g. the obstacles found in an image stamped at its capture time.
+// t after the latest sample is extrapolated up to m_tmax_extrap. The
+// histories are searched without locking as the snapshot.
 class ch_state: public ch_base
 {
  protected:
+	 c_seqlock<s_state_snapshot> m_snap;
+	 void update_snapshot(); // called holding the lock
+
+	 c_hist_ring<s_att_rec, STATE_HIST_SIZE> m_hatt;
+	 c_hist_ring<s_pos_rec, STATE_HIST_SIZE> m_hpos;
+	 c_hist_ring<s_vel_rec, STATE_HIST_SIZE> m_hvel;
+	 c_hist_ring<s_9dof_rec, STATE_HIST_SIZE> m_h9dof;
+	 long long m_tmax_extrap;
+	 // called holding the lock
+	 void push_att();
+	 void push_pos();
+	 void push_vel();
+	 void push_9dof();
+
+	 // weight of r1 for t, false if t is beyond the extrapolation limit
+	 bool calc_weight(const long long t, const long long t0, const long long t1, double & w);
 	 long long tatt, tpos, tvel, tdp;
 	 long long tattf, tposf, tvelf, tdpf;
 	 float roll, pitch, yaw; // roll(deg), pitch(deg), yaw(deg)
@@ -224,12 +295,34 @@ class ch_state: public ch_base
 	   m_tfile(0), tatt(0), tpos(0), tvel(0), tdp(0),
 	   tattf(0), tposf(0), tvelf(0), tdpf(0), 
 	   roll(0), pitch(0), yaw(0), lon(0), lat(0), alt(0), galt(0),
-	   x(0), y(0), z(0), cog(0), sog(0), depth(0),
+	   x(0), y(0), z(0), cog(0), sog(0), vx(0), vy(0), nvx(0), nvy(0),
+	   depth(0),
 	   t9dof(0), mx(0), my(0), mz(0), ax(0), ay(0), az(0),
-	   gx(0), gy(0), gz(0)
+	   gx(0), gy(0), gz(0), m_tmax_extrap(STATE_HIST_MAX_EXTRAP)
 	   {
 	     R = Mat::eye(3, 3, CV_64FC1);
+	     update_snapshot();
 	   }
+
+	 void set_max_extrapolation(const long long dt)
+	 {
+		 m_tmax_extrap = dt;
+	 }
+
+	 bool get_attitude_at(const long long t, float & _r, float & _p, float & _y);
+	 bool get_position_ecef_at(const long long t, double & _x, double & _y, double & _z);
+	 bool get_position_at(const long long t, float & _lat, float & _lon, float & _alt,
+		 float & _x, float & _y, float & _z, Mat & Renu);
+	 bool get_velocity_vector_at(const long long t, float & _vx, float & _vy);
+	 bool get_velocity_at(const long long t, float & _cog, float & _sog);
+	 bool get_9dof_at(const long long t, float & _mx, float & _my, float & _mz,
+		 float & _ax, float & _ay, float & _az,
+		 float & _gx, float & _gy, float & _gz);
+
+	 void get_snapshot(s_state_snapshot & snap)
+	 {
+		 m_snap.read(snap);
+	 }
 	 
 	 void set_attitude(const long long _tatt, const float _r, const float _p, const float _y)
   {
@@ -238,6 +331,8 @@ class ch_state: public ch_base
     roll = _r; 
     pitch = _p;
     yaw = _y;
+    push_att();
+    update_snapshot();
     unlock();
   }
 
@@ -257,6 +352,8 @@ class ch_state: public ch_base
     gx = _gx;
     gy = _gy;
     gz = _gz;
+    push_9dof();
+    update_snapshot();
     unlock();
   }
   
@@ -264,19 +361,18 @@ class ch_state: public ch_base
 	  float & _ax, float & _ay, float & _az,
 	  float & _gx, float & _gy, float & _gz)
   {
-    lock();
-    _t = t9dof;
-    _mx = mx;
-    _my = my;
-    _mz = mz;
-    _ax = ax;
-    _ay = ay;
-    _az = az;
-    _gx = gx;
-    _gy = gy;
-    _gz = gz;
-    
-    unlock();
+    s_state_snapshot s;
+    m_snap.read(s);
+    _t = s.t9dof;
+    _mx = s.mx;
+    _my = s.my;
+    _mz = s.mz;
+    _ax = s.ax;
+    _ay = s.ay;
+    _az = s.az;
+    _gx = s.gx;
+    _gy = s.gy;
+    _gz = s.gz;
   }
 
 
@@ -291,6 +387,8 @@ class ch_state: public ch_base
     float lat_rad = (float)(lat * (PI / 180.)), lon_rad = (float)(lon * (PI / 180.));
     getwrldrot(lat_rad, lon_rad, R);
     bihtoecef(lat_rad, lon_rad, alt, x, y, z);
+    push_pos();
+    update_snapshot();
     unlock();
   }
 
@@ -306,6 +404,8 @@ class ch_state: public ch_base
 	  float mps = (float)(sog * KNOT);
 	  vx = (float)(mps * nvx);
 	  vy = (float)(mps * nvy);
+	  push_vel();
+	  update_snapshot();
 	  unlock();
   }
 
@@ -313,56 +413,58 @@ class ch_state: public ch_base
 	  lock();
 	  tdp = _tdp;
 	  depth = _depth;
+	  update_snapshot();
 	  unlock();
   }
 
   void get_attitude(long long & _tatt, float & _r, float & _p, float & _y)
   {
-    lock();
-    _tatt = tatt;
-    _r = roll;
-    _p = pitch;
-    _y = yaw;
-    unlock();
+    s_state_snapshot s;
+    m_snap.read(s);
+    _tatt = s.tatt;
+    _r = s.roll;
+    _p = s.pitch;
+    _y = s.yaw;
   }
 
   void get_position(long long & _tpos, float & _lat, float & _lon, float & _alt, float & _galt,
 	  float & _x, float & _y, float & _z, Mat & Renu)
   {
-	  lock();
-	  _tpos = tpos;
-	  _lat = lat;
-	  _lon = lon;
-	  _alt = alt;
-	  _galt = galt;
-	  _x = x;
-	  _y = y;
-	  _z = z;
-	  R.copyTo(Renu);
-	  unlock();
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tpos = s.tpos;
+	  _lat = s.lat;
+	  _lon = s.lon;
+	  _alt = s.alt;
+	  _galt = s.galt;
+	  _x = s.x;
+	  _y = s.y;
+	  _z = s.z;
+	  Mat(3, 3, CV_64FC1, s.R).copyTo(Renu);
   }
 
   void get_position(long long & _tpos, float & _lat, float & _lon, float & _alt, float & _galt)
   {
-    lock();
-    _tpos = tpos;
-    _lat = lat;
-    _lon = lon;
-    _alt = alt;
-    _galt = galt;
-    unlock();
+    s_state_snapshot s;
+    m_snap.read(s);
+    _tpos = s.tpos;
+    _lat = s.lat;
+    _lon = s.lon;
+    _alt = s.alt;
+    _galt = s.galt;
   }
 
   void get_position_ecef(long long & _tpos, float & _x, float & _y, float & _z)
   {
-	  lock();
-	  _tpos = tpos;
-	  _x = x;
-	  _y = y;
-	  _z = z;
-	  unlock();
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tpos = s.tpos;
+	  _x = s.x;
+	  _y = s.y;
+	  _z = s.z;
   }
 
+  // Rret is shared by the callers, then this version still locks the channel.
   const Mat & get_enu_rotation(long long & _tpos)
   {
 	  lock();
@@ -372,39 +474,47 @@ class ch_state: public ch_base
 	  return Rret;
   }
 
+  void get_enu_rotation(long long & _tpos, Mat & Renu)
+  {
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tpos = s.tpos;
+	  Mat(3, 3, CV_64FC1, s.R).copyTo(Renu);
+  }
+
   void get_velocity(long long & _tvel, float & _cog, float & _sog)
   {
-	  lock();
-	  _tvel = tvel;
-	  _cog = cog;
-	  _sog = sog;
-	  unlock();
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tvel = s.tvel;
+	  _cog = s.cog;
+	  _sog = s.sog;
   }
 
   void get_velocity_vector(long long & _tvel, float & _vx, float & _vy)
   {
-	  lock();
-	  _tvel = tvel;
-	  _vx = vx;
-	  _vy = vy;
-	  unlock();
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tvel = s.tvel;
+	  _vx = s.vx;
+	  _vy = s.vy;
   }
 
   void get_norm_velocity_vector(long long & _tvel, float & _nvx, float & _nvy)
   {
-	  lock();
-	  _tvel = tvel;
-	  _nvx = nvx;
-	  _nvy = nvy;
-	  unlock();
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tvel = s.tvel;
+	  _nvx = s.nvx;
+	  _nvy = s.nvy;
   }
 
   void get_depth(long long & _tdp, float & _depth)
   {
-	  lock();
-	  _tdp = tdp;
-	  _depth = depth;
-	  unlock();
+	  s_state_snapshot s;
+	  m_snap.read(s);
+	  _tdp = s.tdp;
+	  _depth = s.depth;
   }
 
   virtual size_t get_dsize()
@@ -427,6 +537,11 @@ class ch_state: public ch_base
   virtual int read(FILE * pf, long long tcur);
 
   virtual bool log2txt(FILE * pbf, FILE * ptf);
+
+  virtual bool skip_rec(FILE * pbf, long long & trec)
+  {
+	  return skip_fixed_rec(pbf, sizeof(long long) * 6 + sizeof(float) * 19, 0, trec);
+  }
 };
 
 
@@ -453,9 +568,38 @@ enum StatGear{
 
 extern const char * strStatGear[Reverse+1];
 
+// a consistent copy of the ch_eng_state's values
+struct s_eng_state_snapshot{
+  long long trapid;
+  float rpm;
+  unsigned char trim;
+
+  long long tdyn;
+  int poil;
+  float toil, temp, valt, frate;
+  unsigned int teng;
+  int pclnt, pfl;
+  StatEng1 stat1;
+  StatEng2 stat2;
+  unsigned char ld, tq;
+
+  long long ttran;
+  StatGear gear;
+  int pgoil;
+  float tgoil;
+
+  long long ttrip;
+  int flused;
+  float flavg, fleco, flinst;
+};
+
+// engine state channel. As ch_state, getters read the seqlock without locking.
 class ch_eng_state: public ch_base
 {
  private:
+  c_seqlock<s_eng_state_snapshot> m_snap;
+  void update_snapshot(); // called holding the lock
+
   long long t, tf;
 
   long long trapid, trapidf;
@@ -504,16 +648,17 @@ class ch_eng_state: public ch_base
     t = trapid = _t;
     rpm = _rpm;
     trim = _trim;
+    update_snapshot();
     unlock();
   }
 
   void get_rapid(long long & _t, float & _rpm, unsigned char & _trim)
   {
-    lock();
-    _t = trapid;
-    _rpm = rpm;
-    _trim = trim;
-    unlock();
+    s_eng_state_snapshot s;
+    m_snap.read(s);
+    _t = s.trapid;
+    _rpm = s.rpm;
+    _trim = s.trim;
   }
 
   void set_dynamic(const long long _t, const int _poil, const float _toil,
@@ -536,6 +681,7 @@ class ch_eng_state: public ch_base
     stat2 = _stat2;
     ld = _ld;
     tq = _tq;
+    update_snapshot();
     unlock();
   }
 
@@ -545,21 +691,21 @@ class ch_eng_state: public ch_base
 		    StatEng1 & _stat1,  StatEng2 & _stat2,
 		    unsigned char & _ld, unsigned char & _tq)
   {
-    lock();
-    _t = tdyn;
-    _poil = poil;
-    _toil = toil;
-    _temp = temp;
-    _valt = valt;
-    _frate = frate;
-    _teng = teng;
-    _pclnt = pclnt;
-    _pfl = pfl;
-    _stat1 = stat1;
-    _stat2 = stat2;
-    _ld = ld;
-    _tq = tq;
-    unlock();    
+    s_eng_state_snapshot s;
+    m_snap.read(s);
+    _t = s.tdyn;
+    _poil = s.poil;
+    _toil = s.toil;
+    _temp = s.temp;
+    _valt = s.valt;
+    _frate = s.frate;
+    _teng = s.teng;
+    _pclnt = s.pclnt;
+    _pfl = s.pfl;
+    _stat1 = s.stat1;
+    _stat2 = s.stat2;
+    _ld = s.ld;
+    _tq = s.tq;
   }
 
   void set_tran(const long long _t, const StatGear _gear, const int _pgoil,
@@ -570,17 +716,18 @@ class ch_eng_state: public ch_base
     gear = _gear;
     pgoil = _pgoil;
     tgoil = _tgoil;
+    update_snapshot();
     unlock();
   }
 
   void get_tran(long long & _t, StatGear & _gear, int & _pgoil, float & _tgoil)
   {
-    lock();
-    _t = ttran;
-    _gear = gear;
-    _pgoil = pgoil;
-    _tgoil = tgoil;
-    unlock();
+    s_eng_state_snapshot s;
+    m_snap.read(s);
+    _t = s.ttran;
+    _gear = s.gear;
+    _pgoil = s.pgoil;
+    _tgoil = s.tgoil;
   }
 
   void set_trip(const long long _t, const int _flused, const float _flavg,
@@ -592,19 +739,20 @@ class ch_eng_state: public ch_base
     flavg = _flavg;
     fleco = _fleco;
     flinst = _flinst;
+    update_snapshot();
     unlock();
   }
 
   void get_trip(long long & _t, int & _flused, float & _flavg, float & _fleco,
 		float & _flinst)
   {
-    lock();
-    _t = ttrip;
-    _flused = flused;
-    _flavg = flavg;
-    _fleco = fleco;
-    _flinst = flinst;
-    unlock();
+    s_eng_state_snapshot s;
+    m_snap.read(s);
+    _t = s.ttrip;
+    _flused = s.flused;
+    _flavg = s.flavg;
+    _fleco = s.fleco;
+    _flinst = s.flinst;
   }
 
     virtual size_t get_dsize(){
@@ -620,11 +768,33 @@ class ch_eng_state: public ch_base
     virtual int read(FILE * Pf, long long tcur);
     virtual void print(ostream & out);
     virtual bool log2txt(FILE * pbf, FILE * ptf);
+
+    virtual bool skip_rec(FILE * pbf, long long & trec)
+    {
+      return skip_fixed_rec(pbf, get_dsize(), 0, trec);
+    }
+};
+
+struct s_env_snapshot{
+  long long t;
+  float baro, temp, humd, ilum;
 };
 
 class ch_env: public ch_base 
 {
  private:
+  c_seqlock<s_env_snapshot> m_snap;
+  void update_snapshot()
+  {
+    s_env_snapshot & s = m_snap.begin_write();
+    s.t = t;
+    s.baro = baro;
+    s.temp = temp;
+    s.humd = humd;
+    s.ilum = ilum;
+    m_snap.end_write();
+  }
+
   long long t, tf;
   float baro, barof; // barometer
   float temp, tempf; // temperature
@@ -643,18 +813,19 @@ class ch_env: public ch_base
     temp = _temp;
     humd = _humd;
     ilum = _ilum;
+    update_snapshot();
     unlock();
   };
 
   void get(long long & _t, float & _baro, float & _temp, float & _humd, float &_ilum)
   {
-    lock();
-    _t = t;
-    _baro = baro;
-    _temp = temp;
-    _humd = humd;
-    _ilum = ilum;
-    unlock();
+    s_env_snapshot s;
+    m_snap.read(s);
+    _t = s.t;
+    _baro = s.baro;
+    _temp = s.temp;
+    _humd = s.humd;
+    _ilum = s.ilum;
   }
 
   virtual size_t get_dsize(){
@@ -666,6 +837,11 @@ class ch_env: public ch_base
   virtual int read(FILE * Pf, long long tcur);
   virtual void print(ostream & out);
   virtual bool log2txt(FILE * pbf, FILE * ptf);
+
+  virtual bool skip_rec(FILE * pbf, long long & trec)
+  {
+    return skip_fixed_rec(pbf, sizeof(long long) + get_dsize(), sizeof(long long), trec);
+  }
 };
 
 
@@ -715,5 +891,9 @@ public:
   virtual void print(ostream & out);
   virtual bool log2txt(FILE * pbf, FILE * ptf);
 
+  virtual bool skip_rec(FILE * pbf, long long & trec)
+  {
+    return skip_fixed_rec(pbf, sizeof(long long) + get_dsize(), sizeof(long long), trec);
+  }
 };
 #endif
@@ -69,6 +69,7 @@ public:
 		for(i = 0; m_num < m_size && i < len; m_num++, i++, m_tail = (m_tail + 1) % m_size){
 			m_buf[m_tail] = buf[i];
 		}
+		count_pub(i * sizeof(T));
 		unlock();
 		return i;
 	}
@@ -79,6 +80,7 @@ public:
 		for(i = 0; m_num != 0 && i < len; m_num--, i++, m_head = (m_head + 1) % m_size){
 			buf[i] = m_buf[m_head];
 		}
+		count_cons(i * sizeof(T));
 		unlock();
 		return i;
 	}
@@ -151,8 +151,10 @@ void ch_base::register_factory()
 	register_factory<ch_sample>("sample");
 	register_factory<ch_image_cln>("imgc");
 	register_factory<ch_image_ref>("imgr");
+	register_factory<ch_image_pool>("imgp");
 	register_factory<ch_pvt>("pvt");
 	register_factory<ch_nmea>("nmea");
+	register_factory<ch_nmea_rec>("nmea_rec");
 	register_factory<ch_ais>("ais");
 	register_factory<ch_vector<s_binary_message> >("bmsg");
 	register_factory<ch_navdat>("ship");
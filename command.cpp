@@ -30,7 +30,8 @@ const char * str_cmd[CMD_UNKNOWN] = {
 	"channel", "filter", "fcmd", "fset", "fget", 
 	"finf", "fpar", "chinf", "go", "stop", "quit",
 	"step","cyc", "pause","clear", "rcmd", 
-	"trat", "chrm", "frm", "awscd", "awstime"
+	"trat", "chrm", "frm", "awscd", "awstime",
+	"fprof", "chstat"
 };
 
 e_cmd cmd_str_to_id(const char * cmd_str)
@@ -12,7 +12,7 @@ enum e_cmd {
 	CMD_FINF, CMD_FPAR, CMD_CHINF, CMD_GO, CMD_STOP, 
 	CMD_QUIT, CMD_STEP, CMD_CYC, CMD_PAUSE, 
 	CMD_CLEAR, CMD_RCMD, CMD_TRAT, CMD_CHRM, CMD_FRM, 
-	CMD_CD, CMD_TIME,
+	CMD_CD, CMD_TIME, CMD_FPROF, CMD_CHSTAT,
 	CMD_UNKNOWN
 };
 
@@ -0,0 +1,102 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_ap_ctrl.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_ap_ctrl.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_ap_ctrl.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdafx.h"
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+#include "../util/aws_const.h"
+#include "c_ap_ctrl.h"
+
+c_ap_ctrl::c_ap_ctrl(): cdiff(0.f), sdiff(0.f), dcdiff(0.f), dsdiff(0.f),
+  icdiff(0.f), isdiff(0.f),
+  pc(0.1f), ic(0.1f), dc(0.1f), ps(0.1f), is(0.1f), ds(0.1f), verb(false)
+{
+}
+
+void c_ap_ctrl::reset()
+{
+  icdiff = isdiff = 0.f;
+}
+
+void c_ap_ctrl::ctrl_to_cog(const float _cdiff, const float rudmid,
+			    const bool bastern, float & rud)
+{
+  float c = _cdiff;
+  // cdiff is normalized to [-180f,180f]
+  if(bastern)
+    c = -c;
+
+  if (abs(c) > 180.0f){
+    if(c < 0)
+      c += 360.f;
+    else
+      c -= 360.f;
+  }
+  c *= (float)(1.0f/180.0f);
+  dcdiff = (float)(c - cdiff);
+  if((c < 0 && rud > 0.f) || (c > 0 && rud < 255.f))
+    icdiff += c;
+
+  cdiff = c;
+
+  rud = (float)((pc * cdiff + ic * icdiff + dc * dcdiff) * 255.);
+
+  rud += rudmid;
+  rud = max(rud, 0.f);
+  rud = min(rud, 255.f);
+  if (verb)
+    printf("ap rud=%3.1f c=%2.2f dc=%2.2f ic=%2.2f\n", rud, cdiff, dcdiff, icdiff);
+}
+
+void c_ap_ctrl::ctrl_to_sog(const float sog, const float sog_tgt,
+			    const float smax, const float smin,
+			    const float meng_max, const float rudmid,
+			    const float rud, float & meng)
+{
+  float srange = (float)(smax - smin);
+
+  float stgt = (float)(srange * (1.0 - max(0.f, min(1.f, abs(rud - rudmid) * (1.0f / rudmid)))) + smin);
+  stgt = min(sog_tgt, stgt);
+
+  float s = (float)(stgt - sog);
+  s *= (float)(1. / srange);
+
+  dsdiff = (float)(s - sdiff);
+  isdiff += s;
+  sdiff = s;
+
+  meng = (float)((ps * sdiff + is * isdiff + ds * dsdiff) * 255. + 127.);
+  meng = (float)min(meng, meng_max);
+  meng = (float)max(meng, 127.f);
+  if(verb){
+    printf("ap meng=%3.1f stgt=%2.1f sog=%2.1f s=%2.2f ds=%2.2f is=%2.2f \n", meng, stgt, sog, sdiff, dsdiff, isdiff);
+  }
+}
+
+float c_ap_ctrl::calc_cdiff(const float rx, const float ry, const float cog)
+{
+  float ctgt = (float)(atan2(rx, ry) * 180. / PI);
+  float c = (float)(ctgt - cog);
+  if(abs(c) > 180.){
+    if(c < 0)
+      c += 360.;
+    else
+      c -= 360.;
+  }
+  return c;
+}
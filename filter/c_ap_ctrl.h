@@ -0,0 +1,60 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_ap_ctrl.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_ap_ctrl.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_ap_ctrl.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_AP_CTRL_H_
+#define _C_AP_CTRL_H_
+
+// c_ap_ctrl is the PID controller of the autopilot, the course to the
+// rudder and the speed to the main engine. Used by f_aws1_ap in the wp,
+// cursor, follow and stay modes, and by the batch simulator (sim_batch)
+// without the filter graph. The gains have the names of f_aws1_ap's
+// parameters. The controller holds only the PID state; the actuator
+// values are the caller's.
+class c_ap_ctrl
+{
+ protected:
+  float cdiff, sdiff;   // normalized course and speed errors
+  float dcdiff, dsdiff; // their differences
+  float icdiff, isdiff; // their integrals
+
+ public:
+  float pc, ic, dc; // PID for course control
+  float ps, is, ds; // PID for speed control
+  bool verb;
+
+  c_ap_ctrl();
+
+  // clears the integrals of the errors
+  void reset();
+
+  // updates rud toward the course difference cdiff (deg, target - cog).
+  // rudmid is the midship rudder value, bastern reverses the rudder.
+  void ctrl_to_cog(const float cdiff, const float rudmid, const bool bastern,
+		   float & rud);
+
+  // updates meng toward sog_tgt (kts). The target is reduced in [smin,
+  // smax] as the rudder rud leaves rudmid, and meng is limited to
+  // [127, meng_max].
+  void ctrl_to_sog(const float sog, const float sog_tgt,
+		   const float smax, const float smin,
+		   const float meng_max, const float rudmid, const float rud,
+		   float & meng);
+
+  // course difference (deg, in [-180, 180]) from cog (deg) to the point
+  // (rx, ry) (east, north) relative to the own ship.
+  static float calc_cdiff(const float rx, const float ry, const float cog);
+};
+
+#endif
@@ -38,6 +38,7 @@ bool c_model_base::alloc_param(int _index)
   for(int ipar = 0; ipar < n; ipar++){
     str_param[ipar] = gen_str_indexed_param(ipar);
   }  
+  return true;
 }
 
 char * c_model_base::gen_str_indexed_param(int iparam)
@@ -88,100 +89,151 @@ const char * c_model_3dof::_str_par_exp[num_params] = {
 
 };
 
+const char * str_model_integ[EMI_UNDEF] = {
+  "euler", "semi_implicit", "rk4"
+};
+
+// inverse of 3x3 matrix a by cofactors. false if a is singular.
+static bool inv3(const double * a, double * ainv)
+{
+  double c0 = a[4] * a[8] - a[5] * a[7];
+  double c1 = a[5] * a[6] - a[3] * a[8];
+  double c2 = a[3] * a[7] - a[4] * a[6];
+  double det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+  if (det == 0.0)
+    return false;
+
+  double idet = 1.0 / det;
+  ainv[0] = c0 * idet;
+  ainv[1] = (a[2] * a[7] - a[1] * a[8]) * idet;
+  ainv[2] = (a[1] * a[5] - a[2] * a[4]) * idet;
+  ainv[3] = c1 * idet;
+  ainv[4] = (a[0] * a[8] - a[2] * a[6]) * idet;
+  ainv[5] = (a[2] * a[3] - a[0] * a[5]) * idet;
+  ainv[6] = c2 * idet;
+  ainv[7] = (a[1] * a[6] - a[0] * a[7]) * idet;
+  ainv[8] = (a[0] * a[4] - a[1] * a[3]) * idet;
+  return true;
+}
+
+static inline void mul3(const double * a, const double * x, double * y)
+{
+  y[0] = a[0] * x[0] + a[1] * x[1] + a[2] * x[2];
+  y[1] = a[3] * x[0] + a[4] * x[1] + a[5] * x[2];
+  y[2] = a[6] * x[0] + a[7] * x[1] + a[8] * x[2];
+}
+
 void c_model_3dof::init()
 {
-M = Mat::zeros(3, 3, CV_64FC1);
-  double * data = M.ptr<double>();
-  
   for (int i = 0; i < 9; i++)
-    data[i] = ma[i];
-  data[0] += m;
-  data[4] += m;
+    M[i] = ma[i];
+  M[0] += m;
+  M[4] += m;
   iz = m * (xg * xg + yg * yg);
-  data[8] += iz;
+  M[8] += iz;
   
-  mxx = data[0];
-  myy = data[4];
+  mxx = M[0];
+  myy = M[4];
   mxg = m * xg;
   myg = m * yg;
   ny = (ma[5] + ma[7]) * 0.5;
-  
-  Dl = Mat::zeros(3, 3, CV_64FC1);
-  data = Dl.ptr<double>();
+
+  binit = inv3(M, Minv);
+  if (!binit)
+    cerr << "Mass matrix is singular." << endl;
+}
+
+void c_model_3dof::calc_damping(const double * v, double * N)
+{
+  // linear and quadratic drag
+  // q00|v0| q01|v1| q02|v2|
+  // q10|v0| q11|v1| q12|v2|
+  // q20|v0| q21|v1| q22|v2|
   for (int i = 0; i < 9; i++) {
-    data[i] = dl[i];		
+    N[i] = dl[i] + abs(v[i % 3]) * dq[i];
   }
-  
-  Dq = Mat::zeros(3, 3, CV_64FC1);
-  C = Mat::zeros(3, 3, CV_64FC1);
+
+  // coriolis and centrifugal force
+  double c02 = -mxg * v[2] - myy * v[1] + ny * v[2];
+  double c12 = -myg * v[2] + mxx * v[0];
+  N[2] += c02;
+  N[5] += c12;
+  N[6] -= c02;
+  N[7] -= c12;
+}
+
+void c_model_3dof::calc_accel(const double * v, const double * f, double * a)
+{
+  double N[9], r[3];
+  calc_damping(v, N);
+  mul3(N, v, r);
+  r[0] = f[0] - r[0];
+  r[1] = f[1] - r[1];
+  r[2] = f[2] - r[2];
+  mul3(Minv, r, a);
 }
 
-void c_model_3dof::update(double * _v,
-			  double * f /* x-y force and z moment applied */,
+void c_model_3dof::update(const double * _v,
+			  const double * f /* x-y force and z moment applied */,
 			  const double dt /* time step */, double * _vnew)
 {
-  if (Dq.empty() || M.empty() || Dl.empty()) {
+  if (!binit) {
     cerr << "Matrix should be initialized!" << endl;
     _vnew[0] = _vnew[1] = _vnew[2] = 0.;
     return;
   }
-  
-  // initializing quadratic drag
-  // q00|v0| q01|v1| q02|v2|
-  // q10|v0| q11|v1| q12|v2|
-  // q20|v0| q21|v1| q22|v2|
-  double * data = Dq.ptr<double>();
-  for (int i = 0; i < 9; i++) {
-    data[i] = abs(_v[i % 3]) * dq[i];
-  }
-  
-  // initializing coriolis and centrifugal force matrix
-  data = C.ptr<double>();
-  double * mdata = M.ptr<double>();
-  double mxxu = mxx * _v[0];
-  double myyv = myy * _v[1];
-  double mxgr = mxg * _v[2];
-  double mygr = myg * _v[2];
-  double nyr = ny * _v[2];
-  data[2] = -mxgr - myyv + nyr; // c02
-  data[5] = -mygr + mxxu;       // c12
-  data[6] = -data[2];           // c20
-  data[7] = -data[5];           // c21
-  
-  // initializing force vector T
-  Mat T(3, 1, CV_64FC1, f);
-  
-  // Calculating next velocity
+
   // Mv'+(C+Dl+Dq)v=T
-  // v'=M^-1 * (T-(C+Dl+Dq)v)
-  // v=v+v'dt
-  Mat V(3, 1, CV_64FC1, _v);
-  Mat Vnext;
-  Mat R1 = (C + Dl + Dq) * V;
-  Mat R2 = T - R1;
-  Mat R3 = M.inv() * R2;
-  Mat R4 = R3 * dt;
-  Vnext = V + R3 * dt;
-  /*
-  cout << "V:" << V << endl;
-  cout << "Vnext:" << Vnext << endl;
-  cout << "T:" << T << endl;
-  cout << "C:" << C << endl;
-  cout << "Dl:" << Dl << endl;
-  cout << "Dq:" << Dq << endl;
-  cout << "M:" << M << endl;
-  cout << "Mi:" << M.inv() << endl;
-  cout << "R1:" << R1 << endl;
-  cout << "R2:" << R2 << endl;
-  cout << "R3:" << R3 << endl;
-  cout << "R4:" << R4 << endl;
-  cout << "dt:" << dt << endl;
-  */
-  // Updating velocity
-  data = Vnext.ptr<double>();
-  _vnew[0] = data[0];
-  _vnew[1] = data[1];
-  _vnew[2] = data[2];
+  double v[3] = {_v[0], _v[1], _v[2]};
+  switch (integ) {
+  case EMI_SEMI_IMPLICIT:
+    {
+      // (M + dt N(v)) vnext = M v + dt T
+      double N[9], A[9], Ainv[9], b[3];
+      calc_damping(v, N);
+      for (int i = 0; i < 9; i++)
+	A[i] = M[i] + dt * N[i];
+      mul3(M, v, b);
+      b[0] += dt * f[0];
+      b[1] += dt * f[1];
+      b[2] += dt * f[2];
+      if (inv3(A, Ainv)) {
+	mul3(Ainv, b, _vnew);
+	return;
+      }
+    }
+    // A is singular, then euler is used.
+    /* fall through */
+  case EMI_EULER:
+  default:
+    {
+      // v=v+v'dt
+      double a[3];
+      calc_accel(v, f, a);
+      _vnew[0] = v[0] + a[0] * dt;
+      _vnew[1] = v[1] + a[1] * dt;
+      _vnew[2] = v[2] + a[2] * dt;
+    }
+    break;
+  case EMI_RK4:
+    {
+      double k1[3], k2[3], k3[3], k4[3], vt[3];
+      double hdt = 0.5 * dt;
+      calc_accel(v, f, k1);
+      for (int i = 0; i < 3; i++)
+	vt[i] = v[i] + hdt * k1[i];
+      calc_accel(vt, f, k2);
+      for (int i = 0; i < 3; i++)
+	vt[i] = v[i] + hdt * k2[i];
+      calc_accel(vt, f, k3);
+      for (int i = 0; i < 3; i++)
+	vt[i] = v[i] + dt * k3[i];
+      calc_accel(vt, f, k4);
+      for (int i = 0; i < 3; i++)
+	_vnew[i] = v[i] + dt * (1.0 / 6.0) * (k1[i] + 2.0 * (k2[i] + k3[i]) + k4[i]);
+    }
+    break;
+  }
 }
 
 ////////////////////////////////////////////// rudder control model
@@ -265,8 +317,11 @@ void c_model_engine_ctrl::update(const int u, const float gamma,
     slack_inf = fslack;
     rdelta = rfdelta;
   }else{
+    // throttle is closed with the rates of the current gear
     delta_inf = 0.0;
     gamma_inf = 0.0;      
+    slack_inf = (gamma < 0 ? bslack : fslack);
+    rdelta = (gamma < 0 ? rbdelta : rfdelta);
   }
   
   if(gamma != gamma_inf && delta == 0.0)
@@ -123,6 +123,20 @@ class c_model_base
 
 
 //////////////////////////////////// 3dof kinetic model
+// integrators of c_model_3dof
+// EMI_EULER: explicit euler (default)
+// EMI_SEMI_IMPLICIT: linearly implicit euler, the drag and coriolis terms 
+//                    are evaluated at the next velocity with the coefficients
+//                    at the current velocity. Stable for large time steps.
+// EMI_RK4: 4th order runge kutta with the force held in the step.
+enum e_model_integ{
+  EMI_EULER, EMI_SEMI_IMPLICIT, EMI_RK4, EMI_UNDEF
+};
+
+extern const char * str_model_integ[EMI_UNDEF];
+
+// The matrices are 3x3 row major arrays, and M^-1 is calculated once in
+// init(). update() allocates nothing.
 class c_model_3dof: public c_model_base
 {
  private:
@@ -132,11 +146,16 @@ class c_model_3dof: public c_model_base
   double dl[9]; // linear drag matrix
   double dq[9]; // quadratic drag matrix
   
-  Mat M;
-  Mat Minv;
-  Mat Dl;
-  Mat Dq;
-  Mat C;
+  double M[9];    // mass matrix (including added mass)
+  double Minv[9]; // M^-1
+  bool binit;
+  e_model_integ integ;
+
+  // v' = M^-1 (f - (C(v) + Dl + Dq(v)) v)
+  void calc_accel(const double * v, const double * f, double * a);
+
+  // N = C(v) + Dl + Dq(v)
+  void calc_damping(const double * v, double * N);
 
   double iz;
   double mxx;
@@ -156,10 +175,10 @@ class c_model_3dof: public c_model_base
   static const char * _str_par_exp[num_params];
 
  public:
- c_model_3dof():xg(0), yg(0)
+ c_model_3dof():xg(0), yg(0), m(0), binit(false), integ(EMI_EULER)
     {
       for (int i = 0; i < 9; i++)
-	ma[i] = dl[i] = dq[i] = 0;
+	ma[i] = dl[i] = dq[i] = M[i] = Minv[i] = 0;
     }
   
   virtual ~c_model_3dof()
@@ -230,6 +249,16 @@ class c_model_3dof: public c_model_base
 
   virtual void init();
 
+  void set_integrator(const e_model_integ _integ)
+  {
+    integ = _integ;
+  }
+
+  e_model_integ get_integrator()
+  {
+    return integ;
+  }
+
   #ifdef PY_EXPORT
   boost::python::tuple update_py(double & _u, double & _v, double & _r, double & _taux, double & _tauy, double & _taun, double dt)
   {
@@ -241,8 +270,9 @@ class c_model_3dof: public c_model_base
   }
   #endif
   
-  void update(double * _v,
-	      double * f /* x-y force and z moment applied */,
+  // _v and _vnew can be the same array
+  void update(const double * _v,
+	      const double * f /* x-y force and z moment applied */,
 	      const double dt /* time step */, double * _vnew);
 };
 
@@ -408,6 +438,19 @@ public:
   #endif
 };
 
+// propeller rev (rpm) at the steady state for the throttle position
+// (thr_pos is the throttle position minus its slack)
+inline float calc_outboard_rev(const float thr_pos)
+{
+  if (thr_pos < 0.417)
+    return 700;
+  if (thr_pos < 0.709)
+    return (float)((5000 - 700) * (thr_pos - 0.417) / (0.709 - 0.417) + 700);
+  if (thr_pos < 0.854)
+    return (float)((5600 - 5000) * (thr_pos - 0.709) / (0.854 - 0.709) + 5000);
+  return 5600;
+}
+
 //////////////////////////////////////// force model for outboard mortor
 class c_model_outboard_force: public c_model_base
 {
@@ -460,6 +503,7 @@ public:
     case par_CL:
       return &CL;
     }
+    return NULL;
   }
   
   virtual int get_num_params()
@@ -488,8 +532,15 @@ BOOST_PYTHON_MODULE( pyawssim ){
     .def("alloc_param", &c_model_base::alloc_param)
     ;
   
+  python::enum_<e_model_integ>("e_model_integ")
+    .value("euler", EMI_EULER)
+    .value("semi_implicit", EMI_SEMI_IMPLICIT)
+    .value("rk4", EMI_RK4)
+    ;
+
   python::class_<c_model_3dof, python::bases<c_model_base> >("c_model_3dof")
     .def("update", &c_model_3dof::update_py)
+    .def("set_integrator", &c_model_3dof::set_integrator)
     ;
   
   python::class_<c_model_rudder_ctrl, python::bases<c_model_base> >("c_model_rudder_ctrl")
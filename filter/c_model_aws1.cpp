@@ -0,0 +1,219 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_model_aws1.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_model_aws1.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_model_aws1.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdafx.h"
+#include <iostream>
+#include <cmath>
+#include <map>
+using namespace std;
+
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+#include "c_model_aws1.h"
+
+c_model_aws1::c_model_aws1(): integ(EMI_EULER), vplane(10.0)
+{
+}
+
+void c_model_aws1::alloc_param()
+{
+  mrctrl.alloc_param();
+  mectrl.alloc_param();
+  mobf.alloc_param(0);
+  mobfp.alloc_param(1);
+  mobfb.alloc_param(2);
+  m3dof.alloc_param(0);
+  m3dofp.alloc_param(1);
+  m3dofb.alloc_param(2);
+}
+
+void c_model_aws1::init()
+{
+  mrctrl.init();
+  mectrl.init();
+  mobf.init();
+  mobfp.init();
+  mobfb.init();
+  m3dof.init();
+  m3dofp.init();
+  m3dofb.init();
+  m3dof.set_integrator(integ);
+  m3dofp.set_integrator(integ);
+  m3dofb.set_integrator(integ);
+}
+
+int c_model_aws1::set_params(map<string, double> & vals)
+{
+  c_model_base * mdls[8] = {&mrctrl, &mectrl, &mobf, &mobfp, &mobfb,
+			    &m3dof, &m3dofp, &m3dofb};
+  int nset = 0;
+  for (int imdl = 0; imdl < 8; imdl++){
+    c_model_base & mdl = *mdls[imdl];
+    int npars = mdl.get_num_params();
+    for (int ipar = 0; ipar < npars; ipar++){
+      map<string, double>::iterator itr = vals.find(mdl.get_str_param(ipar));
+      if (itr == vals.end())
+	continue;
+      *mdl.get_param(ipar) = itr->second;
+      nset++;
+    }
+  }
+
+  map<string, double>::iterator itr = vals.find("vplane");
+  if (itr != vals.end()){
+    vplane = itr->second;
+    nset++;
+  }
+
+  itr = vals.find("integ");
+  if (itr != vals.end() && itr->second >= 0 && itr->second < EMI_UNDEF){
+    integ = (e_model_integ)(int)itr->second;
+    nset++;
+  }
+
+  init();
+  return nset;
+}
+
+void c_model_aws1::update(const s_aws1_sim_state & stprev,
+			  s_aws1_sim_state & stcur, const double dt)
+{
+  // simulate actuator and pump
+  double v[3];
+  double f[3];
+  double phi = (stprev.cog - stprev.yaw);
+  double th = stprev.cog;
+
+  double sog_ms = stprev.sog * (1852. / 3600.);
+  double dx = sog_ms * dt * sin(th),
+    dy = sog_ms * dt * cos(th); //next position in enu coordinate
+  double dz = 0., alt = 0.;
+
+  wrldtoecef(stprev.Rwrld, stprev.xe, stprev.ye, stprev.ze, &dx, &dy, &dz,
+	     &stcur.xe, &stcur.ye, &stcur.ze, 1);
+  eceftobih(stcur.xe, stcur.ye, stcur.ze, stcur.lat, stcur.lon, alt);
+  getwrldrot(stcur.lat, stcur.lon, stcur.Rwrld);
+
+  v[0] = sog_ms * cos(phi);
+  v[1] = sog_ms * sin(phi);
+  v[2] = stprev.ryaw;
+
+  mrctrl.update(stprev.rud, stprev.rud_pos, stprev.rud_slack, dt,
+		stcur.rud_pos, stcur.rud_slack);
+  mectrl.update(stprev.eng, stprev.gear_pos, stprev.thro_pos,
+		stprev.thro_slack, dt,
+		stcur.gear_pos, stcur.thro_pos, stcur.thro_slack);
+  if(v[0] < 0){
+    // astern model
+    mobfb.update((stprev.rud_pos - stprev.rud_slack),
+		 stprev.gear_pos, stprev.thro_pos - stprev.thro_slack,
+		 stprev.rev, v, f);
+    m3dofb.update(v, f, dt, v);
+  }else if(v[0] < vplane){
+    // displacement model
+    mobf.update((stprev.rud_pos - stprev.rud_slack),
+		stprev.gear_pos, stprev.thro_pos - stprev.thro_slack,
+		stprev.rev, v, f);
+    m3dof.update(v, f, dt, v);
+  }
+  else{
+    // planing model
+    mobfp.update((stprev.rud_pos - stprev.rud_slack),
+		 stprev.gear_pos, stprev.thro_pos - stprev.thro_slack,
+		 stprev.rev, v, f);
+    m3dofp.update(v, f, dt, v);
+  }
+
+  phi = atan2(v[1], v[0]);
+  stcur.yaw += v[2] * dt;
+  if(stcur.yaw > PI)
+    stcur.yaw -= 2 * PI;
+  else if(stcur.yaw < -PI)
+    stcur.yaw += 2 * PI;
+
+  stcur.ryaw = v[2];
+  stcur.cog = stcur.yaw + phi;
+  if(stcur.cog < 0)
+    stcur.cog += 2 * PI;
+  else if(stcur.cog > 2 *PI)
+    stcur.cog -= 2 * PI;
+
+  stcur.sog = sqrt(v[0] * v[0] + v[1] * v[1]) * (3600. / 1852.);
+  stcur.rev = calc_outboard_rev(stcur.thro_pos - stcur.thro_slack);
+}
+
+void c_model_aws1::write_csv_header(ostream & out)
+{
+  out <<
+    "t,lat_o,lon_o,xe_o,ye_o,ze_o,roll_o,pitch_o,yaw_o,sog_o,cog_o,eng_o,rud_o,rev_o,fuel_o,"
+      << "thro,gear,rud,"
+      <<"lat_i,lon_i,xe_i,ye_i,ze_i,roll_i,pitch_i,yaw_i,sog_i,cog_i,eng_i,rud_i,rev_i,fuel_i,"
+      << endl;
+  out.precision(3);
+}
+
+void c_model_aws1::write_csv(ostream & out, const long long t,
+			     const s_aws1_sim_state & svo,
+			     const s_aws1_sim_state & svi)
+{
+  out << t << ",";
+
+  out.precision(8);
+  out <<
+    svo.lat * (180.f/PI) << "," <<
+    svo.lon * (180.f/PI) << "," <<
+    svo.xe << "," <<
+    svo.ye << "," <<
+    svo.ze << ",";
+
+  out.precision(3);
+  out <<
+    svo.roll * (180.f/PI)<< "," <<
+    svo.pitch * (180.f/PI)<< "," <<
+    svo.yaw  * (180.f/PI)<< "," <<
+    svo.sog << "," <<
+    svo.cog  * (180.f/PI)<< "," <<
+    svo.eng << "," <<
+    svo.rud << "," <<
+    svo.rev << "," <<
+    svo.fuel << ",";
+  out <<
+    svo.thro_pos << "," <<
+    svo.gear_pos << "," <<
+    svo.rud_pos << ",";
+
+  out.precision(8);
+  out <<
+    svi.lat * (180.f/PI) << "," <<
+    svi.lon * (180.f/PI) << "," <<
+    svi.xe << "," <<
+    svi.ye << "," <<
+    svi.ze << ",";
+
+  out.precision(3);
+  out <<
+    svi.roll * (180.f/PI) << "," <<
+    svi.pitch * (180.f/PI) << "," <<
+    svi.yaw * (180.f/PI) << "," <<
+    svi.sog << "," <<
+    svi.cog * (180.f/PI) << "," <<
+    svi.eng << "," <<
+    svi.rud << "," <<
+    svi.rev << "," <<
+    svi.fuel << ",";
+
+  out << endl;
+}
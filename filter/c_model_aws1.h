@@ -0,0 +1,115 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_model_aws1.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_model_aws1.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_model_aws1.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_MODEL_AWS1_H_
+#define _C_MODEL_AWS1_H_
+
+#include "../util/aws_coord.h"
+#include "c_model.hpp"
+
+// state vector of the AWS1 simulation (angles in radian, sog in kts)
+struct s_aws1_sim_state
+{
+  long long t;
+  double lat, lon, xe, ye, ze, roll, pitch, yaw, cog, sog, ryaw;
+  s_rot3 Rwrld;
+  float eng, rud, rev, fuel;
+  float thro_pos, thro_slack, gear_pos, rud_pos, rud_slack;
+
+s_aws1_sim_state(const long long & _t,
+		 const double & _lat, const double & _lon,
+		 const double & _roll, const double & _pitch,
+		 const double & _yaw,
+		 const double & _cog, const double & _sog,
+		 const float & _eng, const float & _rud,
+		 const float & _rev, const float & _fuel) :
+  t(_t), lat(_lat), lon(_lon),
+    roll(_roll), pitch(_pitch), yaw(_yaw), cog(_cog), sog(_sog), ryaw(0),
+    eng(_eng), rud(_rud), rev(_rev), fuel(_fuel),
+    thro_pos(0.f), thro_slack(0.f), gear_pos(0.f),
+    rud_pos(0.f), rud_slack(0.f)
+  {
+    update_coordinates();
+  }
+
+s_aws1_sim_state() :t(0), lat(135.f), lon(35.f),
+    roll(0.f), pitch(0.f), yaw(0.f), cog(0.f), sog(0.f), ryaw(0),
+    eng(127.0f), rud(127.0f), rev(700.f), fuel(0.1f),
+    thro_pos(0.f), thro_slack(0.f), gear_pos(0.f),
+    rud_pos(0.f), rud_slack(0.f)
+  {
+    update_coordinates();
+  }
+
+  void update_coordinates() {
+    bihtoecef(lat, lon, 0., xe, ye, ze);
+    getwrldrot(lat, lon, Rwrld);
+  }
+
+  void print()
+  {
+    cout << " rud:" << rud << " rud_pos:" << rud_pos
+	 << " rud_slack:" << rud_slack;
+    cout << " eng: " << eng << " gear_pos:" << gear_pos
+	 << " thro_pos: " << thro_pos << " thro_slack:" << thro_slack;
+    cout << " rev:" << rev;
+    cout << " yaw:" << yaw;
+    cout << " cog:" << cog;
+    cout << " sog:" << sog;
+  }
+};
+
+// c_model_aws1 is the set of the boat models of AWS1 (rudder and engine
+// control, outboard force and 3dof kinetic models for the displacement,
+// planing and astern modes), and steps the state vector. Used by
+// f_aws1_sim and by the batch simulator (sim_batch) without the filter
+// graph. The parameter names are the same as f_aws1_sim's.
+class c_model_aws1
+{
+ public:
+  c_model_rudder_ctrl mrctrl; // rudder control model
+  c_model_engine_ctrl mectrl; // engine control model
+  c_model_outboard_force mobf, mobfp, mobfb; // engine force model, later is for the planing mode and astern mode
+  c_model_3dof m3dof, m3dofp, m3dofb;         // kinetic model, later is for the planing mode and astern mode
+  e_model_integ integ; // integrator of the kinetic models
+  double vplane; // planing velocity
+
+  c_model_aws1();
+
+  // assigns parameter indices (once, before registering the parameters)
+  void alloc_param();
+
+  // initializes the models with the current parameters
+  void init();
+
+  // sets parameters by name ("vplane" and "integ" included) and
+  // initializes the models. returns the number of the parameters set.
+  int set_params(map<string, double> & vals);
+
+  // steps the dynamic fields of stcur (position, attitude, velocity,
+  // actuator state and engine rev) dt seconds from stprev. stcur.yaw is
+  // integrated in place, then stcur should hold the previous output yaw
+  // (or a copy of stprev). stcur and stprev should not be the same.
+  void update(const s_aws1_sim_state & stprev, s_aws1_sim_state & stcur,
+	      const double dt);
+
+  // csv rows, the output vector svo followed by the input vector svi
+  static void write_csv_header(ostream & out);
+  static void write_csv(ostream & out, const long long t,
+			const s_aws1_sim_state & svo,
+			const s_aws1_sim_state & svi);
+};
+
+#endif
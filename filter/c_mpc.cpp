@@ -0,0 +1,425 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_mpc.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_mpc.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_mpc.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdafx.h"
+#include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <map>
+using namespace std;
+
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+#include "../util/aws_coord.h"
+#include "../util/c_clock.h"
+#include "../util/c_lat_hist.h"
+
+#include "c_mpc.h"
+
+c_mpc::c_mpc(): m_prctrl(NULL), m_pectrl(NULL), m_vplane(0.),
+  m_ncands(0), m_nsegs(0), m_nsteps_seg(0),
+  m_best_cost(FLT_MAX), m_bbest(false), m_tplan(0),
+  m_rud_cur(127.f), m_eng_cur(127.f), m_eng_min(0.f), m_eng_max(255.f),
+  m_bwp(false), m_xwp(0.f), m_ywp(0.f), m_sog_tgt(0.f),
+  m_nobst(0), m_ncoast(0), m_rnd(2463534242u),
+  m_nworkers(0), m_gen(0), m_bopen(false), m_bexit(false), m_nactive(0),
+  m_nblk(0), m_iblk(0), m_nblk_done(0), m_tdeadline(0), m_tproc(0)
+{
+  for (int i = 0; i < 3; i++){
+    m_pobf[i] = NULL;
+    m_p3dof[i] = NULL;
+  }
+  for (int i = 0; i < MPC_MAX_WORKERS; i++)
+    m_workers[i] = NULL;
+  m_st.yaw = m_st.u = m_st.v = m_st.r = 0.f;
+}
+
+c_mpc::~c_mpc()
+{
+  destroy();
+}
+
+void c_mpc::set_models(c_model_rudder_ctrl * prctrl,
+		       c_model_engine_ctrl * pectrl,
+		       c_model_outboard_force * pobf,
+		       c_model_outboard_force * pobfp,
+		       c_model_outboard_force * pobfb,
+		       c_model_3dof * p3dof, c_model_3dof * p3dofp,
+		       c_model_3dof * p3dofb, const double vplane)
+{
+  m_prctrl = prctrl;
+  m_pectrl = pectrl;
+  m_pobf[0] = pobf;
+  m_pobf[1] = pobfp;
+  m_pobf[2] = pobfb;
+  m_p3dof[0] = p3dof;
+  m_p3dof[1] = p3dofp;
+  m_p3dof[2] = p3dofb;
+  m_vplane = vplane;
+}
+
+bool c_mpc::init(const s_mpc_par & par)
+{
+  destroy();
+
+  if(!m_prctrl || !m_pectrl){
+    cerr << "Error in c_mpc::init(). Models are not set." << endl;
+    return false;
+  }
+
+  if(par.dt <= 0.f || par.tseg < par.dt){
+    cerr << "Error in c_mpc::init(). Time step " << par.dt
+	 << " should be in (0, " << par.tseg << "]." << endl;
+    return false;
+  }
+
+  m_par = par;
+  m_nsegs = max(1, min(MPC_MAX_SEGS, m_par.nsegs));
+  m_ncands = max(1, min(MPC_MAX_CANDS, m_par.ncands));
+  m_ncands = ((m_ncands + MPC_LANES - 1) / MPC_LANES) * MPC_LANES;
+  m_ncands = min(MPC_MAX_CANDS, max(m_ncands, MPC_LANES));
+  m_nsteps_seg = (int)(m_par.tseg / m_par.dt + 0.5f);
+  m_nblk = m_ncands / MPC_LANES;
+  m_bbest = false;
+  m_best_cost = FLT_MAX;
+
+  m_bexit = false;
+  m_bopen = false;
+  m_nactive = 0;
+  m_nworkers = max(0, min(MPC_MAX_WORKERS, m_par.nworkers));
+  for (int iw = 0; iw < m_nworkers; iw++)
+    m_workers[iw] = new thread(sworker, this);
+
+  return true;
+}
+
+void c_mpc::destroy()
+{
+  {
+    unique_lock<mutex> lock(m_mtx);
+    m_bexit = true;
+  }
+  m_cnd_start.notify_all();
+
+  for (int iw = 0; iw < m_nworkers; iw++){
+    m_workers[iw]->join();
+    delete m_workers[iw];
+    m_workers[iw] = NULL;
+  }
+  m_nworkers = 0;
+}
+
+void c_mpc::sworker(c_mpc * ptr)
+{
+  ptr->worker();
+}
+
+void c_mpc::worker()
+{
+  long long gen = 0;
+  unique_lock<mutex> lock(m_mtx);
+  while(1){
+    while(!m_bexit && !(m_bopen && m_gen != gen))
+      m_cnd_start.wait(lock);
+    if(m_bexit)
+      break;
+
+    gen = m_gen;
+    m_nactive++;
+    lock.unlock();
+
+    rollout_blocks();
+
+    lock.lock();
+    m_nactive--;
+    if(m_nactive == 0)
+      m_cnd_done.notify_one();
+  }
+}
+
+void c_mpc::update_actuator(const float rud, const float eng, const float dt)
+{
+  if(!m_prctrl || !m_pectrl || dt <= 0.f)
+    return;
+
+  // the steps are limited to m_par.dt for the stability of the models
+  float tstep = (m_par.dt > 0.f ? m_par.dt : dt);
+  for (float t = 0.f; t < dt; t += tstep){
+    float h = min(tstep, dt - t);
+    float rp, rs, gp, tp, ts;
+    m_prctrl->update((int) rud, m_act.rud_pos, m_act.rud_slack, h, rp, rs);
+    m_pectrl->update((int) eng, m_act.gear_pos, m_act.thro_pos,
+		     m_act.thro_slack, h, gp, tp, ts);
+    m_act.rud_pos = rp;
+    m_act.rud_slack = rs;
+    m_act.gear_pos = gp;
+    m_act.thro_pos = tp;
+    m_act.thro_slack = ts;
+  }
+}
+
+void c_mpc::sample(const int nshift)
+{
+  const float rud_min = 0.f, rud_max = 255.f;
+  const float eng_min = m_eng_min, eng_max = m_eng_max;
+
+  // warm start: the previous best shifted by the segments elapsed. the last
+  // segment is repeated.
+  float rud0[MPC_MAX_SEGS], eng0[MPC_MAX_SEGS];
+  for (int iseg = 0; iseg < m_nsegs; iseg++){
+    if(m_bbest){
+      int jseg = min(iseg + nshift, m_nsegs - 1);
+      rud0[iseg] = m_best_rud[jseg];
+      eng0[iseg] = m_best_eng[jseg];
+    }else{
+      rud0[iseg] = m_rud_cur;
+      eng0[iseg] = m_eng_cur;
+    }
+  }
+
+  // the random candidates are spread over the blocks, then the blocks
+  // evaluated before the deadline have both kinds.
+  int lane_rand = MPC_LANES - (int)(m_par.rrand * MPC_LANES + 0.5f);
+  for (int icand = 0; icand < m_ncands; icand++){
+    if(icand == 0){ // warm start
+      for (int iseg = 0; iseg < m_nsegs; iseg++){
+	m_rud[iseg][icand] = rud0[iseg];
+	m_eng[iseg][icand] = eng0[iseg];
+      }
+    }else if(icand == 1){ // holding the current control
+      for (int iseg = 0; iseg < m_nsegs; iseg++){
+	m_rud[iseg][icand] = m_rud_cur;
+	m_eng[iseg][icand] = m_eng_cur;
+      }
+    }else if(icand == 2){ // stop
+      for (int iseg = 0; iseg < m_nsegs; iseg++){
+	m_rud[iseg][icand] = 127.f;
+	m_eng[iseg][icand] = 127.f;
+      }
+    }else if(icand % MPC_LANES >= lane_rand){ // uniformly random
+      for (int iseg = 0; iseg < m_nsegs; iseg++){
+	m_rud[iseg][icand] = rud_min + (rud_max - rud_min) * rand_u();
+	m_eng[iseg][icand] = eng_min + (eng_max - eng_min) * rand_u();
+      }
+    }else{ // perturbed warm start (triangular noise)
+      for (int iseg = 0; iseg < m_nsegs; iseg++){
+	float nr = (rand_u() + rand_u() - 1.f) * m_par.srud;
+	float ne = (rand_u() + rand_u() - 1.f) * m_par.seng;
+	m_rud[iseg][icand] = min(rud_max, max(rud_min, rud0[iseg] + nr));
+	m_eng[iseg][icand] = min(eng_max, max(eng_min, eng0[iseg] + ne));
+      }
+    }
+  }
+}
+
+void c_mpc::rollout_blocks()
+{
+  while(1){
+    int iblk = m_iblk.fetch_add(1);
+    if(iblk >= m_nblk)
+      break;
+    if(get_mono_time_nsec() > m_tdeadline)
+      break;
+    rollout(iblk);
+  }
+}
+
+void c_mpc::rollout(const int iblk)
+{
+  const int c0 = iblk * MPC_LANES;
+  const float dt = m_par.dt;
+  const float wwp = m_par.wwp * dt, wsog = m_par.wsog * dt;
+  const float wais = m_par.wais * dt, wcoast = m_par.wcoast * dt;
+  const float icoast2 = 1.f / (m_par.dcoast * m_par.dcoast);
+  const float wctrl = m_par.wctrl * (1.f / (255.f * 255.f));
+
+  float x[MPC_LANES], y[MPC_LANES], yaw[MPC_LANES];
+  float u[MPC_LANES], v[MPC_LANES], r[MPC_LANES];
+  float rp[MPC_LANES], rs[MPC_LANES], gp[MPC_LANES], tp[MPC_LANES], ts[MPC_LANES];
+  float rud_prev[MPC_LANES], eng_prev[MPC_LANES];
+  float cost[MPC_LANES];
+
+  for (int l = 0; l < MPC_LANES; l++){
+    x[l] = y[l] = 0.f;
+    yaw[l] = m_st.yaw;
+    u[l] = m_st.u;
+    v[l] = m_st.v;
+    r[l] = m_st.r;
+    rp[l] = m_act.rud_pos;
+    rs[l] = m_act.rud_slack;
+    gp[l] = m_act.gear_pos;
+    tp[l] = m_act.thro_pos;
+    ts[l] = m_act.thro_slack;
+    rud_prev[l] = m_rud_cur;
+    eng_prev[l] = m_eng_cur;
+    cost[l] = 0.f;
+  }
+
+  float t = 0.f;
+  for (int iseg = 0; iseg < m_nsegs; iseg++){
+    const float * rud = &m_rud[iseg][c0];
+    const float * eng = &m_eng[iseg][c0];
+    for (int l = 0; l < MPC_LANES; l++){
+      float drud = rud[l] - rud_prev[l], deng = eng[l] - eng_prev[l];
+      cost[l] += wctrl * (drud * drud + deng * deng);
+      rud_prev[l] = rud[l];
+      eng_prev[l] = eng[l];
+    }
+
+    for (int istep = 0; istep < m_nsteps_seg; istep++){
+      // kinematics with the velocity at the beginning of the step
+      for (int l = 0; l < MPC_LANES; l++){
+	float s = sinf(yaw[l]), c = cosf(yaw[l]);
+	x[l] += (u[l] * s + v[l] * c) * dt;
+	y[l] += (u[l] * c - v[l] * s) * dt;
+      }
+
+      // actuators and kinetics (as f_aws1_sim::update_output_sample)
+      for (int l = 0; l < MPC_LANES; l++){
+	double vl[3] = {u[l], v[l], r[l]};
+	double f[3];
+	float thro = tp[l] - ts[l];
+	int imdl = (vl[0] < 0 ? 2 : (vl[0] < m_vplane ? 0 : 1));
+	m_pobf[imdl]->update(rp[l] - rs[l], gp[l], thro,
+			     calc_outboard_rev(thro), vl, f);
+	m_p3dof[imdl]->update(vl, f, dt, vl);
+	u[l] = (float) vl[0];
+	v[l] = (float) vl[1];
+	r[l] = (float) vl[2];
+
+	float rpn, rsn, gpn, tpn, tsn;
+	m_prctrl->update((int) rud[l], rp[l], rs[l], dt, rpn, rsn);
+	m_pectrl->update((int) eng[l], gp[l], tp[l], ts[l], dt, gpn, tpn, tsn);
+	rp[l] = rpn;
+	rs[l] = rsn;
+	gp[l] = gpn;
+	tp[l] = tpn;
+	ts[l] = tsn;
+      }
+
+      for (int l = 0; l < MPC_LANES; l++)
+	yaw[l] += r[l] * dt;
+
+      t += dt;
+
+      // waypoint and speed
+      if(m_bwp){
+	for (int l = 0; l < MPC_LANES; l++){
+	  float dx = x[l] - m_xwp, dy = y[l] - m_ywp;
+	  cost[l] += wwp * sqrtf(dx * dx + dy * dy);
+	}
+      }
+
+      for (int l = 0; l < MPC_LANES; l++){
+	float ds = sqrtf(u[l] * u[l] + v[l] * v[l]) - m_sog_tgt;
+	cost[l] += wsog * ds * ds;
+      }
+
+      // moving obstacles, cost grows as the squared distance decreases
+      // in the range of avoidance
+      for (int io = 0; io < m_nobst; io++){
+	const s_mpc_obst & o = m_obst[io];
+	float ox = o.x + o.vx * t, oy = o.y + o.vy * t;
+	float irav2 = 1.f / (o.rav * o.rav);
+	for (int l = 0; l < MPC_LANES; l++){
+	  float dx = x[l] - ox, dy = y[l] - oy;
+	  float e = 1.f - (dx * dx + dy * dy) * irav2;
+	  cost[l] += wais * max(e, 0.f);
+	}
+      }
+
+      // coast lines
+      for (int ic = 0; ic < m_ncoast; ic++){
+	float cx = m_xcoast[ic], cy = m_ycoast[ic];
+	for (int l = 0; l < MPC_LANES; l++){
+	  float dx = x[l] - cx, dy = y[l] - cy;
+	  float e = 1.f - (dx * dx + dy * dy) * icoast2;
+	  cost[l] += wcoast * max(e, 0.f);
+	}
+      }
+    }
+  }
+
+  // diverged rollouts (NaN) are never chosen
+  for (int l = 0; l < MPC_LANES; l++)
+    m_cost[c0 + l] = (cost[l] == cost[l] ? cost[l] : FLT_MAX);
+  m_nblk_done.fetch_add(1);
+}
+
+bool c_mpc::plan(const long long tcur, float & rud, float & eng)
+{
+  if(m_nblk == 0)
+    return false;
+
+  long long tstart = get_mono_time_nsec();
+  m_tdeadline = tstart + (long long)(m_par.tmax * 1e6);
+
+  int nshift = 0;
+  long long tseg = (long long)(m_par.tseg * SEC);
+  if(m_bbest && tcur >= m_tplan){
+    nshift = (int)((tcur - m_tplan) / tseg);
+    m_tplan += nshift * tseg;
+  }else{
+    m_tplan = tcur;
+  }
+
+  sample(nshift);
+  for (int icand = 0; icand < m_ncands; icand++)
+    m_cost[icand] = FLT_MAX;
+
+  // the first block is always evaluated.
+  m_nblk_done.store(0);
+  m_iblk.store(1);
+  rollout(0);
+
+  if(m_nworkers > 0){
+    {
+      unique_lock<mutex> lock(m_mtx);
+      m_gen++;
+      m_bopen = true;
+    }
+    m_cnd_start.notify_all();
+  }
+
+  rollout_blocks();
+
+  if(m_nworkers > 0){
+    unique_lock<mutex> lock(m_mtx);
+    m_bopen = false;
+    while(m_nactive > 0)
+      m_cnd_done.wait(lock);
+  }
+
+  int ibest = 0;
+  for (int icand = 1; icand < m_ncands; icand++){
+    if(m_cost[icand] < m_cost[ibest])
+      ibest = icand;
+  }
+
+  if(ibest != 0)
+    m_tplan = tcur;
+  for (int iseg = 0; iseg < m_nsegs; iseg++){
+    m_best_rud[iseg] = m_rud[iseg][ibest];
+    m_best_eng[iseg] = m_eng[iseg][ibest];
+  }
+  m_best_cost = m_cost[ibest];
+  m_bbest = true;
+
+  rud = m_best_rud[0];
+  eng = m_best_eng[0];
+  m_tproc = get_mono_time_nsec() - tstart;
+  return true;
+}
@@ -0,0 +1,272 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_mpc.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_mpc.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_mpc.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_MPC_H_
+#define _C_MPC_H_
+
+#include "../util/aws_thread.h"
+#include "c_model.hpp"
+
+#define MPC_MAX_CANDS 1024 // maximum number of candidate control sequences
+#define MPC_MAX_SEGS 16    // maximum number of segments in a sequence
+#define MPC_MAX_OBST 64    // maximum number of moving obstacles
+#define MPC_MAX_COAST 128  // maximum number of coast line points
+#define MPC_MAX_WORKERS 16 // maximum number of worker threads
+#define MPC_LANES 8        // number of candidates rolled out together
+
+// parameters of c_mpc (registered by the filter owning c_mpc)
+struct s_mpc_par
+{
+  int ncands;       // number of candidates (rounded up to MPC_LANES)
+  int nsegs;        // number of segments in a sequence
+  float tseg;       // duration of a segment (sec)
+  float dt;         // time step of the rollouts (sec). for large steps, the
+                    // semi implicit integrator of c_model_3dof is stable.
+  float tmax;       // deadline of the rollouts from the start of plan() (msec)
+  int nworkers;     // number of worker threads (the caller also rolls out)
+  float wwp;        // weight of the distance to the waypoint (per m sec)
+  float wsog;       // weight of the speed error (per (m/s)^2 sec)
+  float wais;       // weight of the intrusion into the range of AIS ships (per sec)
+  float wcoast;     // weight of the intrusion into the coast clearance (per sec)
+  float wctrl;      // weight of the control change between segments
+  float dcoast;     // clearance to the coast lines (m)
+  float srud, seng; // range of the perturbation to the previous best
+  float rrand;      // ratio of the uniformly random candidates
+
+s_mpc_par(): ncands(256), nsegs(6), tseg(5.f), dt(0.5f), tmax(50.f),
+    nworkers(2), wwp(1.f), wsog(10.f), wais(1000.f), wcoast(1000.f),
+    wctrl(10.f), dcoast(50.f), srud(40.f), seng(20.f), rrand(0.25f)
+  {
+  }
+};
+
+// own ship at the start of the rollouts. The positions given to c_mpc are
+// in the ENU frame centered at the own ship.
+struct s_mpc_state
+{
+  float yaw;  // heading (radian, clockwise from north)
+  float u, v; // surge and sway velocity (m/s)
+  float r;    // yaw rate (rad/s)
+};
+
+// actuator state (as f_aws1_sim's state vector)
+struct s_mpc_act
+{
+  float rud_pos, rud_slack;
+  float gear_pos, thro_pos, thro_slack;
+s_mpc_act():rud_pos(0.f), rud_slack(0.f),
+    gear_pos(0.f), thro_pos(0.f), thro_slack(0.f)
+  {
+  }
+};
+
+// moving obstacle, the position at the start of the rollouts and the velocity
+struct s_mpc_obst
+{
+  float x, y, vx, vy;
+  float rav; // range for avoidance (m)
+};
+
+// c_mpc is a sampling based model predictive controller. Every plan()
+// samples candidate sequences of (rudder, main engine) control values,
+// each is held for a segment, rolls them out through the boat models
+// (c_model_*, the same as f_aws1_sim), and chooses the sequence with the
+// least cost. The candidates are sampled around the previous best (shifted
+// by the segments elapsed), and some are uniformly random.
+//
+// The candidates are rolled out in blocks of MPC_LANES in SoA layout, the
+// kinematics and the cost terms are evaluated in the loops over the lanes.
+// The blocks are taken by the caller of plan() and the worker threads, and
+// the blocks not started before the deadline are left unevaluated.
+// The first block (including the previous best) is always evaluated.
+// Nothing is allocated after init().
+class c_mpc
+{
+ private:
+  // boat models (owned by the caller). [0]: displacement, [1]: planing,
+  // [2]: astern
+  c_model_rudder_ctrl * m_prctrl;
+  c_model_engine_ctrl * m_pectrl;
+  c_model_outboard_force * m_pobf[3];
+  c_model_3dof * m_p3dof[3];
+  double m_vplane;
+
+  s_mpc_par m_par;
+  int m_ncands, m_nsegs, m_nsteps_seg;
+
+  // control sequences, [segment][candidate]
+  float m_rud[MPC_MAX_SEGS][MPC_MAX_CANDS];
+  float m_eng[MPC_MAX_SEGS][MPC_MAX_CANDS];
+  float m_cost[MPC_MAX_CANDS];
+  float m_best_rud[MPC_MAX_SEGS], m_best_eng[MPC_MAX_SEGS];
+  float m_best_cost;
+  bool m_bbest;
+  long long m_tplan; // time the segment 0 of the best sequence started
+
+  // inputs of the cycle
+  s_mpc_state m_st;
+  s_mpc_act m_act;
+  float m_rud_cur, m_eng_cur; // control issued currently
+  float m_eng_min, m_eng_max;
+  bool m_bwp;
+  float m_xwp, m_ywp;
+  float m_sog_tgt;
+  s_mpc_obst m_obst[MPC_MAX_OBST];
+  int m_nobst;
+  float m_xcoast[MPC_MAX_COAST], m_ycoast[MPC_MAX_COAST];
+  int m_ncoast;
+
+  unsigned int m_rnd; // xorshift state
+  float rand_u() // uniform in [0,1)
+  {
+    m_rnd ^= m_rnd << 13;
+    m_rnd ^= m_rnd >> 17;
+    m_rnd ^= m_rnd << 5;
+    return (float)((m_rnd >> 8) * (1.0 / 16777216.0));
+  }
+
+  void sample(const int nshift);
+  void rollout(const int iblk);
+  void rollout_blocks();
+
+  // workers
+  thread * m_workers[MPC_MAX_WORKERS];
+  int m_nworkers;
+  mutex m_mtx;
+  condition_variable m_cnd_start, m_cnd_done;
+  long long m_gen;  // incremented every plan()
+  bool m_bopen;     // true while the workers can join the rollouts
+  bool m_bexit;
+  int m_nactive;    // workers in the rollouts
+  int m_nblk;
+  atomic<int> m_iblk, m_nblk_done;
+  long long m_tdeadline; // by get_mono_time_nsec()
+  long long m_tproc;     // time consumed in the last plan() (nsec)
+
+  static void sworker(c_mpc * ptr);
+  void worker();
+
+ public:
+  c_mpc();
+  ~c_mpc();
+
+  void set_models(c_model_rudder_ctrl * prctrl, c_model_engine_ctrl * pectrl,
+		  c_model_outboard_force * pobf, c_model_outboard_force * pobfp,
+		  c_model_outboard_force * pobfb,
+		  c_model_3dof * p3dof, c_model_3dof * p3dofp,
+		  c_model_3dof * p3dofb, const double vplane);
+
+  // starts the workers. The models should be set and initialized.
+  bool init(const s_mpc_par & par);
+  void destroy();
+
+  // propagates the actuator state with the control issued for dt seconds.
+  void update_actuator(const float rud, const float eng, const float dt);
+
+  // seed of the candidate sampling (for reproducible plans, with the
+  // deadline long enough to evaluate all the candidates)
+  void set_seed(const unsigned int seed)
+  {
+    m_rnd = (seed ? seed : 2463534242u);
+  }
+
+  void set_state(const s_mpc_state & st)
+  {
+    m_st = st;
+  }
+
+  void set_control(const float rud, const float eng,
+		   const float eng_min, const float eng_max)
+  {
+    m_rud_cur = rud;
+    m_eng_cur = eng;
+    m_eng_min = eng_min;
+    m_eng_max = eng_max;
+  }
+
+  void set_waypoint(const float x, const float y, const float sog_tgt)
+  {
+    m_bwp = true;
+    m_xwp = x;
+    m_ywp = y;
+    m_sog_tgt = sog_tgt;
+  }
+
+  void reset_waypoint(const float sog_tgt = 0.f)
+  {
+    m_bwp = false;
+    m_sog_tgt = sog_tgt;
+  }
+
+  void clear_obst()
+  {
+    m_nobst = 0;
+  }
+
+  bool add_obst(const float x, const float y, const float vx, const float vy,
+		const float rav)
+  {
+    if(m_nobst >= MPC_MAX_OBST)
+      return false;
+    s_mpc_obst & o = m_obst[m_nobst++];
+    o.x = x;
+    o.y = y;
+    o.vx = vx;
+    o.vy = vy;
+    o.rav = rav;
+    return true;
+  }
+
+  void clear_coast()
+  {
+    m_ncoast = 0;
+  }
+
+  bool add_coast(const float x, const float y)
+  {
+    if(m_ncoast >= MPC_MAX_COAST)
+      return false;
+    m_xcoast[m_ncoast] = x;
+    m_ycoast[m_ncoast] = y;
+    m_ncoast++;
+    return true;
+  }
+
+  // rolls out the candidates and gives the control of the best sequence
+  // for now. tcur is the current time (in 100ns).
+  bool plan(const long long tcur, float & rud, float & eng);
+
+  float get_best_cost()
+  {
+    return m_best_cost;
+  }
+
+  int get_num_evaluated()
+  {
+    return m_nblk_done.load() * MPC_LANES;
+  }
+
+  int get_num_cands()
+  {
+    return m_ncands;
+  }
+
+  long long get_proc_time()
+  {
+    return m_tproc;
+  }
+};
+
+#endif
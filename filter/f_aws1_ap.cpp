@@ -37,16 +37,12 @@ using namespace cv;
 f_aws1_ap::f_aws1_ap(const char * name) :
   f_base(name), 
   m_state(NULL), m_engstate(NULL), m_ctrl_inst(NULL), m_ctrl_stat(NULL), m_obst(NULL),
-  m_ap_inst(NULL), m_ais_obj(NULL), m_verb(false),
+  m_ap_inst(NULL), m_ais_obj(NULL), m_map(NULL), m_verb(false),
   m_wp(NULL), m_meng(127.), m_seng(127.), m_rud(127.), 
   m_smax(10), m_smin(3), m_rev_max(5500), m_rev_min(700),
   m_meng_max(200), m_meng_min(80), m_seng_max(200), m_seng_min(80),
   devyaw(3.0f), devcog(3.0f), devsog(1.0f), devrev(500.f),
-  m_pc(0.1f), m_ic(0.1f), m_dc(0.1f), m_ps(0.1f), m_is(0.1f), m_ds(0.1f),
-  m_cdiff(0.f), m_sdiff(0.f), m_revdiff(0.f),
-  m_dcdiff(0.f), m_icdiff(0.f),
-  m_dsdiff(0.f), m_isdiff(0.f),
-  m_drevdiff(0.f), m_irevdiff(0.f),
+  m_revdiff(0.f), m_drevdiff(0.f), m_irevdiff(0.f),
   m_prev(0.1f), m_irev(0.1f), m_drev(0.1f),
   rudmidlr(127.0f), rudmidrl(127.0f),
   alpha_tbl_stable_rpm(0.01f),
@@ -55,7 +51,9 @@ f_aws1_ap::f_aws1_ap(const char * name) :
   alpha_yaw_bias(0.1f),
   twindow_stability_check_sec(3),
   m_Lo(8), m_Wo(2), m_Lais(400), m_Wais(80), m_Rav(3), m_Tav(300), m_Cav_max(45),
-  yaw_bias(0.0f)
+  yaw_bias(0.0f),
+  m_bmpc(false), m_integ(EMI_EULER), vplane(10.0), m_tmpc_prev(-1),
+  m_bcoast_q(false)
 {
   register_fpar("ch_state", (ch_base**)&m_state, typeid(ch_state).name(), "State channel");
   register_fpar("ch_engstate", (ch_base**)&m_engstate, typeid(ch_eng_state).name(), "Engine State channel.");	
@@ -65,6 +63,7 @@ f_aws1_ap::f_aws1_ap(const char * name) :
   register_fpar("ch_obst", (ch_base**)&m_obst, typeid(ch_obst).name(), "Obstacle channel.");
   register_fpar("ch_ap_inst", (ch_base**)&m_ap_inst, typeid(ch_aws1_ap_inst).name(), "Autopilot instruction channel");
   register_fpar("ch_ais_obj", (ch_base**)&m_ais_obj, typeid(ch_ais_obj).name(), "AIS object channel.");
+  register_fpar("ch_map", (ch_base**)&m_map, typeid(ch_map).name(), "Map channel (coast lines for mpc).");
   register_fpar("verb", &m_verb, "Verbose for debug.");
   register_fpar("rud", &m_inst.rud_aws, "Rudder value");
   register_fpar("meng", &m_inst.meng_aws, "Main engine value");
@@ -79,13 +78,13 @@ f_aws1_ap::f_aws1_ap(const char * name) :
   register_fpar("rev_max", &m_rev_max, "Maximum rev value in RPM");
   register_fpar("rev_min", &m_rev_min, "Minimum rev value in RPM");
 
-  register_fpar("pc", &m_pc, "Coefficient P in the course control with PID.");
-  register_fpar("ic", &m_ic, "Coefficient I in the course control with PID.");
-  register_fpar("dc", &m_dc, "Coefficient D in the course control with PID.");
+  register_fpar("pc", &m_apc.pc, "Coefficient P in the course control with PID.");
+  register_fpar("ic", &m_apc.ic, "Coefficient I in the course control with PID.");
+  register_fpar("dc", &m_apc.dc, "Coefficient D in the course control with PID.");
 
-  register_fpar("ps", &m_ps, "Coefficient P in the speed control with PID.");
-  register_fpar("is", &m_is, "Coefficient I in the speed control with PID.");
-  register_fpar("ds", &m_ds, "Coefficient D in the speed control with PID.");
+  register_fpar("ps", &m_apc.ps, "Coefficient P in the speed control with PID.");
+  register_fpar("is", &m_apc.is, "Coefficient I in the speed control with PID.");
+  register_fpar("ds", &m_apc.ds, "Coefficient D in the speed control with PID.");
 
   register_fpar("prev", &m_prev, "Coefficient P in the rev control with PID.");
   register_fpar("irev", &m_irev, "Coefficient I in the rev control with PID.");
@@ -112,6 +111,41 @@ f_aws1_ap::f_aws1_ap(const char * name) :
 
   fctrl_state[0] = '\0';
   register_fpar("fctrl_state", fctrl_state, sizeof(fctrl_state), "Autopilot Control State");
+
+  register_fpar("mpc", &m_bmpc, "Model predictive control in the wp modes.");
+  register_fpar("mpc_ncands", &m_mpc_par.ncands, "Number of candidate control sequences.");
+  register_fpar("mpc_nsegs", &m_mpc_par.nsegs, "Number of segments in a control sequence.");
+  register_fpar("mpc_tseg", &m_mpc_par.tseg, "Duration of a segment in second.");
+  register_fpar("mpc_dt", &m_mpc_par.dt, "Time step of the rollouts in second.");
+  register_fpar("mpc_tmax", &m_mpc_par.tmax, "Deadline of the rollouts in msec.");
+  register_fpar("mpc_nth", &m_mpc_par.nworkers, "Number of worker threads for the rollouts.");
+  register_fpar("mpc_wwp", &m_mpc_par.wwp, "Weight of the distance to the waypoint.");
+  register_fpar("mpc_wsog", &m_mpc_par.wsog, "Weight of the speed error.");
+  register_fpar("mpc_wais", &m_mpc_par.wais, "Weight of the approach to AIS ships.");
+  register_fpar("mpc_wcoast", &m_mpc_par.wcoast, "Weight of the approach to coast lines.");
+  register_fpar("mpc_wctrl", &m_mpc_par.wctrl, "Weight of the control change.");
+  register_fpar("mpc_dcoast", &m_mpc_par.dcoast, "Clearance to the coast lines in meter.");
+  register_fpar("mpc_srud", &m_mpc_par.srud, "Range of the rudder perturbation.");
+  register_fpar("mpc_seng", &m_mpc_par.seng, "Range of the engine perturbation.");
+  register_fpar("mpc_rrand", &m_mpc_par.rrand, "Ratio of the uniformly random candidates.");
+  register_fpar("vplane", &vplane, "Planing Velocity in kts");
+  register_fpar("integ", (int*)&m_integ, (int)EMI_UNDEF, str_model_integ, "Integrator of the kinetic models.");
+  mrctrl.alloc_param();
+  register_model_params(mrctrl);
+  mectrl.alloc_param();
+  register_model_params(mectrl);
+  mobf.alloc_param(0);
+  register_model_params(mobf);
+  mobfp.alloc_param(1);
+  register_model_params(mobfp);
+  mobfb.alloc_param(2);
+  register_model_params(mobfb);
+  m3dof.alloc_param(0);
+  register_model_params(m3dof);
+  m3dofp.alloc_param(1);
+  register_model_params(m3dofp);
+  m3dofb.alloc_param(2);
+  register_model_params(m3dofb);
   
   // registering rpm tables
   for (int itbl = 0; itbl < 60; itbl++){
@@ -189,11 +223,34 @@ bool f_aws1_ap::init_run()
   if(fctrl_state[0] != '\0'){
     load_ctrl_state();
   }
+
+  if(m_bmpc){
+    mrctrl.init();
+    mectrl.init();
+    mobf.init();
+    mobfp.init();
+    mobfb.init();
+    m3dof.init();
+    m3dofp.init();
+    m3dofb.init();
+    m3dof.set_integrator(m_integ);
+    m3dofp.set_integrator(m_integ);
+    m3dofb.set_integrator(m_integ);
+    m_mpc.set_models(&mrctrl, &mectrl, &mobf, &mobfp, &mobfb,
+		     &m3dof, &m3dofp, &m3dofb, vplane);
+    if(!m_mpc.init(m_mpc_par))
+      return false;
+    m_tmpc_prev = -1;
+    m_bcoast_q = false;
+    m_coast_hits.reserve(MPC_MAX_COAST);
+  }
   return true;
 }
 
 void f_aws1_ap::destroy_run()
 {
+  m_mpc.destroy();
+
   if(fctrl_state[0] != '\0'){
     save_ctrl_state();
   }
@@ -409,9 +466,19 @@ bool f_aws1_ap::proc()
   m_engstate->get_rapid(teng, rpm, trim);
   m_state->get_attitude(tatt, roll, pitch, yaw);
   m_ctrl_stat->get(stat);
+  m_apc.verb = m_verb;
   
   calc_stat(tvel, cog, sog, tatt, yaw, teng, rpm, stat);
 
+  if(m_bmpc){
+    // actuator state of the rollouts follows the control applied
+    long long tcur = get_time();
+    if(m_tmpc_prev >= 0 && tcur > m_tmpc_prev)
+      m_mpc.update_actuator(stat.rud_aws, stat.meng_aws,
+			    (float)((double)(tcur - m_tmpc_prev) / (double)SEC));
+    m_tmpc_prev = tcur;
+  }
+
   if(stat.ctrl_src == ACS_AP1)
     {	
       if (!m_ap_inst){
@@ -444,7 +511,8 @@ bool f_aws1_ap::proc()
     m_rud = 127.;
     m_meng = 127.;
     m_seng = 127.;
-    m_icdiff = m_isdiff = m_irevdiff = 0.;
+    m_apc.reset();
+    m_irevdiff = 0.;
   }
   if(m_verb){
     cout << "(meng, seng, rud)=(" << m_meng
@@ -517,33 +585,8 @@ const float f_aws1_ap::calc_course_change_for_ais_ship(const float crs)
 
 void f_aws1_ap::ctrl_to_cog(const float cdiff)
 {
-  float rudmid = (is_rud_ltor ? rudmidlr : rudmidrl);
-  float _cdiff = cdiff;
-  // cdiff is normalized to [-180f,180f]
-  if(rev_prop < 0)
-    _cdiff = -_cdiff;
-  
-  if (abs(_cdiff) > 180.0f){
-    if(_cdiff < 0)
-      _cdiff += 360.f;
-    else
-      _cdiff -= 360.f;
-  }
-  _cdiff *= (float)(1.0f/180.0f);
-  m_dcdiff = (float)(_cdiff - m_cdiff);
-  if((_cdiff < 0 && m_rud > 0.f) || (_cdiff > 0 && m_rud < 255.f))
-    m_icdiff += _cdiff;
-  
-  m_cdiff = _cdiff;
-
-  m_rud = (float)((m_pc * m_cdiff + m_ic * m_icdiff + m_dc * m_dcdiff) * 255.);
-  
-  m_rud += rudmid;  
-  m_rud = max(m_rud, 0.f);
-  m_rud = min(m_rud, 255.f);
-  if (m_verb)
-    printf("ap rud=%3.1f c=%2.2f dc=%2.2f ic=%2.2f\n", m_rud, m_cdiff, m_dcdiff, m_icdiff);
-
+  m_apc.ctrl_to_cog(cdiff, (is_rud_ltor ? rudmidlr : rudmidrl),
+		    rev_prop < 0, m_rud);
 }
 
 
@@ -597,25 +640,8 @@ void f_aws1_ap::ctrl_to_rev(const float rev, const float rev_tgt,
 void f_aws1_ap::ctrl_to_sog(const float sog, const float sog_tgt,
 			    const float smax, const float smin)
 {
-  float rudmid = (is_rud_ltor ? rudmidlr : rudmidrl);
-  float srange = (float)(smax - smin);
-  
-  float stgt = (float)(srange * (1.0 - max(0.f, min(1.f, abs(m_rud - rudmid) * (1.0f / rudmid)))) + smin);
-  stgt = min(sog_tgt, stgt);
-  
-  float sdiff = (float)(stgt - sog);
-  sdiff *= (float)(1. / srange);
-  
-  m_dsdiff = (float)(sdiff - m_sdiff);
-  m_isdiff += sdiff;
-  m_sdiff = sdiff;
-  
-  m_meng = (float)((m_ps * m_sdiff + m_is * m_isdiff + m_ds * m_dsdiff) * 255. + 127.);
-  m_meng = (float)min(m_meng, m_meng_max);
-  m_meng = (float)max(m_meng, 127.f);  
-  if(m_verb){
-    printf("ap meng=%3.1f stgt=%2.1f sog=%2.1f s=%2.2f ds=%2.2f is=%2.2f \n", m_meng, stgt, sog, m_sdiff, m_dsdiff, m_isdiff);
-  }
+  m_apc.ctrl_to_sog(sog, sog_tgt, smax, smin, m_meng_max,
+		    (is_rud_ltor ? rudmidlr : rudmidrl), m_rud, m_meng);
 }
 
 void f_aws1_ap::ctrl_to_sog_cog(const float sog, const float sog_tgt,
@@ -628,6 +654,11 @@ void f_aws1_ap::ctrl_to_sog_cog(const float sog, const float sog_tgt,
 
 void f_aws1_ap::wp(const float sog, const float cog, const float yaw, bool bav)
 {
+  if(m_bmpc){
+    wp_mpc(sog, cog, yaw, bav);
+    return;
+  }
+
   float cc = 0;
   float sog_tgt = 0.0;
   m_ap_inst->get_tgt_sog(sog_tgt);
@@ -640,7 +671,7 @@ void f_aws1_ap::wp(const float sog, const float cog, const float yaw, bool bav)
     m_rud = 127.;
     m_meng = 127.;
     m_seng = 127.;
-    m_icdiff = m_isdiff = 0.;
+    m_apc.reset();
   }
   else{
     s_wp & wp = m_wp->get_next_wp();
@@ -658,6 +689,107 @@ void f_aws1_ap::wp(const float sog, const float cog, const float yaw, bool bav)
   m_wp->unlock();
 }
 
+void f_aws1_ap::update_coast(const Mat & Rorg, const float xorg,
+			     const float yorg, const float zorg)
+{
+  m_mpc.clear_coast();
+  if(!m_map || !m_map->get_db())
+    return;
+
+  AWSMap2::vec3 pt(xorg, yorg, zorg);
+  double dx = pt.x - m_coast_qpt.x, dy = pt.y - m_coast_qpt.y,
+    dz = pt.z - m_coast_qpt.z;
+  double dq = 0.5 * m_mpc_par.dcoast;
+  if(!m_bcoast_q || dx * dx + dy * dy + dz * dz > dq * dq){
+    float reach = (float)(m_smax * (1852. / 3600.)
+			  * m_mpc_par.nsegs * m_mpc_par.tseg
+			  + m_mpc_par.dcoast);
+    m_map->get_db()->nearestCoastLine(pt, reach, MPC_MAX_COAST, m_coast_hits);
+    m_coast_qpt = pt;
+    m_bcoast_q = true;
+  }
+
+  for (int ihit = 0; ihit < (int)m_coast_hits.size(); ihit++){
+    const AWSMap2::vec3 & p = m_coast_hits[ihit].pt;
+    double x, y, z;
+    eceftowrld(Rorg, (double)xorg, (double)yorg, (double)zorg,
+	       p.x, p.y, p.z, x, y, z);
+    m_mpc.add_coast((float)x, (float)y);
+  }
+}
+
+void f_aws1_ap::wp_mpc(const float sog, const float cog, const float yaw, bool bav)
+{
+  float sog_tgt = 0.0;
+  m_ap_inst->get_tgt_sog(sog_tgt);
+
+  long long t;
+  Mat Rorg;
+  float xorg, yorg, zorg;
+  Rorg = m_state->get_enu_rotation(t);
+  m_state->get_position_ecef(t, xorg, yorg, zorg);
+
+  m_wp->lock();
+  if (m_wp->is_finished()){
+    m_wp->unlock();
+    m_rud = 127.;
+    m_meng = 127.;
+    m_seng = 127.;
+    return;
+  }
+
+  s_wp & wp = m_wp->get_next_wp();
+  if(wp.v > 0)
+    sog_tgt = min(sog_tgt, wp.v);
+  float xwp, ywp, zwp;
+  eceftowrld(Rorg, xorg, yorg, zorg, wp.x, wp.y, wp.z, xwp, ywp, zwp);
+  m_wp->unlock();
+
+  const float kts2ms = (float)(1852. / 3600.);
+  float phi = (float)((cog - yaw) * (PI / 180.));
+  s_mpc_state st;
+  st.yaw = (float)(yaw * (PI / 180.));
+  st.u = (float)(sog * kts2ms * cos(phi));
+  st.v = (float)(sog * kts2ms * sin(phi));
+  st.r = (float)(dyaw * (PI / 180.));
+  m_mpc.set_state(st);
+  m_mpc.set_control(m_rud, m_meng, m_meng_min, m_meng_max);
+  m_mpc.set_waypoint(xwp, ywp, sog_tgt * kts2ms);
+
+  // AIS ships relative to the own ship's current position (get_prediction
+  // extrapolates with the velocity relative to the own ship), moving at
+  // their own velocity while c_mpc moves the own ship.
+  long long tcur = get_time();
+  m_mpc.clear_obst();
+  if (bav && m_ais_obj){
+    float rav = (float)(0.5 * (m_Lais + m_Lo) * m_Rav);
+    m_ais_obj->lock();
+    for (m_ais_obj->begin(); !m_ais_obj->is_end(); m_ais_obj->next()){
+      float x, y, z, vx, vy, vz, yw, s;
+      if (!m_ais_obj->get_cur_state(x, y, z, vx, vy, vz, yw) ||
+	  !m_ais_obj->get_prediction(tcur, x, y, s))
+	continue;
+      if (!m_mpc.add_obst(x, y, vx, vy, rav))
+	break;
+    }
+    m_ais_obj->unlock();
+  }
+
+  update_coast(Rorg, xorg, yorg, zorg);
+
+  float rud, meng;
+  if (m_mpc.plan(tcur, rud, meng)){
+    m_rud = rud;
+    m_meng = meng;
+  }
+  m_seng = 127.; // the sub engine is not used in the plan
+
+  if (m_verb)
+    printf("ap mpc rud=%3.1f meng=%3.1f cost=%g %d/%d cands %lld usec\n",
+	   m_rud, m_meng, m_mpc.get_best_cost(), m_mpc.get_num_evaluated(),
+	   m_mpc.get_num_cands(), m_mpc.get_proc_time() / 1000);
+}
+
 void f_aws1_ap::cursor(const float sog, const float cog, const float yaw, bool bav)
 {
   float xr, yr, d, dir;
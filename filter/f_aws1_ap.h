@@ -20,6 +20,11 @@
 #include "../channel/ch_state.h"
 #include "../channel/ch_obj.h"
 #include "../channel/ch_wp.h"
+#include "../channel/ch_map.h"
+
+#include "c_model.hpp"
+#include "c_mpc.h"
+#include "c_ap_ctrl.h"
 
 // automatically controls along with the waypoints
 // connects to ch_wp
@@ -34,6 +39,7 @@ protected:
   ch_wp * m_wp;
   ch_obst * m_obst;
   ch_ais_obj * m_ais_obj;
+  ch_map * m_map;
   
   s_aws1_ctrl_inst m_inst;
   float m_Lo, m_Wo; // assumed size for my own ship
@@ -92,12 +98,9 @@ protected:
   float alpha_rud_mid;
   
   // for wp mode
-  float m_cdiff, m_sdiff, m_revdiff; 
-  float m_dcdiff, m_dsdiff, m_drevdiff; 
-  float m_icdiff, m_isdiff, m_irevdiff;
+  c_ap_ctrl m_apc; // PID for course and speed control
+  float m_revdiff, m_drevdiff, m_irevdiff;
   float m_prev, m_irev, m_drev; // PID for rev control
-  float m_pc, m_ic, m_dc; // PID for course control
-  float m_ps, m_is, m_ds; // PID for speed control
   
   float m_meng, m_seng, m_rud;
   float rev_prop, u, v, angle_drift, yaw_bias;
@@ -111,6 +114,36 @@ protected:
   float m_meng_max, m_meng_min;
   float m_seng_max, m_seng_min;
   
+  // model predictive control in the wp modes (enabled with "mpc")
+  // the boat models are the same as f_aws1_sim's.
+  bool m_bmpc;
+  c_model_rudder_ctrl mrctrl;
+  c_model_engine_ctrl mectrl;
+  c_model_outboard_force mobf, mobfp, mobfb;
+  c_model_3dof m3dof, m3dofp, m3dofb;
+  e_model_integ m_integ;
+  double vplane;
+  s_mpc_par m_mpc_par;
+  c_mpc m_mpc;
+  long long m_tmpc_prev;  // time the actuator state of m_mpc updated
+
+  // coast line points near the own ship (ECEF), queried again when the
+  // own ship moves more than half the clearance from the query point.
+  vector<AWSMap2::CoastLineHit> m_coast_hits;
+  AWSMap2::vec3 m_coast_qpt;
+  bool m_bcoast_q;
+  void update_coast(const Mat & Rorg, const float xorg, const float yorg,
+		    const float zorg);
+  void wp_mpc(const float sog, const float cog, const float yaw, bool bav);
+  void register_model_params(c_model_base & mdl)
+  {
+    int n = mdl.get_num_params();
+    for (int ipar = 0; ipar < n; ipar++){
+      register_fpar(mdl.get_str_param(ipar), mdl.get_param(ipar),
+		    mdl.get_str_param_exp(ipar));
+    }
+  }
+
   const float calc_course_change_for_ais_ship(const float yaw);
   void ctrl_to_sog_cog(const float sog, const float sog_tgt,
 		       const float cdiff, const float smax, const float smin);
@@ -47,7 +47,9 @@ f_aws1_nmea_sw::f_aws1_nmea_sw(const char * name): f_base(name),
 	m_ais_nmea_o(NULL), m_gps_nmea_o(NULL),
 	m_aws_ctrl(false), m_verb(false),
 	m_aws_oint(1), m_ap_oint(1), m_gff_oint(1), m_ais_oint(1), m_gps_oint(1),
-	m_aws_ocnt(0), m_ap_ocnt(0), m_gff_ocnt(0), m_ais_ocnt(0), m_gps_ocnt(0)
+	m_aws_ocnt(0), m_ap_ocnt(0), m_gff_ocnt(0), m_ais_ocnt(0), m_gps_ocnt(0),
+	m_gff_rec_i(NULL), m_ais_rec_i(NULL), m_gps_rec_i(NULL), m_brec(false),
+	m_ais_tfrag(AIS_FRAG_TIMEOUT_DEFAULT)
 {
 	register_fpar("state", (ch_base**)&m_state, typeid(ch_state).name(), "State output channel.");
 	register_fpar("ais_obj", (ch_base**)&m_ais_obj, typeid(ch_ais_obj).name(), "AIS object channel.");
@@ -61,6 +63,9 @@ f_aws1_nmea_sw::f_aws1_nmea_sw(const char * name): f_base(name),
 	register_fpar("ais_nmea_o", (ch_base**)&m_ais_nmea_o, typeid(ch_nmea).name(), "Output Channel of ais_nmea.");
 	register_fpar("gps_nmea_i", (ch_base**)&m_gps_nmea_i, typeid(ch_nmea).name(), "Input Channel of gps_nmea.");
 	register_fpar("gps_nmea_o", (ch_base**)&m_gps_nmea_o, typeid(ch_nmea).name(), "Output Channel of gps_nmea.");
+	register_fpar("gff_rec_i", (ch_base**)&m_gff_rec_i, typeid(ch_nmea_rec).name(), "Decoded input channel of gff_nmea (used instead of gff_nmea_i).");
+	register_fpar("ais_rec_i", (ch_base**)&m_ais_rec_i, typeid(ch_nmea_rec).name(), "Decoded input channel of ais_nmea (used instead of ais_nmea_i).");
+	register_fpar("gps_rec_i", (ch_base**)&m_gps_rec_i, typeid(ch_nmea_rec).name(), "Decoded input channel of gps_nmea (used instead of gps_nmea_i).");
 
 	register_fpar("aws_ctrl", &m_aws_ctrl, "If yes, APB message is switched from fish finder to aws (default false)");
 	register_fpar("awsint", &m_aws_oint, "Output interval of aws output channel (default 1)");
@@ -69,6 +74,7 @@ f_aws1_nmea_sw::f_aws1_nmea_sw(const char * name): f_base(name),
 	register_fpar("aisint", &m_ais_oint, "Output interval of AIS output channel (default 1)");
 	register_fpar("gpsint", &m_gps_oint, "Output interval of GPS output channel (default 1)");
 	register_fpar("verb", &m_verb, "For debug.");
+	register_fpar("ais_tfrag", &m_ais_tfrag, "Timeout of the fragments of AIS messages in second.");
 }
 
 f_aws1_nmea_sw::~f_aws1_nmea_sw()
@@ -77,6 +83,7 @@ f_aws1_nmea_sw::~f_aws1_nmea_sw()
 
 bool f_aws1_nmea_sw::init_run()
 {
+  m_nmea_dec.set_ais_timeout(m_ais_tfrag);
   return true;
 }
 
@@ -84,6 +91,29 @@ void f_aws1_nmea_sw::destroy_run()
 {
 }
 
+bool f_aws1_nmea_sw::pop_nmea(ch_nmea * pnmea, ch_nmea_rec * prec)
+{
+	if(prec){
+		if(!prec->pop(m_rec))
+			return false;
+		memcpy(m_nmea, m_rec.raw, sizeof(m_nmea));
+		m_brec = true;
+		return true;
+	}
+
+	m_brec = false;
+	return pnmea->pop(m_nmea);
+}
+
+const s_nmea_rec & f_aws1_nmea_sw::get_rec()
+{
+	if(!m_brec){
+		m_nmea_dec.decode(m_nmea, m_rec, get_time());
+		m_brec = true;
+	}
+	return m_rec;
+}
+
 void f_aws1_nmea_sw::aws_to_out()
 {
 	while(m_aws_nmea_i->pop(m_nmea)){
@@ -134,13 +164,13 @@ void f_aws1_nmea_sw::ap_to_out()
 
 void f_aws1_nmea_sw::gff_to_out()
 {
-	while(m_gff_nmea_i->pop(m_nmea)){
-		e_nd_type type = get_nd_type(m_nmea);
+	while(pop_nmea(m_gff_nmea_i, m_gff_rec_i)){
+		e_nd_type type = get_type();
 
 		if(m_state && type == ENDT_DBT){
-			const c_dbt * pdbt = dynamic_cast<const c_dbt*>(m_nmea_dec.decode(m_nmea));
-			if(pdbt){
-				m_state->set_depth(get_time(), pdbt->dm);
+			const s_nmea_rec & rec = get_rec();
+			if(rec.dtype == ENDT_DBT){
+				m_state->set_depth(get_time(), rec.dbt.dm);
 			}
 		}
 
@@ -174,8 +204,8 @@ void f_aws1_nmea_sw::gff_to_out()
 
 void f_aws1_nmea_sw::ais_to_out()
 {
-  while(m_ais_nmea_i->pop(m_nmea)){
-    e_nd_type type = get_nd_type(m_nmea);
+  while(pop_nmea(m_ais_nmea_i, m_ais_rec_i)){
+    e_nd_type type = get_type();
     
     if(m_verb)
       cout << "AIS > " << m_nmea << endl;
@@ -194,30 +224,16 @@ void f_aws1_nmea_sw::ais_to_out()
     }	
     
     if(m_ais_obj){
-      const c_nmea_dat * pnd = m_nmea_dec.decode(m_nmea);
-      if(pnd){
-	//pnd->show(cout);
-	switch(pnd->get_type()){			  
+      const s_nmea_rec & rec = get_rec();
+      if(rec.dtype != ENDT_UNDEF){
+	switch(rec.dtype){			  
 	case ENDT_VDM1:
-	  {
-	    const c_vdm_msg1 * pvdm1 = dynamic_cast<const c_vdm_msg1*>(pnd);
-	    m_ais_obj->push(get_time(), pvdm1->m_mmsi, pvdm1->m_lat, pvdm1->m_lon,
-			    pvdm1->m_course, pvdm1->m_speed, pvdm1->m_heading);
-	  }
-	  break;
 	case ENDT_VDM18:
-	  {
-	    const c_vdm_msg18 * pvdm18 = dynamic_cast<const c_vdm_msg18*>(pnd);
-	    m_ais_obj->push(get_time(), pvdm18->m_mmsi, pvdm18->m_lat, pvdm18->m_lon, 
-			    pvdm18->m_course, pvdm18->m_speed, pvdm18->m_heading);
-	  }
-	  break;
 	case ENDT_VDM19:
-	  {
-	    const c_vdm_msg19 * pvdm19 = dynamic_cast<const c_vdm_msg19*>(pnd);
-	    m_ais_obj->push(get_time(), pvdm19->m_mmsi, pvdm19->m_lat, pvdm19->m_lon, 
-			    pvdm19->m_course, pvdm19->m_speed, pvdm19->m_heading);
-	  }
+	  m_ais_obj->push(get_time(), rec.vdm.mmsi, rec.vdm.lat, rec.vdm.lon,
+			  rec.vdm.course, rec.vdm.speed, rec.vdm.heading);
+	  break;
+	default:
 	  break;
 	}
 	
@@ -230,41 +246,39 @@ void f_aws1_nmea_sw::ais_to_out()
 
 void f_aws1_nmea_sw::gps_to_out()
 {
-  while(m_gps_nmea_i->pop(m_nmea)){
-    e_nd_type type = get_nd_type(m_nmea);
+  while(pop_nmea(m_gps_nmea_i, m_gps_rec_i)){
+    e_nd_type type = get_type();
     
     if(m_state){
       switch(type){
       case ENDT_GGA: // lat, lon, alt
 	{
-	  const c_gga * pgga = dynamic_cast<const c_gga*>(m_nmea_dec.decode(m_nmea));
-	  if(pgga){
-	    m_state->set_position(get_time(), 
-				  (float) (pgga->m_lat_dir == EGP_N ? pgga->m_lat_deg : -pgga->m_lat_deg),
-				  (float) (pgga->m_lon_dir == EGP_E ? pgga->m_lon_deg : -pgga->m_lon_deg),
-				  pgga->m_alt, pgga->m_geos);
+	  const s_nmea_rec & rec = get_rec();
+	  if(rec.dtype == ENDT_GGA){
+	    m_state->set_position(get_time(), (float) rec.gga.lat, (float) rec.gga.lon,
+				  rec.gga.alt, rec.gga.geos);
 	  }
 	}
 	break;
       case ENDT_VTG: // cog, sog
 	{
-	  const c_vtg * pvtg = dynamic_cast<const c_vtg*>(m_nmea_dec.decode(m_nmea));
-	  if(pvtg){
-	    m_state->set_velocity(get_time(), pvtg->crs_t, pvtg->v_n);
+	  const s_nmea_rec & rec = get_rec();
+	  if(rec.dtype == ENDT_VTG){
+	    m_state->set_velocity(get_time(), rec.vtg.crs_t, rec.vtg.v_n);
 	  }
 	}
       case ENDT_RMC: // time
 	{
-	  const c_rmc * prmc = dynamic_cast<const c_rmc*>(m_nmea_dec.decode(m_nmea));	  
-	  if(prmc){
+	  const s_nmea_rec & rec = get_rec();
+	  if(rec.dtype == ENDT_RMC){
 	    tmex tm;
-	    tm.tm_year = prmc->m_yr + (m_tm.tm_year / 100) * 100;
-	    tm.tm_mon = prmc->m_mn - 1;
-	    tm.tm_mday = prmc->m_dy;
-	    tm.tm_hour = prmc->m_h;
-	    tm.tm_min = prmc->m_m;
-	    tm.tm_sec = (int) prmc->m_s;
-	    tm.tm_msec = (int)((prmc->m_s - tm.tm_sec) * 100);
+	    tm.tm_year = rec.rmc.yr + (m_tm.tm_year / 100) * 100;
+	    tm.tm_mon = rec.rmc.mn - 1;
+	    tm.tm_mday = rec.rmc.dy;
+	    tm.tm_hour = rec.rmc.h;
+	    tm.tm_min = rec.rmc.m;
+	    tm.tm_sec = (int) rec.rmc.s;
+	    tm.tm_msec = (int)((rec.rmc.s - tm.tm_sec) * 100);
 	    tm.tm_isdst = -1;
 	    f_base::set_time(tm);	  
 	  }
@@ -272,19 +286,19 @@ void f_aws1_nmea_sw::gps_to_out()
 	break;
       case ENDT_ZDA: // time 
 	{
-	  const c_zda * pzda = dynamic_cast<const c_zda*>(m_nmea_dec.decode(m_nmea));
-	  if(pzda){
+	  const s_nmea_rec & rec = get_rec();
+	  if(rec.dtype == ENDT_ZDA){
 	    tmex tm;
-	    tm.tm_year = pzda->m_yr + (m_tm.tm_year / 100) * 100;
-	    tm.tm_mon = pzda->m_mn - 1;
-	    tm.tm_mday = pzda->m_dy;
-	    tm.tm_hour = pzda->m_h;
-	    tm.tm_min = pzda->m_m;
-	    tm.tm_sec = (int) pzda->m_s;
-	    tm.tm_msec = (int)((pzda->m_s - tm.tm_sec) * 100);
+	    tm.tm_year = rec.zda.yr + (m_tm.tm_year / 100) * 100;
+	    tm.tm_mon = rec.zda.mn - 1;
+	    tm.tm_mday = rec.zda.dy;
+	    tm.tm_hour = rec.zda.h;
+	    tm.tm_min = rec.zda.m;
+	    tm.tm_sec = (int) rec.zda.s;
+	    tm.tm_msec = (int)((rec.zda.s - tm.tm_sec) * 100);
 	    tm.tm_isdst = -1;
 	    f_base::set_time(tm);	  
-	    f_base::set_tz(pzda->m_lzh * 60 + pzda->m_lzm);
+	    f_base::set_tz(rec.zda.lzh * 60 + rec.zda.lzm);
 	  }
 	}
 	break;
@@ -341,13 +355,13 @@ bool f_aws1_nmea_sw::proc()
   if(m_ap_nmea_i)
 	ap_to_out();
 
-  if(m_gff_nmea_i)
+  if(m_gff_nmea_i || m_gff_rec_i)
 	gff_to_out();
 
-  if(m_ais_nmea_i)
+  if(m_ais_nmea_i || m_ais_rec_i)
 	ais_to_out();
 
-  if(m_gps_nmea_i)
+  if(m_gps_nmea_i || m_gps_rec_i)
 	gps_to_out();
 
   if(m_aws_ocnt > 0)
@@ -38,6 +38,7 @@ class f_aws1_nmea_sw: public f_base
 {
 protected:
 	c_nmea_dec m_nmea_dec;
+	float m_ais_tfrag; // timeout of the AIS fragments in second
 	ch_state * m_state;
 	ch_ais_obj * m_ais_obj;
 
@@ -62,6 +63,23 @@ protected:
 
 	char m_nmea[84];
 
+	// gff, ais and gps inputs can also be given as the record channels 
+	// decoded by f_nmea. Then the sentences are not decoded here.
+	ch_nmea_rec * m_gff_rec_i;
+	ch_nmea_rec * m_ais_rec_i;
+	ch_nmea_rec * m_gps_rec_i;
+	s_nmea_rec m_rec;
+	bool m_brec; // m_rec is the decoded m_nmea
+
+	// pops a sentence into m_nmea from prec if given, otherwise from pnmea.
+	bool pop_nmea(ch_nmea * pnmea, ch_nmea_rec * prec);
+	e_nd_type get_type()
+	{
+		return m_brec ? m_rec.type : get_nd_type(m_nmea);
+	}
+	// decoded m_nmea. decoded at the first call if popped from ch_nmea.
+	const s_nmea_rec & get_rec();
+
 	void aws_to_out();
 	void ap_to_out();
 	void gff_to_out();
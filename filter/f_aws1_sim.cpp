@@ -41,7 +41,7 @@ using namespace cv;
 /////////////////////////////////////////////////////////////////////////// f_aws1_sim members
 
 f_aws1_sim::f_aws1_sim(const char * name) :
-  f_base(name), vplane(10.0),
+  f_base(name),
   m_state(NULL), m_ch_ctrl_ui(NULL), m_ch_ctrl_ap1(NULL), m_ch_ctrl_ap2(NULL),
   m_ch_ctrl_stat(NULL),
   m_state_sim(NULL), m_engstate_sim(NULL), m_ch_ctrl_stat_sim(NULL),
@@ -145,24 +145,18 @@ f_aws1_sim::f_aws1_sim(const char * name) :
   
   m_fcsv_out[0] = '\0';
   register_fpar("fcsv", m_fcsv_out, 1024, "CSV output file.");
-  register_fpar("vplane", &vplane, "Planing Velocity in kts");
+  register_fpar("vplane", &m_model.vplane, "Planing Velocity in kts");
+  register_fpar("integ", (int*)&m_model.integ, (int)EMI_UNDEF, str_model_integ, "Integrator of the kinetic models.");
   register_fpar("update_model_params", &bupdate_model_params, "Update model params.");
-  mrctrl.alloc_param();
-  register_model_params(mrctrl);
-  mectrl.alloc_param();
-  register_model_params(mectrl);
-  mobf.alloc_param(0);
-  register_model_params(mobf);
-  mobfp.alloc_param(1);
-  register_model_params(mobfp);
-  mobfb.alloc_param(2);
-  register_model_params(mobfb);
-  m3dof.alloc_param(0);
-  register_model_params(m3dof);
-  m3dofp.alloc_param(1);
-  register_model_params(m3dofp);
-  m3dofb.alloc_param(2);
-  register_model_params(m3dofb);
+  m_model.alloc_param();
+  register_model_params(m_model.mrctrl);
+  register_model_params(m_model.mectrl);
+  register_model_params(m_model.mobf);
+  register_model_params(m_model.mobfp);
+  register_model_params(m_model.mobfb);
+  register_model_params(m_model.m3dof);
+  register_model_params(m_model.m3dofp);
+  register_model_params(m_model.m3dofb);
 }
 
 bool f_aws1_sim::init_run()
@@ -180,12 +174,7 @@ bool f_aws1_sim::init_run()
     }
     
     // first row of the csv file
-    m_fcsv <<
-      "t,lat_o,lon_o,xe_o,ye_o,ze_o,roll_o,pitch_o,yaw_o,sog_o,cog_o,eng_o,rud_o,rev_o,fuel_o,"
-	   << "thro,gear,rud,"
-	   <<"lat_i,lon_i,xe_i,ye_i,ze_i,roll_i,pitch_i,yaw_i,sog_i,cog_i,eng_i,rud_i,rev_i,fuel_i," 
-	   << endl;
-    m_fcsv.precision(3);
+    c_model_aws1::write_csv_header(m_fcsv);
   }
 
   update_model_params();
@@ -194,12 +183,7 @@ bool f_aws1_sim::init_run()
 
 void f_aws1_sim::update_model_params()
 {
-  mrctrl.init();
-  mectrl.init();
-  mobf.init();
-  mobfp.init();
-  m3dof.init();
-  m3dofp.init();
+  m_model.init();
   bupdate_model_params = false;
 }
 
@@ -460,67 +444,7 @@ void f_aws1_sim::update_output_sample(const long long & tcur)
       (iosv == 0 ? m_input_vectors[m_iv_head] : m_output_vectors[iosv-1]);
     s_state_vector & stcur = m_output_vectors[iosv];
     
-    // simulate actuator and pump  
-    double v[3];
-    double f[3];
-    double phi = (stprev.cog - stprev.yaw);
-    double th = stprev.cog;
-    
-    double sog_ms = stprev.sog * (1852. / 3600.);
-    double dx = sog_ms * dt * sin(th),
-      dy = sog_ms * dt * cos(th); //next position in enu coordinate
-    double alt = 0.;
-    
-    wrldtoecef(stprev.Rwrld, stprev.xe, stprev.ye, stprev.ze, dx, dy, 0.,
-	       stcur.xe, stcur.ye, stcur.ze);
-    eceftobih(stcur.xe, stcur.ye, stcur.ze, stcur.lat, stcur.lon, alt);
-    
-    v[0] = sog_ms * cos(phi);
-    v[1] = sog_ms * sin(phi);
-    v[2] = stprev.ryaw;
-    
-    mrctrl.update(stprev.rud, stprev.rud_pos, stprev.rud_slack, dt,
-		  stcur.rud_pos, stcur.rud_slack);
-    mectrl.update(stprev.eng, stprev.gear_pos, stprev.thro_pos,
-		  stprev.thro_slack, dt,
-		  stcur.gear_pos, stcur.thro_pos, stcur.thro_slack);
-    if(v[0] < 0){
-      // astern model
-      mobfb.update((stprev.rud_pos - stprev.rud_slack),
-		  stprev.gear_pos, stprev.thro_pos - stprev.thro_slack,
-		  stprev.rev, v, f);
-      m3dofb.update(v, f, dt, v);
-    }else if(v[0] < vplane){
-      // displacement model
-      mobf.update((stprev.rud_pos - stprev.rud_slack),
-		  stprev.gear_pos, stprev.thro_pos - stprev.thro_slack,
-		  stprev.rev, v, f);
-      m3dof.update(v, f, dt, v);
-    }
-    else{
-      // planing model
-      mobfp.update((stprev.rud_pos - stprev.rud_slack),
-		   stprev.gear_pos, stprev.thro_pos - stprev.thro_slack,
-		   stprev.rev, v, f);
-      m3dofp.update(v, f, dt, v);
-    }
-  
-    phi = atan2(v[1], v[0]);
-    stcur.yaw += v[2] * dt;
-    if(stcur.yaw > PI)
-      stcur.yaw -= 2 * PI;
-    else if(stcur.yaw < -PI)
-      stcur.yaw += 2 * PI;      
-    
-    stcur.ryaw = v[2];
-    stcur.cog = stcur.yaw + phi;
-    if(stcur.cog < 0)
-      stcur.cog += 2 * PI;
-    else if(stcur.cog > 2 *PI)
-      stcur.cog -= 2 * PI;
-    
-    stcur.sog = sqrt(v[0] * v[0] + v[1] * v[1]) * (3600. / 1852.);
-    stcur.rev = final_rev(stcur.thro_pos - stcur.thro_slack);
+    m_model.update(stprev, stcur, dt);
   }
 }
 
@@ -528,53 +452,7 @@ void f_aws1_sim::save_csv(const long long tcur)
 {
   s_state_vector & svo = m_output_vectors[0];
   s_state_vector & svi = m_input_vectors[m_iv_head];
-  m_fcsv << tcur << ",";
-  
-  m_fcsv.precision(8);
-  m_fcsv <<
-    svo.lat * (180.f/PI) << "," <<
-    svo.lon * (180.f/PI) << "," <<
-    svo.xe << "," <<
-    svo.ye << "," <<
-    svo.ze << ",";
-  
-  m_fcsv.precision(3);
-  m_fcsv <<
-    svo.roll * (180.f/PI)<< "," <<
-    svo.pitch * (180.f/PI)<< "," <<
-    svo.yaw  * (180.f/PI)<< "," <<
-    svo.sog << "," <<
-    svo.cog  * (180.f/PI)<< "," <<
-    svo.eng << "," <<
-    svo.rud << "," <<
-    svo.rev << "," <<
-    svo.fuel << ",";
-  m_fcsv <<
-    svo.thro_pos << "," <<
-    svo.gear_pos << "," <<
-    svo.rud_pos << ",";
-  
-  m_fcsv.precision(8);
-  m_fcsv <<
-    svi.lat * (180.f/PI) << "," <<
-    svi.lon * (180.f/PI) << "," <<
-    svi.xe << "," <<
-    svi.ye << "," <<
-    svi.ze << ",";
-  
-  m_fcsv.precision(3);
-  m_fcsv <<
-    svi.roll * (180.f/PI) << "," <<
-    svi.pitch * (180.f/PI) << "," <<
-    svi.yaw * (180.f/PI) << "," <<
-    svi.sog << "," <<
-    svi.cog * (180.f/PI) << "," <<
-    svi.eng << "," <<
-    svi.rud << "," <<
-    svi.rev << "," <<
-    svi.fuel << ",";
-
-  m_fcsv << endl;
+  c_model_aws1::write_csv(m_fcsv, tcur, svo, svi);
 }
 
 bool f_aws1_sim::proc()
@@ -25,18 +25,14 @@
 
 #define RUD_PER_CYCLE 0.45f
 
-#include "c_model.hpp"
+#include "c_model_aws1.h"
 
 //////////////////////////////////////////////////////// f_aws1_sim
 class f_aws1_sim : public f_base
 {
 protected:
   // simulation models
-  c_model_rudder_ctrl mrctrl; // rudder control model
-  c_model_engine_ctrl mectrl; // engine control model
-  c_model_outboard_force mobf, mobfp, mobfb; // engine force model, later is for the planing mode and astern mode
-  c_model_3dof m3dof, m3dofp, m3dofb;         // kinetic model, later is for the planing mode and astern mode
-  double vplane; // planing velocity
+  c_model_aws1 m_model;
   
   // input channels
   ch_state * m_state;
@@ -51,54 +47,7 @@ protected:
   ch_eng_state * m_engstate_sim;
   ch_aws1_ctrl_stat * m_ch_ctrl_stat_sim;
   
-  struct s_state_vector
-  {
-    long long t;
-    double lat, lon, xe, ye, ze, roll, pitch, yaw, cog, sog, ryaw;		
-    Mat Rwrld;
-    float eng, rud, rev, fuel; 
-    float thro_pos, thro_slack, gear_pos, rud_pos, rud_slack;
-    
-  s_state_vector(const long long & _t,
-		 const double & _lat, const double & _lon,
-		 const double & _roll, const double & _pitch,
-		 const double & _yaw,
-		 const double & _cog, const double & _sog,
-		 const float & _eng, const float & _rud,
-		 const float & _rev, const float & _fuel) :
-    t(_t), lat(_lat), lon(_lon),
-      roll(_roll), pitch(_pitch), yaw(_yaw), cog(_cog), sog(_sog),
-      eng(_eng), rud(_rud), rev(_rev), fuel(_fuel), ryaw(0)
-    {
-      update_coordinates();
-    }
-    
-  s_state_vector() :lat(135.f), lon(35.f),
-      roll(0.f), pitch(0.f), yaw(0.f), cog(0.f), sog(0.f),
-      eng(127.0f), rud(127.0f), rev(700.f), fuel(0.1f),
-      thro_pos(0.f), thro_slack(0.f), gear_pos(0.f),
-      rud_pos(0.f), rud_slack(0.f)
-    {
-      update_coordinates();
-    }
-    
-    void update_coordinates() {
-      bihtoecef(lat, lon, 0, xe, ye, ze);
-      getwrldrot(lat, lon, Rwrld);			
-    }
-
-    void print()
-    {
-      cout << " rud:" << rud << " rud_pos:" << rud_pos
-	   << " rud_slack:" << rud_slack;
-      cout << " eng: " << eng << " gear_pos:" << gear_pos
-	   << " thro_pos: " << thro_pos << " thro_slack:" << thro_slack;
-      cout << " rev:" << rev;
-      cout << " yaw:" << yaw;
-      cout << " cog:" << cog;
-      cout << " sog:" << sog;
-    }
-  };
+  typedef s_aws1_sim_state s_state_vector;
 
   float m_int_smpl_sec;
   unsigned int m_int_smpl; // sampling interval (m_int_smpl_sec * 10e7)
@@ -125,17 +74,6 @@ protected:
   void simulate(const long long tcur, const int iosv);
   void simulate_rudder(const float rud, const float rud_pos, float & rud_pos_next);
   void simulate_engine(const float eng, const float eng_pos, const float gear_pos, float & eng_pos_next, float & gear_pos_next);
-  const float final_rev(const float thr_pos)
-  {
-    if (thr_pos < 0.417)
-      return 700;
-    if (thr_pos < 0.709)
-      return (5000 - 700) * (thr_pos - 0.417) / (0.709 - 0.417) + 700;
-    if (thr_pos < 0.854)
-      return (5600 - 5000) * (thr_pos - 0.709) / (0.854 - 0.709) + 5000;
-    return 5600;
-  }
-  
   bool m_bcsv_out;
   char m_fcsv_out[1024];
   ofstream m_fcsv;
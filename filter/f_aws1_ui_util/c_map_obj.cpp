@@ -434,16 +434,16 @@ bool c_map_coast_line_obj::update_points(list<AWSMap2::LayerDataPtr> & coast_lin
 	  (*itr)->print();
     const AWSMap2::CoastLine & cl = dynamic_cast<const AWSMap2::CoastLine&>(**itr);
     unsigned int num_lines = cl.getNumLines();
+    const double * px = cl.getX(), * py = cl.getY(), * pz = cl.getZ();
     for (unsigned int iline = 0; iline < num_lines; iline++, index++){
-      const vector<AWSMap2::vec3> & pts_ecef = cl.getPointsECEF(iline);
-      pts.resize(pts_ecef.size());
-      bcull.resize(pts_ecef.size());
-
-      for (int ipt = 0; ipt < pts.size(); ipt++){
-        const AWSMap2::vec3 & pte = pts_ecef[ipt];
-		pts[ipt].x = (float)pte.x;
-		pts[ipt].y = (float)pte.y;
-		pts[ipt].z = (float)pte.z;
+      unsigned int ipt0 = cl.getLineBegin(iline), ipt1 = cl.getLineEnd(iline);
+      pts.resize(ipt1 - ipt0);
+      bcull.resize(ipt1 - ipt0);
+
+      for (unsigned int ipt = ipt0; ipt < ipt1; ipt++){
+		pts[ipt - ipt0].x = (float)px[ipt];
+		pts[ipt - ipt0].y = (float)py[ipt];
+		pts[ipt - ipt0].z = (float)pz[ipt];
 	  }
 
       if (!add_new_line(index, pts.size(), (const float*)pts.data()))
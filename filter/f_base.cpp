@@ -29,6 +29,7 @@ using namespace std;
 #include "../util/aws_stdlib.h"
 #include "../util/aws_thread.h"
 #include "../util/c_clock.h"
+#include "../util/c_thread_pool.h"
 
 #include <opencv2/opencv.hpp>
 using namespace cv;
@@ -194,11 +195,14 @@ mutex f_base::m_mutex;
 condition_variable f_base::m_cond;
 long long f_base::m_cur_time = 0;
 long long f_base::m_count_clock = 0;
+long long f_base::m_count_settle = 0;
+condition_variable f_base::m_cond_settle;
 int f_base::m_time_zone_minute = 540;
 char f_base::m_time_str[32];
 tmex f_base::m_tm;
 c_clock f_base::m_clk;
 c_aws * f_base::m_paws = NULL;
+c_thread_pool * f_base::m_pool = NULL;
 
 ofstream f_base::m_file_err;
 f_base::s_ferr f_base::m_err_buf[SIZE_FERR_BUF];
@@ -210,7 +214,14 @@ mutex f_base::m_err_mtx;
 // this function is used if the filter should be executed in the mainthread such as the case using OpenGL
 void f_base::fthread()
 {
-  if((unsigned int) m_cycle < m_intvl){
+  if(m_bevt){
+    unique_lock<mutex> lock(m_evt.mtx);
+    if(m_evt.count == m_count_evt){
+      m_cycle++;
+      return;
+    }
+    m_count_evt = m_evt.count;
+  }else if((unsigned int) m_cycle < m_intvl){
     m_cycle++;
     return;
   }
@@ -218,15 +229,18 @@ void f_base::fthread()
   if(m_bactive){		
     calc_time_diff();
     
-    if (!proc()){
+    if (!proc_prof()){
       m_bactive = false;
     }
+    publish_ochan();
     
     if(m_clk.is_run()){
       m_count_proc++;
       m_max_cycle = max(m_cycle, m_max_cycle);
       m_proc_rate = (double)  m_count_proc / (double) m_count_clock;
     }
+    if(m_bevt)
+      m_cycle = 0;
   }
 }
 
@@ -236,23 +250,36 @@ void f_base::sfthread(f_base * filter)
   while(filter->m_bactive){
     filter->m_count_pre = filter->m_count_clock;
     
-    while(filter->m_cycle < (int) filter->m_intvl){
-      filter->clock_wait();
-      filter->m_cycle++;
+    if(filter->m_bevt){
+      // event driven mode: wait for the update of the input channels
+      filter->evt_wait();
+      if(!filter->m_bactive)
+	break;
+      filter->m_cycle = (int)(filter->m_count_clock - filter->m_count_pre);
+    }else{
+      while(filter->m_cycle < (int) filter->m_intvl){
+	filter->clock_wait();
+	filter->m_cycle++;
+      }
     }
     filter->lock_cmd();
     
     filter->calc_time_diff();
     
-    if(!filter->proc()){
+    if(!filter->proc_prof()){
       filter->m_bactive = false;
     }
+    filter->publish_ochan();
+    
     if(filter->m_clk.is_run()){
       filter->m_count_proc++;
       filter->m_max_cycle = max(filter->m_cycle, filter->m_max_cycle);
       filter->m_count_post = filter->m_count_clock;
       filter->m_cycle = (int)(filter->m_count_post - filter->m_count_pre);
-      filter->m_cycle -= filter->m_intvl;
+      if(filter->m_bevt)
+	filter->m_cycle = 0;
+      else
+	filter->m_cycle -= filter->m_intvl;
       filter->m_proc_rate = (double)  filter->m_count_proc / (double) filter->m_count_clock;
     }
     
@@ -260,6 +287,175 @@ void f_base::sfthread(f_base * filter)
   }
   
   filter->m_bstopped = true;
+  if(filter->m_clk.is_lock_step())
+    notify_settle();
+}
+
+void f_base::dispatch()
+{
+  if(!m_bactive || m_btask)
+    return;
+
+  m_cycle++;
+  if(m_bevt){
+    unique_lock<mutex> lock(m_evt.mtx);
+    if(m_evt.count == m_count_evt)
+      return;
+    m_count_evt = m_evt.count;
+  }else if(m_cycle < (int) m_intvl){
+    return;
+  }
+
+  m_btask = true;
+  m_pool->push(stask, (void*) this);
+}
+
+// Task function executed in the worker pool
+void f_base::stask(void * ptr)
+{
+  f_base * filter = (f_base*) ptr;
+  filter->lock_cmd();
+  
+  filter->calc_time_diff();
+  
+  if(!filter->proc_prof()){
+    filter->m_bactive = false;
+  }
+  filter->publish_ochan();
+  
+  if(filter->m_clk.is_run()){
+    filter->m_count_proc++;
+    filter->m_max_cycle = max(filter->m_cycle, filter->m_max_cycle);
+    filter->m_proc_rate = (double)  filter->m_count_proc / (double) filter->m_count_clock;
+  }
+  filter->m_cycle = 0;
+  
+  filter->unlock_cmd();
+  filter->m_btask = false;
+  if(m_clk.is_lock_step())
+    notify_settle();
+}
+
+bool f_base::is_settled()
+{
+  if(!m_bactive || m_bstopped || is_main_thread())
+    return true;
+
+  if(m_bpooled)
+    return !m_btask;
+
+  if(m_bevt){
+    unique_lock<mutex> lock(m_evt.mtx);
+    return m_bidle && m_evt.count == m_count_evt;
+  }
+
+  return m_count_ack >= m_count_clock;
+}
+
+void f_base::set_turn(const bool bturn)
+{
+  if(m_bevt){
+    {
+      unique_lock<mutex> lock(m_evt.mtx);
+      m_bturn = bturn;
+    }
+    m_evt.cnd.notify_all();
+    return;
+  }
+
+  unique_lock<mutex> lock(m_mutex);
+  m_bturn = bturn;
+  m_cond.notify_all();
+}
+
+void f_base::wait_settled()
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(!is_settled())
+    m_cond_settle.wait(lock);
+}
+
+void f_base::settle(vector<f_base*> & filters)
+{
+  // the first scan gives the clock to all the filters, and the following
+  // scans execute the filters with the events caused in this clock, until
+  // no filter runs. Only one filter runs at a time.
+  bool bfirst = true, brun = true;
+  while(brun){
+    brun = false;
+    for(int i = 0; i < filters.size(); i++){
+      f_base * pf = filters[i];
+      if(!pf->m_bactive || pf->m_bstopped)
+	continue;
+
+      if(pf->is_main_thread() || pf->m_bpooled){
+	if(!bfirst && !(pf->m_bevt && pf->has_evt()))
+	  continue;
+	if(pf->is_main_thread()){
+	  pf->fthread();
+	}else{
+	  pf->dispatch();
+	  pf->wait_settled();
+	}
+	brun = true;
+      }else if(!pf->is_settled()){
+	pf->set_turn(true);
+	pf->wait_settled();
+	pf->set_turn(false);
+	brun = true;
+      }
+    }
+    bfirst = false;
+  }
+}
+
+void f_base::get_prof_info(s_cmd & cmd)
+{
+  // all values are in micro second
+  snprintf(cmd.get_ret_str(), RET_LEN, 
+	   "%s n=%llu mean=%.1f p50=%.1f p99=%.1f p999=%.1f max=%.1f "
+	   "cmd_p99=%.1f cmd_max=%.1f ch_p99=%.1f ch_max=%.1f",
+	   m_name, m_hist_proc.get_num(), 
+	   m_hist_proc.get_mean() * 1e-3,
+	   m_hist_proc.get_quantile(0.5) * 1e-3,
+	   m_hist_proc.get_quantile(0.99) * 1e-3,
+	   m_hist_proc.get_quantile(0.999) * 1e-3,
+	   m_hist_proc.get_max() * 1e-3,
+	   m_hist_cmd.get_quantile(0.99) * 1e-3,
+	   m_hist_cmd.get_max() * 1e-3,
+	   m_hist_ch.get_quantile(0.99) * 1e-3,
+	   m_hist_ch.get_max() * 1e-3);
+}
+
+void f_base::dump_prof(ostream & out, long long t, bool json)
+{
+  if(json){
+    out << "{\"t\":" << t
+	<< ",\"filter\":\"" << m_name << "\""
+	<< ",\"n\":" << m_hist_proc.get_num()
+	<< ",\"mean\":" << m_hist_proc.get_mean() * 1e-3
+	<< ",\"p50\":" << m_hist_proc.get_quantile(0.5) * 1e-3
+	<< ",\"p99\":" << m_hist_proc.get_quantile(0.99) * 1e-3
+	<< ",\"p999\":" << m_hist_proc.get_quantile(0.999) * 1e-3
+	<< ",\"max\":" << m_hist_proc.get_max() * 1e-3
+	<< ",\"cmd_p99\":" << m_hist_cmd.get_quantile(0.99) * 1e-3
+	<< ",\"cmd_max\":" << m_hist_cmd.get_max() * 1e-3
+	<< ",\"ch_p99\":" << m_hist_ch.get_quantile(0.99) * 1e-3
+	<< ",\"ch_max\":" << m_hist_ch.get_max() * 1e-3
+	<< "}" << endl;
+  }else{
+    out << t << "," << m_name << ","
+	<< m_hist_proc.get_num() << ","
+	<< m_hist_proc.get_mean() * 1e-3 << ","
+	<< m_hist_proc.get_quantile(0.5) * 1e-3 << ","
+	<< m_hist_proc.get_quantile(0.99) * 1e-3 << ","
+	<< m_hist_proc.get_quantile(0.999) * 1e-3 << ","
+	<< m_hist_proc.get_max() * 1e-3 << ","
+	<< m_hist_cmd.get_quantile(0.99) * 1e-3 << ","
+	<< m_hist_cmd.get_max() * 1e-3 << ","
+	<< m_hist_ch.get_quantile(0.99) * 1e-3 << ","
+	<< m_hist_ch.get_max() * 1e-3 << endl;
+  }
 }
 
 void f_base::flush_err_buf(){
@@ -295,14 +491,31 @@ bool f_base::stop()
     cout << "Stopping " << m_name << "." << endl;
     m_bactive = false;
   }
+  if(m_bevt){
+    // wake up the thread waiting for input channels
+    m_evt.notify();
+  }
+
   if(is_main_thread()){
     if(!m_bstopped)
       cout << m_name << " stopped." << endl;
     m_bstopped = true;
+    unsubscribe_ichan();
+    return true;
+  }
+
+  if(m_bpooled){
+    if(m_btask) // wait for the task in the pool
+      return false;
+    if(!m_bstopped)
+      cout << m_name << " stopped." << endl;
+    m_bstopped = true;
+    unsubscribe_ichan();
     return true;
   }
   
   if(m_bstopped){
+    unsubscribe_ichan();
     if(m_fthread){
       m_fthread->join();
       delete m_fthread;
@@ -317,7 +530,8 @@ bool f_base::stop()
 
 void f_base::clock(long long cur_time){
 	unique_lock<mutex> lock(m_mutex);
-	if(m_clk.is_run())
+	// in lock step mode, "step" in pause state is also a clock.
+	if(m_clk.is_run() || (m_clk.is_lock_step() && cur_time != m_cur_time))
 		m_count_clock++;
 	m_cur_time = cur_time;
 	gmtimeex(m_cur_time / MSEC  + m_time_zone_minute * 60000, m_tm);
@@ -335,13 +549,16 @@ void f_base::clock(long long cur_time){
 }
 
 f_base::f_base(const char * name):m_offset_time(0), m_bactive(false), m_fthread(NULL),
-	m_intvl(1), m_bstopped(true), m_cmd(false), m_mutex_cmd()
+	m_intvl(1), m_bstopped(true), m_cmd(false), m_mutex_cmd(), m_bevt(false), m_count_evt(0),
+	m_bdedicated(false), m_bpooled(false), m_btask(false)
 {
 	m_name = new char[strlen(name) + 1];
 	strncpy(m_name, name, strlen(name) + 1);
 
 	register_fpar("TimeShift", &m_offset_time, "Filter time offset relative to global clock. (may be offline mode only)");
 	register_fpar("Interval", &m_intvl, "Execution interval in cycle. (default 0)");
+	register_fpar("DedicatedThread", &m_bdedicated, "Run in its own thread even if the worker pool is enabled. Set y for filters blocking in drivers. (default n)");
+	register_fpar("Event", &m_bevt, "Event driven execution. If yes, the filter is executed when input channels are updated, and Interval is ignored. (default n)");
 	register_fpar("ProcCount", &m_count_proc, "Number of execution."); 
 	register_fpar("ClockCount", &m_count_clock, "Number of clock cycles passed." );
 	register_fpar("ProcRate", &m_proc_rate, "Processing rate.(Read only)");
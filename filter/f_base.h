@@ -24,7 +24,9 @@
 // * f_base::proc is the main function which is executed synchronous to the clock. you can 
 // implements any functions using data in input channels and transfer the results
 // to the next filter via output channels. Or you can control the latency of the proc
-// by setting m_intvl with cmd_proc.
+// by setting m_intvl with cmd_proc. If the parameter "Event" is set to 'y',
+// the filter is not clocked, but executed when the filters feeding its input
+// channels complete their proc().
 // * f_base::cmd_proc is the processing function for filter command. by overriding
 // the function, you can change the internal parameters of the filter you desgined.
 // cmd_proc is called by c_aws for each cycle. because f_base members 
@@ -44,10 +46,12 @@
 #include "../util/aws_stdlib.h"
 #include "../util/aws_sock.h"
 #include "../util/aws_thread.h"
+#include "../util/c_lat_hist.h"
 #include "../command.h"
 #include "../channel/ch_base.h"
 
 class f_base;
+class c_thread_pool;
 
 #define FILE_FERR_LOG "ferr.log"
 #define SIZE_FERR_BUF 64
@@ -306,6 +310,30 @@ protected:
 	// thread body. called with m_fthread
 	static void sfthread(f_base * filter);
 
+	// worker pool shared by the filters. NULL if each filter has its own thread.
+	static c_thread_pool * m_pool;
+	bool m_bdedicated; // if true, the filter has its own thread even if m_pool is enabled.
+	bool m_bpooled; // true if the filter is executed in the worker pool.
+	atomic<bool> m_btask; // true while the proc() task is in the worker pool.
+
+	// task body. pushed to m_pool by dispatch()
+	static void stask(void * filter);
+
+	// latency histograms of proc(), waiting in lock_cmd(), and blocking in 
+	// ch_base::lock() during proc(). 
+	c_lat_hist m_hist_proc, m_hist_cmd, m_hist_ch;
+
+	// proc() with the latencies measured.
+	bool proc_prof()
+	{
+		long long tch = ch_base::get_lock_wait_nsec();
+		long long t = get_mono_time_nsec();
+		bool res = proc();
+		m_hist_proc.add(get_mono_time_nsec() - t);
+		m_hist_ch.add(ch_base::get_lock_wait_nsec() - tch);
+		return res;
+	}
+
 	bool m_bactive; // if it is true, filter thread continues to loop
 	bool m_bstopped; //true indicates filter is stopped. 
 	// count number of proc() executed
@@ -319,6 +347,80 @@ protected:
 	static mutex m_mutex;
 	static condition_variable m_cond;
 
+	// event driven mode. the filter waits for m_evt notified by the input channels
+	bool m_bevt;
+	s_evt_signal m_evt;
+	long long m_count_evt;
+
+	// wait signal from the input channels.
+	void evt_wait(){
+		if(!m_clk.is_lock_step()){
+			m_evt.wait(m_count_evt);
+			return;
+		}
+
+		{
+			unique_lock<mutex> lock(m_evt.mtx);
+			m_bidle = true;
+		}
+		notify_settle();
+
+		// the event is consumed in the turn of the filter, and m_bidle is 
+		// cleared at once
+		unique_lock<mutex> lock(m_evt.mtx);
+		m_evt.cnd.wait(lock, [&]{return (m_bturn && m_evt.count != m_count_evt) || !m_bactive;});
+		m_count_evt = m_evt.count;
+		m_bidle = false;
+	}
+
+	// lock step mode (trat 0). c_aws advances the clock after all the 
+	// filters have finished the current clock. A filter thread acknowledges
+	// the clocks it has consumed in clock_wait(), and m_count_settle is 
+	// incremented every time a filter thread or a task finishes. A filter 
+	// thread consumes clocks and events only in its turn given by settle().
+	long long m_count_tick;        // clocks consumed by the filter thread
+	atomic<long long> m_count_ack; // clocks the filter thread has finished
+	bool m_bidle;                  // the event driven thread is waiting (under m_evt.mtx)
+	bool m_bturn;                  // the filter thread may run (under m_mutex, or m_evt.mtx in event driven mode)
+	static long long m_count_settle;
+	static condition_variable m_cond_settle;
+
+	static void notify_settle(){
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_count_settle++;
+		}
+		m_cond_settle.notify_all();
+	}
+
+	// gives/takes the turn to/from the filter thread
+	void set_turn(const bool bturn);
+
+	// waits until the filter is settled
+	void wait_settled();
+
+	bool has_evt(){
+		unique_lock<mutex> lock(m_evt.mtx);
+		return m_evt.count != m_count_evt;
+	}
+
+	// subscribe/unsubscribe m_evt to/from the input channels
+	void subscribe_ichan(){
+		for(int ich = 0; ich < m_chin.size(); ich++)
+			m_chin[ich]->add_evt_signal(&m_evt);
+	}
+
+	void unsubscribe_ichan(){
+		for(int ich = 0; ich < m_chin.size(); ich++)
+			m_chin[ich]->remove_evt_signal(&m_evt);
+	}
+
+	// notify the filters waiting for the output channels
+	void publish_ochan(){
+		for(int ich = 0; ich < m_chout.size(); ich++)
+			m_chout[ich]->publish();
+	}
+
 	virtual bool seek(long long seek_time)
 	{
 		return true;
@@ -342,6 +444,11 @@ public:
 	// invoke main thread.
 	virtual bool run(long long start_time, long long end_time)
 	{
+		if(m_bevt && m_chin.size() == 0){
+			cerr << m_name << " has no input channel to be driven by events." << endl;
+			return false;
+		}
+
 		if(!init_run()){
 			return false;
 		}
@@ -358,7 +465,18 @@ public:
 		m_max_cycle = 0;
 		m_cycle = 0;
 		m_count_pre = m_count_post = m_count_clock;
-		if (!is_main_thread())
+		m_count_tick = m_count_clock;
+		m_count_ack = m_count_clock;
+		m_bidle = false;
+		m_bturn = false;
+		if(m_bevt){
+			m_count_evt = m_evt.count;
+			subscribe_ichan();
+		}
+
+		m_bpooled = m_pool != NULL && !m_bdedicated && !is_main_thread();
+		m_btask = false;
+		if (!is_main_thread() && !m_bpooled)
 			m_fthread = new thread(sfthread, this);
 		return true;
 	}
@@ -371,9 +489,32 @@ public:
 
 	void runstat(){
 	  cout << get_name() << ": ";
+	  if(is_main_thread())
+	    cout << "[main";
+	  else if(m_bpooled)
+	    cout << "[pool";
+	  else
+	    cout << "[thread";
+	  cout << (m_bevt ? ",event] " : "] ");
 	  cout << "Processing rate " << m_proc_rate;
 	  cout << " (" << m_count_proc << "/" << m_count_clock << ") ";
-	  cout << "Max cycles " << m_max_cycle << endl;
+	  cout << "Max cycles " << m_max_cycle;
+	  cout << " Proc time p50 " << m_hist_proc.get_quantile(0.5) / 1000;
+	  cout << "us p99 " << m_hist_proc.get_quantile(0.99) / 1000;
+	  cout << "us max " << m_hist_proc.get_max() / 1000 << "us" << endl;
+	}
+
+	// profile information for fprof command
+	void get_prof_info(s_cmd & cmd);
+
+	// dump profile as a csv line (or json line if json is true) with time t
+	void dump_prof(ostream & out, long long t, bool json);
+
+	void reset_prof()
+	{
+		m_hist_proc.reset();
+		m_hist_cmd.reset();
+		m_hist_ch.reset();
 	}
 
 	// check the filter activity condition
@@ -401,6 +542,32 @@ public:
 		return false;
 	}
 
+	static void set_pool(c_thread_pool * pool)
+	{
+		m_pool = pool;
+	}
+
+	bool is_pooled()
+	{
+		return m_bpooled;
+	}
+
+	// true if the filter has finished the current clock in lock step mode.
+	// The filters in the main thread and the pooled filters waiting for
+	// dispatch() with events are regarded as settled.
+	bool is_settled();
+
+	// c_aws executes the filters in lock step mode one by one in the order
+	// of the list, each settled before the next, so a filter reads the
+	// outputs of the filters before it in the current clock. The list is
+	// scanned again while the events caused in the clock wake filters.
+	static void settle(vector<f_base*> & filters);
+
+	// This is called in the main loop for the filters executed in the worker pool.
+	// The proc() task is pushed to the pool if the interval is expired (or the input
+	// channels are updated in event mode), and the previous task has been finished.
+	void dispatch();
+
 	virtual bool proc() = 0;
 
 	////////////////////////////////////////////////////// time and the methods
@@ -426,8 +593,19 @@ protected:
 	static long long m_count_clock;
 
 	// wait signal from aws main loop clocked with hardware timer.
+	// In lock step mode, the clocks are never missed.
 	void clock_wait(){
 		unique_lock<mutex> lock(m_mutex);
+		if(m_clk.is_lock_step()){
+			m_count_ack = m_count_tick;
+			m_count_settle++;
+			m_cond_settle.notify_all();
+			while((!m_bturn || m_count_clock <= m_count_tick) && m_bactive)
+				m_cond.wait(lock);
+			if(m_count_tick < m_count_clock)
+				m_count_tick++;
+			return;
+		}
 		m_cond.wait(lock);
 	}
 
@@ -579,10 +757,20 @@ public:
 	// lock for command processing mutex
 	void lock_cmd(bool bcmd = false)
 	{
-		if(bcmd)
+		if(bcmd){
 			m_cmd = true;
+			m_mutex_cmd.lock();
+			return;
+		}
 
-		m_mutex_cmd.lock();
+		// the filter thread measures the time waiting for the command processing
+		if(m_mutex_cmd.try_lock()){
+			m_hist_cmd.add(0);
+		}else{
+			long long t = get_mono_time_nsec();
+			m_mutex_cmd.lock();
+			m_hist_cmd.add(get_mono_time_nsec() - t);
+		}
 	}
 
 	// unlock for command processing mutex
@@ -38,7 +38,7 @@ using namespace cv;
 //////////////////////////////////////////////////// class f_cam members
 
 f_cam::f_cam(const char * name):f_base(name), 
-		m_intpar(false), m_pout(NULL), m_pcamparout(NULL), m_bstream(false)
+		m_intpar(false), m_type_frm(-1), m_pout(NULL), m_pcamparout(NULL), m_bstream(false)
 {
 	register_fpar("bstrm", &m_bstream, "Stream activity status.");
 }
@@ -157,6 +157,35 @@ bool f_cam::proc()
 	if(pout == NULL)
 		return false;
 
+	// if the output is pooled, the frame is grabbed into a slot of the pool
+	// directly. The slot is sized as the last frame.
+	ch_image_pool * ppool = dynamic_cast<ch_image_pool*>(pout);
+	if(ppool && m_type_frm >= 0){
+		Mat img;
+		int islot = ppool->acquire(img, m_sz_frm.height, m_sz_frm.width, m_type_frm);
+		if(islot >= 0){
+			uchar * pdata = img.data;
+			m_bstream = grab(img);
+			if(!m_bstream){
+				ppool->cancel(islot);
+				return true;
+			}
+
+			m_time_shot = m_cur_time;
+			if(img.data == pdata){
+				ppool->commit(islot, m_cur_time);
+			}else{
+				// grab() replaced the buffer (the format has changed, or the
+				// camera does not grab in place).
+				ppool->cancel(islot);
+				pout->set_img(img, m_cur_time);
+				m_sz_frm = img.size();
+				m_type_frm = img.type();
+			}
+			return true;
+		}
+	}
+
 	Mat img;
 	m_bstream = grab(img);
 
@@ -164,6 +193,8 @@ bool f_cam::proc()
 		return true;
 
 	m_time_shot = m_cur_time;
+	m_sz_frm = img.size();
+	m_type_frm = img.type();
 	pout->set_img(img, m_cur_time);
 	return true;
 }
@@ -45,6 +45,8 @@ protected:
 	Mat m_tvec_base; // translation vector from wold center to the camera center.
 
 	long long m_time_shot;
+	Size m_sz_frm;  // size and type of the last frame, used to acquire
+	int m_type_frm; // the buffer from ch_image_pool before grab()
 	ch_image * m_pout; // filter output pin
 	ch_campar * m_pcamparout;
 public:
@@ -59,6 +61,8 @@ public:
 
 	virtual bool init_run(){
 			m_time_shot = -1;
+			m_sz_frm = Size(0, 0);
+			m_type_frm = -1;
 		return true;
 	}
 
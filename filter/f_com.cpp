@@ -664,7 +664,19 @@ bool f_trn_img::proc()
 
 	long long timg;
 	
-	Mat img = m_pimgin->get_img(timg);
+	// for pooled image channel, the frame is held by frm until proc returns
+	// and is read without copy.
+	ch_image_pool * ppool = dynamic_cast<ch_image_pool*>(m_pimgin);
+	c_img_frame frm;
+	Mat img;
+	if(ppool){
+		if(ppool->get_frame(frm) && !frm.empty()){
+			img = frm.img();
+			timg = frm.get_time();
+		}
+	}else{
+		img = m_pimgin->get_img(timg);
+	}
 
 	if(img.empty()){
 		return true;
@@ -677,6 +689,8 @@ bool f_trn_img::proc()
 		sz.width = (int)(sz.width * m_scale + 0.5);
 		sz.height = (int)(sz.height * m_scale + 0.5);
 		resize(img, data, sz);
+	}else if(ppool){
+		data = img;
 	}else{
 		data = img.clone();
 	}
@@ -943,9 +957,25 @@ bool f_write_ch_log::open_log(const int ich)
 		return false;
 	int l = (int) strlen(m_path) + 1;
 	snprintf(fname, 1024, "%s/%s_%lld.log", m_path, m_chin[ich]->get_name(), get_time());
-	m_logs[ich] = fopen(fname, "wb");
+	if(m_basync){
+		m_fds[ich] = m_writer.open(fname);
+		if(m_fds[ich] >= 0){
+#ifdef __linux__
+			if(!m_mems[ich])
+				m_mems[ich] = open_memstream(&m_mbufs[ich], &m_mszs[ich]);
+#endif
+			m_logs[ich] = m_mems[ich];
+		}
+	}else{
+		m_logs[ich] = fopen(fname, "wb");
+	}
 	if(!m_logs[ich]){
 		cerr << "Failed to open " << fname << "." << endl;
+	}else if(m_idx_intvl > 0){
+		char fidx[1024];
+		c_log_index::get_index_name(fname, fidx, 1024);
+		m_idxs[ich] = new c_log_index;
+		m_idxs[ich]->open(fidx, (long long)(m_idx_intvl * SEC));
 	}
 	fjr << "#S " << get_time() << endl;
 	fjr << (&fname[l]) << endl;
@@ -966,10 +996,21 @@ bool f_write_ch_log::close_log(const int ich)
 	fjr << "#E " << get_time() << endl;
 	fjr.close();
 
-	fclose(m_logs[ich]);
+	if(m_basync){
+		// the memory stream is reused for the next file
+		m_writer.close(m_fds[ich]);
+		m_fds[ich] = -1;
+	}else{
+		fclose(m_logs[ich]);
+	}
 	m_logs[ich] = NULL;
 	m_szs[ich] = 0;
 
+	if(m_idxs[ich]){
+		delete m_idxs[ich];
+		m_idxs[ich] = NULL;
+	}
+
 	return true;
 }
 
@@ -989,6 +1030,24 @@ bool f_write_ch_log::init_run()
 {
 	m_logs.resize(m_chin.size(), NULL);
 	m_szs.resize(m_chin.size(), 0);
+	m_idxs.resize(m_chin.size(), NULL);
+	m_fds.resize(m_chin.size(), -1);
+	m_mems.resize(m_chin.size(), NULL);
+	m_mbufs.resize(m_chin.size(), NULL);
+	m_mszs.resize(m_chin.size(), 0);
+
+#ifndef __linux__
+	// the record size is taken from the memory stream, as glibc reports it.
+	if(m_basync){
+		cerr << get_name() << ": async is supported only on Linux. Logs are written synchronously." << endl;
+		m_basync = false;
+	}
+#endif
+
+	if(m_basync){
+		m_writer.start(m_qlen, (long long) m_qsize_mb * 1024 * 1024,
+			(size_t) m_batch_kb * 1024, m_bdirect);
+	}
 	
 	return open_logs();
 }
@@ -998,6 +1057,24 @@ void f_write_ch_log::destroy_run()
 	for(int ich = 0; ich < m_chin.size(); ich++){
 		close_log(ich);
 	}
+
+	if(m_basync){
+		m_writer.stop(); // waits for all the queued records written
+		m_num_drop = m_writer.get_count_drop();
+		m_num_block = m_writer.get_count_block();
+		m_bytes_wr = m_writer.get_bytes_written();
+		if(m_num_drop)
+			cerr << get_name() << " dropped " << m_num_drop << " records." << endl;
+	}
+
+	for(int ich = 0; ich < m_mems.size(); ich++){
+		if(m_mems[ich]){
+			fclose(m_mems[ich]);
+			free(m_mbufs[ich]);
+			m_mems[ich] = NULL;
+			m_mbufs[ich] = NULL;
+		}
+	}
 }
 
 void f_write_ch_log::close_logs()
@@ -1025,8 +1102,33 @@ bool f_write_ch_log::proc()
 		  close_log(ich);
 		  open_log(ich);
 	  }
-    	m_szs[ich] += m_chin[ich]->write(m_logs[ich], get_time());
+	  long long pos;
+	  int sz;
+	  if(m_basync){
+		  // the record is serialized into the memory stream, then queued
+		  pos = (long long) m_szs[ich];
+		  sz = m_chin[ich]->write(m_logs[ich], get_time());
+		  if(sz > 0){
+			  fflush(m_logs[ich]);
+			  sz = (int) m_mszs[ich];
+			  if(!m_writer.push(m_fds[ich], m_mbufs[ich], m_mszs[ich], m_bblock))
+				  sz = 0; // dropped
+		  }
+		  aws_fseek(m_logs[ich], 0, SEEK_SET);
+	  }else{
+		  pos = (m_idxs[ich] ? aws_ftell(m_logs[ich]) : 0);
+		  sz = m_chin[ich]->write(m_logs[ich], get_time());
+	  }
+	  if(m_idxs[ich] && sz > 0)
+		  m_idxs[ich]->add(get_time(), pos);
+	  m_szs[ich] += sz;
   }
+
+	if(m_basync){
+		m_num_drop = m_writer.get_count_drop();
+		m_num_block = m_writer.get_count_block();
+		m_bytes_wr = m_writer.get_bytes_written();
+	}
 	return true;
 }
 
@@ -1062,23 +1164,52 @@ bool f_read_ch_log::open_log(const int och)
 
 		m_te[och] = atoll(&buf[3]);
 		if(m_te[och] > get_time()){
-			m_logs[och] = fopen(fname, "rb");
 			cout << "Opening " << fname << " for " << m_chout[och]->get_name() << endl;
-			if(!m_logs[och]){			
+			if(m_bmmap){
+				m_maps[och] = new c_log_map;
+				if(!m_maps[och]->open(fname)){
+					delete m_maps[och];
+					m_maps[och] = NULL;
+				}
+			}
+			if(!m_maps[och])
+				m_logs[och] = fopen(fname, "rb");
+			if(!m_logs[och] && !m_maps[och]){			
 				cerr << "Failed to open file " << buf << "." << endl;
 				return false;
 			}
+			char fidx[1024];
+			c_log_index::get_index_name(fname, fidx, 1024);
+			if(!m_idxs[och].load(fidx) && m_verb){
+				cout << "No index for " << fname << endl;
+			}
 			seek = true;
 		}
 	}
 	return true;
 }
 
+void f_read_ch_log::close_log(const int och)
+{
+	if(m_logs[och]){
+		fclose(m_logs[och]);
+		m_logs[och] = NULL;
+	}
+
+	if(m_maps[och]){
+		// the mapping is kept while the frames read are referred
+		delete m_maps[och];
+		m_maps[och] = NULL;
+	}
+}
+
 bool f_read_ch_log::init_run()
 {
-	m_logs.resize(m_chout.size());
+	m_logs.resize(m_chout.size(), NULL);
+	m_maps.resize(m_chout.size(), NULL);
 	m_ts.resize(m_chout.size());
 	m_te.resize(m_chout.size());
+	m_idxs.resize(m_chout.size());
 
 	int och;
 	for(och = 0; och < m_chout.size(); och++){
@@ -1088,31 +1219,57 @@ bool f_read_ch_log::init_run()
 	return true;
 }
 
+// jumps to the record indexed just before seek_time in each log file. The
+// records before the position are skipped without being read. Logs 
+// without index are read from the head as before.
+bool f_read_ch_log::seek(long long seek_time)
+{
+	for(int och = 0; och < m_chout.size(); och++){
+		if((!m_logs[och] && !m_maps[och]) || m_idxs[och].size() == 0)
+			continue;
+		long long pos = m_idxs[och].find(seek_time);
+		if(pos < 0)
+			continue;
+		bool res = (m_maps[och] ? m_maps[och]->seek((size_t) pos) :
+			aws_fseek(m_logs[och], pos, SEEK_SET) == 0);
+		if(!res){
+			cerr << "Failed to seek " << m_chout[och]->get_name() << "'s log." << endl;
+			return false;
+		}
+		if(m_verb)
+			cout << m_chout[och]->get_name() << "'s log seeked to " << pos << endl;
+	}
+	return true;
+}
+
 void f_read_ch_log::destroy_run()
 {
 	if(m_logs.size())
 	{
 		for(int och = 0; och < m_chout.size(); och++){
-			if(m_logs[och]){
-				fclose(m_logs[och]);
-			}
+			close_log(och);
 		}
 		m_logs.clear();
+		m_maps.clear();
 	}
 }
 
 bool f_read_ch_log::proc()
 {
   for(int och = 0; och < m_chout.size(); och++){
-	  if(!m_logs[och])
+	  if(m_maps[och]){
+		  m_chout[och]->read_map(*m_maps[och], get_time());
+		  m_maps[och]->prefetch((size_t) m_prefetch_mb * 1024 * 1024);
+	  }else if(m_logs[och]){
+		  m_chout[och]->read(m_logs[och], get_time());
+	  }else{
 		  continue;
-	  m_chout[och]->read(m_logs[och], get_time());
+	  }
 	  if (m_verb) {
 		  m_chout[och]->print(cout);
 	  }
 	  if(get_time() > m_te[och]){
-		  fclose(m_logs[och]);
-		  m_logs[och] = NULL;
+		  close_log(och);
 		  if(!open_log(och)){
 			  cout << m_chout[och]->get_name() << "'s log finished at " << get_time() << endl;
 		  }
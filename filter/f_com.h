@@ -19,6 +19,8 @@
 
 #include "../channel/ch_image.h"
 #include "../channel/ch_vector.h"
+#include "../util/c_log_index.h"
+#include "../util/c_log_writer.h"
 
 #include "f_base.h"
 
@@ -191,17 +193,44 @@ private:
 	vector<FILE *> m_logs;
 	vector<size_t> m_szs;
 	size_t m_max_size;
+	vector<c_log_index*> m_idxs; // time-to-offset index of each log file
+	float m_idx_intvl; // minimum interval of the index entries in second
+
+	// asynchronous writing. Records are serialized into per channel memory
+	// streams, and handed to the writer thread which writes them in large
+	// batches.
+	bool m_basync, m_bdirect, m_bblock;
+	int m_qlen, m_qsize_mb, m_batch_kb;
+	c_log_writer m_writer;
+	vector<int> m_fds;
+	vector<FILE *> m_mems; // memory streams
+	vector<char *> m_mbufs;
+	vector<size_t> m_mszs;
+	long long m_num_drop, m_num_block, m_bytes_wr;
+
 	bool open_log(const int ich);
 	bool open_logs();
 	bool close_log(const int ich);
 	void close_logs();
 public:
-	f_write_ch_log(const char * fname) : f_base(fname), m_verb(false), m_max_size(1024 * 1024 * 1024), m_benable(true)
+	f_write_ch_log(const char * fname) : f_base(fname), m_verb(false), m_max_size(1024 * 1024 * 1024), m_benable(true), m_idx_intvl(1.0f),
+		m_basync(false), m_bdirect(false), m_bblock(false), m_qlen(1024), m_qsize_mb(256), m_batch_kb(4096),
+		m_num_drop(0), m_num_block(0), m_bytes_wr(0)
 	{
 		m_path[0] = '.';m_path[1] = '\0';
 		register_fpar("path", m_path, 1024, "Storage path for logging");
 		register_fpar("sz_max", (int*)&m_max_size, "Maximum size of a log file.");
 		register_fpar("enable", &m_benable, "Enable logging.");
+		register_fpar("idx_intvl", &m_idx_intvl, "Interval of the log index entries in second. (<= 0: no index)");
+		register_fpar("async", &m_basync, "Write logs in the background writer thread.");
+		register_fpar("q_len", &m_qlen, "Maximum number of records queued to the writer. (async)");
+		register_fpar("q_size_mb", &m_qsize_mb, "Maximum bytes queued to the writer in MB. (async)");
+		register_fpar("batch_kb", &m_batch_kb, "Size of a write batch in KB. (async)");
+		register_fpar("direct", &m_bdirect, "Open log files with O_DIRECT. (async)");
+		register_fpar("block", &m_bblock, "Block when the queue is full, otherwise records are dropped. (async)");
+		register_fpar("n_drop", &m_num_drop, "Number of records dropped. (async, read only)");
+		register_fpar("n_block", &m_num_block, "Number of times blocked on the full queue. (async, read only)");
+		register_fpar("bytes_wr", &m_bytes_wr, "Bytes written by the writer. (async, read only)");
 	}
 
 	virtual ~f_write_ch_log()
@@ -220,14 +249,26 @@ private:
 	bool m_verb;
 	vector<FILE *> m_logs;
 	vector<long long> m_ts, m_te;
+	vector<c_log_index> m_idxs;
+
+	// memory mapped logs, used instead of m_logs if m_bmmap is set.
+	bool m_bmmap;
+	int m_prefetch_mb;
+	vector<c_log_map*> m_maps;
+
 	bool open_log(const int och);
+	void close_log(const int och);
+
+	virtual bool seek(long long seek_time);
 
 public:
-	f_read_ch_log(const char * fname): f_base(fname), m_verb(false)
+	f_read_ch_log(const char * fname): f_base(fname), m_verb(false), m_bmmap(false), m_prefetch_mb(64)
 	{
 		m_path[0] = '.';m_path[1] = '\0';
 		register_fpar("path", m_path, 1024, "Storage path for logging");
 		register_fpar("verb", &m_verb, "Debug mode");
+		register_fpar("mmap", &m_bmmap, "Map log files into memory. Images refer to the mapped files without copy.");
+		register_fpar("prefetch_mb", &m_prefetch_mb, "Size of the prefetch ahead of the replay position in MB. (mmap)");
 	}
 
 	virtual ~f_read_ch_log()
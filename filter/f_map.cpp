@@ -42,7 +42,8 @@ const char * f_map::m_str_cmd[emc_undef] =
 	"update", "add_data", "set_pos", "render", "save", "check"
 };
 
-f_map::f_map(const char * name) :f_base(name), m_ch_map(NULL), m_dtype(edt_jpjis), 
+f_map::f_map(const char * name) :f_base(name), m_ch_map(NULL), m_state(NULL),
+m_async(true), m_q_len(64), m_t_ahead(600.), m_tprefetch(0), m_dtype(edt_jpjis), 
 m_max_total_size_layer_data(0x00FFFFFF)/*16MB*/, m_max_num_nodes(64),
 lat(35.0), lon(140.0), res(1.0), range(5000), m_verb(false)
 {
@@ -51,6 +52,7 @@ lat(35.0), lon(140.0), res(1.0), range(5000), m_verb(false)
 	m_fdata[0] = '.';
 	m_fdata[1] = '\0';
 	register_fpar("ch_map", (ch_base**)&m_ch_map, typeid(ch_map).name(), "Map channel.");
+	register_fpar("ch_state", (ch_base**)&m_state, typeid(ch_state).name(), "State channel, used for prefetching map data along the predicted track.");
 	register_fpar("cmd", (int*)&m_cmd, emc_undef, m_str_cmd, "Command");
 	register_fpar("dtype", (int*)&m_dtype, edt_undef, m_str_dtype, "Data type of fdata");
 	register_fpar("path", m_path, 1024, "Path to map data.");
@@ -66,6 +68,10 @@ lat(35.0), lon(140.0), res(1.0), range(5000), m_verb(false)
 	register_fpar("res", &res, "Resolution configured by set_pos");
 	register_fpar("range", &range, "Range configured by set_pos");
 
+	register_fpar("async", &m_async, "Load map data in the background (default yes).");
+	register_fpar("q_len", &m_q_len, "Length of the load queue (default 64).");
+	register_fpar("t_ahead", &m_t_ahead, "Look ahead time in prefetching along the predicted track in seconds (default 600).");
+
 	register_fpar("verb", &m_verb, "Verbose for debug");
 }
 
@@ -84,17 +90,32 @@ bool f_map::init_run()
   m_db.setMaxSizeLayerData(AWSMap2::lt_coast_line, m_max_size_layer_data[AWSMap2::lt_coast_line]);
   if(!m_db.init())
     return false;
+
+  if (m_async && !m_db.startLoader(m_q_len))
+    return false;
+  m_tprefetch = 0;
+
+  m_ch_map->lock();
+  m_ch_map->set_db(&m_db);
+  m_ch_map->unlock();
   return true;
 }
 
 void f_map::destroy_run()
 {
+  m_ch_map->lock();
+  m_ch_map->set_db(NULL);
+  m_ch_map->unlock();
+  m_db.stopLoader();
 }
 
 bool f_map::proc()
 {
   bool success = false;
 
+  if (m_async)
+    prefetch();
+
   m_ch_map->lock();
   if(m_ch_map->is_update())
     m_cmd = emc_update;
@@ -137,12 +158,9 @@ void f_map::check_data()
 	cl.setCenter(m_ch_map->get_center());
 	cl.setRadius(m_ch_map->get_range());
 
-	const list<AWSMap2::LayerDataPtr> cls = m_ch_map->get_layer_data(AWSMap2::lt_coast_line);
-	for (auto itr = cls.begin(); itr != cls.end(); itr++) {
-		const AWSMap2::CoastLine & cld = dynamic_cast<const AWSMap2::CoastLine&>(**itr);
-
-		const_cast<AWSMap2::CoastLine*>(&cld)->merge(cl);
-	}
+	// merged via the database, because the layer data in the channel may 
+	// be read by other filters.
+	m_db.insert(&cl);
 }
 
 bool f_map::update_channel()
@@ -169,12 +187,13 @@ bool f_map::update_channel()
     }
   }
 
-  m_db.request(layerDatum, layerTypes, 
+  int npending = m_db.request(layerDatum, layerTypes, 
 	       m_ch_map->get_center(), 
 	       m_ch_map->get_range(), 
 	       m_ch_map->get_resolution());
   if (m_verb) {
 	  cout << "MapManager Information" << endl;
+	  cout << "\tNumber of Loads Pending: " << npending << endl;
 	  cout << "\tNumber of Nodes Alive: " << AWSMap2::Node::getNumNodesAlive() << endl;
 	  cout << "\tMaximum Node Level: " << AWSMap2::Node::getMaxLevel() << endl;
 	  cout << "\tLayer Data Size: " << AWSMap2::LayerData::getTotalSize() << endl;
@@ -189,12 +208,56 @@ bool f_map::update_channel()
 	  }
     m_ch_map->set_layer_data(*itrType, *itrData);
   }
+  m_ch_map->set_pending((unsigned int)npending);
   m_ch_map->reset_update();
+  if (npending)
+	  m_ch_map->set_update(); // requested again until all the data become resident
   m_ch_map->set_ready();
   m_ch_map->unlock();
   return true;
 }
 
+void f_map::prefetch()
+{
+	if (!m_state || get_time() < m_tprefetch + SEC)
+		return;
+	m_tprefetch = get_time();
+
+	long long t;
+	float lat, lon, alt, galt, x, y, z, vx, vy;
+	Mat Renu;
+	m_state->get_position(t, lat, lon, alt, galt, x, y, z, Renu);
+	m_state->get_velocity_vector(t, vx, vy);
+
+	list<AWSMap2::LayerType> layerTypes;
+	m_ch_map->lock();
+	for (int layer_type = 0; layer_type < (int)AWSMap2::lt_undef; layer_type++) {
+		if (m_ch_map->is_layer_enabled((AWSMap2::LayerType)layer_type))
+			layerTypes.push_back((AWSMap2::LayerType)layer_type);
+	}
+	float rng = m_ch_map->get_range();
+	float mres = m_ch_map->get_resolution();
+	m_ch_map->unlock();
+
+	// the predicted track is sampled with the interval of the range
+	// so that the circles requested cover the track.
+	double dx = vx * m_t_ahead, dy = vy * m_t_ahead;
+	int n = (int)ceil(sqrt(dx * dx + dy * dy) / rng);
+	n = min(n, 16);
+	for (int i = 0; i <= n; i++) {
+		double s = (n ? (double)i / (double)n : 0.);
+		AWSMap2::vec3 c;
+		wrldtoecef(Renu, (double)x, (double)y, (double)z, dx * s, dy * s, 0.,
+			c.x, c.y, c.z);
+		m_db.prefetch(layerTypes, c, rng, mres);
+	}
+
+	if (m_verb) {
+		cout << "Prefetched " << n + 1 << " points along the track, "
+			<< m_db.getNumPending() << " loads pending." << endl;
+	}
+}
+
 bool f_map::add_data()
 {
   AWSMap2::LayerData * pld;
@@ -234,6 +297,8 @@ void f_map::render_data()
 	eceftobih(cecef.x, cecef.y, cecef.z, cbih.lat, cbih.lon, calt);
 	Mat Rwrld;
 	getwrldrot(cbih.lat, cbih.lon, Rwrld);
+	s_rot3 Rw(Rwrld);
+	vector<double> xw, yw, zw;
 
 	float mres = m_ch_map->get_resolution();
 	float mrng = m_ch_map->get_range();
@@ -245,10 +310,10 @@ void f_map::render_data()
 	for (auto itr = cls.begin(); itr != cls.end(); itr++) {
 		
 		const AWSMap2::CoastLine & cl = dynamic_cast<const AWSMap2::CoastLine&>(**itr);
-		{
+		const AWSMap2::Node * pn = cl.getNode();
+		if (pn) { // no node for the instance already replaced in the database
 			cout << "Rendering ";
 			cl.print();
-			const AWSMap2::Node * pn = cl.getNode();
 			vector<Point2i> ptn(4);
 			for (int i = 0; i < 3; i++) {
 				const AWSMap2::vec3 & pte = pn->getVtxECEF(i);
@@ -371,32 +436,27 @@ void f_map::render_data()
 			}
 		}
 	
+		// all the points in the node are transformed at once
+		unsigned int npts = cl.getNumPoints();
+		xw.resize(npts);
+		yw.resize(npts);
+		zw.resize(npts);
+		eceftowrld(Rw, cecef.x, cecef.y, cecef.z, cl.getX(), cl.getY(), cl.getZ(),
+			xw.data(), yw.data(), zw.data(), npts);
+
 		for(int id = 0; id < cl.getNumLines(); id++){
-			const vector<AWSMap2::vec2> & pts_bih = cl.getPointsBIH(id);
-			const vector<AWSMap2::vec3> & pts = cl.getPointsECEF(id);
-			vector<Point2i> pts_wrld(pts.size());
+			unsigned int ipt0 = cl.getLineBegin(id), ipt1 = cl.getLineEnd(id);
+			vector<Point2i> pts_wrld(ipt1 - ipt0);
 
 			auto iwpt = pts_wrld.begin();
 			bool binside = false;
-			for (auto ipt = pts.begin(); ipt != pts.end(); ipt++, iwpt++){
-				double wx, wy, wz;
-				eceftowrld(Rwrld, cecef.x, cecef.y, cecef.z, ipt->x, ipt->y, ipt->z, wx, wy, wz);
-				iwpt->x = (int)(scl * wx) + 512;
-				iwpt->y = -(int)(scl * wy) + 512;
+			for (unsigned int ipt = ipt0; ipt < ipt1; ipt++, iwpt++){
+				iwpt->x = (int)(scl * xw[ipt]) + 512;
+				iwpt->y = -(int)(scl * yw[ipt]) + 512;
 				if (iwpt->x < 1024 && iwpt->x > 0 && iwpt->y < 1024 && iwpt->y > 0) {
 					binside = true;
 				}
 			}
-			/*
-			if (binside) {
-				cout << "line[" << id << "]:";
-				cout.precision(12);
-				cout << "bih (" <<pts_bih.front().x <<"," << pts_bih.front().y << ")-(" <<pts_bih.back().x << "," << pts_bih.back().y << ")";
-				cout << "ecef(" <<pts.front().x << "," <<pts.front().y <<  ")-(" << pts.back().x << "," << pts.back().y << ")";
-				cout << "wrld(" <<pts_wrld.front().x << "," << pts_wrld.front().y <<  ")-(" << pts_wrld.back().x << "," << pts_wrld.back().y << ")";
-				cout << endl;
-			}
-			*/
 			unsigned char r, g, b;
 			r = rand() % 128 + 128;
 			g = rand() % 128 + 128;
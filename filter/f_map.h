@@ -42,6 +42,14 @@ protected:
 	static const char * m_str_cmd[emc_undef];
 
 	ch_map * m_ch_map;
+	ch_state * m_state;
+	
+	// background loading
+	bool m_async;			// if asserted, map data is loaded in the background.
+	unsigned int m_q_len;	// length of the load queue
+	double m_t_ahead;		// look ahead time in prefetching along the predicted track (sec)
+	long long m_tprefetch;	// last time prefetched
+	void prefetch();
 	unsigned int m_max_num_nodes;
 	unsigned int m_max_total_size_layer_data;
 	unsigned int m_max_size_layer_data[AWSMap2::lt_undef];
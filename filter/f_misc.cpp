@@ -60,6 +60,10 @@ f_bkg_mask::~f_bkg_mask()
 
 bool f_bkg_mask::init_run()
 {
+	// the previous frame is taken from the channel's history
+	if(m_ch_img_in)
+		m_ch_img_in->set_hist_depth(2);
+
 	if(m_fmask[0]){
 		char buf[1024];
 		snprintf(buf, 1024, "%s.msk", m_fmask);
@@ -106,7 +110,12 @@ bool f_bkg_mask::proc()
 		m_t = t;
 		m_ifrm = ifrm;
 
-		m_img = img.clone();
+		m_img = img; // frames in the channel are not modified by the producer
+		{
+			// the frame just before t (not the age 1, a newer frame may have come.)
+			long long tprev = 0, ifrm_prev;
+			m_img_prev = m_ch_img_in->get_img_before(t, tprev, ifrm_prev);
+		}
 
 		if(m_bupdate){
 			if(m_mask.empty()){
@@ -134,10 +143,6 @@ bool f_bkg_mask::proc()
 					break;
 				}
 			}
-
-			if(!m_img.empty()){
-				m_img_prev = m_img;
-			}
 		}
 	}
 
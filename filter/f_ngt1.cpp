@@ -75,6 +75,73 @@ PgnFieldValues::~PgnFieldValues()
 
 ////////////////////////////////////////////////////////////////////
 
+bool s_pgn_dec::compile(const Pgn * ppgn)
+{
+  nflds = 0;
+  pgn = 0;
+  if(!ppgn || ppgn->repeatingFields)
+    return false;
+  
+  unsigned int sbit = 0;
+  for(int i = 0; ppgn->fieldList[i].name; i++){
+    const Field & fld = ppgn->fieldList[i];
+    if(i >= PGN_DEC_FLDS || fld.size == LEN_VARIABLE || fld.size > 32)
+      return false;
+    
+    s_pgn_fld & f = flds[i];
+    f.sbit = sbit;
+    f.bits = fld.size;
+    f.sign = fld.hasSign;
+    f.ofs = fld.offset;
+    if(fld.resolution > 0.0)
+      f.scale = fld.resolution;
+    else if(fld.resolution == RES_TEMPERATURE)
+      f.scale = 0.01;
+    else if(fld.resolution == RES_TEMPERATURE_HIGH)
+      f.scale = 0.1;
+    else if(fld.resolution == RES_TEMPERATURE_HIRES)
+      f.scale = 0.001;
+    else if(fld.resolution == RES_PRESSURE
+	    || fld.resolution == RES_PRESSURE_HIRES){
+      f.scale = 1.0;
+      if(fld.units){
+	switch(fld.units[0]){
+	case 'h':
+	case 'H':
+	  f.scale = 100.;
+	  break;
+	case 'k':
+	case 'K':
+	  f.scale = 1000.;
+	  break;
+	case 'd':
+	  f.scale = 0.1;
+	  break;
+	}
+      }
+    }
+    else if(fld.resolution == RES_LATITUDE
+	    || fld.resolution == RES_LONGITUDE)
+      f.scale = RES_LAT_LONG;
+    else if(fld.resolution == RES_INTEGER
+	    || fld.resolution == RES_LOOKUP
+	    || fld.resolution == RES_BITFIELD
+	    || fld.resolution == RES_BINARY
+	    || fld.resolution == RES_MANUFACTURER)
+      f.scale = 1.0;
+    else
+      return false;
+    
+    sbit += fld.size;
+    nflds++;
+  }
+  pgn = ppgn->pgn;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
 
 f_ngt1::Packet::Packet():lastFastPacket(0), size(0), allocSize(0), data(NULL)
 {
@@ -110,10 +177,16 @@ unsigned char f_ngt1::NGT_STARTUP_SEQ[3] =
   };
 
 
-f_ngt1::f_ngt1(const char * name):f_base(name), eng_state(NULL), eng_state2(NULL),  m_hserial(NULL_SERIAL), state(MSG_START), showRaw(false), showTxt(false), showData(false), showBytes(false), showJson(false), showSI(false), sep(NULL), onlyPgn(0), onlySrc(-1), clockSrc(-1), heapSize(0), showGeo(GEO_DD), mp(mbuf)
+const uint32_t f_ngt1::pgn_dec_ids[PD_UNDEF] =
+  {
+    127488, 127489, 127493, 127497, 129025, 127250, 128267
+  };
+
+f_ngt1::f_ngt1(const char * name):f_base(name), eng_state(NULL), eng_state2(NULL), m_state(NULL),  m_hserial(NULL_SERIAL), state(MSG_START), showRaw(false), showTxt(false), showData(false), showBytes(false), showJson(false), showSI(false), sep(NULL), onlyPgn(0), onlySrc(-1), clockSrc(-1), heapSize(0), showGeo(GEO_DD), mp(mbuf)
 {
   register_fpar("ch_eng_state", (ch_base**)&eng_state, typeid(ch_eng_state).name(), "Channel for engine state");
   register_fpar("ch_eng_state2", (ch_base**)&eng_state2, typeid(ch_eng_state).name(), "Channel for second engine state");
+  register_fpar("ch_state", (ch_base**)&m_state, typeid(ch_state).name(), "Channel for position, heading and depth");
   register_fpar("dev", m_dname, 1024, "Device file path of the serial port.");
   register_fpar("port", &m_port, "Port number of the serial port. (only for windows)");
 
@@ -143,6 +216,7 @@ bool f_ngt1::init_run()
   fillManufacturers();
   fillFieldCounts();
   checkPgnList();
+  compileDecoders();
  
   head = buf;
   heapSize = 0;
@@ -165,47 +239,152 @@ void f_ngt1::destroy_run()
     }
   }
 
-  for(auto itr = pgn_queue.begin(); itr != pgn_queue.end(); itr++)
-    delete *itr;
-
-  pgn_queue.clear();
   heapSize = 0;  
 }
 
 bool f_ngt1::proc()
 {
   readNGT1(m_hserial);
+  return true;
+}
 
-  auto itr = pgn_queue.begin();
-  while(pgn_queue.size()){
-    PgnFieldValues * pfv = *itr;
+void f_ngt1::compileDecoders()
+{
+  for(int idec = 0; idec < PD_UNDEF; idec++){
+    Pgn * pgn = NULL;
+    for(size_t i = 0; i < pgnListSize; i++){
+      if(pgnList[i].pgn == pgn_dec_ids[idec]){
+	pgn = &pgnList[i];
+	break;
+      }
+    }
     
-    if(pfv){
-     
-      handle_pgn_eng_state(pfv, eng_state, 0);
-      handle_pgn_eng_state(pfv, eng_state2, 1);
+    if(!m_decs[idec].compile(pgn)){
+      cerr << "Failed to compile decoder for PGN " << pgn_dec_ids[idec] << endl;
+    }
+  }
+}
 
-      /*
-      if(m_verb){
-	cout << "PGN " << pfv->getPgn() << endl;
-	for(int ifv = 0; ifv < pfv->getNumFields(); ifv++){
-	  const FieldValueBase * pfvb = pfv->get(ifv);
-	  cout << "Field[" << ifv << "]:";
-	  pfvb->print();
-	  cout << " type=";
-	  pfvb->print_type();
-	  cout << endl;
-	}
-      }
-      */
-      delete *itr;
+// decodes the PGNs we consume into the fixed structures and passes them to
+// the channels. The field indices follow the Field tables in ngt1/pgn.h
+// (reserved fields included).
+bool f_ngt1::decodePgn(RawMessage * msg, uint8_t * data, int length)
+{
+  bool v0, v;
+  switch(msg->pgn){
+  case 127488:
+    {
+      const s_pgn_dec & d = m_decs[PD_ENG_RAPID];
+      m_eng_rapid.inst = (unsigned char) d.get(data, length, 0, v0);
+      if(!v0)
+	return false;
+      m_eng_rapid.rpm = (float) d.getf(data, length, 1, v);
+      m_eng_rapid.pboost = (int) d.getf(data, length, 2, v);
+      if(!v)
+	m_eng_rapid.pboost = 0;
+      m_eng_rapid.trim = (char) d.get(data, length, 3, v);
+    }
+    handle_pgn_eng_state(msg->pgn, eng_state, 0);
+    handle_pgn_eng_state(msg->pgn, eng_state2, 1);
+    return true;
+  case 127489:
+    {
+      const s_pgn_dec & d = m_decs[PD_ENG_DYN];
+      m_eng_dyn.inst = (unsigned char) d.get(data, length, 0, v0);
+      if(!v0)
+	return false;
+      m_eng_dyn.poil = (int) d.getf(data, length, 1, v);
+      if(!v)
+	m_eng_dyn.poil = 0;
+      m_eng_dyn.toil = (float) d.getf(data, length, 2, v);
+      m_eng_dyn.temp = (float) d.getf(data, length, 3, v);
+      m_eng_dyn.valt = (float) d.getf(data, length, 4, v);
+      m_eng_dyn.frate = (float) d.getf(data, length, 5, v);
+      m_eng_dyn.teng = (unsigned int) d.get(data, length, 6, v);
+      m_eng_dyn.pclnt = (int) d.getf(data, length, 7, v);
+      if(!v)
+	m_eng_dyn.pclnt = 0;
+      m_eng_dyn.pfl = (int) d.get(data, length, 8, v);
+      m_eng_dyn.stat1 = (StatEng1) d.get(data, length, 10, v);
+      m_eng_dyn.stat2 = (StatEng2) d.get(data, length, 11, v);
+      m_eng_dyn.ld = (unsigned char) d.get(data, length, 12, v);
+      m_eng_dyn.tq = (unsigned char) d.get(data, length, 13, v);
+    }
+    handle_pgn_eng_state(msg->pgn, eng_state, 0);
+    handle_pgn_eng_state(msg->pgn, eng_state2, 1);
+    return true;
+  case 127493:
+    {
+      const s_pgn_dec & d = m_decs[PD_TRAN];
+      m_tran.inst = (unsigned char) d.get(data, length, 0, v0);
+      if(!v0)
+	return false;
+      m_tran.gear = (StatGear) d.get(data, length, 1, v);
+      m_tran.poil = (int) d.getf(data, length, 3, v);
+      if(!v)
+	m_tran.poil = 0;
+      m_tran.toil = (float) d.getf(data, length, 4, v);
+    }
+    handle_pgn_eng_state(msg->pgn, eng_state, 0);
+    handle_pgn_eng_state(msg->pgn, eng_state2, 1);
+    return true;
+  case 127497:
+    {
+      const s_pgn_dec & d = m_decs[PD_TRIP];
+      m_trip.inst = (unsigned char) d.get(data, length, 0, v0);
+      if(!v0)
+	return false;
+      m_trip.flused = (int) d.get(data, length, 1, v);
+      m_trip.flavg = (float) d.getf(data, length, 2, v);
+      m_trip.fleco = (float) d.getf(data, length, 3, v);
+      m_trip.flinst = (float) d.getf(data, length, 4, v);
+    }
+    handle_pgn_eng_state(msg->pgn, eng_state, 0);
+    handle_pgn_eng_state(msg->pgn, eng_state2, 1);
+    return true;
+  case 129025:
+    {
+      const s_pgn_dec & d = m_decs[PD_POS];
+      m_pos.lat = d.getf(data, length, 0, v0);
+      m_pos.lon = d.getf(data, length, 1, v);
+      if(!v0 || !v)
+	return false;
+    }
+    handle_pgn_state(msg->pgn);
+    return true;
+  case 127250:
+    {
+      const s_pgn_dec & d = m_decs[PD_HDG];
+      m_hdg.hdg = (float)(d.getf(data, length, 1, v0) * (180. / PI));
+      if(!v0)
+	return false;
+      m_hdg.dev = (float)(d.getf(data, length, 2, v) * (180. / PI));
+      if(!v)
+	m_hdg.dev = 0.f;
+      m_hdg.var = (float)(d.getf(data, length, 3, v) * (180. / PI));
+      if(!v)
+	m_hdg.var = 0.f;
+      m_hdg.ref = (unsigned char) d.get(data, length, 4, v);
+    }
+    handle_pgn_state(msg->pgn);
+    return true;
+  case 128267:
+    {
+      const s_pgn_dec & d = m_decs[PD_DEPTH];
+      m_depth.depth = (float) d.getf(data, length, 1, v0);
+      if(!v0)
+	return false;
+      m_depth.ofs = (float) d.getf(data, length, 2, v);
+      if(!v)
+	m_depth.ofs = 0.f;
     }
-    itr = pgn_queue.erase(itr);
+    handle_pgn_state(msg->pgn);
+    return true;
   }
-  return true;
+  return false;
 }
 
-void f_ngt1::handle_pgn_eng_state(PgnFieldValues * pfv, ch_eng_state * ch, const unsigned char ieng)
+void f_ngt1::handle_pgn_eng_state(const uint32_t pgn, ch_eng_state * ch, const unsigned char ieng)
 {
   if(ch){
     // 127488 engine parameters(rapid)
@@ -234,60 +413,77 @@ void f_ngt1::handle_pgn_eng_state(PgnFieldValues * pfv, ch_eng_state * ch, const
     // 127498 Engine Parameters(Static)
     // 0. Engine Instance, 1. Rated Engine Speed, 2. Vin, 3. Software ID
 
-    switch(pfv->getPgn()){
+    switch(pgn){
     case 127488: // rapid engine parameter
-      if(*pfv->get_vptr<int64_t>(0) != ieng)
+      if(m_eng_rapid.inst != ieng)
 	break;
-      ch->set_rapid(get_time(),
-		    (float)((double)*pfv->get_vptr<int64_t>(1) * 0.25),
-		    (char)(*pfv->get_vptr<int64_t>(3)));
+      ch->set_rapid(get_time(), m_eng_rapid.rpm, m_eng_rapid.trim);
       if(m_verb)
-	cout << 127488 << " rpm:" << (float)((double)*pfv->get_vptr<int64_t>(1) * 0.25) << " trim:" << (*pfv->get_vptr<int64_t>(3)) << endl;
+	cout << 127488 << " rpm:" << m_eng_rapid.rpm << " trim:" << (int) m_eng_rapid.trim << endl;
       break;
     case 127489:
-      if(*pfv->get_vptr<int64_t>(0) != ieng)
+      if(m_eng_dyn.inst != ieng)
 	break;
-      {
-	int32_t poil=(int)(*pfv->get_vptr<int32_t>(1));
-	float toil = (float)(*pfv->get_vptr<double>(2));
-	float temp = (float)(*pfv->get_vptr<double>(3));
-	float valt = (float)((double)*pfv->get_vptr<int64_t>(4) * 0.01);
-	float frate = (float)((double)*pfv->get_vptr<int64_t>(5) * 0.1);
-	unsigned int teng = (unsigned int)(*pfv->get_vptr<int64_t>(6));
-	int pclnt = (int)(*pfv->get_vptr<int32_t>(7));
-	int pfl = (int)(*pfv->get_vptr<int64_t>(8));
-	StatEng1 stat1 = (StatEng1)(*pfv->get_vptr<int64_t>(9));
-	StatEng2 stat2 = (StatEng2)(*pfv->get_vptr<int64_t>(10));
-	unsigned char ld = (unsigned char)(*pfv->get_vptr<int64_t>(11));
-	unsigned char tq = (unsigned char)(*pfv->get_vptr<int64_t>(12));
-	ch->set_dynamic(get_time(), poil, toil, temp, valt, frate, teng, pclnt, pfl, stat1, stat2, ld, tq);
-	if(m_verb)
-	  cout << 127489 << " temp:" << temp << " valt:" << valt << " poil:" << poil << endl; 
-      }
+      ch->set_dynamic(get_time(), m_eng_dyn.poil, m_eng_dyn.toil,
+		      m_eng_dyn.temp, m_eng_dyn.valt, m_eng_dyn.frate,
+		      m_eng_dyn.teng, m_eng_dyn.pclnt, m_eng_dyn.pfl,
+		      m_eng_dyn.stat1, m_eng_dyn.stat2,
+		      m_eng_dyn.ld, m_eng_dyn.tq);
+      if(m_verb)
+	cout << 127489 << " temp:" << m_eng_dyn.temp << " valt:" << m_eng_dyn.valt << " poil:" << m_eng_dyn.poil << endl; 
       break;
     case 127493:
-      if(*pfv->get_vptr<int64_t>(0) != ieng)
+      if(m_tran.inst != ieng)
 	break;
-      ch->set_tran(get_time(),
-		   (StatGear)(*pfv->get_vptr<int64_t>(1)),
-		   (int)(*pfv->get_vptr<int64_t>(3)),
-		   (float)(*pfv->get_vptr<double>(4)));
+      ch->set_tran(get_time(), m_tran.gear, m_tran.poil, m_tran.toil);
       if(m_verb)
-	cout << 127493 << " Gear:" << (*pfv->get_vptr<int64_t>(1)) << endl;
+	cout << 127493 << " Gear:" << (int) m_tran.gear << endl;
       break;
     case 127497:
-      if(*pfv->get_vptr<int64_t>(0) != ieng)
+      if(m_trip.inst != ieng)
 	break;
-      ch->set_trip(get_time(),
-		   (int)(*pfv->get_vptr<int64_t>(1)),
-		   (float)((double)*pfv->get_vptr<int64_t>(2) * 0.1),
-		   (float)((double)*pfv->get_vptr<int64_t>(3) * 0.1),
-		   (float)((double)*pfv->get_vptr<int64_t>(4) * 0.1));			      if(m_verb)									  cout << 127497 << " fuel used:" << (int)(*pfv->get_vptr<int64_t>(1)) << " Fuel Rate:" << (float)((double)*pfv->get_vptr<int64_t>(2) * 0.1) << endl;
+      ch->set_trip(get_time(), m_trip.flused, m_trip.flavg, m_trip.fleco,
+		   m_trip.flinst);
+      if(m_verb)
+	cout << 127497 << " fuel used:" << m_trip.flused << " Fuel Rate:" << m_trip.flavg << endl;
       break;
     }
   }
 }
 
+void f_ngt1::handle_pgn_state(const uint32_t pgn)
+{
+  if(!m_state)
+    return;
+
+  // 129025 Position, Rapid Update
+  // 127250 Vessel Heading
+  // 128267 Water Depth
+  // Values not in the PGNs (altitude, roll and pitch) are kept as they are.
+  long long t;
+  float r, p, y, lat, lon, alt, galt;
+  switch(pgn){
+  case 129025:
+    m_state->get_position(t, lat, lon, alt, galt);
+    m_state->set_position(get_time(), (float) m_pos.lat, (float) m_pos.lon,
+			  alt, galt);
+    if(m_verb)
+      cout << 129025 << " lat:" << m_pos.lat << " lon:" << m_pos.lon << endl;
+    break;
+  case 127250:
+    m_state->get_attitude(t, r, p, y);
+    m_state->set_attitude(get_time(), r, p, m_hdg.hdg);
+    if(m_verb)
+      cout << 127250 << " hdg:" << m_hdg.hdg << endl;
+    break;
+  case 128267:
+    m_state->set_depth(get_time(), m_depth.depth);
+    if(m_verb)
+      cout << 128267 << " depth:" << m_depth.depth << endl;
+    break;
+  }
+}
+
 ///////////////////////////////////////////////////////////// from canboat
 int f_ngt1::readNGT1(AWS_SERIAL handle)
 {
@@ -462,8 +658,12 @@ void  f_ngt1::n2kMessageReceived(const unsigned char * msg, size_t msgLen)
   msg_raw.src = src;
   msg_raw.len = len;
   
-  snprintf(msg_raw.timestamp, sizeof(msg_raw.timestamp),
-	   "%s", now(dateStr));
+  // the timestamp string is only for the text outputs.
+  if(showTxt || showData || showRaw)
+    snprintf(msg_raw.timestamp, sizeof(msg_raw.timestamp),
+	     "%s", now(dateStr));
+  else
+    msg_raw.timestamp[0] = '\0';
   
   /*
   len += 11;
@@ -653,7 +853,10 @@ void f_ngt1::printPacket(size_t index, RawMessage * msg)
           );
   }
 
-  printPgn(msg, packet->data, packet->size);
+  decodePgn(msg, packet->data, packet->size);
+  
+  if(showTxt || showData)
+    printPgn(msg, packet->data, packet->size);
 }
 
 bool f_ngt1::printPgn(RawMessage* msg, uint8_t *dataStart, int length)
@@ -1096,6 +1299,7 @@ bool f_ngt1::printPgn(RawMessage* msg, uint8_t *dataStart, int length)
       }
     if (!r)
       {
+	delete pfv;
 	return false;
       }
     
@@ -1127,7 +1331,7 @@ bool f_ngt1::printPgn(RawMessage* msg, uint8_t *dataStart, int length)
       setSystemClock(currentDate, currentTime);
     }
   */
-  pgn_queue.push_back(pfv);
+  delete pfv;
   return r;
 }
 
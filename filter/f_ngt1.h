@@ -23,6 +23,127 @@
 
 class PgnFieldValues;
 
+// s_pgn_fld is a precomputed extractor of a fixed size numeric field. It is
+// compiled from the Field table in ngt1/pgn.h, so that the PGNs we consume
+// are decoded without walking the table nor allocating field values.
+struct s_pgn_fld
+{
+  unsigned short sbit; // start bit in the payload
+  unsigned char bits;  // field width (<= 32)
+  bool sign;
+  int32_t ofs;         // Excess-K offset (J1939)
+  double scale;        // raw value to the unit printPgn pushes
+                       // (pressure in Pa, temperature in K)
+};
+
+#define PGN_DEC_FLDS 16
+
+struct s_pgn_dec
+{
+  uint32_t pgn;
+  int nflds;
+  s_pgn_fld flds[PGN_DEC_FLDS];
+
+s_pgn_dec():pgn(0), nflds(0)
+  {
+  }
+
+  // fails if the pgn has variable length, string or repeated fields.
+  bool compile(const Pgn * ppgn);
+
+  // raw value of the field ifld. valid is false if the field is out of
+  // the payload or the value is "not available" or "error".
+  int64_t get(const uint8_t * data, const int len, const int ifld,
+	      bool & valid) const
+  {
+    valid = false;
+    if(ifld >= nflds)
+      return 0;
+    
+    const s_pgn_fld & f = flds[ifld];
+    int b0 = f.sbit >> 3, b1 = (f.sbit + f.bits + 7) >> 3;
+    if(b1 > len)
+      return 0;
+    
+    uint64_t v = 0;
+    for(int i = b1 - 1; i >= b0; i--)
+      v = (v << 8) | data[i];
+    
+    int64_t vmax = (int64_t)((((uint64_t)1) << f.bits) - 1);
+    int64_t val = (int64_t)((v >> (f.sbit & 7)) & (uint64_t) vmax);
+    if(f.sign){
+      vmax >>= 1;
+      if(f.ofs)
+	val += f.ofs;
+      else if(val > vmax)
+	val |= ~vmax;
+    }
+    int64_t reserved = (vmax >= 15 ? 2 : (vmax > 1 ? 1 : 0));
+    valid = val <= vmax - reserved;
+    return val;
+  }
+
+  double getf(const uint8_t * data, const int len, const int ifld,
+	      bool & valid) const
+  {
+    return (double) get(data, len, ifld, valid) * flds[ifld].scale;
+  }
+};
+
+// decoded PGNs. Units are the same as those ch_eng_state receives.
+struct s_pgn_eng_rapid // 127488
+{
+  unsigned char inst;
+  float rpm;
+  int pboost;         // boost pressure (Pa)
+  char trim;
+};
+
+struct s_pgn_eng_dyn // 127489
+{
+  unsigned char inst;
+  int poil;           // oil pressure (Pa)
+  float toil, temp;   // oil and engine temperature (K)
+  float valt;         // alternator potential (V)
+  float frate;        // fuel rate (L/h)
+  unsigned int teng;  // total engine hours (s)
+  int pclnt;          // coolant pressure (Pa)
+  int pfl;            // fuel pressure (hPa)
+  StatEng1 stat1;
+  StatEng2 stat2;
+  unsigned char ld, tq;
+};
+
+struct s_pgn_tran // 127493
+{
+  unsigned char inst;
+  StatGear gear;
+  int poil;           // oil pressure (Pa)
+  float toil;         // oil temperature (K)
+};
+
+struct s_pgn_trip // 127497
+{
+  unsigned char inst;
+  int flused;         // fuel used (L)
+  float flavg, fleco, flinst; // (L/h)
+};
+
+struct s_pgn_pos // 129025
+{
+  double lat, lon;    // (deg)
+};
+
+struct s_pgn_hdg // 127250
+{
+  float hdg, dev, var; // (deg)
+  unsigned char ref;
+};
+
+struct s_pgn_depth // 128267
+{
+  float depth, ofs;   // (m)
+};
 
 class f_ngt1: public f_base
 {
@@ -35,6 +156,7 @@ class f_ngt1: public f_base
   bool m_verb;
 
   ch_eng_state * eng_state, * eng_state2;
+  ch_state * m_state;
   
   //<-- these functions are from canboat.actisense-serial
   enum MSG_State
@@ -156,10 +278,29 @@ bool printVarNumber(char * fieldName, Pgn * pgn, uint32_t refPgn, Field * field,
 
   // these functions are from canboat.analyze -->
 
-  list<PgnFieldValues*> pgn_queue;
-
-  void handle_pgn_eng_state(PgnFieldValues * pfv,
+  // <-- compiled decoders for the PGNs we consume.
+  // printPgn() is only called when text output is requested.
+  enum e_pgn_dec{
+    PD_ENG_RAPID, PD_ENG_DYN, PD_TRAN, PD_TRIP, PD_POS, PD_HDG, PD_DEPTH,
+    PD_UNDEF
+  };
+  static const uint32_t pgn_dec_ids[PD_UNDEF];
+  s_pgn_dec m_decs[PD_UNDEF];
+  void compileDecoders();
+  bool decodePgn(RawMessage * msg, uint8_t * data, int length);
+  
+  s_pgn_eng_rapid m_eng_rapid;
+  s_pgn_eng_dyn m_eng_dyn;
+  s_pgn_tran m_tran;
+  s_pgn_trip m_trip;
+  s_pgn_pos m_pos;
+  s_pgn_hdg m_hdg;
+  s_pgn_depth m_depth;
+  // compiled decoders -->
+  
+  void handle_pgn_eng_state(const uint32_t pgn,
 			    ch_eng_state * ch, const unsigned char ieng = 0);
+  void handle_pgn_state(const uint32_t pgn);
   
   ////////////////////////////////////////// pgn hanler
   
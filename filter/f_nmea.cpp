@@ -141,7 +141,7 @@ bool f_nmea::rcv_file()
 		}
 
 		//cout << &m_buf[31] << endl;
-		if(m_chout){
+		if(m_chout || m_chrecs.size()){
 			int len = (int) strlen(&m_buf[31]);
 			if(len >= 84){
 				cerr << "Irregal long sentence detected. :" << m_buf << endl;
@@ -149,8 +149,7 @@ bool f_nmea::rcv_file()
 				continue;
 			}
 			if(is_filtered(&m_buf[31])){
-				if(!m_chout->push(&m_buf[31]))
-					cerr << "Buffer overflow in ch_nmea " << m_chout->get_name() << endl;
+				push_nmea(&m_buf[31]);
 			}
 		}
 
@@ -164,105 +163,79 @@ bool f_nmea::rcv_file()
 
 bool f_nmea::rcv_com()
 {
-	int nrcv;
-	while(nrcv = read_serial(m_hcom, &m_buf[m_buf_head], SIZE_NMEA_BUF - m_buf_head)){
-		m_buf_tail += nrcv;
+	int nrcv, len;
+	char * pw = m_scan.get_wbuf(len);
+	while((nrcv = read_serial(m_hcom, pw, len)) > 0){
+		m_scan.commit(nrcv);
 		extract_nmea_from_buffer();
+		pw = m_scan.get_wbuf(len);
 	}
 	return true;
 }
 
 bool f_nmea::rcv_udp()
 {
-	int nrcv;
-	while(nrcv = recv(m_sock, m_buf + m_buf_head, SIZE_NMEA_BUF - m_buf_head, 0)){
-		m_buf_tail += nrcv;
+#ifdef _WIN32
+	int nrcv, len;
+	char * pw = m_scan.get_wbuf(len);
+	while((nrcv = recv(m_sock, pw, len, 0)) > 0){
+		m_scan.commit(nrcv);
 		extract_nmea_from_buffer();
+		pw = m_scan.get_wbuf(len);
+	}
+#else
+	// datagrams are received in batches without blocking.
+	while(1){
+		int nmsg = recvmmsg(m_sock, m_mmsg, NMEA_UDP_BATCH, MSG_DONTWAIT, NULL);
+		if(nmsg <= 0)
+			break;
+
+		for(int imsg = 0; imsg < nmsg; imsg++){
+			const char * p = m_udp_buf[imsg];
+			int n = (int) m_mmsg[imsg].msg_len;
+			while(n > 0){
+				int l = m_scan.append(p, n);
+				p += l;
+				n -= l;
+				extract_nmea_from_buffer();
+			}
+		}
+
+		if(nmsg < NMEA_UDP_BATCH)
+			break;
 	}
+#endif
 	return true;
 }
 
 void f_nmea::extract_nmea_from_buffer()
 {
-	while(m_buf_tail){
-		// if the nmea sentence is empty, seek for the head mark ! or $.
-		if(m_nmea_tail == 0){
-			for(;m_buf[m_buf_head] != '!' 
-				&& m_buf[m_buf_head] != '$' 
-				&& m_buf_head < m_buf_tail; m_buf_head++){
-					if(!m_buf[m_buf_head]){
-						m_buf_head = m_buf_tail = m_nmea_tail = 0;
-						return;
-					}
-			}
-
-			if(m_buf_head == m_buf_tail){
-				m_buf_head = 0;
-				m_buf_tail = 0;
-				break;
-			}
-		}
-
-		// Copy the nmea string from buffer 
-		for(;m_buf_head < m_buf_tail && m_nmea_tail < 84; 
-			m_buf_head++, m_nmea_tail++){
-				if(!m_buf[m_buf_head]){
-					m_buf_head = m_buf_tail = m_nmea_tail = 0;
-					return;
-				}
-
-				m_nmea[m_nmea_tail] = m_buf[m_buf_head];
-				if(m_buf[m_buf_head] == 0x0D){// detecting CR
-					m_nmea[m_nmea_tail] = '\0';
-					m_nmea_tail = -1; // uses -1 as flag of nmea extraction
-					break;
-				}else if(m_nmea_tail == 84){
-					m_nmea[83] = '\0';
-					cerr << m_name << "::extrac_nmea_from_buffer" << 
-						" No termination character detected in 83 characters." << endl;
-					cerr << "    -> string: " << m_nmea << endl;
-					m_nmea_tail = 0;
-				}
+	int len;
+	c_nmea_scanner::e_chk chk;
+	const char * nmea;
+	while((nmea = m_scan.next(len, chk)) != NULL){
+		if(chk == c_nmea_scanner::ECHK_BAD && m_bchk){
+			if(m_verb)
+				cerr << m_name << " invalid checksum: " << nmea << endl;
+			continue;
 		}
 
-		// if the  buffer ends before the full nmea sentence is transfered
-		// we need to fill buffer with newly received data.
-		if(m_buf_head == m_buf_tail){
-			m_buf_head = 0;
-			m_buf_tail = 0;
-			break;
+		// send it to the channel and log file.
+		if(is_filtered(nmea)){
+			push_nmea(nmea);
 		}
 
-		// If the complete nmea found, send it to the channel and log file.
-		// Then the string remained in the buffer is shiftted to the head.
-		if(m_nmea_tail == -1){
-			if(is_filtered(m_nmea)){
-				if(!m_chout->push(m_nmea)){
-					cerr << "Buffer overflow in ch_nmea " << m_chout->get_name() << endl;
-				}
-			}
-
-			if(m_blog){
-				if(m_flog.is_open())
-					m_flog << get_time_str() << m_nmea << endl;
-				else{
-					sprintf(m_fname_log, "%s_%lld.nmea", m_name, get_time());
-					m_flog.open(m_fname_log);
-				}
-			}
-
-			if(m_verb){
-				cout << m_name << " > " << m_nmea << endl;
+		if(m_blog){
+			if(m_flog.is_open())
+				m_flog << get_time_str() << nmea << endl;
+			else{
+				sprintf(m_fname_log, "%s_%lld.nmea", m_name, get_time());
+				m_flog.open(m_fname_log);
 			}
+		}
 
-			// remained data moves to the buffer head
-			int itail = 0;
-			for(; m_buf_head < m_buf_tail; m_buf_head++, itail++){
-				m_buf[itail] = m_buf[m_buf_head];
-			}
-			m_buf_head = 0; 
-			m_buf_tail = itail;
-			m_nmea_tail = 0;
+		if(m_verb){
+			cout << m_name << " > " << nmea << endl;
 		}
 	}
 }
@@ -289,6 +262,22 @@ bool f_nmea::proc(){
 	return true;
 }
 
+void f_nmea::push_nmea(const char * nmea)
+{
+	if(m_chout){
+		if(!m_chout->push(nmea)){
+			cerr << "Buffer overflow in ch_nmea " << m_chout->get_name() << endl;
+		}
+	}
+
+	if(m_chrecs.size()){
+		m_rec.t = get_time();
+		m_dec.decode(nmea, m_rec, m_rec.t);
+		for(int ich = 0; ich < m_chrecs.size(); ich++)
+			m_chrecs[ich]->push(m_rec);
+	}
+}
+
 int f_nmea::send_nmea()
 {
 	if(!m_chin){
@@ -329,12 +318,18 @@ int f_nmea::send_nmea()
 
 bool f_nmea::init_run()
 {
+	m_dec.set_ais_timeout(m_ais_tfrag);
 
+	m_chrecs.clear();
 	for(int ich = 0;ich < f_base::m_chout.size(); ich++){
 		ch_nmea * pch = dynamic_cast<ch_nmea*>(f_base::m_chout[ich]);
 		if(pch != NULL){
 			m_chout = pch;
 		}
+		ch_nmea_rec * prec = dynamic_cast<ch_nmea_rec*>(f_base::m_chout[ich]);
+		if(prec != NULL){
+			m_chrecs.push_back(prec);
+		}
 	}
 
 	for(int ich = 0; ich < f_base::m_chin.size(); ich++){
@@ -370,9 +365,16 @@ bool f_nmea::init_run()
 		}
 	}
 
-	m_buf_head = 0;
-	m_buf_tail = 0;
-	m_nmea_tail = 0;
+	m_scan.reset();
+#ifndef _WIN32
+	memset(m_mmsg, 0, sizeof(m_mmsg));
+	for(int imsg = 0; imsg < NMEA_UDP_BATCH; imsg++){
+		m_iov[imsg].iov_base = m_udp_buf[imsg];
+		m_iov[imsg].iov_len = NMEA_UDP_LEN;
+		m_mmsg[imsg].msg_hdr.msg_iov = &m_iov[imsg];
+		m_mmsg[imsg].msg_hdr.msg_iovlen = 1;
+	}
+#endif
 	return true;
 }
 
@@ -399,4 +401,11 @@ void f_nmea::destroy_run(){
 	}
 	if(m_flog.is_open())
 		m_flog.close();
+
+	if(m_chrecs.size()){
+		const c_vdm_dec & vdm = m_dec.get_vdm_dec();
+		cout << m_name << " AIS fragments: completed " << vdm.get_count_complete()
+			<< " expired " << vdm.get_count_expired()
+			<< " dropped " << vdm.get_count_drop() << endl;
+	}
 }
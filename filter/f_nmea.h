@@ -18,10 +18,13 @@
 #define _F_NMEA_H_
 
 #define SIZE_NMEA_BUF 166 // for two NMEA
+#define NMEA_UDP_BATCH 16 // datagrams received at once
+#define NMEA_UDP_LEN 1500
 #include "../channel/ch_base.h"
 #include "../channel/ch_ais.h"
 #include "../channel/ch_vector.h"
 #include "../channel/ch_nmea.h"
+#include "../util/c_nmea_scanner.h"
 
 #include "f_base.h"
 
@@ -31,6 +34,12 @@ protected:
 	ch_nmea * m_chout;
 	ch_nmea * m_chin;
 
+	// sentences are decoded once here and pushed to the record channels.
+	vector<ch_nmea_rec*> m_chrecs;
+	c_nmea_dec m_dec;
+	s_nmea_rec m_rec;
+	float m_ais_tfrag; // timeout of the AIS fragments in second
+
 	bool m_blog;
 	bool m_verb;
 	char m_fname_log[1024];
@@ -39,11 +48,14 @@ protected:
 	char m_buf_send[SIZE_NMEA_BUF];
 	char m_filter[6];
 
-	int m_buf_head;
-	int m_buf_tail;
-
-	char m_nmea[84];
-	int m_nmea_tail;
+	// sentences from COM or UDP are framed in the receive buffer of m_scan
+	c_nmea_scanner m_scan;
+	bool m_bchk;
+#ifndef _WIN32
+	struct mmsghdr m_mmsg[NMEA_UDP_BATCH];
+	struct iovec m_iov[NMEA_UDP_BATCH];
+	char m_udp_buf[NMEA_UDP_BATCH][NMEA_UDP_LEN];
+#endif
 	char m_src_type_str[8];
 	enum e_nmea_src{NONE, FILE, COM, UDP} m_nmea_src;
 	union{
@@ -91,8 +103,11 @@ protected:
 	//extract_nmea_from_buffer() is the helper for rcv_com() and rcv_udp()
 	void extract_nmea_from_buffer();
 
+	// pushes the sentence to the output channels
+	void push_nmea(const char * nmea);
+
 	int send_nmea();
-	bool is_filtered(char * nmea){
+	bool is_filtered(const char * nmea){
 		nmea++; // skip ! or $
 
 		// comparing filter with five characters XXYYY where XX is the sender and YYY is the sentence code.
@@ -108,7 +123,8 @@ protected:
 
 public:
  f_nmea(const char * name): f_base(name), m_chin(NULL), m_chout(NULL), m_verb(false), m_blog(false),
-		m_hcom(NULL_SERIAL), m_nmea_src(NONE){
+		m_hcom(NULL_SERIAL), m_nmea_src(NONE), m_bchk(false),
+		m_ais_tfrag(AIS_FRAG_TIMEOUT_DEFAULT){
 		m_fname[0] = '\0';
 
 		m_filter[0] = m_filter[1] = m_filter[2] = m_filter[3] = m_filter[4] = '*';
@@ -123,6 +139,8 @@ public:
 		register_fpar("port", &m_port, "Port number of NMEA source UDP.");
 		register_fpar("verb", &m_verb, "For debug.");
 		register_fpar("log", &m_blog, "Log enable (y or n)");
+		register_fpar("chk", &m_bchk, "Drop sentences with invalid checksum.");
+		register_fpar("ais_tfrag", &m_ais_tfrag, "Timeout of the fragments of AIS messages in second.");
 		register_fpar("filter", m_filter, 6, "Sentence filter. 5 characters are to be specified. * can be used as wild card.");
 	}
 
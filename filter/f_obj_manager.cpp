@@ -63,19 +63,18 @@ void f_obj_manager::destroy_run()
 
 bool f_obj_manager::proc()
 {
-	Mat Renu;
-	float x, y, z;
-	float r, p;
-	float vox, voy;
-	long long t = 0;
-	Renu = m_state->get_enu_rotation(t);
-	m_state->get_position_ecef(t, x, y, z);
-	m_state->get_velocity_vector(t, vox, voy);
+	// position, rotation and velocity are taken from a single snapshot
+	s_state_snapshot st;
+	m_state->get_snapshot(st);
+	Mat Renu(3, 3, CV_64FC1, st.R);
+	float x = st.x, y = st.y, z = st.z;
+	float vox = st.vx, voy = st.vy;
+	long long t = st.tvel;
 
 	if(m_ais_obj){
 		// update enu coordinate
 		if(!Renu.empty()){
-			m_ais_obj->update_rel_pos_and_vel(Renu, x, y, z);
+			m_ais_obj->update_rel_pos_and_vel(m_state, Renu, x, y, z);
 			m_ais_obj->remove_old(get_time() - m_dtold);
 			m_ais_obj->remove_out(m_range);
 		}
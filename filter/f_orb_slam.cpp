@@ -73,7 +73,7 @@ namespace ORB_SLAM2
 		register_fpar("ch_state", (ch_base**)(&m_ch_state), typeid(ch_state).name(), "State channel");
 		m_fcp[0] = m_fvoc[0] = '\0';
 		register_fpar("fcp", m_fcp, 1024, "File of camera parameters.");
-		register_fpar("fvoc", m_fvoc, 1024, "File of vocablary.");
+		register_fpar("fvoc", m_fvoc, 1024, "File of vocablary. (DBoW2 text, or binary with extension .bin)");
 
 		register_fpar("max_frms", &m_max_frms, "Maximum frames for new key frame insertion");
 		register_fpar("min_frms", &m_min_frms, "Minimum frames for preventing new key frame insertion");
@@ -216,12 +216,13 @@ namespace ORB_SLAM2
 			Initializer::m_nfini = Initializer::m_nhini = 0;
 		}
 
-		if (!m_pvoc)
+		if (m_pvoc)
 			delete m_pvoc;
 
+		// the binary cache <m_fvoc>.bin is created at the first load
 		m_pvoc = new ORBVocabulary;
 		cout << "Loading voc file ...";
-		if (!m_pvoc->loadFromTextFile(m_fvoc)){
+		if (!m_pvoc->loadFromCachedFile(m_fvoc)){
 			delete m_pvoc;
 			m_pvoc = NULL;
 			return false;
@@ -212,9 +212,14 @@ bool f_stereo::proc()
 	Mat Rorg;
 
 	if (m_ch_state){
-		m_ch_state->get_attitude(tatt, roll, pitch, yaw);
-		Rorg = m_ch_state->get_enu_rotation(trot);
-		m_ch_state->get_position_ecef(tpos, porg.x, porg.y, porg.z);
+		// the state at the capture time, or the latest one if it is out of the history
+		float lat, lon, alt;
+		if (!m_ch_state->get_attitude_at(m_timg1, roll, pitch, yaw))
+			m_ch_state->get_attitude(tatt, roll, pitch, yaw);
+		if (!m_ch_state->get_position_at(m_timg1, lat, lon, alt, porg.x, porg.y, porg.z, Rorg)){
+			Rorg = m_ch_state->get_enu_rotation(trot);
+			m_ch_state->get_position_ecef(tpos, porg.x, porg.y, porg.z);
+		}
 	}
 
 	if (m_bpl && m_bpr && m_bstp && !m_brct){
@@ -31,6 +31,7 @@ using namespace std;
 using namespace cv;
 
 #include "f_wp_manager.h"
+#include "c_ap_ctrl.h"
 
 const char * f_wp_manager::str_cmd[cmd_null] = {
 	"ins", "ers", "save", "load", "next", "prev"
@@ -130,14 +131,7 @@ bool f_wp_manager::proc()
 		float d2 = wp.rx * wp.rx + wp.ry * wp.ry;
 
 		float d = (float)sqrt(d2);
-		float ctgt = (float)(atan2(wp.rx, wp.ry) * 180. / PI);
-		float cdiff = (float)(ctgt - cog);
-		if(abs(cdiff) > 180.){
-			if(cdiff < 0)
-				cdiff += 360.;
-			else
-				cdiff -= 360.;
-		}
+		float cdiff = c_ap_ctrl::calc_cdiff(wp.rx, wp.ry, cog);
 
 		m_wp->set_diff(d, cdiff);
 		if(d < wp.rarv){// arrived
@@ -0,0 +1,11 @@
+#include <iostream>
+#include "aws_cmd.h"
+
+
+#define AWS_CMD "chstat"
+#define AWS_CMD_USAGE "chstat {<chan name> | n <chan id> | on | off | reset | rank [<file>]}"
+
+int main(int argc, char ** argv)
+{
+  return aws_cmd(argc, argv, AWS_CMD);
+}
@@ -0,0 +1,11 @@
+#include <iostream>
+#include "aws_cmd.h"
+
+
+#define AWS_CMD "fprof"
+#define AWS_CMD_USAGE "fprof {<filter name> | n <filter id> | reset | off | {csv | json} <file> <sec>}"
+
+int main(int argc, char ** argv)
+{
+  return aws_cmd(argc, argv, AWS_CMD);
+}
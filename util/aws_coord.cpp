@@ -20,6 +20,12 @@ using namespace std;
 #include <opencv2/opencv.hpp>
 using namespace cv;
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "aws_coord.h"
 
 void bihtoecef(const float lat, const float lon, const float alt, 
@@ -602,3 +608,130 @@ void trans(Mat & Mtrn, Point3d & Xwrld, Point2d & Xview)
 	Xview.y *= s;
 }
 
+
+///////////////////////////////////////////////////////// batch transformations
+void getwrldrot(const double lat, const double lon, s_rot3 & Rwrld)
+{
+	// same as getwrldrot(lat, lon, Mat&), Rz(pi/2) Ry(pi/2 - lat) Rz(lon)
+	double slat = sin(lat), clat = cos(lat);
+	double slon = sin(lon), clon = cos(lon);
+	double * r = Rwrld.r;
+	r[0] = -slon;		r[1] = clon;		r[2] = 0;
+	r[3] = -slat * clon;	r[4] = -slat * slon;	r[5] = clat;
+	r[6] = clat * clon;	r[7] = clat * slon;	r[8] = slat;
+}
+
+void bihtoecef(const double * lat, const double * lon, const double * alt,
+	double * x, double * y, double * z, const size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		double slat = sin(lat[i]);
+		double clat = cos(lat[i]);
+		double slon = sin(lon[i]);
+		double clon = cos(lon[i]);
+		double h = (alt ? alt[i] : 0.);
+		double N = AE / sqrt(1 - EE2 * slat * slat);
+
+		double tmp = (N + h) * clat;
+		x[i] = tmp * clon;
+		y[i] = tmp * slon;
+		z[i] = (N * (1 - EE2) + h) * slat;
+	}
+}
+
+// The same formula as eceftobih(double...), but sin/cos of the parametric
+// latitude and of the latitude are derived from the arguments of atan and 
+// atan2, leaving only two atan2 per point.
+void eceftobih(const double * x, const double * y, const double * z,
+	double * lat, double * lon, double * alt, const size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		double xi = x[i], yi = y[i], zi = z[i];
+		double p = sqrt(xi * xi + yi * yi);
+		double u = zi * AE, v = p * BE;
+		double r = 1. / sqrt(u * u + v * v);
+		double s = u * r;
+		double c = v * r;
+		s = s * s * s;
+		c = c * c * c;
+		double num = zi + EE2_B * s;
+		double den = p - EE2_A * c;
+		double h = sqrt(num * num + den * den);
+		double slat = num / h;
+		lat[i] = atan2(num, den);
+		lon[i] = atan2(yi, xi);
+		if (alt)
+			alt[i] = p * h / den - AE / sqrt(1 - EE2 * slat * slat);
+	}
+}
+
+// out = M (in - a) + b for n points. 
+static void affine3(const double * m, const double * a, const double * b,
+	const double * xi, const double * yi, const double * zi,
+	double * xo, double * yo, double * zo, const size_t n)
+{
+	size_t i = 0;
+#if defined(__AVX__)
+	__m256d m0 = _mm256_set1_pd(m[0]), m1 = _mm256_set1_pd(m[1]), m2 = _mm256_set1_pd(m[2]);
+	__m256d m3 = _mm256_set1_pd(m[3]), m4 = _mm256_set1_pd(m[4]), m5 = _mm256_set1_pd(m[5]);
+	__m256d m6 = _mm256_set1_pd(m[6]), m7 = _mm256_set1_pd(m[7]), m8 = _mm256_set1_pd(m[8]);
+	__m256d ax = _mm256_set1_pd(a[0]), ay = _mm256_set1_pd(a[1]), az = _mm256_set1_pd(a[2]);
+	__m256d bx = _mm256_set1_pd(b[0]), by = _mm256_set1_pd(b[1]), bz = _mm256_set1_pd(b[2]);
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_sub_pd(_mm256_loadu_pd(xi + i), ax);
+		__m256d y = _mm256_sub_pd(_mm256_loadu_pd(yi + i), ay);
+		__m256d z = _mm256_sub_pd(_mm256_loadu_pd(zi + i), az);
+		__m256d u = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m0, x), _mm256_mul_pd(m1, y)), _mm256_mul_pd(m2, z));
+		__m256d v = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m3, x), _mm256_mul_pd(m4, y)), _mm256_mul_pd(m5, z));
+		__m256d w = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m6, x), _mm256_mul_pd(m7, y)), _mm256_mul_pd(m8, z));
+		_mm256_storeu_pd(xo + i, _mm256_add_pd(u, bx));
+		_mm256_storeu_pd(yo + i, _mm256_add_pd(v, by));
+		_mm256_storeu_pd(zo + i, _mm256_add_pd(w, bz));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	float64x2_t m0 = vdupq_n_f64(m[0]), m1 = vdupq_n_f64(m[1]), m2 = vdupq_n_f64(m[2]);
+	float64x2_t m3 = vdupq_n_f64(m[3]), m4 = vdupq_n_f64(m[4]), m5 = vdupq_n_f64(m[5]);
+	float64x2_t m6 = vdupq_n_f64(m[6]), m7 = vdupq_n_f64(m[7]), m8 = vdupq_n_f64(m[8]);
+	float64x2_t ax = vdupq_n_f64(a[0]), ay = vdupq_n_f64(a[1]), az = vdupq_n_f64(a[2]);
+	float64x2_t bx = vdupq_n_f64(b[0]), by = vdupq_n_f64(b[1]), bz = vdupq_n_f64(b[2]);
+	for (; i + 2 <= n; i += 2) {
+		float64x2_t x = vsubq_f64(vld1q_f64(xi + i), ax);
+		float64x2_t y = vsubq_f64(vld1q_f64(yi + i), ay);
+		float64x2_t z = vsubq_f64(vld1q_f64(zi + i), az);
+		float64x2_t u = vfmaq_f64(vfmaq_f64(vfmaq_f64(bx, m0, x), m1, y), m2, z);
+		float64x2_t v = vfmaq_f64(vfmaq_f64(vfmaq_f64(by, m3, x), m4, y), m5, z);
+		float64x2_t w = vfmaq_f64(vfmaq_f64(vfmaq_f64(bz, m6, x), m7, y), m8, z);
+		vst1q_f64(xo + i, u);
+		vst1q_f64(yo + i, v);
+		vst1q_f64(zo + i, w);
+	}
+#endif
+	for (; i < n; i++) {
+		double x = xi[i] - a[0], y = yi[i] - a[1], z = zi[i] - a[2];
+		xo[i] = m[0] * x + m[1] * y + m[2] * z + b[0];
+		yo[i] = m[3] * x + m[4] * y + m[5] * z + b[1];
+		zo[i] = m[6] * x + m[7] * y + m[8] * z + b[2];
+	}
+}
+
+void eceftowrld(const s_rot3 & Rrot,
+	const double xorg, const double yorg, const double zorg,
+	const double * xecef, const double * yecef, const double * zecef,
+	double * xwrld, double * ywrld, double * zwrld, const size_t n)
+{
+	const double org[3] = { xorg, yorg, zorg };
+	const double zero[3] = { 0., 0., 0. };
+	affine3(Rrot.r, org, zero, xecef, yecef, zecef, xwrld, ywrld, zwrld, n);
+}
+
+void wrldtoecef(const s_rot3 & Rrot,
+	const double xorg, const double yorg, const double zorg,
+	const double * xwrld, const double * ywrld, const double * zwrld,
+	double * xecef, double * yecef, double * zecef, const size_t n)
+{
+	const double * r = Rrot.r;
+	const double rt[9] = { r[0], r[3], r[6], r[1], r[4], r[7], r[2], r[5], r[8] };
+	const double org[3] = { xorg, yorg, zorg };
+	const double zero[3] = { 0., 0., 0. };
+	affine3(rt, zero, org, xwrld, ywrld, zwrld, xecef, yecef, zecef, n);
+}
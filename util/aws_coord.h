@@ -62,6 +62,43 @@ void eceftowrld(const Mat & Rrot,
 void getwrldrot(const float lat, const float lon, Mat & Rwrld);
 void getwrldrot(const double lat, const double lon, Mat & Rwrld);
 
+// s_rot3 is a 3x3 rotation matrix in row major order. Used in the batch
+// transformations below instead of Mat.
+struct s_rot3{
+	double r[9];
+	s_rot3(){
+		for(int i = 0; i < 9; i++)
+			r[i] = (i % 4 == 0 ? 1. : 0.);
+	}
+
+	// R should be 3x3 CV_64FC1 (as given by getwrldrot)
+	s_rot3(const Mat & R){
+		const double * ptr = R.ptr<double>();
+		for(int i = 0; i < 9; i++)
+			r[i] = ptr[i];
+	}
+};
+
+void getwrldrot(const double lat, const double lon, s_rot3 & Rwrld);
+
+// Batch transformations of n points given in arrays (structure of arrays).
+// The rotations are vectorized with AVX or NEON if the compiler targets 
+// them, and the others are written to be vectorized by the compiler
+// except for the trigonometric functions. Output arrays can be the same 
+// as the input arrays. alt can be NULL for zero altitude.
+void bihtoecef(const double * lat, const double * lon, const double * alt,
+	double * x, double * y, double * z, const size_t n);
+void eceftobih(const double * x, const double * y, const double * z,
+	double * lat, double * lon, double * alt, const size_t n);
+void eceftowrld(const s_rot3 & Rrot,
+	const double xorg, const double yorg, const double zorg,
+	const double * xecef, const double * yecef, const double * zecef,
+	double * xwrld, double * ywrld, double * zwrld, const size_t n);
+void wrldtoecef(const s_rot3 & Rrot,
+	const double xorg, const double yorg, const double zorg,
+	const double * xwrld, const double * ywrld, const double * zwrld,
+	double * xecef, double * yecef, double * zecef, const size_t n);
+
 void bihtoecef(const s_bihpos & Xbih, Point3d & Xecef);
 void eceftobih(Mat & Xecef, Mat & Xbih);
 void bihtowrld(Point3d & Xorg, Mat & Xrot, s_bihpos & Xbih, Point3d & Xwrld);
@@ -19,6 +19,7 @@
 #include <list>
 #include <cmath>
 #include <fstream>
+#include <algorithm>
 
 using namespace std;
 
@@ -27,6 +28,8 @@ using namespace cv;
 
 #include "aws_coord.h"
 #include "aws_stdlib.h"
+#include "aws_thread.h"
+#include "c_log_map.h"
 #include "aws_map.h"
 
 
@@ -206,6 +209,123 @@ namespace AWSMap2 {
 		return lt_undef;
 	}
 
+	////////////////////////////////////////////////////////////// MapLoader
+	MapLoader::MapLoader() :th(NULL), bexit(true), maxQueue(64)
+	{
+	}
+
+	MapLoader::~MapLoader()
+	{
+		stop();
+		for (auto itr = done.begin(); itr != done.end(); itr++) {
+			delete (*itr)->index;
+			delete (*itr)->layerData;
+			delete (*itr);
+		}
+		done.clear();
+	}
+
+	bool MapLoader::start(const unsigned int _maxQueue)
+	{
+		if (th)
+			return false;
+		maxQueue = _maxQueue;
+		bexit = false;
+		th = new thread(sloader, this);
+		return true;
+	}
+
+	void MapLoader::stop()
+	{
+		if (!th)
+			return;
+		{
+			unique_lock<mutex> lock(mtx);
+			bexit = true;
+		}
+		cnd.notify_all();
+		th->join();
+		delete th;
+		th = NULL;
+
+		// the requests not processed are returned without results
+		// so that the requester can clear pending flags.
+		done.insert(done.end(), queue.begin(), queue.end());
+		queue.clear();
+	}
+
+	bool MapLoader::push(LoadRequest * req)
+	{
+		{
+			unique_lock<mutex> lock(mtx);
+			if (!th || queue.size() >= maxQueue)
+				return false;
+			queue.push_back(req);
+		}
+		cnd.notify_one();
+		return true;
+	}
+
+	bool MapLoader::pop(LoadRequest *& req)
+	{
+		unique_lock<mutex> lock(mtx);
+		if (done.empty())
+			return false;
+		req = done.front();
+		done.pop_front();
+		return true;
+	}
+
+	unsigned int MapLoader::getNumPending()
+	{
+		unique_lock<mutex> lock(mtx);
+		return (unsigned int)(queue.size() + done.size());
+	}
+
+	void MapLoader::sloader(MapLoader * ptr)
+	{
+		ptr->loader();
+	}
+
+	void MapLoader::loader()
+	{
+		while (1) {
+			LoadRequest * req = NULL;
+			{
+				unique_lock<mutex> lock(mtx);
+				cnd.wait(lock, [this] {return !queue.empty() || bexit; });
+				if (bexit)
+					break;
+				// the request stays in the queue until processed
+				req = queue.front();
+			}
+
+#ifdef _AWS_MAP_DEBUG
+			cout << "Loading (background) " << req->fname << endl;
+#endif
+			if (req->layerType == lt_undef) {
+				NodeIndex * index = new NodeIndex;
+				if (Node::loadIndex(req->fname, *index))
+					req->index = index;
+				else
+					delete index;
+			}
+			else {
+				LayerData * layerData = LayerData::create(req->layerType);
+				if (layerData && layerData->loadFile(req->fname))
+					req->layerData = layerData;
+				else
+					delete layerData;
+			}
+
+			{
+				unique_lock<mutex> lock(mtx);
+				queue.pop_front();
+				done.push_back(req);
+			}
+		}
+	}
+
 	////////////////////////////////////////////////////////////// MapDataBase
 	unsigned int MapDataBase::maxSizeLayerData[lt_undef] =
 	{
@@ -215,6 +335,7 @@ namespace AWSMap2 {
 	unsigned int MapDataBase::maxTotalSizeLayerData = 0x4FFFFF0;
 
 	char * MapDataBase::path = NULL;
+	mutex MapDataBase::mtx;
 
 	void MapDataBase::setPath(const char * _path)
 	{
@@ -240,12 +361,101 @@ namespace AWSMap2 {
   
   MapDataBase::~MapDataBase()
   {
+    stopLoader();
     for (int i = 0; i < 20; i++)
       delete pNodes[i];
   }
 
+  bool MapDataBase::startLoader(const unsigned int maxQueue)
+  {
+    return loader.start(maxQueue);
+  }
+
+  void MapDataBase::stopLoader()
+  {
+    if (!loader.isRunning())
+      return;
+    loader.stop();
+    installLoaded();
+  }
+
+  bool MapDataBase::requestLoad(Node * pNodeUp, const unsigned char idChild,
+				const LayerType layerType)
+  {
+    LoadRequest * req = new LoadRequest;
+    list<unsigned char> path_id;
+    pNodeUp->getPath(path_id);
+    req->path_id.assign(path_id.begin(), path_id.end());
+    req->layerType = layerType;
+
+    char path[2048];
+    pNodeUp->getPath(path, 2048);
+    if (layerType == lt_undef) {
+      req->path_id.push_back(idChild);
+      snprintf(req->fname, MAX_PATH_LEN, "%s/N%02d/N%02d.index", path, (int)idChild, (int)idChild);
+    }
+    else {
+      snprintf(req->fname, MAX_PATH_LEN, "%s/%s.dat", path, strLayerType[layerType]);
+    }
+
+    if (!loader.push(req)) {
+      delete req;
+      return false;
+    }
+    return true;
+  }
+
+  Node * MapDataBase::findNode(const vector<unsigned char> & path_id,
+			       const size_t len)
+  {
+    if (len == 0 || path_id[0] >= 20)
+      return NULL;
+
+    Node * pNode = pNodes[path_id[0]];
+    for (size_t i = 1; i < len && pNode != NULL; i++) {
+      if (!pNode->bdownLink || path_id[i] >= 4)
+	return NULL;
+      pNode = pNode->downLink[path_id[i]];
+    }
+    return pNode;
+  }
+
+  int MapDataBase::installLoaded()
+  {
+    unique_lock<mutex> lock(mtx);
+    return _installLoaded();
+  }
+
+  int MapDataBase::_installLoaded()
+  {
+    int ninstalled = 0;
+    LoadRequest * req;
+    while (loader.pop(req)) {
+      if (req->layerType == lt_undef) {
+	Node * pNodeUp = findNode(req->path_id, req->path_id.size() - 1);
+	if (pNodeUp) {
+	  if (pNodeUp->installDownLink(req->path_id.back(), req->index))
+	    ninstalled++;
+	}
+      }
+      else {
+	Node * pNode = findNode(req->path_id, req->path_id.size());
+	if (pNode && pNode->installLayerData(req->layerType, req->layerData)) {
+	  req->layerData = NULL;
+	  ninstalled++;
+	}
+      }
+
+      delete req->index;
+      delete req->layerData;
+      delete req;
+    }
+    return ninstalled;
+  }
+
   bool MapDataBase::init()
   {
+    unique_lock<mutex> lock(mtx);
     bool bloaded = true;
     for (unsigned int id = 0; id < 20; id++){
       pNodes[id] = Node::load(NULL, id);
@@ -314,18 +524,123 @@ namespace AWSMap2 {
     return true;
   }
   
-  void MapDataBase::request(list<list<LayerDataPtr>> & layerDatum, const list<LayerType> & layerTypes,
+  int MapDataBase::request(list<list<LayerDataPtr>> & layerDatum, const list<LayerType> & layerTypes,
 	  const vec3 & center, const float radius, const float resolution)
   {
+	  unique_lock<mutex> lock(mtx);
+	  MapDataBase * pdb = NULL;
+	  if (loader.isRunning()) {
+		  _installLoaded();
+		  pdb = this;
+	  }
+
+	  bool bcomplete = true;
+	  for (int iface = 0; iface < 20; iface++)
+	  {
+		  bcomplete &= pNodes[iface]->getLayerData(layerDatum, layerTypes,
+			  center, radius, resolution, pdb);
+	  }
+
+	  if (bcomplete)
+		  return 0;
+	  return max((int)loader.getNumPending(), 1);
+  }
+
+  int MapDataBase::prefetch(const list<LayerType> & layerTypes,
+	  const vec3 & center, const float radius, const float resolution)
+  {
+	  if (!loader.isRunning())
+		  return 0;
+
+	  unique_lock<mutex> lock(mtx);
+	  _installLoaded();
 	  for (int iface = 0; iface < 20; iface++)
 	  {
-		  pNodes[iface]->getLayerData(layerDatum, layerTypes,
-			  center, radius, resolution);
+		  pNodes[iface]->prefetch(this, layerTypes, center, radius, resolution);
 	  }
+	  return (int)loader.getNumPending();
+  }
+
+  bool MapDataBase::nearestCoastLine(const vec3 & pt, const float radius,
+	  CoastLineHit & hit, const float resolution)
+  {
+	  list<list<LayerDataPtr>> layerDatum(1);
+	  list<LayerType> layerTypes(1, lt_coast_line);
+	  request(layerDatum, layerTypes, pt, radius, resolution);
+
+	  bool bfound = false;
+	  double dmax = radius;
+	  const list<LayerDataPtr> & cls = layerDatum.front();
+	  for (auto itr = cls.begin(); itr != cls.end(); itr++) {
+		  const CoastLine & cl = dynamic_cast<const CoastLine&>(**itr);
+		  if (cl.nearest(pt, hit, dmax)) {
+			  dmax = hit.dist;
+			  bfound = true;
+		  }
+	  }
+	  return bfound;
+  }
+
+  int MapDataBase::nearestCoastLine(const vec3 & pt, const float radius,
+	  const unsigned int k, vector<CoastLineHit> & hits, const float resolution)
+  {
+	  list<list<LayerDataPtr>> layerDatum(1);
+	  list<LayerType> layerTypes(1, lt_coast_line);
+	  request(layerDatum, layerTypes, pt, radius, resolution);
+
+	  hits.clear();
+	  if (k == 0)
+		  return 0;
+
+	  // the buffers are reused over the coast lines (at most k hits each)
+	  vector<CoastLineHit> hits_cl, hits_merged;
+	  hits_cl.reserve(k);
+	  hits_merged.reserve(2 * k);
+	  hits.reserve(2 * k);
+	  const list<LayerDataPtr> & cls = layerDatum.front();
+	  for (auto itr = cls.begin(); itr != cls.end(); itr++) {
+		  const CoastLine & cl = dynamic_cast<const CoastLine&>(**itr);
+		  double dmax = (hits.size() == k ? hits.back().dist : radius);
+		  if (cl.nearest(pt, k, hits_cl, dmax) == 0)
+			  continue;
+
+		  // merge the sorted lists keeping k nearest
+		  hits_merged.resize(hits.size() + hits_cl.size());
+		  merge(hits.begin(), hits.end(), hits_cl.begin(), hits_cl.end(), hits_merged.begin(),
+			  [](const CoastLineHit & l, const CoastLineHit & r) { return l.dist < r.dist; });
+		  if (hits_merged.size() > k)
+			  hits_merged.resize(k);
+		  hits.swap(hits_merged);
+	  }
+	  return (int)hits.size();
+  }
+
+  bool MapDataBase::intersectCoastLine(const vec3 & p0, const vec3 & p1,
+	  const float width, CoastLineHit & hit, const float resolution)
+  {
+	  vec3 center = (p0 + p1) * 0.5;
+	  float radius = (float)(0.5 * l2Norm(p0, p1) + width);
+
+	  list<list<LayerDataPtr>> layerDatum(1);
+	  list<LayerType> layerTypes(1, lt_coast_line);
+	  request(layerDatum, layerTypes, center, radius, resolution);
+
+	  bool bfound = false;
+	  const list<LayerDataPtr> & cls = layerDatum.front();
+	  for (auto itr = cls.begin(); itr != cls.end(); itr++) {
+		  const CoastLine & cl = dynamic_cast<const CoastLine&>(**itr);
+		  CoastLineHit h;
+		  if (cl.intersect(p0, p1, width, h) && (!bfound || h.t < hit.t)) {
+			  hit = h;
+			  bfound = true;
+		  }
+	  }
+	  return bfound;
   }
 
   bool MapDataBase::insert(const LayerData * layerData)
   {
+    unique_lock<mutex> lock(mtx);
     list<Node*> nodes;
     for (int iface = 0; iface < 20; iface++){
       if (!pNodes[iface]->collision(layerData->center(), layerData->radius()))
@@ -343,7 +658,10 @@ namespace AWSMap2 {
 			return false;
 		}
 
+		unique_lock<mutex> lock(mtx);
 		Node * pNode = layerData->getNode();
+		if (!pNode)
+			return false; // already erased
 
 		pNode->deleteLayerData(layerData);
 
@@ -352,12 +670,14 @@ namespace AWSMap2 {
 
 	void MapDataBase::restruct()
 	{
+		unique_lock<mutex> lock(mtx);
 		LayerData::restruct();
 		Node::restruct();
 	}
 
 	bool MapDataBase::save()
 	{
+	  unique_lock<mutex> lock(mtx);
 	  bool result = true;
 	  for (int iface = 0; iface < 20; iface++){
 	    result &= pNodes[iface]->save();
@@ -366,6 +686,17 @@ namespace AWSMap2 {
 	  return result;
 	}
 
+	bool MapDataBase::convert()
+	{
+	  unique_lock<mutex> lock(mtx);
+	  bool result = true;
+	  for (int iface = 0; iface < 20; iface++){
+	    result &= pNodes[iface]->convert();
+	  }
+
+	  return result;
+	}
+
 	///////////////////////////////////////////////////////////////////// Node
 	Node * Node::head = NULL;
 	Node * Node::tail = NULL;
@@ -477,8 +808,7 @@ namespace AWSMap2 {
     auto itr = layerDataList.find(layerData->getLayerType());
     if (itr == layerDataList.end())
       return false;
-    itr->second->release();
-    delete itr->second;
+    LayerData::detach(itr->second);
     
     layerDataList.erase(itr);
     return true;
@@ -493,13 +823,13 @@ namespace AWSMap2 {
 		layerDataList.clear();
 	}
 
-Node::Node() : prev(NULL), next(NULL), level(0), upLink(NULL), bdownLink(false), bupdate(false), refcount(0)
+Node::Node() : prev(NULL), next(NULL), level(0), upLink(NULL), bdownLink(false), pendingDownLink(0), bupdate(false), refcount(0)
 {
 	downLink[0] = downLink[1] = downLink[2] = downLink[3] = NULL;
 }
 
 Node::Node(const unsigned char _id, Node * _upLink, const vec2 vtx_bih0, const vec2 vtx_bih1, const vec2 vtx_bih2) : prev(NULL), next(NULL), id(_id), upLink(_upLink),
-bupdate(true), refcount(0), bdownLink(false)
+bupdate(true), refcount(0), bdownLink(false), pendingDownLink(0)
 {
 		downLink[0] = downLink[1] = downLink[2] = downLink[3] = NULL;
 		vtx_bih[0] = vtx_bih0;
@@ -528,11 +858,11 @@ Node::~Node()
 	save();
 
 	for (auto itr = layerDataList.begin(); itr != layerDataList.end(); itr++){
-		itr->second->setNode(NULL);
-		if (!itr->second->isLocked()) {
-			itr->second->release();
-			delete itr->second;
-		}
+		LayerData * p = itr->second;
+		if (!p->isLocked())
+			p->release();
+		// unlinked from the list before the last holder deletes it
+		LayerData::detach(p);
 	}
 
 	for (int i = 0; i < 4; i++) {
@@ -608,6 +938,42 @@ bool Node::save()
 	  bupdate = false;
   return result;
 }
+
+bool Node::convert()
+{
+  bool result = true;
+
+  // locked not to be released in restruct() while visiting the downlinks
+  lock();
+  for (auto itr = layerDataList.begin(); itr != layerDataList.end();
+       itr++){
+    LayerData * pLayerData = itr->second;
+    bool bactive = pLayerData->isActive();
+    if (!bactive && !pLayerData->load()){
+      result = false;
+      continue;
+    }
+
+    if (pLayerData->isLegacy()){
+      pLayerData->setUpdate();
+      result &= pLayerData->save();
+    }
+
+    if (!bactive)
+      pLayerData->release();
+  }
+
+  if (bdownLink){
+    for (int idown = 0; idown < 4; idown++){
+      if (!downLink[idown])
+	downLink[idown] = Node::load(this, idown);
+      if (downLink[idown])
+	result &= downLink[idown]->convert();
+    }
+  }
+  unlock();
+  return result;
+}
   
 Node * Node::load(Node * pNodeUp, unsigned int idChild)
 {
@@ -630,34 +996,55 @@ Node * Node::load(Node * pNodeUp, unsigned int idChild)
   cout << "Loading " << fname << endl;
 #endif
 
+  NodeIndex index;
+  if (!loadIndex(fname, index))
+    return NULL;
+
+  return build(pNodeUp, idChild, index);
+}
+
+bool Node::loadIndex(const char * fname, NodeIndex & index)
+{
   ifstream findex(fname, ios::binary);
   if (!findex.is_open()){
-    return NULL;
+    return false;
   }
-  
+
+  findex.read((char*)&(index.bdownLink), sizeof(bool));
+  findex.read((char*)(index.vtx_bih), sizeof(vec2) * 3);
+
+  unsigned int num_layer_datum = 0;
+  findex.read((char*)(&num_layer_datum), sizeof(unsigned int));
+
+  index.layerTypes.clear();
+  while (!findex.eof() && num_layer_datum != 0){
+    LayerType layerType;
+    findex.read((char*)&layerType, sizeof(LayerType));
+    index.layerTypes.push_back(layerType);
+    num_layer_datum--;
+  }
+  return true;
+}
+
+Node * Node::build(Node * pNodeUp, unsigned int idChild, const NodeIndex & index)
+{
   Node * pNode = new Node();
   pNode->upLink = pNodeUp;
   pNode->id = idChild;
   if (pNodeUp)
 	  pNode->level = pNodeUp->level + 1;
 
-  ////////////////////// loading index file to the Node
-  findex.read((char*)&(pNode->bdownLink), sizeof(bool));
-  findex.read((char*)(pNode->vtx_bih), sizeof(vec2) * 3);
+  pNode->bdownLink = index.bdownLink;
+  for (int i = 0; i < 3; i++)
+    pNode->vtx_bih[i] = index.vtx_bih[i];
   pNode->calc_ecef();
 
-  unsigned int num_layer_datum = 0;
-  findex.read((char*)(&num_layer_datum), sizeof(unsigned int));
-  
-  while (!findex.eof() && num_layer_datum != 0){
-    LayerType layerType;
-    findex.read((char*)&layerType, sizeof(LayerType));
-    LayerData * layerData = LayerData::create(layerType);
+  for (auto itr = index.layerTypes.begin(); itr != index.layerTypes.end(); itr++){
+    LayerData * layerData = LayerData::create(*itr);
     if (layerData){
       layerData->setNode(pNode);
       pNode->insertLayerData(layerData);
     }
-    num_layer_datum--;
   }
 
   pNode->bupdate = false;
@@ -665,6 +1052,19 @@ Node * Node::load(Node * pNodeUp, unsigned int idChild)
   Node::insert(pNode);
   return pNode;
 }
+
+bool Node::installDownLink(const unsigned int idChild, const NodeIndex * index)
+{
+  pendingDownLink &= ~(1 << idChild);
+  if (!index || !bdownLink || downLink[idChild])
+    return false;
+
+  // locked not to be released in restruct() invoked in insert()
+  lock();
+  downLink[idChild] = build(this, idChild, *index);
+  unlock();
+  return true;
+}
   
 bool Node::createDownLink()
 {
@@ -748,6 +1148,30 @@ const bool Node::collision(const vec3 & center, const float radius)
 	return det_collision_tri_and_sphere(vtx_ecef[0], vtx_ecef[1], vtx_ecef[2], center, radius * radius);
 }
 
+const bool Node::collision(const unsigned int idChild, const vec3 & center, const float radius)
+{
+	// the same vertices as those createDownLink() gives.
+	vec3 vtx_mid[3];
+	for (int i = 0; i < 3; i++) {
+		vec3 m = (vtx_ecef[i] + vtx_ecef[(i + 1) % 3]) * 0.5;
+		double lat, lon, alt;
+		eceftobih(m.x, m.y, m.z, lat, lon, alt);
+		bihtoecef(lat, lon, 0., vtx_mid[i].x, vtx_mid[i].y, vtx_mid[i].z);
+	}
+
+	switch (idChild) {
+	case 0:
+		return det_collision_tri_and_sphere(vtx_ecef[0], vtx_mid[2], vtx_mid[0], center, radius * radius);
+	case 1:
+		return det_collision_tri_and_sphere(vtx_ecef[1], vtx_mid[0], vtx_mid[1], center, radius * radius);
+	case 2:
+		return det_collision_tri_and_sphere(vtx_ecef[2], vtx_mid[1], vtx_mid[2], center, radius * radius);
+	case 3:
+		return det_collision_tri_and_sphere(vtx_mid[0], vtx_mid[2], vtx_mid[1], center, radius * radius);
+	}
+	return false;
+}
+
 const void Node::collision_downlink(const vector<vec3> & pts, vector<char> & inodes)
 {
 	if (!bdownLink)
@@ -789,91 +1213,173 @@ const void Node::collision_downlink(const vector<vec3> & pts, vector<char> & ino
 // return layer datum corresponding to layer types specified as a list of LayerType,
 // datum with the largest resolutions less than the resolution specified are selected.
 // If there is no data satisfying the constraint of the resolution, null data is returned.
-  void Node::getLayerData(
+// When pdb is given, data not resident are requested to the loader, and the
+// coarser data in the upper node is returned instead if exists.
+  bool Node::getLayerData(
 				list<list<LayerDataPtr>> & layerData,
 				const list<LayerType> & layerType, 
 				const vec3 & center, const float radius,
-				const float resolution)
+				const float resolution, MapDataBase * pdb)
   {
     
     if (!collision(center, radius))
-      return;
+      return true;
 
     if (layerData.size() != layerType.size()){
       layerData.resize(layerType.size());
     }
 
-	list<bool> filled(layerType.size(), false);
+	bool bcomplete = true;
 	list<LayerType> detailedLayerType; 
+	list<list<LayerDataPtr>*> detailedDst; // destination of the detailed data
+	list<LayerData*> coarseData;	// data in this node for the detailed types
 	{
 		auto itrData = layerData.begin();
 		auto itrType = layerType.begin();
-		auto itrFilled = filled.begin();
 		for (; itrData != layerData.end(); itrData++, itrType++) {
-			LayerData * data = getLayerData(*itrType);
+			LayerData * data = getLayerData(*itrType, pdb);
 			if (!data) {
+				if (pdb && layerDataList.find(*itrType) != layerDataList.end())
+					bcomplete = false; // pending
 				continue;
 			}
 			if (data->resolution() < resolution || !bdownLink) {
 				itrData->push_back(LayerDataPtr(data));
-				(*itrFilled) = true;
 				continue;
 			}
 			detailedLayerType.push_back(*itrType);
+			detailedDst.push_back(&(*itrData));
+			coarseData.push_back(data);
 		}
 		if (detailedLayerType.size() == 0)
-			return;
+			return bcomplete;
 	}
 
     // retrieving more detailed data than this node
-    list<list<LayerDataPtr>> detailedLayerData;
-
-	detailedLayerData.resize(layerType.size());
+    list<list<LayerDataPtr>> detailedLayerData(detailedLayerType.size());
+	bool bcompleteDetailed = true;
     if(bdownLink){
       for (int idown = 0; idown < 4; idown++){
 		  if (downLink[idown] == NULL) {
+			  if (pdb) {
+				  if (!collision(idown, center, radius))
+					  continue;
+				  if (!(pendingDownLink & (1 << idown)) && pdb->requestLoad(this, idown))
+					  pendingDownLink |= (1 << idown);
+				  bcompleteDetailed = false;
+				  continue;
+			  }
 			  downLink[idown] = load(this, idown);
 		  }
-		downLink[idown]->getLayerData(detailedLayerData, detailedLayerType,
-				      center, radius, resolution);
+		bcompleteDetailed &= downLink[idown]->getLayerData(detailedLayerData, detailedLayerType,
+				      center, radius, resolution, pdb);
       }
     }
     
-	auto itrData = layerData.begin();
-	auto itrType = layerType.begin();
-	auto itrFilled = filled.begin();
-
-	auto itrDetailedType = detailedLayerType.begin();
-	auto itrDetailedDatum = detailedLayerData.begin();
-	for (; itrFilled != filled.end(); itrFilled++, itrData++, itrType++) {
-		if (*itrFilled) // data of the type is filled in this layer.
+	auto itrDst = detailedDst.begin();
+	auto itrCoarse = coarseData.begin();
+	for (auto itrDetailedDatum = detailedLayerData.begin();
+		itrDetailedDatum != detailedLayerData.end();
+		itrDetailedDatum++, itrDst++, itrCoarse++) {
+		if (!bcompleteDetailed) {
+			// some of the detailed data are pending.
+			(*itrDst)->push_back(LayerDataPtr(*itrCoarse));
 			continue;
-
-		assert(*itrType == *itrDetailedType);
+		}
 
 		for (auto itrDetailedData = itrDetailedDatum->begin();
 			itrDetailedData != itrDetailedDatum->end(); itrDetailedData++) {
-			itrData->push_back(LayerDataPtr(*itrDetailedData));
+			(*itrDst)->push_back(LayerDataPtr(*itrDetailedData));
 		}
-		itrDetailedDatum++;
-		itrDetailedType++;
 	}
+	return bcomplete && bcompleteDetailed;
+  }
+
+  void Node::prefetch(MapDataBase * pdb, const list<LayerType> & layerType,
+		      const vec3 & center, const float radius,
+		      const float resolution)
+  {
+	  if (!collision(center, radius))
+		  return;
+
+	  // the finer data are fetched after the data in this node is loaded,
+	  // because the resolution of the data is unknown until then.
+	  list<LayerType> detailedLayerType;
+	  for (auto itrType = layerType.begin(); itrType != layerType.end(); itrType++) {
+		  auto itrLayerData = layerDataList.find(*itrType);
+		  if (itrLayerData == layerDataList.end())
+			  continue;
+
+		  LayerData * data = itrLayerData->second;
+		  if (!data->isActive()) {
+			  if (!data->isPending() && pdb->requestLoad(this, 0, *itrType))
+				  data->setPending(true);
+			  continue;
+		  }
+
+		  if (data->resolution() < resolution)
+			  continue;
+		  detailedLayerType.push_back(*itrType);
+	  }
+
+	  if (!bdownLink || detailedLayerType.size() == 0)
+		  return;
+
+	  for (int idown = 0; idown < 4; idown++) {
+		  if (downLink[idown] == NULL) {
+			  if (!collision(idown, center, radius))
+				  continue;
+			  if (!(pendingDownLink & (1 << idown)) && pdb->requestLoad(this, idown))
+				  pendingDownLink |= (1 << idown);
+			  continue;
+		  }
+		  downLink[idown]->prefetch(pdb, detailedLayerType, center, radius, resolution);
+	  }
   }
   
-  LayerData * Node::getLayerData(const LayerType layerType)
+  LayerData * Node::getLayerData(const LayerType layerType, MapDataBase * pdb)
   {
 	auto itrLayerData = layerDataList.find(layerType);
 	if (itrLayerData == layerDataList.end())
 		return NULL;
 	
 	LayerData * layerData = itrLayerData->second;
-	if (!layerData->isActive())
+	if (!layerData->isActive()) {
+		if (pdb) {
+			if (!layerData->isPending() && pdb->requestLoad(this, 0, layerType))
+				layerData->setPending(true);
+			return NULL;
+		}
 		layerData->load();
+	}
 	Node::accessed(this);
 	LayerData::accessed(layerData);
 	return layerData;
   }
 
+  bool Node::installLayerData(const LayerType layerType, LayerData * pLayerData)
+  {
+	  auto itrLayerData = layerDataList.find(layerType);
+	  if (itrLayerData == layerDataList.end())
+		  return false;
+
+	  LayerData * pOld = itrLayerData->second;
+	  pOld->setPending(false);
+	  if (!pLayerData || pOld->isActive() || pOld->isLocked())
+		  return false;
+
+	  // the old instance is empty because it is not active.
+	  delete pOld;
+	  pLayerData->setNode(this);
+	  itrLayerData->second = pLayerData;
+
+	  lock();
+	  pLayerData->setActive();
+	  Node::accessed(this);
+	  unlock();
+	  return true;
+  }
+
   void Node::insertLayerData(LayerData * pLayerData)
   {
 	  layerDataList.insert(pair<LayerType, LayerData*>(pLayerData->getLayerType(), pLayerData));
@@ -914,6 +1420,16 @@ bool Node::addLayerData(const LayerData & layerData,
 		if (!pDstLayerData->isActive())
 			// if the data is not active, activate it by loading.
 			pDstLayerData->load();
+		else if (pDstLayerData->isLocked()) {
+			// the data is held by readers. They keep the current instance,
+			// and the clone is modified and placed in this node.
+			LayerData * pNewLayerData = pDstLayerData->clone();
+			pNewLayerData->setNode(this);
+			LayerData::detach(pDstLayerData);
+			itrDstLayerData->second = pNewLayerData;
+			pNewLayerData->setActive();
+			pDstLayerData = pNewLayerData;
+		}
 	}
 	else {
 		// the layer data object is not in the node, create new one.
@@ -977,7 +1493,11 @@ void LayerData::insert(LayerData * pLayerData)
 		restruct();
 
 	totalSize += (unsigned int) pLayerData->size();
+	append(pLayerData);
+}
 
+void LayerData::append(LayerData * pLayerData)
+{
 	if (head == NULL && tail == NULL){
 		pLayerData->next = pLayerData->prev = NULL;
 		head = tail = pLayerData;
@@ -1015,8 +1535,40 @@ void LayerData::accessed(LayerData * pLayerData)
 	insert(pLayerData);
 }
 
+void LayerData::collectAccessed()
+{
+	LayerData * p = head, * last = tail;
+	while (p != NULL) {
+		LayerData * next = p->next;
+		if (p->baccessed.exchange(false) && p != tail) {
+			pop(p);
+			totalSize += (unsigned int) p->size();
+			append(p);
+		}
+		if (p == last)
+			break;
+		p = next;
+	}
+}
+
+void LayerData::detach(LayerData * pLayerData)
+{
+	if (pLayerData->isActive()) {
+		LayerData::pop(pLayerData);
+		pLayerData->bactive = false;
+	}
+	// the holders may release the instance concurrently. the one who makes
+	// refcount zero deletes it.
+	if (pLayerData->detachNode() == 0)
+		delete pLayerData;
+}
+
 void LayerData::restruct()
 {
+	// accesses through LayerDataPtr are only flagged, then the list is 
+	// reordered here.
+	collectAccessed();
+
 	LayerData * p = head;
 
 	while (totalSize >= MapDataBase::getMaxTotalSizeLayerData() && p != NULL)
@@ -1051,12 +1603,20 @@ bool LayerData::save(){
 #ifdef _AWS_MAP_DEBUG
 	cout << "saving " << fname << endl;
 #endif
-	ofstream ofile(fname, ios::binary);
+	// written to a temporary file and renamed, because the data may be 
+	// mapped from the file being replaced.
+	char fname_tmp[2048];
+	snprintf(fname_tmp, 2048, "%s.tmp", fname);
+	ofstream ofile(fname_tmp, ios::binary);
 	if (!ofile.is_open())
 		return false;
 
 	if (!save(ofile))
 		return false;
+	ofile.close();
+
+	if (rename(fname_tmp, fname) != 0)
+		return false;
 
 	bupdate = false;
 	return true;
@@ -1071,11 +1631,7 @@ bool LayerData::load(){
 #ifdef _AWS_MAP_DEBUG
 	cout << "loading " << fname << endl;
 #endif
-	ifstream ifile(fname, ios::binary);
-	if (!ifile.is_open())
-		return false;
-
-	if (!load(ifile))
+	if (!loadFile(fname))
 		return false;
 
 	bupdate = false;
@@ -1085,6 +1641,15 @@ bool LayerData::load(){
 	return true;
 }
 
+bool LayerData::loadFile(const char * fname)
+{
+	ifstream ifile(fname, ios::binary);
+	if (!ifile.is_open())
+		return false;
+
+	return load(ifile);
+}
+
 void LayerData::release()
 {
 	if (!isActive())
@@ -1131,35 +1696,529 @@ bool LayerData::merge(const LayerData & layerData)
 
 ///////////////////////////////////////////////////////////////////// CoastLine
 
-  const vector<vec3> CoastLine::null_vec_vec3;
-  const vector<vec2> CoastLine::null_vec_vec2;
-  
-  CoastLine::CoastLine() :dist_min(FLT_MAX), total_size(0)
+CoastLine::CoastLine() :dist_min(FLT_MAX), pt_radius(0), pck(NULL), sz_pck(0),
+	pmap(NULL), blegacy(false), hdr(NULL), ofs(NULL),
+	lat(NULL), lon(NULL), x(NULL), y(NULL), z(NULL), len_seg_max(0)
 {
 }
 
 CoastLine::~CoastLine()
 {
+	// instances loaded in the background may be deleted without release()
+	_release();
 }
 
-bool CoastLine::save(ofstream & ofile)
+bool CoastLine::setPack(char * p, const size_t sz)
 {
-	unsigned int nlines = (unsigned int) lines.size();
-	ofile.write((const char*)&nlines, sizeof(unsigned int));
-	for (auto itr = lines.begin(); itr != lines.end(); itr++){
-		vector<vec2> & pts = (*itr)->pts;
-		unsigned int length = (unsigned int) pts.size();
-		ofile.write((const char*)&length, sizeof(unsigned int));
-		for (auto itr_pt = pts.begin(); itr_pt != pts.end(); itr_pt++){	
-			vec2 pt = *itr_pt;
-			ofile.write((const char*)(&pt), sizeof(vec2));
+	if (sz < sizeof(CoastLinePackHeader))
+		return false;
+
+	CoastLinePackHeader * h = (CoastLinePackHeader*)p;
+	if (memcmp(h->magic, COAST_LINE_PACK_MAGIC, 8) != 0 || 
+		h->version != COAST_LINE_PACK_VERSION)
+		return false;
+
+	size_t sz_ofs = sizeof(unsigned long long) * ((size_t)h->nlines + 1);
+	size_t sz_pts = sizeof(double) * 5 * (size_t)h->npts;
+	if (sz != sizeof(CoastLinePackHeader) + sz_ofs + sz_pts)
+		return false;
+
+	const unsigned long long * o = 
+		(const unsigned long long*)(p + sizeof(CoastLinePackHeader));
+	if (o[0] != 0 || o[h->nlines] != h->npts)
+		return false;
+	for (unsigned int iline = 0; iline < h->nlines; iline++)
+		if (o[iline] > o[iline + 1])
+			return false;
+
+	pck = p;
+	sz_pck = sz;
+	hdr = h;
+	ofs = o;
+	lat = (const double*)(p + sizeof(CoastLinePackHeader) + sz_ofs);
+	lon = lat + h->npts;
+	x = lon + h->npts;
+	y = x + h->npts;
+	z = y + h->npts;
+
+	pt_center = vec3(h->center[0], h->center[1], h->center[2]);
+	pt_center_bih = vec2(h->center_bih[0], h->center_bih[1]);
+	pt_radius = h->radius;
+	dist_min = h->dist_min;
+
+	buildIndex();
+	return true;
+}
+
+void CoastLine::releasePack()
+{
+	if (pmap) {
+		delete pmap;
+		pmap = NULL;
+	}
+	else if (pck) {
+		free(pck);
+	}
+
+	pck = NULL;
+	sz_pck = 0;
+	hdr = NULL;
+	ofs = NULL;
+	lat = lon = x = y = z = NULL;
+	bvh.clear();
+	seg.clear();
+	len_seg_max = 0;
+}
+
+void CoastLine::pack()
+{
+	unsigned int nlines = (unsigned int)lines.size();
+	size_t npts = 0;
+	for (unsigned int iline = 0; iline < nlines; iline++)
+		npts += lines[iline]->pts.size();
+
+	size_t sz_ofs = sizeof(unsigned long long) * ((size_t)nlines + 1);
+	size_t sz = sizeof(CoastLinePackHeader) + sz_ofs + sizeof(double) * 5 * npts;
+	char * p = (char*)malloc(sz);
+
+	CoastLinePackHeader * h = (CoastLinePackHeader*)p;
+	memset(h, 0, sizeof(CoastLinePackHeader));
+	memcpy(h->magic, COAST_LINE_PACK_MAGIC, 8);
+	h->version = COAST_LINE_PACK_VERSION;
+	h->nlines = nlines;
+	h->npts = npts;
+	h->center[0] = pt_center.x;
+	h->center[1] = pt_center.y;
+	h->center[2] = pt_center.z;
+	h->center_bih[0] = pt_center_bih.lat;
+	h->center_bih[1] = pt_center_bih.lon;
+	h->radius = pt_radius;
+	h->dist_min = dist_min;
+
+	unsigned long long * o = (unsigned long long*)(p + sizeof(CoastLinePackHeader));
+	double * plat = (double*)(p + sizeof(CoastLinePackHeader) + sz_ofs);
+	double * plon = plat + npts, * px = plon + npts, * py = px + npts, * pz = py + npts;
+	size_t ipt = 0;
+	for (unsigned int iline = 0; iline < nlines; iline++) {
+		o[iline] = ipt;
+		vector<vec2> & pts = lines[iline]->pts;
+		vector<vec3> & pts_ecef = lines[iline]->pts_ecef;
+		for (size_t i = 0; i < pts.size(); i++, ipt++) {
+			plat[ipt] = pts[i].lat;
+			plon[ipt] = pts[i].lon;
+			px[ipt] = pts_ecef[i].x;
+			py[ipt] = pts_ecef[i].y;
+			pz[ipt] = pts_ecef[i].z;
+		}
+		delete lines[iline];
+	}
+	o[nlines] = ipt;
+	lines.clear();
+
+	releasePack();
+	setPack(p, sz);
+}
+
+void CoastLine::getLines(vector<s_line*> & dst) const
+{
+	unsigned int nlines = getNumLines();
+	dst.resize(nlines);
+	for (unsigned int iline = 0; iline < nlines; iline++) {
+		s_line * pline = new s_line;
+		unsigned int ipt0 = getLineBegin(iline), ipt1 = getLineEnd(iline);
+		pline->pts.resize(ipt1 - ipt0);
+		pline->pts_ecef.resize(ipt1 - ipt0);
+		for (unsigned int ipt = ipt0; ipt < ipt1; ipt++) {
+			pline->pts[ipt - ipt0] = vec2(lat[ipt], lon[ipt]);
+			pline->pts_ecef[ipt - ipt0] = vec3(x[ipt], y[ipt], z[ipt]);
+		}
+		dst[iline] = pline;
+	}
+}
+
+void CoastLine::unpack()
+{
+	if (!hdr || lines.size() != 0)
+		return;
+
+	getLines(lines);
+	releasePack();
+}
+
+// squared distance from the point p to the box
+static double distBox2(const vec3 & p, const vec3 & bmin, const vec3 & bmax)
+{
+	double d, d2 = 0;
+	d = (p.x < bmin.x ? bmin.x - p.x : (p.x > bmax.x ? p.x - bmax.x : 0));
+	d2 += d * d;
+	d = (p.y < bmin.y ? bmin.y - p.y : (p.y > bmax.y ? p.y - bmax.y : 0));
+	d2 += d * d;
+	d = (p.z < bmin.z ? bmin.z - p.z : (p.z > bmax.z ? p.z - bmax.z : 0));
+	d2 += d * d;
+	return d2;
+}
+
+// closest point q on the segment a-b from the point p. returns the squared distance.
+static double closestPtSeg(const vec3 & p, const vec3 & a, const vec3 & b, vec3 & q)
+{
+	vec3 ab = b - a;
+	double l2 = dot(ab, ab);
+	double s = (l2 > 0 ? dot(p - a, ab) / l2 : 0);
+	s = min(1.0, max(0.0, s));
+	q = a + ab * s;
+	return l2Norm2(p, q);
+}
+
+// closest points p0 + s (p1 - p0) and q0 + t (q1 - q0) between the segments.
+// returns the squared distance.
+static double closestSegSeg(const vec3 & p0, const vec3 & p1, 
+	const vec3 & q0, const vec3 & q1, double & s, double & t)
+{
+	vec3 d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+	double a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+	if (a <= 0 && e <= 0) {
+		s = t = 0;
+		return dot(r, r);
+	}
+
+	if (a <= 0) {
+		s = 0;
+		t = min(1.0, max(0.0, f / e));
+	}
+	else {
+		double c = dot(d1, r);
+		if (e <= 0) {
+			t = 0;
+			s = min(1.0, max(0.0, -c / a));
+		}
+		else {
+			double b = dot(d1, d2), den = a * e - b * b;
+			s = (den > 0 ? min(1.0, max(0.0, (b * f - c * e) / den)) : 0);
+			t = (b * s + f) / e;
+			if (t < 0) {
+				t = 0;
+				s = min(1.0, max(0.0, -c / a));
+			}
+			else if (t > 1) {
+				t = 1;
+				s = min(1.0, max(0.0, (b - c) / a));
+			}
+		}
+	}
+	return l2Norm2(p0 + d1 * s, q0 + d2 * t);
+}
+
+// clips the segment p0 + s (p1 - p0) (0 <= s <= 1) with the box expanded by
+// margin. returns false if the segment does not pass the box, otherwise 
+// s_in is the parameter the segment enters the box.
+static bool clipSegBox(const vec3 & p0, const vec3 & p1, 
+	const vec3 & bmin, const vec3 & bmax, const double margin, double & s_in)
+{
+	const double o[3] = { p0.x, p0.y, p0.z };
+	const double d[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+	const double lo[3] = { bmin.x - margin, bmin.y - margin, bmin.z - margin };
+	const double hi[3] = { bmax.x + margin, bmax.y + margin, bmax.z + margin };
+	double s0 = 0, s1 = 1;
+	for (int i = 0; i < 3; i++) {
+		if (d[i] == 0) {
+			if (o[i] < lo[i] || o[i] > hi[i])
+				return false;
+			continue;
+		}
+		double ta = (lo[i] - o[i]) / d[i], tb = (hi[i] - o[i]) / d[i];
+		if (ta > tb)
+			swap(ta, tb);
+		s0 = max(s0, ta);
+		s1 = min(s1, tb);
+		if (s0 > s1)
+			return false;
+	}
+	s_in = s0;
+	return true;
+}
+
+void CoastLine::buildIndex()
+{
+	bvh.clear();
+	seg.clear();
+	len_seg_max = 0;
+
+	unsigned int nlines = getNumLines();
+	for (unsigned int iline = 0; iline < nlines; iline++) {
+		unsigned int ipt1 = getLineEnd(iline);
+		for (unsigned int ipt = getLineBegin(iline); ipt + 1 < ipt1; ipt++) {
+			seg.push_back(ipt);
+			len_seg_max = max(len_seg_max, l2Norm(pointECEF(ipt), pointECEF(ipt + 1)));
+		}
+	}
+
+	if (seg.size() == 0)
+		return;
+
+	// top down construction splitting the segments at the median of their
+	// centers along the longest axis.
+	struct s_range {
+		unsigned int inode, first, nseg;
+	};
+	vector<s_range> ranges;
+	bvh.reserve(2 * (seg.size() / COAST_LINE_BVH_LEAF) + 1);
+	bvh.push_back(s_bvh_node());
+	s_range r0 = { 0, 0, (unsigned int)seg.size() };
+	ranges.push_back(r0);
+	while (ranges.size() != 0) {
+		s_range r = ranges.back();
+		ranges.pop_back();
+
+		vec3 bmin(DBL_MAX, DBL_MAX, DBL_MAX), bmax(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+		vec3 cmin = bmin, cmax = bmax;
+		for (unsigned int i = r.first; i < r.first + r.nseg; i++) {
+			unsigned int ipt = seg[i];
+			for (unsigned int j = ipt; j <= ipt + 1; j++) {
+				bmin.x = min(bmin.x, x[j]);
+				bmin.y = min(bmin.y, y[j]);
+				bmin.z = min(bmin.z, z[j]);
+				bmax.x = max(bmax.x, x[j]);
+				bmax.y = max(bmax.y, y[j]);
+				bmax.z = max(bmax.z, z[j]);
+			}
+			vec3 c = (pointECEF(ipt) + pointECEF(ipt + 1)) * 0.5;
+			cmin.x = min(cmin.x, c.x);
+			cmin.y = min(cmin.y, c.y);
+			cmin.z = min(cmin.z, c.z);
+			cmax.x = max(cmax.x, c.x);
+			cmax.y = max(cmax.y, c.y);
+			cmax.z = max(cmax.z, c.z);
+		}
+		bvh[r.inode].bmin = bmin;
+		bvh[r.inode].bmax = bmax;
+
+		if (r.nseg <= COAST_LINE_BVH_LEAF) {
+			bvh[r.inode].first = r.first;
+			bvh[r.inode].nseg = r.nseg;
+			continue;
+		}
+
+		vec3 ext = cmax - cmin;
+		const double * c = (ext.x >= ext.y && ext.x >= ext.z ? x : (ext.y >= ext.z ? y : z));
+		unsigned int mid = r.first + r.nseg / 2;
+		nth_element(seg.begin() + r.first, seg.begin() + mid, seg.begin() + r.first + r.nseg,
+			[c](unsigned int a, unsigned int b) { return c[a] + c[a + 1] < c[b] + c[b + 1]; });
+
+		unsigned int ichild = (unsigned int)bvh.size();
+		bvh.resize(ichild + 2);
+		bvh[r.inode].first = ichild;
+		bvh[r.inode].nseg = 0;
+
+		s_range rl = { ichild, r.first, mid - r.first };
+		s_range rr = { ichild + 1, mid, r.first + r.nseg - mid };
+		ranges.push_back(rl);
+		ranges.push_back(rr);
+	}
+}
+
+unsigned int CoastLine::findLine(const unsigned int ipt) const
+{
+	return (unsigned int)(upper_bound(ofs, ofs + getNumLines() + 1, 
+		(unsigned long long)ipt) - ofs) - 1;
+}
+
+bool CoastLine::nearest(const vec3 & pt, CoastLineHit & hit, const double dmax) const
+{
+	if (bvh.size() == 0)
+		return false;
+
+	double d2best = (dmax == DBL_MAX ? DBL_MAX : dmax * dmax);
+	bool bfound = false;
+
+	// the depth of the tree is bounded by log2 of the number of segments
+	unsigned int stack[64];
+	int nstack = 0;
+	stack[nstack++] = 0;
+	while (nstack > 0) {
+		const s_bvh_node & nd = bvh[stack[--nstack]];
+		if (distBox2(pt, nd.bmin, nd.bmax) > d2best)
+			continue;
+
+		if (nd.nseg == 0) {
+			// the nearer child is visited first
+			double d0 = distBox2(pt, bvh[nd.first].bmin, bvh[nd.first].bmax);
+			double d1 = distBox2(pt, bvh[nd.first + 1].bmin, bvh[nd.first + 1].bmax);
+			stack[nstack++] = (d0 < d1 ? nd.first + 1 : nd.first);
+			stack[nstack++] = (d0 < d1 ? nd.first : nd.first + 1);
+			continue;
+		}
+
+		for (unsigned int i = nd.first; i < nd.first + nd.nseg; i++) {
+			unsigned int ipt = seg[i];
+			vec3 q;
+			double d2 = closestPtSeg(pt, pointECEF(ipt), pointECEF(ipt + 1), q);
+			if (d2 < d2best) {
+				d2best = d2;
+				hit.pt = q;
+				hit.ipt = ipt;
+				bfound = true;
+			}
 		}
 	}
+
+	if (!bfound)
+		return false;
+
+	hit.dist = sqrt(d2best);
+	hit.t = 0;
+	hit.iline = findLine(hit.ipt);
+	return true;
+}
+
+int CoastLine::nearest(const vec3 & pt, const unsigned int k, 
+	vector<CoastLineHit> & hits, const double dmax) const
+{
+	hits.clear();
+	if (bvh.size() == 0 || k == 0)
+		return 0;
+
+	// hits is kept as a max heap of the distance until the end
+	auto closer = [](const CoastLineHit & l, const CoastLineHit & r) { return l.dist < r.dist; };
+	double d2lim = (dmax == DBL_MAX ? DBL_MAX : dmax * dmax);
+
+	unsigned int stack[64];
+	int nstack = 0;
+	stack[nstack++] = 0;
+	while (nstack > 0) {
+		const s_bvh_node & nd = bvh[stack[--nstack]];
+		if (distBox2(pt, nd.bmin, nd.bmax) > d2lim)
+			continue;
+
+		if (nd.nseg == 0) {
+			double d0 = distBox2(pt, bvh[nd.first].bmin, bvh[nd.first].bmax);
+			double d1 = distBox2(pt, bvh[nd.first + 1].bmin, bvh[nd.first + 1].bmax);
+			stack[nstack++] = (d0 < d1 ? nd.first + 1 : nd.first);
+			stack[nstack++] = (d0 < d1 ? nd.first : nd.first + 1);
+			continue;
+		}
+
+		for (unsigned int i = nd.first; i < nd.first + nd.nseg; i++) {
+			unsigned int ipt = seg[i];
+			CoastLineHit h;
+			double d2 = closestPtSeg(pt, pointECEF(ipt), pointECEF(ipt + 1), h.pt);
+			if (d2 >= d2lim)
+				continue;
+
+			h.dist = sqrt(d2);
+			h.ipt = ipt;
+			hits.push_back(h);
+			push_heap(hits.begin(), hits.end(), closer);
+			if (hits.size() > k) {
+				pop_heap(hits.begin(), hits.end(), closer);
+				hits.pop_back();
+			}
+
+			if (hits.size() == k)
+				d2lim = hits.front().dist * hits.front().dist;
+		}
+	}
+
+	sort_heap(hits.begin(), hits.end(), closer);
+	for (auto itr = hits.begin(); itr != hits.end(); itr++)
+		itr->iline = findLine(itr->ipt);
+
+	return (int)hits.size();
+}
+
+bool CoastLine::intersect(const vec3 & p0, const vec3 & p1, const double width,
+	CoastLineHit & hit) const
+{
+	if (bvh.size() == 0)
+		return false;
+
+	// chords of length l are apart from the surface at most l^2/8R
+	double lq2 = l2Norm2(p0, p1);
+	double margin = width + (lq2 + len_seg_max * len_seg_max) / (8.0 * AE);
+	double tbest = DBL_MAX;
+	bool bfound = false;
+
+	unsigned int stack[64];
+	int nstack = 0;
+	stack[nstack++] = 0;
+	while (nstack > 0) {
+		const s_bvh_node & nd = bvh[stack[--nstack]];
+		double s_in;
+		if (!clipSegBox(p0, p1, nd.bmin, nd.bmax, margin, s_in) || s_in > tbest)
+			continue;
+
+		if (nd.nseg == 0) {
+			stack[nstack++] = nd.first + 1;
+			stack[nstack++] = nd.first;
+			continue;
+		}
+
+		for (unsigned int i = nd.first; i < nd.first + nd.nseg; i++) {
+			unsigned int ipt = seg[i];
+			vec3 a = pointECEF(ipt), b = pointECEF(ipt + 1);
+			double s, t;
+			double d2 = closestSegSeg(p0, p1, a, b, s, t);
+			double w = width + (lq2 + l2Norm2(a, b)) / (8.0 * AE);
+			if (d2 > w * w || s > tbest)
+				continue;
+
+			tbest = s;
+			hit.dist = sqrt(d2);
+			hit.t = s;
+			hit.pt = a + (b - a) * t;
+			hit.ipt = ipt;
+			bfound = true;
+		}
+	}
+
+	if (bfound)
+		hit.iline = findLine(hit.ipt);
+	return bfound;
+}
+
+bool CoastLine::save(ofstream & ofile)
+{
+	if (!hdr)
+		pack();
+
+	// the properties might be changed by setCenter() or setRadius() 
+	hdr->center[0] = pt_center.x;
+	hdr->center[1] = pt_center.y;
+	hdr->center[2] = pt_center.z;
+	hdr->radius = pt_radius;
+
+	ofile.write(pck, sz_pck);
+	if (!ofile.good())
+		return false;
+
+	blegacy = false;
 	return true;
 }
 
 bool CoastLine::load(ifstream & ifile)
 {
+	_release();
+
+	char magic[8];
+	ifile.read(magic, 8);
+	if (ifile.gcount() == 8 && memcmp(magic, COAST_LINE_PACK_MAGIC, 8) == 0) {
+		ifile.seekg(0, ios::end);
+		size_t sz = (size_t)ifile.tellg();
+		ifile.seekg(0, ios::beg);
+		char * p = (char*)malloc(sz);
+		ifile.read(p, sz);
+		if (!ifile.good() || !setPack(p, sz)) {
+			free(p);
+			return false;
+		}
+		blegacy = false;
+		return true;
+	}
+
+	// old format: number of lines followed by the length and BIH points of 
+	// each line. ECEF points are calculated here.
+	ifile.clear();
+	ifile.seekg(0, ios::beg);
+
 	unsigned int nlines = 0;
 	ifile.read((char*)&nlines, sizeof(unsigned int));
 	lines.resize(nlines);
@@ -1185,10 +2244,28 @@ bool CoastLine::load(ifstream & ifile)
 	}
 
 	update_properties();
+	blegacy = true;
 
 	return true;
 }
 
+bool CoastLine::loadFile(const char * fname)
+{
+	_release();
+
+	// files in the packed format are mapped and used as they are.
+	pmap = new c_log_map;
+	if (pmap->open(fname) && 
+		setPack(const_cast<char*>(pmap->get_base()), pmap->get_size())) {
+		blegacy = false;
+		return true;
+	}
+	delete pmap;
+	pmap = NULL;
+
+	return LayerData::loadFile(fname);
+}
+
 void CoastLine::print() const
 {
 	char path[2048] = "Not Active";
@@ -1198,7 +2275,7 @@ void CoastLine::print() const
 	cout << "\t pos:" << pt_center_bih.lat * 180. / PI << "," << pt_center_bih.lon * 180. / PI
 		<< " radius:" << radius()
 		<< " mindim:" << dist_min
-		<< " lines:" << lines.size() 
+		<< " lines:" << getNumLines() 
 		<< " size:" << size() << endl;
 }
 
@@ -1209,11 +2286,12 @@ void CoastLine::_release()
 		delete (*itr);
 	}
 	lines.clear();
+	releasePack();
 }
 
 size_t CoastLine::size() const
 {
-	return total_size;
+	return sz_pck;
 }
 
 float CoastLine::resolution() const
@@ -1242,8 +2320,12 @@ bool CoastLine::split(list<Node*> & nodes, Node * pParentNode) const
 		}
 	}
 
-	for (int iline = 0; iline < lines.size(); iline++) {
-		vector<vec3> & pts = lines[iline]->pts_ecef;
+	for (unsigned int iline = 0; iline < getNumLines(); iline++) {
+		unsigned int ipt0 = getLineBegin(iline);
+		vector<vec3> pts(getLineEnd(iline) - ipt0);
+		for (unsigned int ipt = 0; ipt < pts.size(); ipt++)
+			pts[ipt] = vec3(x[ipt0 + ipt], y[ipt0 + ipt], z[ipt0 + ipt]);
+
 		// first find correspondance between points in the line and nodes.
 
 		vector<char> asgnc(pts.size(), -1);
@@ -1277,7 +2359,7 @@ bool CoastLine::split(list<Node*> & nodes, Node * pParentNode) const
 
 				// form new line contains points ipts to ipte.
 				for (int iptl = ipts; iptl < ipte; iptl++) {
-					line_new.push_back(lines[iline]->pts[iptl]);
+					line_new.push_back(vec2(lat[ipt0 + iptl], lon[ipt0 + iptl]));
 				}
 
 				cls[in].add(line_new);
@@ -1296,7 +2378,7 @@ bool CoastLine::split(list<Node*> & nodes, Node * pParentNode) const
 		cls[inode].print();
 		cout << " \tsize: " << cls[inode].size() << endl;
 #endif
-		if (cls[inode].size() > 0)
+		if (cls[inode].getNumLines() > 0)
 			vnodes[inode]->addLayerData(cls[inode], MapDataBase::getMaxSizeLayerData(cls[inode].getLayerType()));
 	}
 
@@ -1473,14 +2555,15 @@ bool CoastLine::_reduce(const size_t sz_lim)
 		return true;
 
 	// calculate nred; the number of points to be reduced
-	unsigned int sz_pts_lim = (unsigned int)(sz_lim);	
-	unsigned int sz_pt = (unsigned int)(sizeof(vec2)+sizeof(vec3));
-	unsigned int npts = 0;
-	for (unsigned int iline = 0; iline < lines.size(); iline++){
-		npts += (unsigned int) lines[iline]->pts.size();
-	}
-
-	unsigned int nred = npts - (sz_pts_lim / sz_pt);
+	size_t sz_fixed = sizeof(CoastLinePackHeader) + 
+		sizeof(unsigned long long) * ((size_t)getNumLines() + 1);
+	size_t sz_pts_lim = (sz_lim > sz_fixed ? sz_lim - sz_fixed : 0);
+	size_t sz_pt = sizeof(double) * 5;
+	unsigned int npts = getNumPoints();
+	unsigned int npts_lim = (unsigned int)(sz_pts_lim / sz_pt);
+	unsigned int nred = (npts > npts_lim ? npts - npts_lim : 0);
+
+	unpack();
 	if (try_reduce(nred) != 0){
 		return false;
 	}
@@ -1494,7 +2577,9 @@ bool CoastLine::_merge(const LayerData & layerData)
 #endif
 	bupdate = true;
 	const CoastLine * src = dynamic_cast<const CoastLine*>(&layerData);
-	const vector<s_line*> & lines_src = src->lines;
+	vector<s_line*> lines_src;
+	src->getLines(lines_src);
+	unpack();
 
 	// this loop finds connection between lines in layerData and this object.
 	for (int iline0 = 0; iline0 < lines_src.size(); iline0++){
@@ -1613,6 +2698,9 @@ bool CoastLine::_merge(const LayerData & layerData)
 		}
 	}
 
+	for (auto itr = lines_src.begin(); itr != lines_src.end(); itr++)
+		delete (*itr);
+
 	// erase null element from lines
 	for (vector<s_line*>::iterator itr = lines.begin(); itr != lines.end();){
 		if (*itr == NULL)
@@ -1635,14 +2723,14 @@ LayerData * CoastLine::clone() const
 	pnew->pNode = NULL;
 	pnew->bupdate = bupdate;
 	pnew->dist_min = dist_min;
-	pnew->total_size = total_size;
-
-	vector<s_line*> & lines_new = pnew->lines;
-	lines_new.resize(lines.size());
-	auto itr_new = lines_new.begin();
-	for (auto itr = lines.begin(); itr != lines.end(); itr++, itr_new++){
-		*itr_new = new s_line;
-		*(*itr_new) = *(*itr);
+	pnew->pt_radius = pt_radius;
+	pnew->pt_center = pt_center;
+	pnew->pt_center_bih = pt_center_bih;
+
+	if (hdr) {
+		char * p = (char*)malloc(sz_pck);
+		memcpy(p, pck, sz_pck);
+		pnew->setPack(p, sz_pck);
 	}
 
 	return pnew;
@@ -1670,7 +2758,6 @@ LayerData * CoastLine::clone() const
 			vec3 & pt1 = pts[i];
 			dist_min = min(dist_min, l2Norm(pt0, pt1));
 		}
-		total_size += pline->size();
 	}
 
 	void CoastLine::update_properties()
@@ -1698,7 +2785,6 @@ LayerData * CoastLine::clone() const
 		eceftobih(pt_center.x, pt_center.y, pt_center.z, pt_center_bih.lat, pt_center_bih.lon, alt);
 		
 
-		total_size = 0;
 		pt_radius = 0;
 		dist_min = DBL_MAX;
 		for (int iline = 0; iline < lines.size(); iline++){
@@ -1711,14 +2797,16 @@ LayerData * CoastLine::clone() const
 				double dist = l2Norm(pt0, pt1);
 				if (dist == 0) {
 					pts.erase(pts.begin() + i);
+					lines[iline]->pts.erase(lines[iline]->pts.begin() + i);
 					i--;
 					continue;
 				}
 				dist_min = min(dist_min, dist);
 				pt_radius = max(pt_radius, l2Norm(pt_center, pts[i]));
 			}
-			total_size += lines[iline]->size();
 		}
+
+		pack();
 	}
 
 	bool CoastLine::loadJPJIS(const char * fname)
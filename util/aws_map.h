@@ -17,6 +17,8 @@
 #define GR 1.61803398875 // golden ratio
 #define _AWS_MAP_DEBUG
 
+class c_log_map;
+
 namespace AWSMap2 {
 
   struct vec3{
@@ -141,10 +143,80 @@ namespace AWSMap2 {
   class Node;
   class LayerData;
   class LayerDataPtr;
+  struct CoastLineHit;
+
+  // contents of a node's index file
+  struct NodeIndex
+  {
+    bool bdownLink;
+    vec2 vtx_bih[3];
+    vector<LayerType> layerTypes;
+  };
+
+  // a request to MapLoader. The target is specified with path_id (top node
+  // id followed by child ids), because the node may be released before
+  // the request completes.
+  struct LoadRequest
+  {
+    vector<unsigned char> path_id;
+    LayerType layerType;		// lt_undef for the node index
+    char fname[MAX_PATH_LEN];
+    NodeIndex * index;			// result for the node index
+    LayerData * layerData;		// result for the layer data
+  LoadRequest() :layerType(lt_undef), index(NULL), layerData(NULL)
+    {
+      fname[0] = '\0';
+    }
+  };
+
+  // MapLoader reads node index files and layer data files in a background
+  // thread. It never touches the node tree; the results are installed
+  // into the tree by MapDataBase on the caller's thread.
+  class MapLoader
+  {
+  private:
+    mutex mtx;
+    condition_variable cnd;
+    thread * th;
+    bool bexit;
+    unsigned int maxQueue;
+    list<LoadRequest*> queue, done;
+    
+    static void sloader(MapLoader * ptr);
+    void loader();
+  public:
+    MapLoader();
+    ~MapLoader();
+
+    bool start(const unsigned int _maxQueue);
+    void stop();
+    bool isRunning()
+    {
+      return th != NULL;
+    }
+    
+    // push a request. fails when the queue is full.
+    bool push(LoadRequest * req);
 
+    // pop a completed request. returns false if none.
+    bool pop(LoadRequest *& req);
+
+    // number of requests queued or completed but not popped
+    unsigned int getNumPending();
+  };
+  
+  // MapDataBase can be shared by multiple threads. Operations on the tree
+  // (request, prefetch, insert, erase, restruct, save, ...) are serialized
+  // with a lock, and the layer data obtained via request() can be read 
+  // concurrently without the lock while held by LayerDataPtr. The layer data
+  // held are never released in restruct() nor modified in insert(); insert()
+  // and erase() replace them with new instances, and the old instances are 
+  // deleted when the last LayerDataPtr is released.
   class MapDataBase
   {
+    friend class Node;
   private:
+    static mutex mtx;							// lock for the tree and the lists of nodes and layer data
     static unsigned int maxSizeLayerData[lt_undef]; // maximum size of each LayerData instance
     static unsigned int maxNumNodes;			// maximum number of Node instances
     static unsigned int maxTotalSizeLayerData;	// maximum total size of LayerData instances
@@ -185,15 +257,56 @@ namespace AWSMap2 {
     
   private:
     Node * pNodes[20];							// 20 triangles of the first icosahedron
-    
+    MapLoader loader;
+
+    // push load request of the index of pNodeUp's child idChild
+    // (layerType == lt_undef) or layer data in pNodeUp.
+    bool requestLoad(Node * pNodeUp, const unsigned char idChild,
+		     const LayerType layerType = lt_undef);
+    Node * findNode(const vector<unsigned char> & path_id,
+		    const size_t len);
   public:
     MapDataBase();
     virtual ~MapDataBase();
 
     bool init();
+
+    // start/stop the background loader. While the loader is running,
+    // request() and prefetch() never read files; data not resident are
+    // requested to the loader and marked as pending.
+    bool startLoader(const unsigned int maxQueue = 64);
+    void stopLoader();
+
+    // install nodes and layer data loaded in the background.
+    // (called in request() and prefetch())
+    int installLoaded();
+  private:
+    int _installLoaded();
+  public:
+
+    unsigned int getNumPending()
+    {
+      return loader.getNumPending();
+    }
     
 	// request layerData within the circle specified with (center, radius).
-	void request(list<list<LayerDataPtr>> & layerDatum, const list<LayerType> & layerTypes,
+	// returns the number of the loads pending. (only for the loader running)
+	int request(list<list<LayerDataPtr>> & layerDatum, const list<LayerType> & layerTypes,
+		const vec3 & center, const float radius, const float resolution = 0);
+
+	// spatial queries on the coast lines within radius from the point (or
+	// the query segment). The layer data are requested as request(), and 
+	// the queries are processed with the index of each coast line.
+	bool nearestCoastLine(const vec3 & pt, const float radius, CoastLineHit & hit,
+		const float resolution = 0);
+	int nearestCoastLine(const vec3 & pt, const float radius, const unsigned int k,
+		vector<CoastLineHit> & hits, const float resolution = 0);
+	bool intersectCoastLine(const vec3 & p0, const vec3 & p1, const float width,
+		CoastLineHit & hit, const float resolution = 0);
+
+	// request nodes and layer data to be loaded in the background, which
+	// would be requested with the same arguments.
+	int prefetch(const list<LayerType> & layerTypes,
 		const vec3 & center, const float radius, const float resolution = 0);
 
     // insert an instance of LayerData to the location.
@@ -208,6 +321,10 @@ namespace AWSMap2 {
     
     // save MapDataBase (only the parts updated)
     bool save();
+
+    // rewrite all the layer data stored in old formats in the current
+    // format. (whole the tree under the path is visited)
+    bool convert();
   };
   
   class Node
@@ -223,6 +340,8 @@ namespace AWSMap2 {
     static void restruct();				// remove nodes if the limit of  maximum number of nodes are violated. 
 	                                    // Nodes without downlink nodes instantiated and least recently used are removed.
     static Node * load(Node * pNodeUp, unsigned int idChild); // loads child node.
+    static bool loadIndex(const char * fname, NodeIndex & index); // loads index file (thread safe)
+    static Node * build(Node * pNodeUp, unsigned int idChild, const NodeIndex & index); // instantiates node from the index
 	static const unsigned int getNumNodesAlive()
 	{
 		return numNodesAlive;
@@ -237,14 +356,16 @@ namespace AWSMap2 {
 	}
 
   private:
+    friend class MapDataBase;
     Node * prev, * next;// link pointers for memory management
 	unsigned char level;
-	int refcount;
+	atomic<int> refcount;
     bool bupdate;		// update flag. asserted when the layerDataList or downLink is updated
     unsigned char id;	// id of the node in the upper node. (0 to 3 for ordinal nodes. 0 to 19 for top level nodes.)
     Node * upLink;		// Up link. NULL for top 20 nodes
     bool bdownLink;		// false until the downLink is created.
     Node * downLink[4]; // Down link. 
+    unsigned char pendingDownLink; // bit i is asserted while downLink[i] is loaded in the background
     vec2 vtx_bih[3];	// bih coordinte of the node's triangle
 	void calc_ecef();
     vec3 vtx_ecef[3];   // ecef coordinate of the node's triangle (calculated automatically in construction phase) 
@@ -263,8 +384,15 @@ namespace AWSMap2 {
     // insertLayerData helps addLayerData. 
 	void insertLayerData(LayerData * pLayerData);
     
-    // getLayerData returns layerData of layerType in this node 
-    LayerData * getLayerData(LayerType layerType);
+    // getLayerData returns layerData of layerType in this node. If pdb is
+    // given and the data is not resident, the data is requested to the
+    // loader and NULL is returned.
+    LayerData * getLayerData(LayerType layerType, MapDataBase * pdb = NULL);
+
+    // collision(unsigned int, vec3, float) determines whether the circle
+    // collides with the child idChild not instantiated.
+    const bool collision(const unsigned int idChild, const vec3 & center,
+			 const float radius);
     
     // distributeLayerData helps addLayerData. 
     bool distributeLayerData(const LayerData & layerData);
@@ -318,6 +446,10 @@ namespace AWSMap2 {
     // save Node data and layer data recursively for all downlinks
     // this function is called only from MapDataBase::save()
     bool save();
+
+    // convert layer data recursively for all downlinks
+    // this function is called only from MapDataBase::convert()
+    bool convert();
     
     // collision(vec3) determines whether the specified point collides with the node.
     const bool collision(const vec3 & location, const double err = 0.0f);
@@ -329,9 +461,22 @@ namespace AWSMap2 {
 	const void collision_downlink(const vector<vec3> & pts, vector<char> & inodes);
 
     // getLayerData called from MapDataBase::request
-    void getLayerData(list<list<LayerDataPtr>> & layerData, 
+    // pdb is given only when the background loader is running. returns false
+    // if some of the data are not resident.
+    bool getLayerData(list<list<LayerDataPtr>> & layerData, 
 			    const list<LayerType> & layerType, const vec3 & center,
-			    const float radius, const float resolution = 0);
+			    const float radius, const float resolution = 0,
+			    MapDataBase * pdb = NULL);
+
+    // prefetch called from MapDataBase::prefetch
+    void prefetch(MapDataBase * pdb, const list<LayerType> & layerType,
+		  const vec3 & center, const float radius,
+		  const float resolution = 0);
+
+    // installs layer data loaded in the background. fails if the
+    // layer data in this node is already active.
+    bool installLayerData(const LayerType layerType, LayerData * pLayerData);
+    bool installDownLink(const unsigned int idChild, const NodeIndex * index);
     
     // addLayerData adds the layer data given in the argument.
     // the function is invoked from LayerData::split, and the split is called from MapDataBase::insert
@@ -345,6 +490,8 @@ namespace AWSMap2 {
     bool deleteLayerData(const LayerData * layerData);	
   };
   
+#define LD_ATTACHED 0x40000000 // flag in LayerData::refcount
+
   class LayerData
   {
 	  friend class LayerDataPtr;
@@ -354,9 +501,15 @@ namespace AWSMap2 {
     static unsigned int totalSize;
   protected:
     static void insert(LayerData * pLayerData);
+    static void append(LayerData * pLayerData);
     static void pop(LayerData * pLayerData);
+    static void collectAccessed();
   public:
     static void accessed(LayerData * pLayerData);
+
+    // removes pLayerData from the tree. The instance is deleted immediately
+    // if not held, otherwise deleted by the last LayerDataPtr released.
+    static void detach(LayerData * pLayerData);
 	static void resize(unsigned int size_diff)
 	{
 		totalSize += size_diff;
@@ -372,9 +525,13 @@ namespace AWSMap2 {
     
   protected:
     LayerData * prev, * next;
-	int  refcount;
+	// number of the holders, and LD_ATTACHED while the instance is in the 
+	// tree. The instance is deleted by the one who makes it zero.
+	atomic<int> refcount;
+    atomic<bool> baccessed; // asserted by readers, and reflected to the list in restruct()
     bool bupdate;
     bool bactive;
+    bool bpending; // asserted while being loaded in the background
     
     Node * pNode;
     
@@ -386,10 +543,23 @@ namespace AWSMap2 {
     }
     
   public:
-  LayerData() : prev(NULL), next(NULL), pNode(NULL), refcount(0), bupdate(false), bactive(false) {};
+  LayerData() : prev(NULL), next(NULL), pNode(NULL), refcount(0), baccessed(false), bupdate(false), bactive(false), bpending(false) {};
     virtual ~LayerData() {};
  
-    void setNode(Node * _pNode) { pNode = _pNode; };
+    // attaches the instance to the node in the tree. (with the lock of MapDataBase)
+    void setNode(Node * _pNode) {
+      pNode = _pNode;
+      if (pNode)
+        refcount.fetch_or(LD_ATTACHED);
+    };
+
+    // removes the instance from the tree, returns the value of refcount 
+    // remaining. The caller should delete the instance if it is zero.
+    int detachNode() {
+      pNode = NULL;
+      return refcount.fetch_and(~LD_ATTACHED) & ~LD_ATTACHED;
+    }
+
     Node * getNode() const { return pNode; };
     
     void setActive(){
@@ -400,23 +570,44 @@ namespace AWSMap2 {
     bool isActive(){
       return bactive;
     }
+
+    bool isPending(){
+      return bpending;
+    }
+
+    void setPending(const bool _bpending){
+      bpending = _bpending;
+    }
+
+    void setUpdate(){
+      bupdate = true;
+    }
     
 	bool isLocked()
 	{
-		return refcount > 0;
+		return (refcount.load() & ~LD_ATTACHED) > 0;
 	}
 
 	void lock() {
 		refcount++;
 	}
 
-	void unlock() {
-		refcount--;
+	// returns the value of refcount remaining, zero if the last holder
+	// released the instance detached from the tree.
+	int unlock() {
+		return --refcount;
+	}
+
+	// marks the instance as recently used. (can be called without the lock)
+	void touch() {
+		baccessed.store(true, memory_order_relaxed);
 	}
 
     // major interfaces 
     bool save();
     bool load();
+    virtual bool loadFile(const char * fname); // load data from the file. The default implementation uses load(ifstream&)
+    virtual bool isLegacy() const { return false; } // true if loaded from the file in an old format
     void release();
     bool reduce(const size_t sz_lim);
     bool merge(const LayerData & layerData);
@@ -440,52 +631,138 @@ namespace AWSMap2 {
 	virtual void print() const = 0;
   };
   
+  // Packed coast line block. The same layout is used in the file and in
+  // memory, so the file can be mapped and used without parsing.
+  //   CoastLinePackHeader
+  //   unsigned long long ofs[nlines + 1]  (points of line i are [ofs[i], ofs[i+1]))
+  //   double lat[npts], lon[npts]          (BIH coordinates)
+  //   double x[npts], y[npts], z[npts]     (ECEF coordinates)
+  // All the sections are 8 byte aligned.
+#define COAST_LINE_PACK_MAGIC "AWSCLPK"
+#define COAST_LINE_PACK_VERSION 1
+  // result of the spatial queries on coast lines
+  struct CoastLineHit
+  {
+    double dist;		// distance to the coast line in meter
+    double t;			// position on the query segment (0 at the start, 1 at the end)
+    vec3 pt;			// closest point on the coast line (ECEF)
+    unsigned int iline;	// the line in the layer data
+    unsigned int ipt;	// the segment from the point ipt to ipt + 1
+  CoastLineHit() :dist(DBL_MAX), t(0), iline(0), ipt(0)
+    {
+    }
+  };
+
+  struct CoastLinePackHeader
+  {
+    char magic[8];
+    unsigned int version;
+    unsigned int nlines;
+    unsigned long long npts;
+    double center[3];
+    double center_bih[2];
+    double radius;
+    double dist_min;
+  };
+
   class CoastLine : public LayerData
   {
   protected:
-    static const vector<vec3> null_vec_vec3;
-	static const vector<vec2> null_vec_vec2;
-
     struct s_line {
       vector<vec2> pts;
       vector<vec3> pts_ecef;
-      
-      size_t size() {
-	return sizeof(unsigned int) + (sizeof(vec2) + sizeof(vec3)) * pts.size();
-      }
     };
-    size_t total_size;
     double dist_min;
     double pt_radius;
 	vec3 pt_center;
 	vec2 pt_center_bih;
 
+    // packed block, allocated or mapped from the file. 
+    char * pck;
+    size_t sz_pck;
+    c_log_map * pmap;
+    bool blegacy;
+    CoastLinePackHeader * hdr;
+    const unsigned long long * ofs;
+    const double * lat, * lon, * x, * y, * z;
+
+    // lines are only used while editing (merge, reduce, split and add).
+    // update_properties() packs them and releases them.
     vector<s_line*> lines;
     void add(list<vec2> & line);
     int try_reduce(int nred);
     void update_properties();
+
+    // bounding volume hierarchy of the segments in ECEF, built in setPack()
+    // and never modified until the next pack, so the queries below can run
+    // in parallel. Leaves have at most COAST_LINE_BVH_LEAF segments.
+#define COAST_LINE_BVH_LEAF 4
+    struct s_bvh_node {
+      vec3 bmin, bmax;
+      unsigned int first; // first child (internal node) or first entry in seg (leaf)
+      unsigned int nseg;  // number of segments (leaf) or 0 (internal node)
+    };
+    vector<s_bvh_node> bvh;
+    vector<unsigned int> seg;	// start point of the segments
+    double len_seg_max;			// maximum segment length
+    void buildIndex();
+    unsigned int findLine(const unsigned int ipt) const;
+    vec3 pointECEF(const unsigned int ipt) const
+    {
+      return vec3(x[ipt], y[ipt], z[ipt]);
+    }
+
+    bool setPack(char * p, const size_t sz);
+    void releasePack();
+    void pack();
+    void unpack();
+    void getLines(vector<s_line*> & dst) const;
   public:
     CoastLine();
     virtual ~CoastLine();
     
     const unsigned int getNumLines() const
     {
-      return lines.size();
+      return hdr ? hdr->nlines : 0;
     }
-    
-    const vector<vec3> & getPointsECEF(unsigned int id) const
+
+    const unsigned int getNumPoints() const
     {
-      if (id >= lines.size())
-	return null_vec_vec3;
-      return lines[id]->pts_ecef;
+      return hdr ? (unsigned int) hdr->npts : 0;
     }
 
-	const vector<vec2> & getPointsBIH(unsigned int id) const
-	{
-		if (id >= lines.size())
-			return null_vec_vec2;
-		return lines[id]->pts;
-	}
+    // points of line id are in [getLineBegin(id), getLineEnd(id)) of the 
+    // coordinate arrays below.
+    const unsigned int getLineBegin(unsigned int id) const
+    {
+      return id < getNumLines() ? (unsigned int) ofs[id] : 0;
+    }
+
+    const unsigned int getLineEnd(unsigned int id) const
+    {
+      return id < getNumLines() ? (unsigned int) ofs[id + 1] : 0;
+    }
+
+    const double * getLat() const { return lat; }
+    const double * getLon() const { return lon; }
+    const double * getX() const { return x; }
+    const double * getY() const { return y; }
+    const double * getZ() const { return z; }
+
+    // nearest segment from pt within dmax. returns false if none.
+    bool nearest(const vec3 & pt, CoastLineHit & hit, const double dmax = DBL_MAX) const;
+
+    // k nearest segments from pt within dmax, in ascending order of the
+    // distance. returns the number of the segments found.
+    int nearest(const vec3 & pt, const unsigned int k, vector<CoastLineHit> & hits, 
+		const double dmax = DBL_MAX) const;
+
+    // first segment within width from the segment p0-p1 (width = 0 for the 
+    // swept segment, half width of the corridor otherwise). The allowance 
+    // for the curvature of the earth is added to the width, because both
+    // the segments are chords. returns false if none.
+    bool intersect(const vec3 & p0, const vec3 & p1, const double width, 
+		   CoastLineHit & hit) const;
     
     bool loadJPJIS(const char * fname);
   protected:
@@ -496,6 +773,8 @@ namespace AWSMap2 {
     virtual const LayerType getLayerType() const { return lt_coast_line; };
     virtual bool save(ofstream & ofile);
     virtual bool load(ifstream & ifile);
+    virtual bool loadFile(const char * fname);
+    virtual bool isLegacy() const { return blegacy; }
     virtual bool split(list<Node*> & nodes, Node * pParentNode = NULL) const;
     virtual LayerData * clone() const;
     virtual size_t size() const;
@@ -513,10 +792,31 @@ namespace AWSMap2 {
 	virtual void print() const;
   };
 
+  // LayerDataPtr holds an instance of LayerData. Copies and releases can be
+  // done in any thread without the lock of MapDataBase.
   class LayerDataPtr
   {
   private:
 	  const LayerData * ptr;
+
+	  void hold()
+	  {
+		  if (ptr)
+			  const_cast<LayerData*>(ptr)->lock();
+	  }
+
+	  void release()
+	  {
+		  if (!ptr)
+			  return;
+		  LayerData * p = const_cast<LayerData*>(ptr);
+		  ptr = NULL;
+		  p->touch();
+		  // the last holder deletes the instance detached from the tree.
+		  // p is not referred after unlock() unless it is zero.
+		  if (p->unlock() == 0)
+			  delete p;
+	  }
   public:
 	  LayerDataPtr() :ptr(NULL)
 	  {
@@ -524,22 +824,27 @@ namespace AWSMap2 {
 
 	  LayerDataPtr(const LayerDataPtr & ldp) :ptr(ldp.ptr)
 	  {
-		  const_cast<LayerData*>(ptr)->lock();
+		  hold();
 	  }
 
 	  LayerDataPtr(const LayerData * _ptr) :ptr(_ptr)
 	  {
-		  const_cast<LayerData*>(ptr)->lock();
+		  hold();
 	  }
 
 	  ~LayerDataPtr()
 	  {
-		  const_cast<LayerData*>(ptr)->accessed(const_cast<LayerData*>(ptr));
-		  const_cast<LayerData*>(ptr)->unlock();
-		  if (!const_cast<LayerData*>(ptr)->getNode()) {
-			  const_cast<LayerData*>(ptr)->pop(const_cast<LayerData*>(ptr));
-			  delete ptr;
+		  release();
+	  }
+
+	  LayerDataPtr & operator = (const LayerDataPtr & ldp)
+	  {
+		  if (ptr != ldp.ptr) {
+			  release();
+			  ptr = ldp.ptr;
+			  hold();
 		  }
+		  return *this;
 	  }
 
 	  const LayerData & operator * () const
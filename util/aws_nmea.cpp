@@ -16,6 +16,7 @@
 // You should have received a copy of the GNU General Public License
 // along with aws_nmea.cpp.  If not, see <http://www.gnu.org/licenses/>. 
 #include <cstdio>
+#include <cstring>
 #include <stdlib.h>
 #include <wchar.h>
 #include <iostream>
@@ -117,14 +118,19 @@ int parstrcpy(char * str, const char * src, char delim, int max_buf)
 
 
 ///////////////////////////////////////////// navdat decoder
-const c_nmea_dat * c_nmea_dec::decode(const char * str)
+const c_nmea_dat * c_nmea_dec::decode(const char * str, const long long t)
+{
+	return decode(str, get_nd_type(str), t);
+}
+
+const c_nmea_dat * c_nmea_dec::decode(const char * str, const e_nd_type nt,
+	const long long t)
 {
 	if(!eval_nmea_chksum(str)){
 	  cerr << "Check sum is not valid. " << str << endl;
 		return NULL;
 	}
 
-	e_nd_type nt = get_nd_type(str);
 	if(nt == ENDT_UNDEF)
 		return NULL;
 
@@ -158,10 +164,10 @@ const c_nmea_dat * c_nmea_dec::decode(const char * str)
 		pnd = &mtw;
 		break;
 	case ENDT_VDM:	
-		pnd = vdmdec.dec(str);
+		pnd = vdmdec.dec(str, t);
 		break;
 	case ENDT_VDO:
-		pnd = vdodec.dec(str);
+		pnd = vdodec.dec(str, t);
 		break;
 	case ENDT_ABK:
 		pnd = &abk;
@@ -180,6 +186,140 @@ const c_nmea_dat * c_nmea_dec::decode(const char * str)
 	return pnd;
 }
 
+bool c_nmea_dec::decode(const char * str, s_nmea_rec & rec, const long long t)
+{
+	strncpy(rec.raw, str, 83);
+	rec.raw[83] = '\0';
+	rec.type = get_nd_type(str);
+	rec.dtype = ENDT_UNDEF;
+	rec.toker[0] = str[1];
+	rec.toker[1] = str[2];
+
+	const c_nmea_dat * pnd = decode(str, rec.type, t);
+	if(!pnd)
+		return false;
+
+	// the object type is given by get_type(), then static_cast is safe here.
+	switch(pnd->get_type()){
+	case ENDT_GGA:
+		{
+			const c_gga * p = static_cast<const c_gga*>(pnd);
+			s_nmea_gga & d = rec.gga;
+			d.h = p->m_h; d.m = p->m_m; d.s = p->m_s;
+			d.fix = (char) p->m_fix;
+			d.nsats = p->m_num_sats;
+			d.lat = (p->m_lat_dir == EGP_N ? p->m_lat_deg : -p->m_lat_deg);
+			d.lon = (p->m_lon_dir == EGP_E ? p->m_lon_deg : -p->m_lon_deg);
+			d.hdop = p->m_hdop; d.alt = p->m_alt; d.geos = p->m_geos;
+		}
+		break;
+	case ENDT_RMC:
+		{
+			const c_rmc * p = static_cast<const c_rmc*>(pnd);
+			s_nmea_rmc & d = rec.rmc;
+			d.h = p->m_h; d.m = p->m_m; d.s = p->m_s;
+			d.v = p->m_v;
+			d.lat = (p->m_lat_dir == EGP_N ? p->m_lat_deg : -p->m_lat_deg);
+			d.lon = (p->m_lon_dir == EGP_E ? p->m_lon_deg : -p->m_lon_deg);
+			d.sog = (float) p->m_vel;
+			d.cog = (float) p->m_crs;
+			d.var = (float) (p->m_crs_var_dir == EGP_E ? p->m_crs_var : -p->m_crs_var);
+			d.yr = p->m_yr; d.mn = p->m_mn; d.dy = p->m_dy;
+		}
+		break;
+	case ENDT_VTG:
+		{
+			const c_vtg * p = static_cast<const c_vtg*>(pnd);
+			s_nmea_vtg & d = rec.vtg;
+			d.crs_t = p->crs_t; d.crs_m = p->crs_m;
+			d.v_n = p->v_n; d.v_k = p->v_k;
+		}
+		break;
+	case ENDT_ZDA:
+		{
+			const c_zda * p = static_cast<const c_zda*>(pnd);
+			s_nmea_zda & d = rec.zda;
+			d.h = p->m_h; d.m = p->m_m; d.s = p->m_s;
+			d.dy = p->m_dy; d.mn = p->m_mn; d.yr = p->m_yr;
+			d.lzh = p->m_lzh; d.lzm = p->m_lzm;
+		}
+		break;
+	case ENDT_TTM:
+		{
+			const c_ttm * p = static_cast<const c_ttm*>(pnd);
+			s_nmea_ttm & d = rec.ttm;
+			d.id = p->m_id;
+			d.dist = p->m_dist; d.bear = p->m_bear; d.spd = p->m_spd;
+			d.crs = p->m_crs; d.dcpa = p->m_dcpa; d.tcpa = p->m_tcpa;
+			d.bear_true = p->m_is_bear_true;
+			d.crs_true = p->m_is_crs_true != 0;
+			d.dist_unit = p->m_dist_unit;
+			d.state = p->m_state;
+		}
+		break;
+	case ENDT_DBT:
+		{
+			const c_dbt * p = static_cast<const c_dbt*>(pnd);
+			rec.dbt.dfe = p->dfe; rec.dbt.dm = p->dm; rec.dbt.dfa = p->dfa;
+		}
+		break;
+	case ENDT_MTW:
+		rec.mtw.t = static_cast<const c_mtw*>(pnd)->t;
+		break;
+	case ENDT_VDM1:
+		{
+			const c_vdm_msg1 * p = static_cast<const c_vdm_msg1*>(pnd);
+			memset(&rec.vdm, 0, sizeof(rec.vdm));
+			rec.vdm.mmsi = p->m_mmsi;
+			rec.vdm.lat = p->m_lat; rec.vdm.lon = p->m_lon;
+			rec.vdm.course = p->m_course; rec.vdm.speed = p->m_speed;
+			rec.vdm.heading = p->m_heading;
+		}
+		break;
+	case ENDT_VDM18:
+		{
+			const c_vdm_msg18 * p = static_cast<const c_vdm_msg18*>(pnd);
+			memset(&rec.vdm, 0, sizeof(rec.vdm));
+			rec.vdm.mmsi = p->m_mmsi;
+			rec.vdm.lat = p->m_lat; rec.vdm.lon = p->m_lon;
+			rec.vdm.course = p->m_course; rec.vdm.speed = p->m_speed;
+			rec.vdm.heading = p->m_heading;
+		}
+		break;
+	case ENDT_VDM19:
+		{
+			const c_vdm_msg19 * p = static_cast<const c_vdm_msg19*>(pnd);
+			memset(&rec.vdm, 0, sizeof(rec.vdm));
+			rec.vdm.mmsi = p->m_mmsi;
+			rec.vdm.lat = p->m_lat; rec.vdm.lon = p->m_lon;
+			rec.vdm.course = p->m_course; rec.vdm.speed = p->m_speed;
+			rec.vdm.heading = p->m_heading;
+			rec.vdm.shiptype = p->m_shiptype;
+			rec.vdm.to_bow = p->m_to_bow; rec.vdm.to_stern = p->m_to_stern;
+			rec.vdm.to_port = p->m_to_port; rec.vdm.to_starboard = p->m_to_starboard;
+			memcpy(rec.vdm.shipname, p->m_shipname, sizeof(rec.vdm.shipname));
+		}
+		break;
+	case ENDT_VDM5:
+		{
+			const c_vdm_msg5 * p = static_cast<const c_vdm_msg5*>(pnd);
+			memset(&rec.vdm, 0, sizeof(rec.vdm));
+			rec.vdm.mmsi = p->m_mmsi;
+			rec.vdm.shiptype = p->m_shiptype;
+			rec.vdm.to_bow = p->m_to_bow; rec.vdm.to_stern = p->m_to_stern;
+			rec.vdm.to_port = p->m_to_port; rec.vdm.to_starboard = p->m_to_starboard;
+			memcpy(rec.vdm.callsign, p->m_callsign, sizeof(rec.vdm.callsign));
+			memcpy(rec.vdm.shipname, p->m_shipname, sizeof(rec.vdm.shipname));
+		}
+		break;
+	default:
+		return false;
+	}
+
+	rec.dtype = pnd->get_type();
+	return true;
+}
+
 //////////////////////////////////////////////// ttm decoder
 bool c_ttm::dec(const char * str)
 {
@@ -155,6 +155,87 @@ public:
 
 #include "aws_nmea_ais.h"
 
+/////////////////////// s_nmea_rec (decoded sentence as plain data)
+// The payloads of the major sentences. Latitudes and longitudes are in
+// degree, negative for S and W. 
+struct s_nmea_gga{
+	short h, m;
+	float s;
+	char fix;   // e_gp_fix_stat
+	short nsats;
+	double lat, lon;
+	float hdop, alt, geos;
+};
+
+struct s_nmea_rmc{
+	short h, m;
+	float s;
+	bool v;
+	double lat, lon;
+	float sog, cog, var;
+	short yr, mn, dy;
+};
+
+struct s_nmea_vtg{
+	float crs_t, crs_m, v_n, v_k;
+};
+
+struct s_nmea_zda{
+	short h, m;
+	float s;
+	short dy, mn, yr;
+	short lzh, lzm;
+};
+
+struct s_nmea_ttm{
+	short id;
+	float dist, bear, spd, crs, dcpa, tcpa;
+	bool bear_true, crs_true;
+	char dist_unit, state;
+};
+
+struct s_nmea_dbt{
+	float dfe, dm, dfa;
+};
+
+struct s_nmea_mtw{
+	float t;
+};
+
+// AIS message 1, 18, 19 (position report) and 5 (static information)
+struct s_nmea_vdm{
+	unsigned int mmsi;
+	float lat, lon, course, speed;
+	unsigned short heading;
+	unsigned char shiptype;
+	short to_bow, to_stern;
+	unsigned char to_port, to_starboard;
+	unsigned char callsign[8];
+	unsigned char shipname[21];
+};
+
+// s_nmea_rec is a sentence with its decoded payload. type is the sentence
+// type, and dtype is the type of the payload, which is one of ENDT_GGA, 
+// ENDT_RMC, ENDT_VTG, ENDT_ZDA, ENDT_TTM, ENDT_DBT, ENDT_MTW, ENDT_VDM1, 
+// ENDT_VDM5, ENDT_VDM18, ENDT_VDM19, or ENDT_UNDEF if not decoded (other
+// sentences, invalid checksum, or incomplete AIS fragment). 
+struct s_nmea_rec{
+	long long t;
+	e_nd_type type, dtype;
+	char toker[2];
+	union{
+		s_nmea_gga gga;
+		s_nmea_rmc rmc;
+		s_nmea_vtg vtg;
+		s_nmea_zda zda;
+		s_nmea_ttm ttm;
+		s_nmea_dbt dbt;
+		s_nmea_mtw mtw;
+		s_nmea_vdm vdm;
+	};
+	char raw[84];
+};
+
 // nmea decoder class 
 // Usage : Instantiate an object, and call decode method with NMEA string as an argument. 
 // * decode method returns an NMEA data object, the object is allocated in the decoder object.
@@ -175,11 +256,33 @@ protected:
 
 	c_vdm_dec vdmdec;
 	c_vdm_dec vdodec;
+
+	// decodes str of the sentence type nt given by get_nd_type()
+	const c_nmea_dat * decode(const char * str, const e_nd_type nt, 
+		const long long t);
 public:
 	c_nmea_dec()
 	{
 	}
-	const c_nmea_dat * decode(const char * str);
+	// t is the time the sentence received (aws time), used to expire the 
+	// fragments of the AIS messages.
+	const c_nmea_dat * decode(const char * str, const long long t);
+
+	// decodes str into rec. raw and type are always filled. returns false
+	// if the payload is not decoded.
+	bool decode(const char * str, s_nmea_rec & rec, const long long t);
+
+	const c_vdm_dec & get_vdm_dec() const
+	{
+		return vdmdec;
+	}
+
+	// timeout of the fragments of the AIS messages in second
+	void set_ais_timeout(const float sec)
+	{
+		vdmdec.set_timeout(sec);
+		vdodec.set_timeout(sec);
+	}
 };
 
 #endif
@@ -15,6 +15,7 @@
 // You should have received a copy of the GNU General Public License
 // along with aws_nmea_gps.cpp.  If not, see <http://www.gnu.org/licenses/>. 
 #include <cstdio>
+#include <cstring>
 #include <stdlib.h>
 #include <wchar.h>
 #include <iostream>
@@ -149,11 +150,83 @@ const char * get_ship_type_name(unsigned char uc)
 
 //////////////////////////////////////////////// vdm decoder
 
+c_vdm_dec::c_vdm_dec(): m_vdo(false), m_pool(NULL),
+	m_timeout((long long) AIS_FRAG_TIMEOUT_DEFAULT * 10000000LL), m_tsweep(0),
+	m_count_complete(0), m_count_expired(0), m_count_drop(0), m_pnext(NULL)
+{
+	clear();
+}
+
 void c_vdm_dec::clear()
 {
-	for(list<s_pl*>::iterator itr = m_tmp.begin(); itr != m_tmp.end(); itr++)
-		delete *itr;
-	m_tmp.clear();
+	m_pool = NULL;
+	for(int i = 0; i < AIS_FRAG_POOL; i++)
+		free(&m_pls[i]);
+
+	for(int i = 0; i < AIS_FRAG_TBL; i++)
+		m_tbl[i].ppl = NULL;
+}
+
+int c_vdm_dec::find(unsigned int key)
+{
+	for(int i = get_home(key), n = 0; n < AIS_FRAG_TBL; 
+		i = (i + 1) & (AIS_FRAG_TBL - 1), n++){
+		if(!m_tbl[i].ppl)
+			return -1;
+		if(m_tbl[i].key == key)
+			return i;
+	}
+	return -1;
+}
+
+int c_vdm_dec::insert(unsigned int key, s_pl * ppl, long long t)
+{
+	for(int i = get_home(key), n = 0; n < AIS_FRAG_TBL; 
+		i = (i + 1) & (AIS_FRAG_TBL - 1), n++){
+		if(!m_tbl[i].ppl){
+			m_tbl[i].key = key;
+			m_tbl[i].ppl = ppl;
+			m_tbl[i].t = t;
+			return i;
+		}
+	}
+	return -1;
+}
+
+// removes the entry with backward shift, so that no tombstone is left in
+// the probe sequences.
+void c_vdm_dec::remove(int islot)
+{
+	const int mask = AIS_FRAG_TBL - 1;
+	int hole = islot;
+	m_tbl[hole].ppl = NULL;
+	for(int i = (hole + 1) & mask; m_tbl[i].ppl; i = (i + 1) & mask){
+		int home = get_home(m_tbl[i].key);
+		// the entry can fill the hole if its home is not in (hole, i]
+		if(((i - home) & mask) >= ((i - hole) & mask)){
+			m_tbl[hole] = m_tbl[i];
+			m_tbl[i].ppl = NULL;
+			hole = i;
+		}
+	}
+}
+
+void c_vdm_dec::expire(long long t)
+{
+	// sweeping at most four times in a timeout period
+	if(t - m_tsweep < m_timeout / 4)
+		return;
+	m_tsweep = t;
+
+	for(int i = 0; i < AIS_FRAG_TBL;){
+		if(m_tbl[i].ppl && t - m_tbl[i].t > m_timeout){
+			free(m_tbl[i].ppl);
+			remove(i);
+			m_count_expired++;
+			continue; // another entry may have been shifted here
+		}
+		i++;
+	}
 }
 
 char armor(char c)
@@ -176,15 +249,17 @@ void s_pl::dearmor(const char * str)
 	}
 }
 
-c_vdm * c_vdm_dec::dec(const char * str)
+c_vdm * c_vdm_dec::dec(const char * str, const long long t)
 {
-	s_pl * ppl = NULL;
 	c_vdm * pnd;
 	int i = 0;
 	int ipar = 0;
 	int len;
 	char buf[64];
-	int fcounts = 0, fnumber = 0, seqmsgid = 0;
+	char pl[64];
+	int fcounts = 0, fnumber = 0, seqmsgid = 0, num_padded_zeros = 0;
+	bool is_chan_A = true;
+	pl[0] = '\0';
 	while(ipar < 7){
 		len = parstrcpy(buf, &str[i], ',', 64);
 		i += len + 1;
@@ -201,58 +276,91 @@ c_vdm * c_vdm_dec::dec(const char * str)
 		case 3: // sequential message number
 			if(len != 0)
 				seqmsgid = htoi(buf);
-			if(fnumber == 1){
-				ppl = alloc();
-				ppl->fcounts = fcounts;
-				ppl->seqmsgid = seqmsgid;
-			}else{
-				// finding same seqmsgid
-				list<s_pl*>::iterator itr = m_tmp.begin();
-				for(;itr != c_vdm_dec::m_tmp.end(); itr++)
-					if((*itr)->seqmsgid == seqmsgid)
-						break;
-				if(itr == c_vdm_dec::m_tmp.end()){ // not found
-					cerr << "Cannot find preceding fragment." << endl;
-					return NULL;
-				}
-				ppl = *itr;
-				c_vdm_dec::m_tmp.erase(itr);
-			}
-			ppl->fnumber = fnumber;
 			break;
 		case 4: // channnel A or B
-			ppl->is_chan_A = buf[0] == 'A';
+			is_chan_A = buf[0] == 'A';
 			break;
-		case 5: // dearmor payload
-			ppl->dearmor(buf);
+		case 5: // armored payload
+			memcpy(pl, buf, sizeof(pl));
 			break;
 		case 6: // number of padded zeros
-			ppl->num_padded_zeros = buf[0] - '0';
+			num_padded_zeros = buf[0] - '0';
 		}
 
 		ipar++;
 	}
 
-	if(!ppl->is_complete()){
-		c_vdm_dec::m_tmp.push_back(ppl);
-		if(c_vdm_dec::m_tmp.size() > 10){
-			c_vdm_dec::free(*c_vdm_dec::m_tmp.begin());
-			c_vdm_dec::m_tmp.pop_front();
-#ifdef _DEBUG
-			cerr << "Payload fragment exceeded 10." << endl;
-#endif
+	s_pl * ppl = NULL;
+	if(fcounts <= 1){
+		ppl = &m_single;
+		ppl->pl_size = 0;
+		ppl->fcounts = ppl->fnumber = 1;
+		ppl->seqmsgid = seqmsgid;
+	}else{
+		expire(t);
+
+		unsigned int key = get_key(&str[1], is_chan_A, seqmsgid);
+		int islot = find(key);
+		if(fnumber == 1){
+			if(islot >= 0){ // the previous message was not completed
+				free(m_tbl[islot].ppl);
+				remove(islot);
+				m_count_drop++;
+			}
+			ppl = alloc();
+			if(!ppl){
+				m_count_drop++;
+				return NULL;
+			}
+			ppl->fcounts = fcounts;
+			ppl->fnumber = 0;
+			ppl->seqmsgid = seqmsgid;
+			islot = insert(key, ppl, t);
+			if(islot < 0){
+				free(ppl);
+				m_count_drop++;
+				return NULL;
+			}
+		}else{
+			if(islot < 0){ // preceding fragment not found
+				m_count_drop++;
+				return NULL;
+			}
+			ppl = m_tbl[islot].ppl;
+			if(ppl->fnumber + 1 != fnumber || ppl->fcounts != fcounts){
+				// lost or out of order fragment. duplicated ones are just ignored.
+				if(ppl->fnumber != fnumber){
+					free(ppl);
+					remove(islot);
+				}
+				m_count_drop++;
+				return NULL;
+			}
 		}
-		return NULL;
+
+		if(fnumber != fcounts){
+			ppl->fnumber = fnumber;
+			ppl->is_chan_A = is_chan_A;
+			ppl->dearmor(pl);
+			return NULL;
+		}
+		remove(islot);
+		m_count_complete++;
 	}
 
+	ppl->fnumber = fnumber;
+	ppl->is_chan_A = is_chan_A;
+	ppl->dearmor(pl);
+	ppl->num_padded_zeros = num_padded_zeros;
+
 	pnd = dec_payload(ppl);
-	c_vdm_dec::free(ppl);
+	if(ppl != &m_single)
+		free(ppl);
 	if(pnd != NULL)
 		pnd->m_vdo = m_vdo;
 	return pnd;
 }
 
-
 c_vdm * c_vdm_dec::dec_payload(s_pl * ppl)
 {
 	m_type = (short) ppl->payload[0];
@@ -389,6 +389,17 @@ public:
 };
 
 /////////////////////////////////////////////////////////// vdm decoder
+// Fragments of multi sentence messages are reassembled in a small open
+// addressing hash table keyed by (talker, channel, sequential message id),
+// so that the messages from several receivers merged in a stream do not 
+// disturb each other. The payloads are taken from a fixed pool, and the
+// pending messages not completed in the timeout are discarded. The timeout
+// is evaluated in the time given with the sentences (aws time, 100ns), 
+// then it follows the data time also in replay.
+#define AIS_FRAG_POOL 64
+#define AIS_FRAG_TBL 128 // power of 2, at least twice AIS_FRAG_POOL
+#define AIS_FRAG_TIMEOUT_DEFAULT 5 // sec
+
 class c_vdm_dec
 {
 protected:
@@ -402,8 +413,19 @@ protected:
 	c_vdm_msg19 vdm_msg19;
 	c_vdm_msg24 vdm_msg24;
 
-	s_pl * m_pool;
-	list<s_pl*> m_tmp; // temporaly store multi fragments message
+	s_pl m_single; // payload of single sentence message
+	s_pl m_pls[AIS_FRAG_POOL];
+	s_pl * m_pool; // free list of m_pls
+
+	struct s_frag{
+		unsigned int key;
+		s_pl * ppl; // NULL if the entry is empty
+		long long t; // time the first fragment received (100ns)
+	};
+	s_frag m_tbl[AIS_FRAG_TBL];
+	long long m_timeout, m_tsweep;
+
+	long long m_count_complete, m_count_expired, m_count_drop;
 
 	c_vdm_dec * m_pnext;
 
@@ -414,7 +436,7 @@ protected:
 
 	s_pl * alloc(){
 		if(m_pool == NULL)
-			return new s_pl;
+			return NULL;
 		s_pl * tmp = m_pool;
 		m_pool = m_pool->pnext;
 		tmp->pl_size = 0;
@@ -426,26 +448,53 @@ protected:
 		m_pool = ptr;
 	}
 
-	void clear();
-public:
-	c_vdm_dec():m_pool(NULL), m_vdo(false)
+	static unsigned int get_key(const char * toker, bool is_chan_A, int seqmsgid)
 	{
+		return ((unsigned int)(unsigned char) toker[0] << 24) | 
+			((unsigned int)(unsigned char) toker[1] << 16) |
+			((is_chan_A ? 1u : 0u) << 8) | (unsigned int)(seqmsgid & 0xFF);
 	}
 
-	~c_vdm_dec()
+	static int get_home(unsigned int key)
 	{
-		while(m_pool){
-			s_pl * ppl = m_pool->pnext;
-			delete m_pool;
-			m_pool = ppl;
-		}
+		return (int)((key * 2654435761u) >> 16) & (AIS_FRAG_TBL - 1);
 	}
 
+	int find(unsigned int key);
+	int insert(unsigned int key, s_pl * ppl, long long t);
+	void remove(int islot);
+	void expire(long long t);
+
+	void clear();
+public:
+	c_vdm_dec();
+
 	void set_vdo(){
 		m_vdo = true;
 	}
 
-	c_vdm * dec(const char * str);
+	void set_timeout(float sec)
+	{
+		m_timeout = (long long)(sec * 1e7);
+	}
+
+	// t is the time the sentence received (100ns)
+	c_vdm * dec(const char * str, const long long t);
+
+	long long get_count_complete() const
+	{
+		return m_count_complete;
+	}
+
+	long long get_count_expired() const
+	{
+		return m_count_expired;
+	}
+
+	long long get_count_drop() const
+	{
+		return m_count_drop;
+	}
 };
 
 #endif
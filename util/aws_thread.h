@@ -20,5 +20,6 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 
 #endif
\ No newline at end of file
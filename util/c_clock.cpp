@@ -174,7 +174,7 @@ bool c_clock::start(unsigned period, unsigned delay,
   else
     m_rate = rate;
   m_offset = offset;
-  m_tcyc = m_rate * period;
+  m_tcyc = (m_rate > 0 ? m_rate : 1) * period;
   
   if(m_state == STOP){
 #ifdef _WIN32
@@ -304,6 +304,24 @@ long long c_clock::get_time()
 
 void c_clock::wait()
 {
+  if(is_lock_step()){
+    // The time advances a cycle without sleep. c_aws synchronizes the
+    // filters. In pause state, a cycle is slept.
+    if(m_state == RUN){
+      m_tcur += m_tcyc;
+      return;
+    }
+#ifndef _WIN32
+    timespec ts, trem;
+    ts.tv_sec = m_tcyc / SEC;
+    ts.tv_nsec = (m_tcyc - ts.tv_sec * SEC) * 100;
+    while(nanosleep(&ts, &trem)){
+      ts = trem;
+    }
+    return;
+#endif
+  }
+
   long long delta_adjust = 0;
   if(abs(m_delta) < m_delta_adjust) // too small delta is ignored
     delta_adjust = 0;
@@ -95,7 +95,7 @@ class c_clock
 #else
   timespec m_ts_start;  
 #endif
-  int m_rate;
+  int m_rate;         // time rate. 0 is the lock step mode (offline only)
  public:
   c_clock(void);
   ~c_clock(void);
@@ -129,6 +129,12 @@ class c_clock
   bool is_pause(){
     return m_state == PAUSE;
   }
+
+  // In lock step mode, wait() returns immediately advancing the time a 
+  // cycle, and c_aws advances the clock after all the filters finished.
+  bool is_lock_step(){
+    return !m_bonline && m_rate == 0;
+  }
   
   long long get_time(); // get UTC time
   const long long get_time_from_start()
@@ -0,0 +1,149 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_hist_ring.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_hist_ring.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_hist_ring.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_HIST_RING_H_
+#define _C_HIST_RING_H_
+
+#include "c_seqlock.h"
+
+// c_hist_ring<T, N> keeps the last N records of T in the order of time. T
+// is trivially copyable and has the time stamp "long long t". Each slot is
+// a c_seqlock, then the readers search the records without locking, and a
+// record overwritten during the search is detected by its index. As
+// c_seqlock, push() is called by a single writer at a time (in the
+// channels, holding the channel's mutex).
+template <class T, int N> class c_hist_ring
+{
+ private:
+  struct s_slot{
+    long long idx; // index of the record, -1 if never written
+    T rec;
+  };
+
+  c_seqlock<s_slot> m_slots[N];
+  std::atomic<long long> m_num;  // number of the records pushed so far
+  std::atomic<long long> m_base; // index of the oldest valid record
+
+  // returns false if the slot has been reused for a newer record
+  bool get(const long long idx, T & rec) const
+  {
+    s_slot s;
+    m_slots[idx % N].read(s);
+    rec = s.rec;
+    return s.idx == idx;
+  }
+
+ public:
+  c_hist_ring():m_num(0), m_base(0)
+  {
+    for(int i = 0; i < N; i++){
+      m_slots[i].begin_write().idx = -1;
+      m_slots[i].end_write();
+    }
+  }
+
+  // A record with the same time as the latest one overwrites it. A record
+  // older than the latest one (e.g. the log is rewound) discards the 
+  // history.
+  void push(const T & rec)
+  {
+    long long num = m_num.load(std::memory_order_relaxed);
+    if(num > m_base.load(std::memory_order_relaxed)){
+      T last;
+      get(num - 1, last);
+      if(rec.t == last.t){
+	s_slot & s = m_slots[(num - 1) % N].begin_write();
+	s.rec = rec;
+	m_slots[(num - 1) % N].end_write();
+	return;
+      }
+      if(rec.t < last.t)
+	m_base.store(num, std::memory_order_release);
+    }
+
+    s_slot & s = m_slots[num % N].begin_write();
+    s.idx = num;
+    s.rec = rec;
+    m_slots[num % N].end_write();
+    m_num.store(num + 1, std::memory_order_release);
+  }
+
+  void clear()
+  {
+    m_base.store(m_num.load(std::memory_order_relaxed), std::memory_order_release);
+  }
+
+  // Finds the pair of records r0 and r1 for t by binary search, such that
+  // r0.t <= t < r1.t. If t is at or after the latest record, r1 is the
+  // latest and r0 is the previous one (r0 == r1 if there is only one).
+  // Returns false if there is no record or t is before the oldest one.
+  bool find(const long long t, T & r0, T & r1) const
+  {
+    long long num = m_num.load(std::memory_order_acquire);
+    long long base = m_base.load(std::memory_order_acquire);
+    // the oldest slot is excluded, it can be overwritten by the next push.
+    long long lo = (num - N + 1 > base ? num - N + 1 : base);
+    long long hi = num - 1;
+    if(hi < lo)
+      return false;
+
+    if(!get(hi, r1))
+      return false;
+    if(r1.t <= t){
+      if(hi == lo || !get(hi - 1, r0))
+	r0 = r1;
+      return true;
+    }
+
+    if(!get(lo, r0) || t < r0.t)
+      return false;
+
+    // r0 = rec[lo], r1 = rec[hi], r0.t <= t < r1.t
+    while(hi - lo > 1){
+      long long mid = (lo + hi) >> 1;
+      T rm;
+      if(!get(mid, rm))
+	return false; // the writer has caught up the search range
+      if(rm.t <= t){
+	lo = mid;
+	r0 = rm;
+      }else{
+	hi = mid;
+	r1 = rm;
+      }
+    }
+
+    return true;
+  }
+
+  // the latest record
+  bool latest(T & rec) const
+  {
+    long long num = m_num.load(std::memory_order_acquire);
+    if(num <= m_base.load(std::memory_order_acquire))
+      return false;
+    return get(num - 1, rec);
+  }
+
+  int size() const
+  {
+    long long num = m_num.load(std::memory_order_acquire);
+    long long base = m_base.load(std::memory_order_acquire);
+    long long n = num - base;
+    return (int)(n < N - 1 ? n : N - 1);
+  }
+};
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_lat_hist.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_lat_hist.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_lat_hist.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_LAT_HIST_H_
+#define _C_LAT_HIST_H_
+
+#include <chrono>
+#include <algorithm>
+#include "aws_thread.h"
+
+// monotonic time in nano second. only for measuring intervals.
+inline long long get_mono_time_nsec()
+{
+  return (long long) std::chrono::duration_cast<std::chrono::nanoseconds>
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// c_lat_hist is a log-linear latency histogram in nano second.
+// Values less than 2^LHIST_SUB_BITS are counted linearly, and larger values
+// are counted in LHIST_SUB sub-buckets per power of two, so that the relative
+// error of the quantiles is less than 1/LHIST_SUB. add() is lock free and
+// expected to be called from single thread, and the statistics can be read
+// from any thread.
+#define LHIST_SUB_BITS 4
+#define LHIST_SUB (1 << LHIST_SUB_BITS)
+#define LHIST_MAX_SHIFT 40 // values over 2^(LHIST_MAX_SHIFT+LHIST_SUB_BITS) ns are saturated
+#define LHIST_SIZE ((LHIST_MAX_SHIFT + 2) * LHIST_SUB)
+
+class c_lat_hist
+{
+ private:
+  std::atomic<unsigned long long> m_cnt[LHIST_SIZE];
+  std::atomic<unsigned long long> m_num;
+  std::atomic<long long> m_sum, m_max;
+
+  static int get_index(unsigned long long v)
+  {
+    if(v < LHIST_SUB)
+      return (int) v;
+    int e = 63 - __builtin_clzll(v);
+    int shift = e - LHIST_SUB_BITS;
+    if(shift > LHIST_MAX_SHIFT)
+      return LHIST_SIZE - 1;
+    return (shift + 1) * LHIST_SUB + (int)((v >> shift) & (LHIST_SUB - 1));
+  }
+
+  // upper bound of the values counted in the bucket idx
+  static long long get_upper(int idx)
+  {
+    if(idx < LHIST_SUB)
+      return idx;
+    int shift = idx / LHIST_SUB - 1;
+    long long lower = (long long) (LHIST_SUB + idx % LHIST_SUB) << shift;
+    return lower + ((1LL << shift) - 1);
+  }
+
+ public:
+  c_lat_hist()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    for(int i = 0; i < LHIST_SIZE; i++)
+      m_cnt[i].store(0, std::memory_order_relaxed);
+    m_num.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+  }
+
+  void add(long long v)
+  {
+    if(v < 0)
+      v = 0;
+    m_cnt[get_index((unsigned long long) v)].fetch_add(1, std::memory_order_relaxed);
+    m_num.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(v, std::memory_order_relaxed);
+    if(v > m_max.load(std::memory_order_relaxed))
+      m_max.store(v, std::memory_order_relaxed);
+  }
+
+  unsigned long long get_num()
+  {
+    return m_num.load(std::memory_order_relaxed);
+  }
+
+  long long get_max()
+  {
+    return m_max.load(std::memory_order_relaxed);
+  }
+
+  long long get_mean()
+  {
+    unsigned long long n = get_num();
+    return n ? (long long)(m_sum.load(std::memory_order_relaxed) / n) : 0;
+  }
+
+  // q-quantile (0 <= q <= 1) in nano second.
+  long long get_quantile(double q)
+  {
+    unsigned long long n = 0;
+    for(int i = 0; i < LHIST_SIZE; i++)
+      n += m_cnt[i].load(std::memory_order_relaxed);
+    if(n == 0)
+      return 0;
+
+    unsigned long long target = (unsigned long long)(q * (double) n + 0.5);
+    if(target < 1)
+      target = 1;
+
+    unsigned long long acc = 0;
+    for(int i = 0; i < LHIST_SIZE; i++){
+      acc += m_cnt[i].load(std::memory_order_relaxed);
+      if(acc >= target)
+	return std::min(get_upper(i), get_max());
+    }
+    return get_max();
+  }
+};
+
+#endif
@@ -0,0 +1,105 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_log_index.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_log_index.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_log_index.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+#include "c_log_index.h"
+
+void c_log_index::get_index_name(const char * flog, char * fidx, int len)
+{
+  snprintf(fidx, len, "%s", flog);
+  char * d = strrchr(fidx, '.');
+  if(d && strcmp(d, ".log") == 0)
+    *d = '\0';
+  int l = (int) strlen(fidx);
+  snprintf(fidx + l, len - l, ".idx");
+}
+
+bool c_log_index::open(const char * fidx, const long long intvl)
+{
+  close();
+  m_recs.clear();
+  m_intvl = intvl;
+  m_pf = fopen(fidx, "wb");
+  if(!m_pf){
+    cerr << "Failed to open " << fidx << "." << endl;
+    return false;
+  }
+  fwrite((void*)LOG_INDEX_MAGIC, 1, LOG_INDEX_MAGIC_LEN, m_pf);
+  return true;
+}
+
+void c_log_index::add(const long long t, const long long pos)
+{
+  if(!m_recs.empty() && t - m_recs.back().t < m_intvl)
+    return;
+
+  s_log_index_rec rec;
+  rec.t = t;
+  rec.pos = pos;
+  m_recs.push_back(rec);
+  if(m_pf)
+    fwrite((void*)&rec, sizeof(rec), 1, m_pf);
+}
+
+void c_log_index::close()
+{
+  if(m_pf){
+    fclose(m_pf);
+    m_pf = NULL;
+  }
+}
+
+bool c_log_index::load(const char * fidx)
+{
+  m_recs.clear();
+  FILE * pf = fopen(fidx, "rb");
+  if(!pf)
+    return false;
+
+  char magic[LOG_INDEX_MAGIC_LEN];
+  if(fread((void*)magic, 1, LOG_INDEX_MAGIC_LEN, pf) != LOG_INDEX_MAGIC_LEN ||
+     memcmp(magic, LOG_INDEX_MAGIC, LOG_INDEX_MAGIC_LEN) != 0){
+    cerr << fidx << " is not a log index." << endl;
+    fclose(pf);
+    return false;
+  }
+
+  s_log_index_rec rec;
+  while(fread((void*)&rec, sizeof(rec), 1, pf) == 1){
+    m_recs.push_back(rec);
+  }
+  fclose(pf);
+  return true;
+}
+
+long long c_log_index::find(const long long t) const
+{
+  // binary search for the first entry later than t
+  int imin = 0, imax = (int) m_recs.size();
+  while(imin < imax){
+    int imid = (imin + imax) / 2;
+    if(m_recs[imid].t <= t)
+      imin = imid + 1;
+    else
+      imax = imid;
+  }
+
+  if(imin == 0)
+    return -1;
+  return m_recs[imin - 1].pos;
+}
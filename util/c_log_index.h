@@ -0,0 +1,81 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_log_index.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_log_index.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_log_index.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_LOG_INDEX_H_
+#define _C_LOG_INDEX_H_
+
+#include <cstdio>
+#include <vector>
+
+// 64bit file offset
+#ifdef _WIN32
+#define aws_ftell(pf) _ftelli64(pf)
+#define aws_fseek(pf, off, org) _fseeki64(pf, off, org)
+#else
+#define aws_ftell(pf) ((long long) ftello(pf))
+#define aws_fseek(pf, off, org) fseeko(pf, (off_t)(off), org)
+#endif
+
+#define LOG_INDEX_MAGIC "AWSLIDX1"
+#define LOG_INDEX_MAGIC_LEN 8
+
+struct s_log_index_rec{
+  long long t;   // aws time, not earlier than the time of the record at pos
+  long long pos; // file offset of the head of the record
+};
+
+// c_log_index is a sparse time-to-offset index of a channel log file 
+// (<channel>_<time>.log). The index is saved as <channel>_<time>.idx, 
+// which has LOG_INDEX_MAGIC followed by s_log_index_rec's sorted by time.
+// An entry is added only if m_intvl has passed since the last entry.
+class c_log_index
+{
+ private:
+  std::vector<s_log_index_rec> m_recs;
+  long long m_intvl;
+  FILE * m_pf; // index file being written
+
+ public:
+  c_log_index():m_intvl(0), m_pf(NULL)
+  {
+  }
+
+  ~c_log_index()
+  {
+    close();
+  }
+
+  // generates index file name from log file name
+  static void get_index_name(const char * flog, char * fidx, int len);
+
+  // writer side
+  bool open(const char * fidx, const long long intvl);
+  void add(const long long t, const long long pos);
+  void close();
+
+  // reader side
+  bool load(const char * fidx);
+
+  // returns the offset of the last entry whose time is not later than t.
+  // returns -1 if no entry is found.
+  long long find(const long long t) const;
+
+  int size() const
+  {
+    return (int) m_recs.size();
+  }
+};
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_log_map.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_log_map.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_log_map.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+using namespace std;
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "c_log_index.h"
+#include "c_log_map.h"
+
+bool c_log_map::open(const char * fname)
+{
+  close();
+
+  int fd = ::open(fname, O_RDONLY);
+  if(fd < 0){
+    cerr << "Failed to open " << fname << ":" << strerror(errno) << endl;
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0){
+    ::close(fd);
+    return false;
+  }
+
+  void * p = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping holds the file
+  if(p == MAP_FAILED){
+    cerr << "Failed to map " << fname << ":" << strerror(errno) << endl;
+    return false;
+  }
+
+  m_base = (char*) p;
+  m_size = (size_t) st.st_size;
+  m_rgn = new s_log_map_region;
+  m_rgn->base = m_base;
+  m_rgn->size = m_size;
+  m_rgn->nref = 1;
+  m_pos = 0;
+  m_adv_end = 0;
+  madvise(m_base, m_size, MADV_SEQUENTIAL);
+  return true;
+}
+
+void c_log_map::close()
+{
+  if(m_pf){
+    fclose(m_pf);
+    m_pf = NULL;
+  }
+
+  if(m_base){
+    unref(m_rgn);
+    m_rgn = NULL;
+    m_base = NULL;
+    m_size = m_pos = m_adv_end = 0;
+  }
+}
+
+void c_log_map::unref(s_log_map_region * rgn)
+{
+  if(!rgn || rgn->nref.fetch_sub(1, memory_order_acq_rel) != 1)
+    return;
+  munmap(rgn->base, rgn->size);
+  delete rgn;
+}
+
+void c_log_map::prefetch(const size_t len)
+{
+  if(!m_base || len == 0)
+    return;
+
+  size_t end = min(m_size, m_pos + len);
+  if(m_adv_end >= end || (m_adv_end > m_pos && m_adv_end - m_pos > len / 2))
+    return;
+
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t head = (max(m_pos, m_adv_end) / page) * page;
+  if(end > head)
+    madvise(m_base + head, end - head, MADV_WILLNEED);
+  m_adv_end = end;
+}
+
+FILE * c_log_map::begin_stream()
+{
+  if(!m_base)
+    return NULL;
+
+  if(!m_pf){
+    m_pf = fmemopen(m_base, m_size, "rb");
+    if(!m_pf)
+      return NULL;
+  }
+  aws_fseek(m_pf, m_pos, SEEK_SET);
+  return m_pf;
+}
+
+void c_log_map::end_stream()
+{
+  if(!m_pf)
+    return;
+  long long pos = aws_ftell(m_pf);
+  if(pos >= 0)
+    m_pos = (size_t) pos;
+}
@@ -0,0 +1,138 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_log_map.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_log_map.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_log_map.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_LOG_MAP_H_
+#define _C_LOG_MAP_H_
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+
+// mapped region of c_log_map. The region is unmapped when the last 
+// reference is released, then the data referred by the channels are kept
+// valid after the c_log_map is closed.
+struct s_log_map_region
+{
+  char * base;
+  size_t size;
+  std::atomic<int> nref;
+};
+
+// c_log_map maps a channel log file into memory for replay and conversion.
+// Records are parsed in place with take(), then the channels can refer to
+// the payload without copying it, holding a reference by ref(). The mapping is private and writable, so
+// the data referred can be modified by the consumers without touching the
+// file (pages are copied only when written). The pages ahead of the 
+// current position are prefetched with prefetch().
+//
+// For the channels only having FILE based reader, begin_stream() returns a 
+// stream over the mapping positioned at the current position, and 
+// end_stream() takes the position back.
+class c_log_map
+{
+ private:
+  s_log_map_region * m_rgn;
+  char * m_base;
+  size_t m_size;
+  size_t m_pos;
+  size_t m_adv_end; // end of the range already prefetched
+  FILE * m_pf;      // stream over the mapping, opened on demand
+
+ public:
+  c_log_map(): m_rgn(NULL), m_base(NULL), m_size(0), m_pos(0), m_adv_end(0), m_pf(NULL)
+  {
+  }
+
+  ~c_log_map()
+  {
+    close();
+  }
+
+  bool open(const char * fname);
+  void close();
+
+  bool is_open() const
+  {
+    return m_base != NULL;
+  }
+
+  // references the mapped region. the reference should be released by unref().
+  s_log_map_region * ref() const
+  {
+    if(m_rgn)
+      m_rgn->nref.fetch_add(1, std::memory_order_relaxed);
+    return m_rgn;
+  }
+
+  static void unref(s_log_map_region * rgn);
+
+  const char * get_base() const
+  {
+    return m_base;
+  }
+
+  size_t get_size() const
+  {
+    return m_size;
+  }
+
+  size_t tell() const
+  {
+    return m_pos;
+  }
+
+  bool seek(const size_t pos)
+  {
+    if(pos > m_size)
+      return false;
+    m_pos = pos;
+    return true;
+  }
+
+  bool eof() const
+  {
+    return m_pos >= m_size;
+  }
+
+  // returns the pointer to len bytes at the current position, and advances
+  // the position. Returns NULL if the rest is shorter than len.
+  const char * take(const size_t len)
+  {
+    if(m_size - m_pos < len)
+      return NULL;
+    const char * p = m_base + m_pos;
+    m_pos += len;
+    return p;
+  }
+
+  // takes a value. The value is copied because the records are not aligned.
+  template <class T> bool take(T & val)
+  {
+    const char * p = take(sizeof(T));
+    if(!p)
+      return false;
+    memcpy((void*)&val, (const void*)p, sizeof(T));
+    return true;
+  }
+
+  // asks the kernel to read len bytes ahead of the current position. The 
+  // request is issued again only after a half of the range is consumed.
+  void prefetch(const size_t len);
+
+  FILE * begin_stream();
+  void end_stream();
+};
+
+#endif
@@ -0,0 +1,349 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_log_writer.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_log_writer.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_log_writer.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <vector>
+#include <map>
+using namespace std;
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "c_lat_hist.h"
+#include "c_log_writer.h"
+
+c_log_writer::c_log_writer(): m_head(0), m_tail(0), m_qbytes(0), m_qbytes_max(0),
+  m_arena(NULL), m_apos(0), m_nenq(0), m_sz_batch(0), m_bdirect(false), m_th(NULL), m_bexit(true),
+  m_count_push(0), m_count_drop(0), m_bytes_drop(0), m_count_block(0),
+  m_nsec_block(0), m_count_batch(0), m_bytes_written(0), m_count_err(0)
+{
+}
+
+c_log_writer::~c_log_writer()
+{
+  stop();
+}
+
+bool c_log_writer::start(const int qlen, const long long qbytes_max,
+			 const size_t sz_batch, const bool direct)
+{
+  if(m_th)
+    return false;
+
+  m_qbytes_max = (qbytes_max > 0 ? qbytes_max : 1);
+  m_arena = (char*) malloc((size_t) m_qbytes_max);
+  if(!m_arena){
+    cerr << "c_log_writer: failed to allocate " << m_qbytes_max << " bytes." << endl;
+    return false;
+  }
+  m_apos = 0;
+  m_ring.resize(qlen > 0 ? qlen : 1);
+  m_head = m_tail = 0;
+  m_qbytes = 0;
+  m_sz_batch = ((sz_batch + LOG_WRITER_ALIGN - 1) / LOG_WRITER_ALIGN) * LOG_WRITER_ALIGN;
+  if(m_sz_batch == 0)
+    m_sz_batch = LOG_WRITER_ALIGN;
+  m_bdirect = direct;
+  m_bexit = false;
+  m_th = new thread(swriter, this);
+  return true;
+}
+
+void c_log_writer::stop()
+{
+  if(!m_th)
+    return;
+
+  m_bexit = true;
+  m_cnd_req.notify_all();
+  m_cnd_space.notify_all();
+  m_th->join();
+  delete m_th;
+  m_th = NULL;
+  free(m_arena);
+  m_arena = NULL;
+}
+
+#ifdef __linux__
+int c_log_writer::open(const char * fname)
+{
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  int fd = -1;
+  if(m_bdirect){
+    // some file systems (e.g. tmpfs) reject O_DIRECT
+    fd = ::open(fname, flags | O_DIRECT, 0644);
+  }
+  if(fd < 0)
+    fd = ::open(fname, flags, 0644);
+
+  if(fd < 0)
+    cerr << "Failed to open " << fname << ":" << strerror(errno) << endl;
+  return fd;
+}
+#else
+int c_log_writer::open(const char * fname)
+{
+  FILE * pf = fopen(fname, "wb");
+  if(!pf){
+    cerr << "Failed to open " << fname << ":" << strerror(errno) << endl;
+    return -1;
+  }
+
+  unique_lock<mutex> lock(m_mtx_fps);
+  int fd = 0;
+  for(; fd < (int) m_fps.size(); fd++)
+    if(m_fps[fd] == NULL)
+      break;
+  if(fd == (int) m_fps.size())
+    m_fps.push_back(pf);
+  else
+    m_fps[fd] = pf;
+  return fd;
+}
+
+FILE * c_log_writer::get_fp(const int fd)
+{
+  unique_lock<mutex> lock(m_mtx_fps);
+  return (fd >= 0 && fd < (int) m_fps.size() ? m_fps[fd] : NULL);
+}
+#endif
+
+void c_log_writer::close(const int fd)
+{
+  // never dropped unless stopped. after the writer exits, closed here.
+  if(!enqueue(fd, NULL, 0, true) && !m_th)
+    close_file(fd);
+}
+
+bool c_log_writer::is_full(const size_t len)
+{
+  unsigned int head = m_head.load(memory_order_acquire);
+  unsigned int tail = m_tail.load(memory_order_relaxed);
+  if(tail - head >= m_ring.size())
+    return true;
+  long long qbytes = m_qbytes.load(memory_order_acquire);
+  return qbytes + (long long) len > m_qbytes_max;
+}
+
+bool c_log_writer::enqueue(const int fd, const char * data, const size_t len,
+			   const bool block)
+{
+  // stop() lets the writer exit only after the producer leaves here, and
+  // the producer finding m_bexit set fails.
+  m_nenq.fetch_add(1);
+  if(m_bexit.load()){
+    m_nenq.fetch_sub(1);
+    return false;
+  }
+
+  if(is_full(len)){
+    if(!block){
+      m_nenq.fetch_sub(1);
+      return false;
+    }
+
+    long long tstart = get_mono_time_nsec();
+    m_count_block.fetch_add(1, memory_order_relaxed);
+    unique_lock<mutex> lock(m_mtx);
+    // the writer keeps draining the queue until this producer leaves.
+    while(is_full(len)){
+      m_cnd_space.wait_for(lock, chrono::milliseconds(10));
+    }
+    lock.unlock();
+    m_nsec_block.fetch_add(get_mono_time_nsec() - tstart, memory_order_relaxed);
+  }
+
+  s_req req;
+  req.fd = fd;
+  req.pos = m_apos;
+  req.len = len;
+  if(len > 0){
+    size_t n = min(len, (size_t) m_qbytes_max - m_apos);
+    memcpy(m_arena + m_apos, data, n);
+    memcpy(m_arena, data + n, len - n);
+    m_apos = (m_apos + len) % (size_t) m_qbytes_max;
+  }
+
+  unsigned int tail = m_tail.load(memory_order_relaxed);
+  m_ring[tail % m_ring.size()] = req;
+  m_qbytes.fetch_add((long long) len, memory_order_relaxed);
+  m_tail.store(tail + 1, memory_order_release);
+  m_nenq.fetch_sub(1);
+  m_cnd_req.notify_one();
+  return true;
+}
+
+bool c_log_writer::push(const int fd, const char * data, const size_t len, const bool block)
+{
+  if(fd < 0 || len == 0)
+    return false;
+
+  if(len > (size_t) m_qbytes_max || !enqueue(fd, data, len, block)){
+    m_count_drop.fetch_add(1, memory_order_relaxed);
+    m_bytes_drop.fetch_add((long long) len, memory_order_relaxed);
+    return false;
+  }
+  m_count_push.fetch_add(1, memory_order_relaxed);
+  return true;
+}
+
+void c_log_writer::append_file(int fd, s_file & f, const char * p, size_t len)
+{
+  while(f.buf && len > 0){
+    size_t n = min(len, m_sz_batch - f.len);
+    memcpy(f.buf + f.len, p, n);
+    f.len += n;
+    p += n;
+    len -= n;
+    if(f.len == m_sz_batch)
+      write_file(fd, f, f.len);
+  }
+}
+
+void c_log_writer::write_file(int fd, s_file & f, const size_t len)
+{
+  size_t done = 0;
+#ifdef __linux__
+  while(done < len){
+    ssize_t res = ::write(fd, f.buf + done, len - done);
+    if(res < 0){
+      if(errno == EINTR)
+	continue;
+      if(m_count_err.fetch_add(1, memory_order_relaxed) == 0)
+	cerr << "c_log_writer: write failed:" << strerror(errno) << endl;
+      break;
+    }
+    done += (size_t) res;
+  }
+#else
+  FILE * pf = get_fp(fd);
+  if(pf)
+    done = fwrite(f.buf, 1, len, pf);
+  if(done < len && m_count_err.fetch_add(1, memory_order_relaxed) == 0)
+    cerr << "c_log_writer: write failed:" << strerror(errno) << endl;
+#endif
+  m_bytes_written.fetch_add((long long) done, memory_order_relaxed);
+  m_count_batch.fetch_add(1, memory_order_relaxed);
+
+  // the rest is moved to the head of the buffer
+  if(len < f.len)
+    memmove(f.buf, f.buf + len, f.len - len);
+  f.len -= len;
+}
+
+// writes the aligned part of the batch buffer, and the rest also if tail is 
+// true. For O_DIRECT files, the unaligned tail is written after O_DIRECT 
+// is cleared.
+void c_log_writer::flush_file(int fd, s_file & f, const bool tail)
+{
+  size_t len = f.direct ? (f.len / LOG_WRITER_ALIGN) * LOG_WRITER_ALIGN : f.len;
+  if(len > 0)
+    write_file(fd, f, len);
+
+  if(tail && f.len > 0){
+#ifdef __linux__
+    if(f.direct){
+      int flags = fcntl(fd, F_GETFL);
+      fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+      f.direct = false;
+    }
+#endif
+    write_file(fd, f, f.len);
+  }
+}
+
+void c_log_writer::close_file(int fd)
+{
+  map<int, s_file>::iterator itr = m_files.find(fd);
+  if(itr != m_files.end()){
+    flush_file(fd, itr->second, true);
+    free(itr->second.buf);
+    m_files.erase(itr);
+  }
+#ifdef __linux__
+  ::close(fd);
+#else
+  unique_lock<mutex> lock(m_mtx_fps);
+  if(fd >= 0 && fd < (int) m_fps.size() && m_fps[fd]){
+    fclose(m_fps[fd]);
+    m_fps[fd] = NULL;
+  }
+#endif
+}
+
+void c_log_writer::swriter(c_log_writer * ptr)
+{
+  ptr->writer();
+}
+
+void c_log_writer::writer()
+{
+  while(1){
+    unsigned int head = m_head.load(memory_order_relaxed);
+    if(head == m_tail.load(memory_order_acquire)){
+      // queue is empty. write the aligned parts not to keep them long.
+      for(map<int, s_file>::iterator itr = m_files.begin(); itr != m_files.end(); itr++)
+	flush_file(itr->first, itr->second, false);
+
+      if(m_bexit.load() && m_nenq.load() == 0 &&
+	 head == m_tail.load(memory_order_acquire))
+	break;
+
+      unique_lock<mutex> lock(m_mtx);
+      m_cnd_req.wait_for(lock, chrono::milliseconds(10));
+      continue;
+    }
+
+    s_req req = m_ring[head % m_ring.size()];
+    if(req.len == 0){
+      close_file(req.fd);
+    }else{
+      map<int, s_file>::iterator itr = m_files.find(req.fd);
+      if(itr == m_files.end()){
+	s_file f;
+#ifdef __linux__
+	if(posix_memalign((void**)&f.buf, LOG_WRITER_ALIGN, m_sz_batch) != 0)
+	  f.buf = NULL;
+	f.direct = (fcntl(req.fd, F_GETFL) & O_DIRECT) != 0;
+#else
+	f.buf = (char*) malloc(m_sz_batch);
+	f.direct = false;
+#endif
+	if(!f.buf)
+	  cerr << "c_log_writer: failed to allocate batch buffer." << endl;
+	f.len = 0;
+	itr = m_files.insert(map<int, s_file>::value_type(req.fd, f)).first;
+      }
+
+      // the record may wrap around the end of the arena
+      size_t n = min(req.len, (size_t) m_qbytes_max - req.pos);
+      append_file(req.fd, itr->second, m_arena + req.pos, n);
+      append_file(req.fd, itr->second, m_arena, req.len - n);
+    }
+
+    m_qbytes.fetch_sub((long long) req.len, memory_order_release);
+    m_head.store(head + 1, memory_order_release);
+    m_cnd_space.notify_one();
+  }
+
+  // the files not closed by the producer
+  while(!m_files.empty())
+    close_file(m_files.begin()->first);
+}
@@ -0,0 +1,128 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_log_writer.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_log_writer.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_log_writer.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_LOG_WRITER_H_
+#define _C_LOG_WRITER_H_
+
+#include <cstdio>
+#include <vector>
+#include <map>
+#include "aws_thread.h"
+
+#define LOG_WRITER_ALIGN 4096 // alignment of the batch buffer and writes for O_DIRECT
+
+// c_log_writer writes serialized log records to files in a dedicated thread.
+// A single producer pushes records into a bounded lock-free ring, copying
+// the bytes into a preallocated arena of the byte budget, and the writer
+// thread packs them into aligned batch buffers of each file and writes a
+// batch at once. If the ring or the arena is full, push() drops the 
+// record, or blocks until space is made if block is true. A record larger
+// than the arena is always dropped. 
+// Optionally the files are opened with O_DIRECT, then the batches bypass
+// the page cache. Only for Linux. On the other platforms, the files are 
+// written by buffered fwrite() and the direct option is ignored.
+class c_log_writer
+{
+ private:
+  struct s_req{
+    int fd;
+    size_t pos; // position in the arena
+    size_t len; // 0 for closing the file
+  };
+
+  struct s_file{
+    char * buf; // batch buffer aligned to LOG_WRITER_ALIGN
+    size_t len;
+    bool direct;
+  };
+
+  // ring buffer, m_head is advanced only by the writer, m_tail only by the producer
+  std::vector<s_req> m_ring;
+  std::atomic<unsigned int> m_head, m_tail;
+  std::atomic<long long> m_qbytes;
+  long long m_qbytes_max;
+
+  // the records are stored in the arena of m_qbytes_max bytes in the order
+  // of the ring. m_apos is advanced only by the producer.
+  char * m_arena;
+  size_t m_apos;
+  std::atomic<int> m_nenq; // producers in enqueue(), the writer waits them to exit
+
+  size_t m_sz_batch;
+  bool m_bdirect;
+
+  std::map<int, s_file> m_files; // used only in the writer thread
+#ifndef __linux__
+  // file handles returned by open() are the indices of m_fps
+  std::vector<FILE*> m_fps;
+  std::mutex m_mtx_fps;
+  FILE * get_fp(const int fd);
+#endif
+
+  std::thread * m_th;
+  std::atomic<bool> m_bexit;
+  std::mutex m_mtx;
+  std::condition_variable m_cnd_req, m_cnd_space;
+
+  // statistics
+  std::atomic<long long> m_count_push, m_count_drop, m_bytes_drop;
+  std::atomic<long long> m_count_block, m_nsec_block;
+  std::atomic<long long> m_count_batch, m_bytes_written, m_count_err;
+
+  bool is_full(const size_t len);
+  bool enqueue(const int fd, const char * data, const size_t len, const bool block);
+  void append_file(int fd, s_file & f, const char * p, size_t len);
+  void write_file(int fd, s_file & f, const size_t len);
+  void flush_file(int fd, s_file & f, const bool tail);
+  void close_file(int fd);
+  static void swriter(c_log_writer * ptr);
+  void writer();
+
+ public:
+  c_log_writer();
+  ~c_log_writer();
+
+  // qlen: maximum number of records queued
+  // qbytes_max: maximum bytes queued
+  // sz_batch: size of the batch buffer of each file (rounded up to LOG_WRITER_ALIGN)
+  // direct: open the files with O_DIRECT (Linux only)
+  bool start(const int qlen, const long long qbytes_max, 
+	     const size_t sz_batch, const bool direct);
+
+  // writes all the queued records including those of a blocked push(), 
+  // and closes the files. push() after stop() fails.
+  void stop();
+
+  // open a file to be written. returns the file handle or -1.
+  int open(const char * fname);
+
+  // the file is closed after the records pushed before.
+  void close(const int fd);
+
+  // the record is copied. returns false if dropped. 
+  bool push(const int fd, const char * data, const size_t len, const bool block);
+
+  long long get_count_push(){ return m_count_push.load(std::memory_order_relaxed); }
+  long long get_count_drop(){ return m_count_drop.load(std::memory_order_relaxed); }
+  long long get_bytes_drop(){ return m_bytes_drop.load(std::memory_order_relaxed); }
+  long long get_count_block(){ return m_count_block.load(std::memory_order_relaxed); }
+  long long get_nsec_block(){ return m_nsec_block.load(std::memory_order_relaxed); }
+  long long get_count_batch(){ return m_count_batch.load(std::memory_order_relaxed); }
+  long long get_bytes_written(){ return m_bytes_written.load(std::memory_order_relaxed); }
+  long long get_count_err(){ return m_count_err.load(std::memory_order_relaxed); }
+  long long get_qbytes(){ return m_qbytes.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,138 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_nmea_scanner.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_nmea_scanner.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_nmea_scanner.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include "c_nmea_scanner.h"
+
+static inline int hex2i(const char c)
+{
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+c_nmea_scanner::c_nmea_scanner(const int size): m_buf(NULL), 
+  m_size(size), m_head(0), m_tail(0), m_count_sentence(0),
+  m_count_bad_chksum(0), m_count_long(0), m_count_skip(0)
+{
+  if(m_size < 2 * (NMEA_LEN_MAX + 1))
+    m_size = 2 * (NMEA_LEN_MAX + 1);
+  m_buf = new char[m_size];
+}
+
+c_nmea_scanner::~c_nmea_scanner()
+{
+  delete[] m_buf;
+}
+
+char * c_nmea_scanner::get_wbuf(int & len)
+{
+  if(m_size - m_tail < NMEA_LEN_MAX + 1){
+    // the remaining part is an incomplete sentence.
+    int n = m_tail - m_head;
+    if(n > 0)
+      memmove(m_buf, m_buf + m_head, n);
+    m_head = 0;
+    m_tail = n;
+  }
+  len = m_size - m_tail;
+  return m_buf + m_tail;
+}
+
+int c_nmea_scanner::append(const char * data, const int len)
+{
+  int done = 0;
+  while(done < len){
+    int lw;
+    char * pw = get_wbuf(lw);
+    int n = (len - done < lw ? len - done : lw);
+    memcpy(pw, data + done, n);
+    commit(n);
+    done += n;
+    if(n == lw)
+      break; // the caller should consume the sentences before continuing
+  }
+  return done;
+}
+
+const char * c_nmea_scanner::next(int & len, e_chk & chk)
+{
+  while(m_head < m_tail){
+    // seek for the head mark. garbage and LF after the previous sentence
+    // are skipped here.
+    char * p = m_buf + m_head;
+    char * e = m_buf + m_tail;
+    if(*p != '$' && *p != '!'){
+      char * pd = (char*) memchr(p, '$', e - p);
+      char * pe = (char*) memchr(p, '!', (pd ? pd : e) - p);
+      char * ps = (pe ? pe : pd);
+      if(!ps){
+	if(e - p > 1 || (*p != '\r' && *p != '\n'))
+	  m_count_skip++;
+	m_head = m_tail = 0;
+	return NULL;
+      }
+      if(ps - p > 1 || (*p != '\r' && *p != '\n'))
+	m_count_skip++;
+      m_head = (int)(ps - m_buf);
+      p = ps;
+    }
+
+    // scan for the terminating CR. (LF following CR is skipped as garbage 
+    // in the next call.)
+    char * qe = (e - p > NMEA_LEN_MAX ? p + NMEA_LEN_MAX + 1 : e);
+    char * q = (char*) memchr(p + 1, '\r', qe - p - 1);
+    if(!q){
+      if(qe == e)
+	return NULL; // incomplete, waiting for the rest
+      // no terminator in NMEA_LEN_MAX characters. skips the head mark.
+      m_count_long++;
+      m_head++;
+      continue;
+    }
+
+    // checksum of the characters between the head mark and '*', which is 
+    // usually three characters before the terminator.
+    char * ast = (q - p >= 4 && q[-3] == '*' ? q - 3 : 
+		  (char*) memchr(p + 1, '*', q - p - 1));
+    unsigned char sum = 0;
+    for(const char * r = p + 1, * re = (ast ? ast : q); r < re; r++)
+      sum ^= (unsigned char) *r;
+
+    *q = '\0';
+    len = (int)(q - p);
+    m_head = (int)(q - m_buf) + 1;
+
+    if(!ast){
+      chk = ECHK_NONE;
+    }else if(q - ast >= 3 && hex2i(ast[1]) >= 0 && hex2i(ast[2]) >= 0 &&
+	     ((hex2i(ast[1]) << 4) | hex2i(ast[2])) == sum){
+      chk = ECHK_OK;
+    }else{
+      chk = ECHK_BAD;
+      m_count_bad_chksum++;
+    }
+    m_count_sentence++;
+    return p;
+  }
+
+  m_head = m_tail = 0;
+  return NULL;
+}
@@ -0,0 +1,96 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_nmea_scanner.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_nmea_scanner.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_nmea_scanner.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_NMEA_SCANNER_H_
+#define _C_NMEA_SCANNER_H_
+
+#define NMEA_SCAN_BUF_DEFAULT 8192
+#define NMEA_LEN_MAX 83 // without null character
+
+// c_nmea_scanner frames NMEA sentences in a receive buffer. Received bytes
+// are written directly to get_wbuf(), and next() returns the sentences as
+// null terminated strings in the buffer (the terminating CR is overwritten),
+// without copying them. Sentence boundaries are found with memchr, and the
+// checksum is validated while the sentence is still in the cache.
+//
+// The buffer is used linearly, and only the incomplete sentence at the
+// tail (at most NMEA_LEN_MAX bytes) is moved to the head when the space
+// runs out. Then the cost is linear to the received bytes even if a read
+// delivers a burst of sentences.
+class c_nmea_scanner
+{
+ public:
+  enum e_chk{
+    ECHK_NONE, // no checksum field
+    ECHK_OK, 
+    ECHK_BAD
+  };
+
+ private:
+  char * m_buf;
+  int m_size;
+  int m_head, m_tail; // [m_head, m_tail) is not scanned yet
+  
+  long long m_count_sentence, m_count_bad_chksum, m_count_long, m_count_skip;
+
+ public:
+  c_nmea_scanner(const int size = NMEA_SCAN_BUF_DEFAULT);
+  ~c_nmea_scanner();
+
+  void reset()
+  {
+    m_head = m_tail = 0;
+  }
+
+  // returns the free space of at least NMEA_LEN_MAX bytes. len is set to
+  // its size.
+  char * get_wbuf(int & len);
+
+  // notifies len bytes are written to the buffer given by get_wbuf()
+  void commit(const int len)
+  {
+    m_tail += len;
+  }
+
+  // writes len bytes into the buffer. returns the bytes written. 
+  int append(const char * data, const int len);
+
+  // returns the next sentence, or NULL if no complete sentence remains.
+  // len is set to the length of the sentence, and chk to the checksum 
+  // status. The sentence is valid until the next get_wbuf() or append().
+  const char * next(int & len, e_chk & chk);
+
+  long long get_count_sentence() const
+  {
+    return m_count_sentence;
+  }
+
+  long long get_count_bad_chksum() const
+  {
+    return m_count_bad_chksum;
+  }
+
+  long long get_count_long() const
+  {
+    return m_count_long;
+  }
+
+  long long get_count_skip() const
+  {
+    return m_count_skip;
+  }
+};
+
+#endif
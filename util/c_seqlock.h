@@ -0,0 +1,86 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_seqlock.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_seqlock.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_seqlock.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_SEQLOCK_H_
+#define _C_SEQLOCK_H_
+
+#include <cstring>
+#include "aws_thread.h"
+
+// c_seqlock<T> holds a small trivially copyable record T which is written
+// rarely and read frequently. Readers never block the writer, and take a
+// consistent copy of the record by retrying while the writer is updating it.
+// Writers are not serialized by c_seqlock itself. In the channels, the
+// writers call write() or begin_write()/end_write() holding the channel's
+// mutex.
+template <class T> class c_seqlock
+{
+ private:
+  std::atomic<unsigned int> m_seq; // odd while the writer is updating m_data
+  T m_data;
+
+ public:
+  c_seqlock():m_seq(0)
+  {
+    memset((void*)&m_data, 0, sizeof(T));
+  }
+
+  // begin_write() returns the record to be updated in place. The fields not
+  // updated keep the values previously written.
+  T & begin_write()
+  {
+    unsigned int seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return m_data;
+  }
+
+  void end_write()
+  {
+    unsigned int seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_release);
+  }
+
+  void write(const T & data)
+  {
+    begin_write();
+    memcpy((void*)&m_data, (const void*)&data, sizeof(T));
+    end_write();
+  }
+
+  void read(T & data) const
+  {
+    while(1){
+      unsigned int seq0 = m_seq.load(std::memory_order_acquire);
+      if(seq0 & 1){
+	std::this_thread::yield();
+	continue;
+      }
+      memcpy((void*)&data, (const void*)&m_data, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      unsigned int seq1 = m_seq.load(std::memory_order_relaxed);
+      if(seq0 == seq1)
+	break;
+    }
+  }
+
+  // number of the records written so far
+  unsigned int get_count() const
+  {
+    return m_seq.load(std::memory_order_relaxed) >> 1;
+  }
+};
+
+#endif
@@ -0,0 +1,154 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_thread_pool.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_thread_pool.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_thread_pool.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <vector>
+using namespace std;
+
+#include "c_thread_pool.h"
+
+c_thread_pool::c_thread_pool():m_next(0), m_num_pending(0), m_bexit(true)
+{
+}
+
+c_thread_pool::~c_thread_pool()
+{
+  stop();
+}
+
+bool c_thread_pool::start(int num_workers)
+{
+  if(!m_bexit)
+    return false;
+
+  if(num_workers <= 0)
+    num_workers = (int) thread::hardware_concurrency();
+  if(num_workers <= 0)
+    num_workers = 1;
+
+  m_bexit = false;
+  m_next = 0;
+  m_num_pending = 0;
+  m_workers.resize(num_workers);
+  for(int iw = 0; iw < num_workers; iw++)
+    m_workers[iw] = new s_worker;
+
+  for(int iw = 0; iw < num_workers; iw++)
+    m_workers[iw]->pth = new thread(sworker, this, iw);
+
+  return true;
+}
+
+void c_thread_pool::stop()
+{
+  {
+    unique_lock<mutex> lock(m_mtx);
+    if(m_bexit)
+      return;
+    m_bexit = true;
+  }
+  m_cnd.notify_all();
+
+  for(int iw = 0; iw < m_workers.size(); iw++){
+    m_workers[iw]->pth->join();
+    delete m_workers[iw]->pth;
+    delete m_workers[iw];
+  }
+  m_workers.clear();
+}
+
+void c_thread_pool::push(TaskFunc func, void * arg)
+{
+  s_task task;
+  task.func = func;
+  task.arg = arg;
+
+  s_worker * pw = m_workers[m_next];
+  m_next = (m_next + 1) % m_workers.size();
+  {
+    unique_lock<mutex> lock(pw->mtx);
+    pw->tasks.push_back(task);
+  }
+
+  {
+    unique_lock<mutex> lock(m_mtx);
+    m_num_pending++;
+  }
+  m_cnd.notify_one();
+}
+
+bool c_thread_pool::pop(int iworker, s_task & task)
+{
+  s_worker * pw = m_workers[iworker];
+  unique_lock<mutex> lock(pw->mtx);
+  if(pw->tasks.empty())
+    return false;
+  task = pw->tasks.front();
+  pw->tasks.pop_front();
+  return true;
+}
+
+bool c_thread_pool::steal(int iworker, s_task & task)
+{
+  int num_workers = (int) m_workers.size();
+  for(int i = 1; i < num_workers; i++){
+    s_worker * pw = m_workers[(iworker + i) % num_workers];
+    unique_lock<mutex> lock(pw->mtx);
+    if(pw->tasks.empty())
+      continue;
+    task = pw->tasks.back();
+    pw->tasks.pop_back();
+    return true;
+  }
+  return false;
+}
+
+void c_thread_pool::sworker(c_thread_pool * ptr, int iworker)
+{
+  s_worker * pw = ptr->m_workers[iworker];
+  while(1){
+    {
+      unique_lock<mutex> lock(ptr->m_mtx);
+      ptr->m_cnd.wait(lock, [ptr]{return ptr->m_num_pending > 0 || ptr->m_bexit;});
+      if(ptr->m_num_pending == 0)
+	break; // exit only after all the pending tasks are processed
+      ptr->m_num_pending--;
+    }
+
+    // a pending task is reserved above, then the task is certainly found
+    // in one of the queues.
+    s_task task;
+    while(1){
+      if(ptr->pop(iworker, task))
+	break;
+      if(ptr->steal(iworker, task)){
+	pw->count_steal++;
+	break;
+      }
+      this_thread::yield();
+    }
+
+    task.func(task.arg);
+    pw->count_exec++;
+  }
+}
+
+void c_thread_pool::print_stat(ostream & out)
+{
+  for(int iw = 0; iw < m_workers.size(); iw++){
+    out << "Worker " << iw << ": executed " << m_workers[iw]->count_exec
+	<< " stolen " << m_workers[iw]->count_steal << endl;
+  }
+}
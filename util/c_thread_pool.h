@@ -0,0 +1,81 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// c_thread_pool.h is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// c_thread_pool.h is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with c_thread_pool.h.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _C_THREAD_POOL_H_
+#define _C_THREAD_POOL_H_
+
+#include <deque>
+#include <vector>
+#include <iostream>
+#include "aws_thread.h"
+
+// c_thread_pool is a fixed size worker pool with work stealing. Each worker
+// has its own task queue. push() distributes tasks to the queues in round
+// robin, a worker takes tasks from the head of its own queue, and steals from
+// the tail of the other workers' queues if its own queue is empty.
+class c_thread_pool
+{
+ public:
+  typedef void (*TaskFunc)(void * arg);
+
+ private:
+  struct s_task{
+    TaskFunc func;
+    void * arg;
+  };
+
+  struct s_worker{
+    mutex mtx;
+    deque<s_task> tasks;
+    thread * pth;
+    long long count_exec, count_steal;
+    s_worker():pth(NULL), count_exec(0), count_steal(0){}
+  };
+
+  vector<s_worker*> m_workers;
+  unsigned int m_next; // worker the next task is pushed to
+
+  // sleeping workers wait on m_cnd until tasks are pushed
+  mutex m_mtx;
+  condition_variable m_cnd;
+  int m_num_pending;
+  bool m_bexit;
+
+  bool pop(int iworker, s_task & task);
+  bool steal(int iworker, s_task & task);
+  static void sworker(c_thread_pool * ptr, int iworker);
+
+ public:
+  c_thread_pool();
+  ~c_thread_pool();
+
+  // start num_workers threads. if num_workers <= 0, the number of
+  // the hardware threads is used.
+  bool start(int num_workers = 0);
+
+  // stop workers after all the pushed tasks are processed.
+  void stop();
+
+  void push(TaskFunc func, void * arg);
+
+  int get_num_workers()
+  {
+    return (int) m_workers.size();
+  }
+
+  void print_stat(ostream & out);
+};
+
+#endif
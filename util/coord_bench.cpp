@@ -0,0 +1,152 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// coord_bench.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// coord_bench.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with coord_bench.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// coord_bench measures the throughput of the coordinate transformations in
+// aws_coord, comparing the per point functions with the batch functions,
+// and reports the largest difference between them. The points are placed
+// randomly within the given range around a random origin, as the
+// coastlines around the own ship.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+#include "aws_coord.h"
+#include "c_lat_hist.h"
+
+static void report(const char * name, long long nsec, long long count)
+{
+  double sec = (double) nsec * 1e-9;
+  printf("%-16s %10lld points %8.3f sec %12.0f points/s\n",
+	 name, count, sec, (double) count / sec);
+}
+
+static double urand(double vmin, double vmax)
+{
+  return vmin + (vmax - vmin) * ((double) rand() / (double) RAND_MAX);
+}
+
+int main(int argc, char ** argv)
+{
+  int npts = (argc > 1 ? atoi(argv[1]) : 100000);
+  int nrep = (argc > 2 ? atoi(argv[2]) : 10);
+  double rng = (argc > 3 ? atof(argv[3]) : 50000.);
+  if(npts <= 0 || nrep <= 0 || rng <= 0){
+    cout << "Usage: coord_bench [<points> [<repeat> [<range in meter>]]]" << endl;
+    return 1;
+  }
+
+  srand(0);
+  double lat0 = urand(-80., 80.) * PI / 180.;
+  double lon0 = urand(-180., 180.) * PI / 180.;
+  double drad = rng / AE;
+  vector<double> lat(npts), lon(npts), alt(npts);
+  for(int i = 0; i < npts; i++){
+    lat[i] = lat0 + urand(-drad, drad);
+    lon[i] = lon0 + urand(-drad, drad) / cos(lat0);
+    alt[i] = urand(-10., 100.);
+  }
+  double xorg, yorg, zorg;
+  bihtoecef(lat0, lon0, 0., xorg, yorg, zorg);
+  Mat Rwrld;
+  getwrldrot(lat0, lon0, Rwrld);
+  s_rot3 Rw;
+  getwrldrot(lat0, lon0, Rw);
+
+  cout << npts << " points within " << rng << "m around ("
+       << lat0 * 180. / PI << "," << lon0 * 180. / PI << "), repeated "
+       << nrep << " times." << endl;
+
+  long long count = (long long) npts * nrep;
+  vector<double> x(npts), y(npts), z(npts);
+  vector<double> xb(npts), yb(npts), zb(npts);
+  vector<double> u(npts), v(npts), w(npts);
+
+  // bih to ecef
+  long long t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    for(int i = 0; i < npts; i++)
+      bihtoecef(lat[i], lon[i], alt[i], x[i], y[i], z[i]);
+  report("bihtoecef", get_mono_time_nsec() - t0, count);
+
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    bihtoecef(lat.data(), lon.data(), alt.data(), xb.data(), yb.data(), zb.data(), npts);
+  report("bihtoecef batch", get_mono_time_nsec() - t0, count);
+
+  double emax = 0.;
+  for(int i = 0; i < npts; i++)
+    emax = max(emax, max(fabs(x[i] - xb[i]), max(fabs(y[i] - yb[i]), fabs(z[i] - zb[i]))));
+  printf("max error %g m\n", emax);
+
+  // ecef to bih
+  vector<double> latb(npts), lonb(npts), altb(npts);
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    for(int i = 0; i < npts; i++)
+      eceftobih(x[i], y[i], z[i], u[i], v[i], w[i]);
+  report("eceftobih", get_mono_time_nsec() - t0, count);
+
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    eceftobih(x.data(), y.data(), z.data(), latb.data(), lonb.data(), altb.data(), npts);
+  report("eceftobih batch", get_mono_time_nsec() - t0, count);
+
+  double erad = 0.;
+  emax = 0.;
+  for(int i = 0; i < npts; i++){
+    erad = max(erad, max(fabs(u[i] - latb[i]), fabs(v[i] - lonb[i])));
+    emax = max(emax, fabs(w[i] - altb[i]));
+  }
+  printf("max error %g rad %g m\n", erad, emax);
+
+  // ecef to world
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    for(int i = 0; i < npts; i++)
+      eceftowrld(Rwrld, xorg, yorg, zorg, x[i], y[i], z[i], u[i], v[i], w[i]);
+  report("eceftowrld", get_mono_time_nsec() - t0, count);
+
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    eceftowrld(Rw, xorg, yorg, zorg, x.data(), y.data(), z.data(),
+	       xb.data(), yb.data(), zb.data(), npts);
+  report("eceftowrld batch", get_mono_time_nsec() - t0, count);
+
+  emax = 0.;
+  for(int i = 0; i < npts; i++)
+    emax = max(emax, max(fabs(u[i] - xb[i]), max(fabs(v[i] - yb[i]), fabs(w[i] - zb[i]))));
+  printf("max error %g m\n", emax);
+
+  // world to ecef, round trip
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++)
+    wrldtoecef(Rw, xorg, yorg, zorg, xb.data(), yb.data(), zb.data(),
+	       u.data(), v.data(), w.data(), npts);
+  report("wrldtoecef batch", get_mono_time_nsec() - t0, count);
+
+  emax = 0.;
+  for(int i = 0; i < npts; i++)
+    emax = max(emax, max(fabs(u[i] - x[i]), max(fabs(v[i] - y[i]), fabs(w[i] - z[i]))));
+  printf("max round trip error %g m\n", emax);
+
+  return 0;
+}
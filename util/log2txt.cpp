@@ -71,6 +71,7 @@ using namespace std;
 #include "../util/aws_sock.h"
 #include "../util/aws_serial.h"
 #include "../util/c_clock.h"
+#include "../util/c_log_map.h"
 
 #include <opencv2/opencv.hpp>
 using namespace cv;
@@ -206,16 +207,21 @@ int main(int argc, char ** argv)
 	cout << "Initializing channel factory." << endl;
 	ch_base::init();
 
+	// the log is mapped into memory and read sequentially without copy.
+	// empty or unmappable logs are read through the file stream.
 	cout << "Opening " << argv[2] << "." << endl;
-	FILE * pbfile = fopen(argv[2], "rb");
+	c_log_map lm;
+	FILE * pbfile = NULL;
+	if(!lm.open(argv[2])){
+		pbfile = fopen(argv[2], "rb");
+		if(!pbfile){
+			cerr << "Failed to open " << argv[2] << endl;
+			return 1;
+		}
+	}
 	cout << "Opening " << fname << "." << endl;
 	FILE * ptfile = fopen(fname, "w");
 
-	if(!pbfile){
-		cerr << "Failed to open " << argv[2] << endl;
-		return 1;
-	}
-
 	if(!ptfile){
 		cerr << "Failed to open " << fname << endl;
 		return 1;
@@ -229,7 +235,11 @@ int main(int argc, char ** argv)
 	}
 
 	cout << "Converting ... ";
-	if(!pchan->log2txt(pbfile, ptfile)){
+	bool res = (pbfile ? pchan->log2txt(pbfile, ptfile) :
+		pchan->log2txt_map(lm, ptfile));
+	if(pbfile)
+		fclose(pbfile);
+	if(!res){
 		cerr << "Failed to convert " << argv[2] << "." << endl;
 		return 1;
 	}
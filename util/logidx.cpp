@@ -0,0 +1,92 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// logidx.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// logidx.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with logidx.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// logidx builds the time-to-offset index (.idx) of a channel log file 
+// written without index, so that f_read_ch_log can seek in it.
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <list>
+#include <map>
+
+using namespace std;
+
+#include "../util/aws_stdlib.h"
+#include "../util/c_clock.h"
+
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+#include "../util/aws_thread.h"
+#include "../util/c_log_index.h"
+#include "../channel/ch_base.h"
+
+bool g_kill;
+
+int main(int argc, char ** argv)
+{
+	if(argc != 3 && argc != 4){
+		printf("Usage: logidx <channel type> <log file> [<interval in second>]\n");
+		return 1;
+	}
+
+	float intvl = 1.0f;
+	if(argc == 4)
+		intvl = (float) atof(argv[3]);
+
+	char fidx[1024];
+	c_log_index::get_index_name(argv[2], fidx, 1024);
+
+	ch_base::init();
+	ch_base * pchan = ch_base::create(argv[1], "logidx");
+	if(!pchan){
+		cerr << "Channel type " << argv[1] << " cannot be found." << endl;
+		return 1;
+	}
+
+	FILE * pbfile = fopen(argv[2], "rb");
+	if(!pbfile){
+		cerr << "Failed to open " << argv[2] << endl;
+		return 1;
+	}
+
+	c_log_index idx;
+	if(!idx.open(fidx, (long long)(intvl * SEC))){
+		fclose(pbfile);
+		return 1;
+	}
+
+	cout << "Indexing " << argv[2] << " to " << fidx << " ... ";
+	long long nrec = 0, trec;
+	long long pos = aws_ftell(pbfile);
+	while(pchan->skip_rec(pbfile, trec)){
+		idx.add(trec, pos);
+		nrec++;
+		pos = aws_ftell(pbfile);
+	}
+	idx.close();
+	fclose(pbfile);
+
+	if(nrec == 0){
+		cerr << "No record found. Channel type " << argv[1] << " may not support indexing." << endl;
+		return 1;
+	}
+	cout << "done. " << nrec << " records, " << idx.size() << " entries." << endl;
+	return 0;
+}
@@ -0,0 +1,64 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// mapconv.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// mapconv.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with mapconv.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// mapconv rewrites the layer data of a map database (the directory given
+// to f_map as "path") stored in old formats in the current format. 
+// Coast lines are rewritten in the packed format to be mapped directly.
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <list>
+#include <map>
+
+using namespace std;
+
+#include "../util/aws_stdlib.h"
+#include "../util/aws_thread.h"
+
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+#include "../util/aws_coord.h"
+#include "../util/aws_map.h"
+
+bool g_kill;
+
+int main(int argc, char ** argv)
+{
+	if(argc != 2){
+		printf("Usage: mapconv <map path>\n");
+		return 1;
+	}
+
+	AWSMap2::MapDataBase db;
+	db.setPath(argv[1]);
+	if(!db.init()){
+		cerr << "Failed to initialize map database in " << argv[1] << endl;
+		return 1;
+	}
+
+	cout << "Converting " << argv[1] << " ... " << endl;
+	if(!db.convert()){
+		cerr << "Failed to convert some of the layer data." << endl;
+		return 1;
+	}
+	db.save();
+	cout << "done." << endl;
+	return 0;
+}
@@ -0,0 +1,190 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// nmea_bench.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// nmea_bench.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with nmea_bench.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// nmea_bench replays the sentences in a .nmea log written by f_nmea as a
+// byte stream, and measures the framing throughput of the byte copying
+// extractor formerly used in f_nmea and of c_nmea_scanner. The stream is
+// given to the extractors in the chunks of the size specified, emulating 
+// the bursts delivered by a read.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+using namespace std;
+
+#include "c_lat_hist.h"
+#include "c_nmea_scanner.h"
+
+#define LEGACY_BUF 166
+
+// the extractor f_nmea used before c_nmea_scanner. Each complete sentence 
+// is copied byte by byte, and the rest of the buffer is shifted to the head.
+struct s_legacy{
+  char buf[LEGACY_BUF];
+  int head, tail;
+  char nmea[84];
+  int nmea_tail;
+  long long count;
+
+  s_legacy():head(0), tail(0), nmea_tail(0), count(0)
+  {
+  }
+
+  void extract()
+  {
+    while(tail){
+      if(nmea_tail == 0){
+	for(; buf[head] != '!' && buf[head] != '$' && head < tail; head++){
+	  if(!buf[head]){
+	    head = tail = nmea_tail = 0;
+	    return;
+	  }
+	}
+	if(head == tail){
+	  head = tail = 0;
+	  break;
+	}
+      }
+
+      for(; head < tail && nmea_tail < 84; head++, nmea_tail++){
+	if(!buf[head]){
+	  head = tail = nmea_tail = 0;
+	  return;
+	}
+	nmea[nmea_tail] = buf[head];
+	if(buf[head] == 0x0D){
+	  nmea[nmea_tail] = '\0';
+	  nmea_tail = -1;
+	  break;
+	}else if(nmea_tail == 84){
+	  nmea_tail = 0;
+	}
+      }
+
+      if(head == tail){
+	head = tail = 0;
+	break;
+      }
+
+      if(nmea_tail == -1){
+	count++;
+	int itail = 0;
+	for(; head < tail; head++, itail++)
+	  buf[itail] = buf[head];
+	head = 0;
+	tail = itail;
+	nmea_tail = 0;
+      }
+    }
+  }
+
+  // same as the reception loop of f_nmea
+  void feed(const char * data, int len)
+  {
+    while(len > 0){
+      int n = min(len, LEGACY_BUF - head);
+      memcpy(buf + head, data, n);
+      tail += n;
+      data += n;
+      len -= n;
+      extract();
+    }
+  }
+};
+
+static void report(const char * name, long long nsec, long long bytes, long long count)
+{
+  double sec = (double) nsec * 1e-9;
+  printf("%-8s %10lld sentences %8.3f sec %10.2f MB/s %12.0f sentences/s\n",
+	 name, count, sec, (double) bytes / sec * 1e-6, (double) count / sec);
+}
+
+int main(int argc, char ** argv)
+{
+  if(argc < 2){
+    cout << "Usage: nmea_bench <nmea log> [<chunk size> [<repeat>]]" << endl;
+    return 1;
+  }
+
+  int sz_chunk = (argc > 2 ? atoi(argv[2]) : 4096);
+  int nrep = (argc > 3 ? atoi(argv[3]) : 10);
+  if(sz_chunk <= 0 || nrep <= 0){
+    cerr << "Chunk size and repeat should be positive." << endl;
+    return 1;
+  }
+
+  // each line is <time string> <sentence>. The sentences are joined with CRLF.
+  ifstream flog(argv[1]);
+  if(!flog.is_open()){
+    cerr << "Failed to open " << argv[1] << endl;
+    return 1;
+  }
+
+  string stream;
+  long long nsent = 0;
+  string line;
+  while(getline(flog, line)){
+    size_t pos = line.find_first_of("$!");
+    if(pos == string::npos)
+      continue;
+    stream.append(line, pos, string::npos);
+    stream.append("\r\n");
+    nsent++;
+  }
+  cout << nsent << " sentences (" << stream.size() << " bytes) loaded. chunk "
+       << sz_chunk << " bytes, repeated " << nrep << " times." << endl;
+  if(nsent == 0)
+    return 1;
+
+  long long bytes = (long long) stream.size() * nrep;
+
+  s_legacy legacy;
+  long long t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++){
+    for(size_t pos = 0; pos < stream.size(); pos += sz_chunk){
+      legacy.feed(stream.data() + pos, (int) min((size_t) sz_chunk, stream.size() - pos));
+    }
+  }
+  report("legacy", get_mono_time_nsec() - t0, bytes, legacy.count);
+
+  c_nmea_scanner scan;
+  long long count = 0, nbad = 0;
+  t0 = get_mono_time_nsec();
+  for(int irep = 0; irep < nrep; irep++){
+    for(size_t pos = 0; pos < stream.size(); pos += sz_chunk){
+      const char * p = stream.data() + pos;
+      int n = (int) min((size_t) sz_chunk, stream.size() - pos);
+      while(n > 0){
+	int l = scan.append(p, n);
+	p += l;
+	n -= l;
+
+	int len;
+	c_nmea_scanner::e_chk chk;
+	while(scan.next(len, chk)){
+	  count++;
+	  if(chk == c_nmea_scanner::ECHK_BAD)
+	    nbad++;
+	}
+      }
+    }
+  }
+  report("scanner", get_mono_time_nsec() - t0, bytes, count);
+  cout << "invalid checksum " << nbad / nrep << " sentences per replay." << endl;
+  return 0;
+}
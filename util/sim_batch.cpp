@@ -0,0 +1,606 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// sim_batch.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// sim_batch.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with sim_batch.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// sim_batch runs AWS1 simulation scenarios headless and faster than real
+// time. Each scenario is stepped by its own virtual time with the boat
+// models of f_aws1_sim (c_model_aws1) and the controller of f_aws1_ap's
+// wp mode, the MPC (c_mpc) or the PID (c_ap_ctrl), with no clock and no
+// sleep, and the scenarios run concurrently on a thread pool. The filter
+// graph is not used, because the clock of the filters is shared in the
+// process. Then the PID runs without f_aws1_ap's learning (calc_stat),
+// with the midship rudder at 127, and without the AIS avoidance (wpav).
+//
+// Usage: sim_batch <scenario list> [-p <param file>] [-o <output dir>]
+//                  [-j <threads>] [-i <record interval sec>] [-b]
+//
+// param file: "<name>=<value>" per line, the parameters of c_model_aws1
+//   (the same names as f_aws1_sim's, with "vplane" and "integ"). Given to
+//   both the model of the MPC and the simulated boat.
+// scenario list: "<name> <seed> <duration sec> [<key>=<value> ...]" per
+//   line, '#' begins a comment. The keys are
+//     lat, lon    : start position (deg)
+//     route       : waypoints x,y/x,y/... in meter (east, north from start)
+//     rarv        : arrival radius of the waypoints (m)
+//     sog         : target speed (kts), sog0 : initial speed (kts)
+//     nais        : number of AIS ships crossing the route
+//     ais_smin, ais_smax : speed range of the AIS ships (kts)
+//     rav         : range for avoidance of the AIS ships (m)
+//     dt, tctrl   : simulation step and control interval (sec)
+//     meng_min, meng_max : range of the engine control value
+//     ctrl        : pid or mpc (default), as f_aws1_ap's "mpc" flag
+//     pc, ic, dc, ps, is, ds, smax, smin : parameters of the PID, as
+//                   f_aws1_ap's
+//     mpc_*       : parameters of c_mpc, as f_aws1_ap's
+//   other keys are the parameters of the simulated boat only (model
+//   mismatch). The AIS ships are placed by the seed, and the MPC runs
+//   without worker threads and deadline, so a scenario is reproducible.
+//
+// Outputs in <output dir>: <name>.csv (the columns of f_aws1_sim's csv),
+// <name>.bin (-b, s_sim_rec records) and summary.csv (a row per scenario).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+using namespace std;
+
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+#include "aws_coord.h"
+#include "c_clock.h"
+#include "c_lat_hist.h"
+#include "c_thread_pool.h"
+#include "../filter/c_model_aws1.h"
+#include "../filter/c_mpc.h"
+#include "../filter/c_ap_ctrl.h"
+
+// binary record (-b), native byte order
+struct s_sim_rec
+{
+  long long t;
+  double lat, lon; // radian
+  double x, y;     // meter, east and north from the start
+  double yaw, cog, sog; // radian, radian, kts
+  float rud, eng, rev;
+};
+
+struct s_ais
+{
+  double x, y, vx, vy; // at t = 0
+};
+
+struct s_scenario
+{
+  string name;
+  unsigned int seed;
+  double tdur;
+  double lat, lon;
+  vector<double> xwp, ywp;
+  double rarv, sog, sog0, rav, dt, tctrl;
+  int nais;
+  double ais_smin, ais_smax;
+  float meng_min, meng_max;
+  bool bpid;
+  c_ap_ctrl apc;
+  float smax, smin;
+  s_mpc_par mpc;
+  map<string, double> mpar;
+
+s_scenario(): seed(1), tdur(600.), lat(35.), lon(135.),
+    rarv(20.), sog(6.), sog0(0.), rav(50.), dt(0.1), tctrl(1.0),
+    nais(0), ais_smin(3.), ais_smax(12.), meng_min(80.f), meng_max(200.f),
+    bpid(false), smax(10.f), smin(3.f)
+  {
+    mpc.nworkers = 0;
+    mpc.tmax = 1e6f;
+  }
+};
+
+struct s_batch
+{
+  map<string, double> par;
+  string outdir;
+  double trec;
+  bool bbin;
+  mutex mtx;
+  ofstream fsum;
+  double tsim, twall; // totals, under mtx
+  int nruns;
+};
+
+struct s_run
+{
+  s_batch * pb;
+  s_scenario * psc;
+};
+
+static unsigned int xorshift(unsigned int & s)
+{
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+static double urand(unsigned int & s, double vmin, double vmax)
+{
+  return vmin + (vmax - vmin) * ((xorshift(s) >> 8) * (1.0 / 16777216.0));
+}
+
+static bool set_mpc_par(s_mpc_par & par, const string & key, const double val)
+{
+  if(key == "mpc_ncands") par.ncands = (int) val;
+  else if(key == "mpc_nsegs") par.nsegs = (int) val;
+  else if(key == "mpc_tseg") par.tseg = (float) val;
+  else if(key == "mpc_dt") par.dt = (float) val;
+  else if(key == "mpc_tmax") par.tmax = (float) val;
+  else if(key == "mpc_nth") par.nworkers = (int) val;
+  else if(key == "mpc_wwp") par.wwp = (float) val;
+  else if(key == "mpc_wsog") par.wsog = (float) val;
+  else if(key == "mpc_wais") par.wais = (float) val;
+  else if(key == "mpc_wcoast") par.wcoast = (float) val;
+  else if(key == "mpc_wctrl") par.wctrl = (float) val;
+  else if(key == "mpc_dcoast") par.dcoast = (float) val;
+  else if(key == "mpc_srud") par.srud = (float) val;
+  else if(key == "mpc_seng") par.seng = (float) val;
+  else if(key == "mpc_rrand") par.rrand = (float) val;
+  else return false;
+  return true;
+}
+
+static bool set_apc_par(s_scenario & sc, const string & key, const double val)
+{
+  if(key == "pc") sc.apc.pc = (float) val;
+  else if(key == "ic") sc.apc.ic = (float) val;
+  else if(key == "dc") sc.apc.dc = (float) val;
+  else if(key == "ps") sc.apc.ps = (float) val;
+  else if(key == "is") sc.apc.is = (float) val;
+  else if(key == "ds") sc.apc.ds = (float) val;
+  else if(key == "smax") sc.smax = (float) val;
+  else if(key == "smin") sc.smin = (float) val;
+  else return false;
+  return true;
+}
+
+static bool parse_route(const string & str, s_scenario & sc)
+{
+  istringstream in(str);
+  string pt;
+  while(getline(in, pt, '/')){
+    double x, y;
+    if(sscanf(pt.c_str(), "%lf,%lf", &x, &y) != 2)
+      return false;
+    sc.xwp.push_back(x);
+    sc.ywp.push_back(y);
+  }
+  return !sc.xwp.empty();
+}
+
+static bool load_params(const char * fname, map<string, double> & par)
+{
+  ifstream in(fname);
+  if(!in.is_open()){
+    cerr << "Failed to open " << fname << endl;
+    return false;
+  }
+  string line;
+  while(getline(in, line)){
+    size_t pos = line.find('#');
+    if(pos != string::npos)
+      line.erase(pos);
+    pos = line.find('=');
+    if(pos == string::npos)
+      continue;
+    istringstream key(line.substr(0, pos));
+    string name;
+    key >> name;
+    par[name] = atof(line.c_str() + pos + 1);
+  }
+  return true;
+}
+
+static bool load_scenarios(const char * fname, vector<s_scenario> & scs)
+{
+  ifstream in(fname);
+  if(!in.is_open()){
+    cerr << "Failed to open " << fname << endl;
+    return false;
+  }
+
+  string line;
+  int iline = 0;
+  while(getline(in, line)){
+    iline++;
+    size_t pos = line.find('#');
+    if(pos != string::npos)
+      line.erase(pos);
+    istringstream tok(line);
+    s_scenario sc;
+    if(!(tok >> sc.name))
+      continue;
+    if(!(tok >> sc.seed >> sc.tdur)){
+      cerr << fname << ":" << iline << " <name> <seed> <duration> required." << endl;
+      return false;
+    }
+
+    string kv;
+    while(tok >> kv){
+      pos = kv.find('=');
+      if(pos == string::npos){
+	cerr << fname << ":" << iline << " " << kv << " is not <key>=<value>." << endl;
+	return false;
+      }
+      string key = kv.substr(0, pos);
+      string str = kv.substr(pos + 1);
+      double val = atof(str.c_str());
+      if(key == "route"){
+	if(!parse_route(str, sc)){
+	  cerr << fname << ":" << iline << " Bad route " << str << endl;
+	  return false;
+	}
+      }
+      else if(key == "ctrl"){
+	if(str == "pid") sc.bpid = true;
+	else if(str == "mpc") sc.bpid = false;
+	else{
+	  cerr << fname << ":" << iline << " ctrl should be pid or mpc." << endl;
+	  return false;
+	}
+      }
+      else if(key == "lat") sc.lat = val;
+      else if(key == "lon") sc.lon = val;
+      else if(key == "rarv") sc.rarv = val;
+      else if(key == "sog") sc.sog = val;
+      else if(key == "sog0") sc.sog0 = val;
+      else if(key == "nais") sc.nais = (int) val;
+      else if(key == "ais_smin") sc.ais_smin = val;
+      else if(key == "ais_smax") sc.ais_smax = val;
+      else if(key == "rav") sc.rav = val;
+      else if(key == "dt") sc.dt = val;
+      else if(key == "tctrl") sc.tctrl = val;
+      else if(key == "meng_min") sc.meng_min = (float) val;
+      else if(key == "meng_max") sc.meng_max = (float) val;
+      else if(!set_apc_par(sc, key, val) && !set_mpc_par(sc.mpc, key, val))
+	sc.mpar[key] = val;
+    }
+
+    if(sc.xwp.empty()){
+      cerr << fname << ":" << iline << " route is not given." << endl;
+      return false;
+    }
+    if(sc.dt <= 0. || sc.tdur <= 0. || sc.tctrl < sc.dt){
+      cerr << fname << ":" << iline << " Bad dt, tctrl or duration." << endl;
+      return false;
+    }
+    scs.push_back(sc);
+  }
+  return true;
+}
+
+// AIS ships cross the route at the time the own ship is expected there,
+// from random directions at random speeds.
+static void gen_ais(const s_scenario & sc, vector<s_ais> & ais)
+{
+  unsigned int s = (sc.seed ? sc.seed : 1);
+  double len = 0.;
+  for (size_t iwp = 0; iwp < sc.xwp.size(); iwp++){
+    double x0 = (iwp == 0 ? 0. : sc.xwp[iwp - 1]);
+    double y0 = (iwp == 0 ? 0. : sc.ywp[iwp - 1]);
+    len += sqrt((sc.xwp[iwp] - x0) * (sc.xwp[iwp] - x0) +
+		(sc.ywp[iwp] - y0) * (sc.ywp[iwp] - y0));
+  }
+  double sog_ms = max(sc.sog, 1.) * (1852. / 3600.);
+
+  ais.resize(sc.nais);
+  for (int iais = 0; iais < sc.nais; iais++){
+    // crossing point on the route
+    double d = urand(s, 0.2, 0.8) * len, dc = d;
+    double xc = 0., yc = 0.;
+    for (size_t iwp = 0; iwp < sc.xwp.size(); iwp++){
+      double x0 = (iwp == 0 ? 0. : sc.xwp[iwp - 1]);
+      double y0 = (iwp == 0 ? 0. : sc.ywp[iwp - 1]);
+      double dx = sc.xwp[iwp] - x0, dy = sc.ywp[iwp] - y0;
+      double l = sqrt(dx * dx + dy * dy);
+      if(l >= d || iwp == sc.xwp.size() - 1){
+	double r = (l > 0. ? min(d / l, 1.) : 0.);
+	xc = x0 + r * dx;
+	yc = y0 + r * dy;
+	break;
+      }
+      d -= l;
+    }
+
+    double crs = urand(s, -PI, PI);
+    double spd = urand(s, sc.ais_smin, sc.ais_smax) * (1852. / 3600.);
+    double tc = dc / sog_ms;
+    s_ais & a = ais[iais];
+    a.vx = spd * sin(crs);
+    a.vy = spd * cos(crs);
+    a.x = xc - a.vx * tc;
+    a.y = yc - a.vy * tc;
+  }
+}
+
+static void run(void * arg)
+{
+  s_run * pr = (s_run *) arg;
+  s_batch & b = *pr->pb;
+  s_scenario & sc = *pr->psc;
+  long long twall = get_mono_time_nsec();
+
+  // nominal model for the MPC, and the simulated boat
+  c_model_aws1 * pnom = new c_model_aws1, * ptru = new c_model_aws1;
+  pnom->alloc_param();
+  ptru->alloc_param();
+  pnom->set_params(b.par);
+  ptru->set_params(b.par);
+  if(!sc.mpar.empty() && (size_t) ptru->set_params(sc.mpar) != sc.mpar.size())
+    cerr << sc.name << ": some of the parameters are unknown." << endl;
+
+  c_ap_ctrl apc = sc.apc;
+  c_mpc * pmpc = NULL;
+  bool binit = true;
+  if(!sc.bpid){
+    pmpc = new c_mpc;
+    pmpc->set_models(&pnom->mrctrl, &pnom->mectrl,
+		     &pnom->mobf, &pnom->mobfp, &pnom->mobfb,
+		     &pnom->m3dof, &pnom->m3dofp, &pnom->m3dofb, pnom->vplane);
+    pmpc->set_seed(sc.seed);
+    binit = pmpc->init(sc.mpc);
+  }
+
+  vector<s_ais> ais;
+  gen_ais(sc, ais);
+
+  ofstream fcsv, fbin;
+  string fname = b.outdir + "/" + sc.name;
+  fcsv.open((fname + ".csv").c_str(), ios::binary);
+  if(fcsv.is_open())
+    c_model_aws1::write_csv_header(fcsv);
+  else
+    cerr << "Failed to open " << fname << ".csv" << endl;
+  if(b.bbin){
+    fbin.open((fname + ".bin").c_str(), ios::binary);
+    if(!fbin.is_open())
+      cerr << "Failed to open " << fname << ".bin" << endl;
+  }
+
+  // initial state, heading to the first waypoint
+  double yaw0 = atan2(sc.xwp[0], sc.ywp[0]);
+  s_aws1_sim_state st(0, sc.lat * (PI / 180.), sc.lon * (PI / 180.),
+		      0., 0., yaw0, (yaw0 < 0 ? yaw0 + 2 * PI : yaw0), sc.sog0,
+		      127.f, 127.f, 0.f, 0.f);
+  st.rev = calc_outboard_rev(0.f);
+  s_aws1_sim_state stn = st;
+  s_rot3 R0 = st.Rwrld;
+  double xorg = st.xe, yorg = st.ye, zorg = st.ze;
+
+  const double kts2ms = 1852. / 3600.;
+  const long long dtt = (long long)(sc.dt * SEC);
+  const long long nsteps = (long long)(sc.tdur / sc.dt + 0.5);
+  const int nctrl = max(1, (int)(sc.tctrl / sc.dt + 0.5));
+  const int nrec = max(1, (int)(b.trec / sc.dt + 0.5));
+
+  float rud = 127.f, eng = 127.f;
+  size_t iwp = 0;
+  const char * status = (binit ? "timeout" : "init_failed");
+  double tarv = -1., len = 0., dmin = DBL_MAX, serr = 0.;
+  long long nintr = 0, nplan = 0, tplan = 0, istep = 0;
+  double x = 0., y = 0., z = 0.;
+
+  for (; binit && istep < nsteps; istep++){
+    long long t = istep * dtt;
+    double tsec = (double) istep * sc.dt;
+
+    if(istep % nctrl == 0){
+      while(iwp < sc.xwp.size()){
+	double dx = sc.xwp[iwp] - x, dy = sc.ywp[iwp] - y;
+	if(dx * dx + dy * dy > sc.rarv * sc.rarv)
+	  break;
+	iwp++;
+      }
+      if(iwp == sc.xwp.size()){
+	status = "arrived";
+	tarv = tsec;
+	break;
+      }
+
+      if(sc.bpid){
+	// f_aws1_ap::wp() with the course difference of f_wp_manager
+	float cdiff = c_ap_ctrl::calc_cdiff((float)(sc.xwp[iwp] - x),
+					    (float)(sc.ywp[iwp] - y),
+					    (float)(st.cog * (180. / PI)));
+	apc.ctrl_to_cog(cdiff, 127.f, false, rud);
+	apc.ctrl_to_sog((float) st.sog, (float) sc.sog, sc.smax, sc.smin,
+			sc.meng_max, 127.f, rud, eng);
+      }else{
+	double phi = st.cog - st.yaw;
+	double sog_ms = st.sog * kts2ms;
+	s_mpc_state ms;
+	ms.yaw = (float) st.yaw;
+	ms.u = (float)(sog_ms * cos(phi));
+	ms.v = (float)(sog_ms * sin(phi));
+	ms.r = (float) st.ryaw;
+	pmpc->set_state(ms);
+	pmpc->set_control(rud, eng, sc.meng_min, sc.meng_max);
+	pmpc->set_waypoint((float)(sc.xwp[iwp] - x), (float)(sc.ywp[iwp] - y),
+			   (float)(sc.sog * kts2ms));
+	pmpc->clear_obst();
+	for (size_t iais = 0; iais < ais.size(); iais++){
+	  const s_ais & a = ais[iais];
+	  pmpc->add_obst((float)(a.x + a.vx * tsec - x),
+			 (float)(a.y + a.vy * tsec - y),
+			 (float) a.vx, (float) a.vy, (float) sc.rav);
+	}
+	pmpc->plan(t, rud, eng);
+	tplan += pmpc->get_proc_time();
+	nplan++;
+      }
+    }
+
+    st.t = t;
+    st.rud = rud;
+    st.eng = eng;
+    stn = st;
+    ptru->update(st, stn, sc.dt);
+    stn.t = t + dtt;
+    stn.rud = rud;
+    stn.eng = eng;
+    if(pmpc)
+      pmpc->update_actuator(rud, eng, (float) sc.dt);
+
+    if(stn.sog != stn.sog || stn.yaw != stn.yaw){
+      status = "diverged";
+      break;
+    }
+
+    double xn, yn;
+    eceftowrld(R0, xorg, yorg, zorg, &stn.xe, &stn.ye, &stn.ze,
+	       &xn, &yn, &z, 1);
+    len += sqrt((xn - x) * (xn - x) + (yn - y) * (yn - y));
+    x = xn;
+    y = yn;
+
+    double tn = tsec + sc.dt;
+    for (size_t iais = 0; iais < ais.size(); iais++){
+      double dx = ais[iais].x + ais[iais].vx * tn - x;
+      double dy = ais[iais].y + ais[iais].vy * tn - y;
+      double d = sqrt(dx * dx + dy * dy);
+      dmin = min(dmin, d);
+      if(d < sc.rav)
+	nintr++;
+    }
+    serr += fabs(stn.sog - sc.sog);
+
+    if(istep % nrec == 0){
+      if(fcsv.is_open())
+	c_model_aws1::write_csv(fcsv, stn.t, stn, st);
+      if(fbin.is_open()){
+	s_sim_rec rec;
+	rec.t = stn.t;
+	rec.lat = stn.lat;
+	rec.lon = stn.lon;
+	rec.x = x;
+	rec.y = y;
+	rec.yaw = stn.yaw;
+	rec.cog = stn.cog;
+	rec.sog = stn.sog;
+	rec.rud = stn.rud;
+	rec.eng = stn.eng;
+	rec.rev = stn.rev;
+	fbin.write((const char*)&rec, sizeof(rec));
+      }
+    }
+    st = stn;
+  }
+
+  double tsim = (double) istep * sc.dt;
+  double tw = (double)(get_mono_time_nsec() - twall) * 1e-9;
+  delete pmpc;
+  delete pnom;
+  delete ptru;
+
+  b.mtx.lock();
+  b.fsum << sc.name << "," << sc.seed << "," << status << ","
+	 << tarv << "," << len << ","
+	 << (dmin == DBL_MAX ? -1. : dmin) << "," << nintr << ","
+	 << (istep > 0 ? serr / (double) istep : 0.) << ","
+	 << istep << "," << tw << "," << (tw > 0. ? tsim / tw : 0.) << ","
+	 << (nplan > 0 ? (double) tplan * 1e-6 / (double) nplan : 0.)
+	 << endl;
+  printf("%-16s %-11s %8.1f sim sec %7.3f wall sec x%.0f\n",
+	 sc.name.c_str(), status, tsim, tw, (tw > 0. ? tsim / tw : 0.));
+  b.tsim += tsim;
+  b.twall += tw;
+  b.nruns++;
+  b.mtx.unlock();
+}
+
+int main(int argc, char ** argv)
+{
+  const char * fscn = NULL, * fpar = NULL;
+  s_batch b;
+  b.outdir = ".";
+  b.trec = 0.;
+  b.bbin = false;
+  b.tsim = b.twall = 0.;
+  b.nruns = 0;
+  int nth = 0;
+
+  for (int iarg = 1; iarg < argc; iarg++){
+    if(strcmp(argv[iarg], "-p") == 0 && iarg + 1 < argc)
+      fpar = argv[++iarg];
+    else if(strcmp(argv[iarg], "-o") == 0 && iarg + 1 < argc)
+      b.outdir = argv[++iarg];
+    else if(strcmp(argv[iarg], "-j") == 0 && iarg + 1 < argc)
+      nth = atoi(argv[++iarg]);
+    else if(strcmp(argv[iarg], "-i") == 0 && iarg + 1 < argc)
+      b.trec = atof(argv[++iarg]);
+    else if(strcmp(argv[iarg], "-b") == 0)
+      b.bbin = true;
+    else if(argv[iarg][0] != '-' && !fscn)
+      fscn = argv[iarg];
+    else
+      fscn = NULL, iarg = argc;
+  }
+
+  if(!fscn){
+    cout << "Usage: sim_batch <scenario list> [-p <param file>] [-o <output dir>] [-j <threads>] [-i <record interval sec>] [-b]" << endl;
+    return 1;
+  }
+
+  if(fpar && !load_params(fpar, b.par))
+    return 1;
+
+  vector<s_scenario> scs;
+  if(!load_scenarios(fscn, scs))
+    return 1;
+
+  string fsum = b.outdir + "/summary.csv";
+  b.fsum.open(fsum.c_str(), ios::binary);
+  if(!b.fsum.is_open()){
+    cerr << "Failed to open " << fsum << endl;
+    return 1;
+  }
+  b.fsum << "name,seed,status,t_arrival,path_len,min_ais_dist,intrusion_steps,mean_sog_err,steps,wall_sec,speedup,mean_plan_ms" << endl;
+
+  vector<s_run> runs(scs.size());
+  c_thread_pool pool;
+  if(!pool.start(nth))
+    return 1;
+  int nworkers = pool.get_num_workers(); // cleared by stop()
+
+  long long t0 = get_mono_time_nsec();
+  for (size_t isc = 0; isc < scs.size(); isc++){
+    runs[isc].pb = &b;
+    runs[isc].psc = &scs[isc];
+    pool.push(run, &runs[isc]);
+  }
+  pool.stop();
+  double tw = (double)(get_mono_time_nsec() - t0) * 1e-9;
+
+  printf("%d runs on %d threads, %.1f sim sec in %.3f wall sec (x%.0f, x%.0f per run)\n",
+	 b.nruns, nworkers,
+	 b.tsim, tw, (tw > 0. ? b.tsim / tw : 0.),
+	 (b.twall > 0. ? b.tsim / b.twall : 0.));
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright(c) 2019 Yohei Matsumoto, All right reserved.
+
+// voc2bin.cpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// voc2bin.cpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with voc2bin.cpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// voc2bin converts the ORB vocabulary in DBoW2 text format to the binary
+// format, and reports the time to load each. The binary file is the same
+// as the cache f_orb_slam creates next to the text file (<text file>.bin),
+// so converting once in advance saves the first start up on the boards.
+// Built only with ORB_SLAM=y (make voc2bin).
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include "c_lat_hist.h"
+#include "../orb_slam/ORBVocabulary.h"
+
+using namespace ORB_SLAM2;
+
+int main(int argc, char ** argv)
+{
+  if(argc < 2){
+    cout << "Usage: voc2bin <text vocabulary> [<binary vocabulary>]" << endl;
+    return 1;
+  }
+
+  string ftxt(argv[1]);
+  string fbin(argc > 2 ? argv[2] : ftxt + ".bin");
+
+  ORBVocabulary voc;
+  long long t0 = get_mono_time_nsec();
+  if(!voc.loadFromTextFile(ftxt)){
+    cerr << "Failed to load " << ftxt << endl;
+    return 1;
+  }
+  long long ttxt = get_mono_time_nsec() - t0;
+
+  if(!voc.saveToBinaryFile(fbin)){
+    cerr << "Failed to save " << fbin << endl;
+    return 1;
+  }
+
+  ORBVocabulary vocb;
+  t0 = get_mono_time_nsec();
+  if(!vocb.loadFromBinaryFile(fbin)){
+    cerr << "Failed to reload " << fbin << endl;
+    return 1;
+  }
+  long long tbin = get_mono_time_nsec() - t0;
+
+  if(vocb.size() != voc.size()){
+    cerr << "Number of words mismatch " << vocb.size() << " != " << voc.size() << endl;
+    return 1;
+  }
+
+  printf("%u words. load text %.3f sec, binary %.3f sec\n",
+	 voc.size(), (double) ttxt * 1e-9, (double) tbin * 1e-9);
+  return 0;
+}